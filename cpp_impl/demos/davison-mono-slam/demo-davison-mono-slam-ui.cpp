@@ -44,13 +44,18 @@ auto EllipsePntPolarToEuclid(Scalar semi_major, Scalar semi_minor, Scalar theta)
 }
 
 SrkColor GetSalientPointColor(const TrackedSalientPoint& sal_pnt)
+{
+    return GetSalientPointColor(sal_pnt.track_status);
+}
+
+SrkColor GetSalientPointColor(SalPntTrackStatus track_status)
 {
     SrkColor new_sal_pnt_color{ 0, 255, 0 }; // green
     SrkColor matched_sal_pnt_color{ 255, 0, 0 }; // red
     SrkColor unobserved_sal_pnt_color{ 255, 255, 0 }; // yellow
     SrkColor default_sal_pnt_color{ 255, 255, 255 };
     SrkColor* sal_pnt_color = &default_sal_pnt_color;
-    switch (sal_pnt.track_status)
+    switch (track_status)
     {
     case SalPntTrackStatus::New:
         sal_pnt_color = &new_sal_pnt_color;
@@ -322,16 +327,14 @@ void RenderCameraTrajectory(const std::vector<SE3Transform>& gt_cam_orient_cfw,
     }
 }
 
-void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::SalPntId sal_pnt_id)
+void RenderSalientTemplate(const PublishedSalientPoint& sal_pnt, suriko::Sizei templ_size)
 {
     MarkUsedTrackerStateToVisualize();
-    std::optional<SalPntRectFacet> rect = mono_slam->ProtrudeSalientTemplateIntoWorld(sal_pnt_id);
+    const std::optional<SalPntRectFacet>& rect = sal_pnt.templ_rect_w;
     if (!rect.has_value())
         return;
 
-    const TrackedSalientPoint& sal_pnt = mono_slam->GetSalientPoint(sal_pnt_id);
-
-    bool in_virtual_mode = sal_pnt.initial_templ_gray_.empty();
+    bool in_virtual_mode = sal_pnt.initial_templ_gray.empty();
     if (in_virtual_mode)
     {
         // in virtual mode render just an outline of the template
@@ -356,8 +359,8 @@ void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::Sa
     {
         // render an image of rectangular template, associated with salient point
         // NOTE: glTexImage2D requires a texture size to be 2^N
-        const GLsizei tex_width = static_cast<GLsizei>(CeilPow2N(mono_slam->sal_pnt_templ_size_.width));
-        const GLsizei tex_height = static_cast<GLsizei>(CeilPow2N(mono_slam->sal_pnt_templ_size_.height));
+        const GLsizei tex_width = static_cast<GLsizei>(CeilPow2N(templ_size.width));
+        const GLsizei tex_height = static_cast<GLsizei>(CeilPow2N(templ_size.height));
 
         glEnable(GL_TEXTURE_2D);
 
@@ -369,7 +372,7 @@ void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::Sa
         static cv::Mat tex_bgr(tex_height, tex_width, CV_8UC3);
 
         // put template into the bottom-left corner of the texture
-        cv::Rect templ_bounds{ 0, tex_height - mono_slam->sal_pnt_templ_size_.height, mono_slam->sal_pnt_templ_size_.width, mono_slam->sal_pnt_templ_size_.height };
+        cv::Rect templ_bounds{ 0, tex_height - templ_size.height, templ_size.width, templ_size.height };
         cv::Mat templ_submat{ tex_bgr, templ_bounds };
 
         bool templ_constructed = false;
@@ -384,7 +387,7 @@ void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::Sa
 #endif
         if (!templ_constructed)
         {
-            cv::cvtColor(sal_pnt.initial_templ_gray_, templ_submat, cv::COLOR_GRAY2BGR);
+            cv::cvtColor(sal_pnt.initial_templ_gray, templ_submat, cv::COLOR_GRAY2BGR);
         }
 
         // cv::Mat must be prepared to be used as texture in OpenGL, see https://stackoverflow.com/questions/16809833/opencv-image-loading-for-opengl-texture
@@ -407,8 +410,8 @@ void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::Sa
         glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);  // do not mix texture color with background
 
         // template is in the bottom-left corner of the texture
-        GLfloat tex_max_x = static_cast<GLfloat>(mono_slam->sal_pnt_templ_size_.width) / tex_width;
-        GLfloat tex_max_y = static_cast<GLfloat>(mono_slam->sal_pnt_templ_size_.height) / tex_height;
+        GLfloat tex_max_x = static_cast<GLfloat>(templ_size.width) / tex_width;
+        GLfloat tex_max_y = static_cast<GLfloat>(templ_size.height) / tex_height;
 
         using PointIndAndTexCoord = std::tuple<size_t, std::array <GLfloat, 2>>;
         std::array< PointIndAndTexCoord, 4> vertex_and_tex_coords = {
@@ -436,27 +439,23 @@ void RenderSalientTemplate(const DavisonMonoSlam* mono_slam, DavisonMonoSlam::Sa
     }
 }
 
-void RenderMap(const DavisonMonoSlam* mono_slam, Scalar covar3D_to_ellipsoid_chi_square,
+void RenderMap(const DavisonMonoSlamPublishedState& tracker_state, suriko::Sizei templ_size, Scalar covar3D_to_ellipsoid_chi_square,
     bool display_3D_uncertainties,
     size_t dots_per_ellipse,
     bool ui_swallow_exc)
 {
-    for (DavisonMonoSlam::SalPntId sal_pnt_id : mono_slam->GetSalientPoints())
+    for (const PublishedSalientPoint& sal_pnt : tracker_state.sal_pnts)
     {
-        const TrackedSalientPoint& sal_pnt = mono_slam->GetSalientPoint(sal_pnt_id);
-
-        SrkColor sal_pnt_color = GetSalientPointColor(sal_pnt);
+        SrkColor sal_pnt_color = GetSalientPointColor(sal_pnt.track_status);
         glColor3fv(GLColorRgb(sal_pnt_color).data());
 
         MarkUsedTrackerStateToVisualize();
-        Point3 sal_pnt_pos;
-        Eigen::Matrix<Scalar, 3, 3> sal_pnt_pos_uncert;
-        bool got_3d_pos = mono_slam->GetSalientPointEstimated3DPosWithUncertaintyNew(sal_pnt_id, &sal_pnt_pos, &sal_pnt_pos_uncert);
-        if (got_3d_pos)
+        if (sal_pnt.pos_w.has_value())
         {
+            const Point3& sal_pnt_pos = sal_pnt.pos_w.value();
             if (display_3D_uncertainties)
             {
-                RenderPosUncertaintyMatAsEllipsoid(sal_pnt_pos, sal_pnt_pos_uncert, covar3D_to_ellipsoid_chi_square, dots_per_ellipse, ui_swallow_exc);
+                RenderPosUncertaintyMatAsEllipsoid(sal_pnt_pos, sal_pnt.pos_uncert, covar3D_to_ellipsoid_chi_square, dots_per_ellipse, ui_swallow_exc);
             }
 
             glBegin(GL_POINTS);
@@ -468,11 +467,7 @@ void RenderMap(const DavisonMonoSlam* mono_slam, Scalar covar3D_to_ellipsoid_chi
             // of salient point pixels template) may be visually off, which indicates some errors in estimation
             if (sal_pnt.IsDetected())
             {
-                RenderSalientTemplate(mono_slam, sal_pnt_id);
-            }
-            else
-            {
-                SRK_ASSERT(true);
+                RenderSalientTemplate(sal_pnt, templ_size);
             }
         }
         else
@@ -533,7 +528,10 @@ void RenderScene(const UIThreadParams& ui_params, const DavisonMonoSlam* mono_sl
 
         RenderAxes(0.5, 2); // axes of the tracker's origin (=cam0)
 
-        RenderMap(mono_slam, covar3D_to_ellipsoid_chi_square, display_3D_uncertainties, dots_per_ellipse, ui_swallow_exc);
+        // the tracker may be processing the next frame, hence render the latest published snapshot of its state
+        std::shared_ptr<const DavisonMonoSlamPublishedState> tracker_state = mono_slam->GetPublishedState();
+        if (tracker_state != nullptr)
+            RenderMap(*tracker_state, mono_slam->sal_pnt_templ_size_, covar3D_to_ellipsoid_chi_square, display_3D_uncertainties, dots_per_ellipse, ui_swallow_exc);
 
         // render history of camera's positions (schematic)
         std::array<float, 3> actual_track_color{ 128 / 255.0f, 255 / 255.0f, 255 / 255.0f }; // cyan
@@ -544,24 +542,17 @@ void RenderScene(const UIThreadParams& ui_params, const DavisonMonoSlam* mono_sl
         }
 
         // render current (the latest) camera position
+        if (tracker_state != nullptr)
         {
             MarkUsedTrackerStateToVisualize();
-            CameraStateVars cam_vars = mono_slam->GetCameraEstimatedVars();
+            const CameraStateVars& cam_vars = tracker_state->cam_state;
             SE3Transform cam_wfc = CamWfc(cam_vars);
             RenderSchematicCamera(cam_wfc, cam_instrinsics, actual_track_color, CamDisplayType::Schematic);
-        }
 
-        if (display_3D_uncertainties)
-        {
-            Point3 cam_pos;
-            Eigen::Matrix<Scalar, 3, 3> cam_pos_uncert;
-            Eigen::Matrix<Scalar, 4, 1> cam_orient_quat_wfc;
-            mono_slam->GetCameraEstimatedPosAndOrientationWithUncertainty(&cam_pos, &cam_pos_uncert, &cam_orient_quat_wfc);
-
-            Eigen::Matrix<Scalar, 3, 3> cam_orient_wfc;
-            RotMatFromQuat(gsl::make_span<const Scalar>(cam_orient_quat_wfc.data(), 4), &cam_orient_wfc);
-
-            RenderPosUncertaintyMatAsEllipsoid(cam_pos, cam_pos_uncert, covar3D_to_ellipsoid_chi_square, dots_per_ellipse, ui_swallow_exc);
+            if (display_3D_uncertainties)
+            {
+                RenderPosUncertaintyMatAsEllipsoid(cam_vars.pos_w, tracker_state->cam_pos_uncert, covar3D_to_ellipsoid_chi_square, dots_per_ellipse, ui_swallow_exc);
+            }
         }
 
         glPopMatrix();
@@ -910,8 +901,11 @@ void SceneVisualizationPangolinGui::SetCameraBehindTracker()
     const DavisonMonoSlam& mono_slam = *s_ui_params_.mono_slam;
 
     // take camera's coordinates from filter
-    CameraStateVars cam_vars = mono_slam.GetCameraEstimatedVars();
-    SE3Transform cam_tfc = CamWfc(cam_vars);
+    // (the tracker may work in another thread, so read the published state; nothing is published before the first frame)
+    std::shared_ptr<const DavisonMonoSlamPublishedState> tracker_state = mono_slam.GetPublishedState();
+    if (tracker_state == nullptr)
+        return;
+    SE3Transform cam_tfc = CamWfc(tracker_state->cam_state);
     SE3Transform cam_cft = SE3Inv(cam_tfc);
 
     static Scalar behind_cam_dist = 5;
@@ -1008,33 +1002,29 @@ void DrawDistortedEllipseOnPicture(const RotatedEllipse2D& ellipse_pix,
     }
 }
 
-void DavisonMonoSlam2DDrawer::DrawEstimatedSalientPoint(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id,
-    cv::Mat* out_image_bgr) const
+void DavisonMonoSlam2DDrawer::DrawEstimatedSalientPoint(const PublishedSalientPoint& sal_pnt, cv::Mat* out_image_bgr) const
 {
-    const TrackedSalientPoint& sal_pnt = mono_slam.GetSalientPoint(sal_pnt_id);
-    SrkColor sal_pnt_color = GetSalientPointColor(sal_pnt);
+    SrkColor sal_pnt_color = GetSalientPointColor(sal_pnt.track_status);
     cv::Scalar sal_pnt_color_bgr = OcvColorBgr(sal_pnt_color);
 
     // we draw ellipse as a current representation of an area where a salient point is positioned
-    MarkUsedTrackerStateToVisualize();
-    auto [op_corner, corner_ellipse] = mono_slam.GetSalientPointProjectedUncertEllipse(FilterStageType::Estimated, sal_pnt_id);
-    if (op_corner)
+    // (the ellipses are extracted by the tracker for all salient points at once, when it publishes the state)
+    if (sal_pnt.estim_ellipse_pix.has_value())
     {
-        static_assert(std::is_same_v<decltype(corner_ellipse), RotatedEllipse2D>);
-        DrawDistortedEllipseOnPicture(corner_ellipse, dots_per_uncert_ellipse_, sal_pnt_color_bgr, LineType::Solid, nullptr, out_image_bgr);
+        DrawDistortedEllipseOnPicture(sal_pnt.estim_ellipse_pix.value(), dots_per_uncert_ellipse_, sal_pnt_color_bgr, LineType::Solid, nullptr, out_image_bgr);
     }
 
     // we draw a rectangle of a search area, where a salient point is expected to be in the next frame
-    if (auto [op, predict_pos_ellipse] = mono_slam.GetPredictedSalientPointProjectedUncertEllipse(sal_pnt_id); op)
+    if (sal_pnt.predicted_ellipse_pix.has_value())
     {
-        static_assert(std::is_same_v<decltype(predict_pos_ellipse), RotatedEllipse2D>);
-        Rect corner_bounds = GetEllipseBounds2(predict_pos_ellipse);
+        Rect corner_bounds = GetEllipseBounds2(sal_pnt.predicted_ellipse_pix.value());
         Recti predict_pos_rect = EncompassRect(corner_bounds);
 
         // highlight salient points outside of predicted search rect
         SrkColor search_rect_color = { 192, 192, 192 };
-        if (op_corner)
+        if (sal_pnt.estim_ellipse_pix.has_value())
         {
+            const RotatedEllipse2D& corner_ellipse = sal_pnt.estim_ellipse_pix.value();
             Point2i corner{ corner_ellipse.world_from_ellipse.T[0], corner_ellipse.world_from_ellipse.T[1] };
             bool is_in =
                 corner.x > predict_pos_rect.x && corner.x < predict_pos_rect.Right() &&
@@ -1050,11 +1040,11 @@ void DavisonMonoSlam2DDrawer::DrawEstimatedSalientPoint(const DavisonMonoSlam& m
     }
 }
 
-void DavisonMonoSlam2DDrawer::DrawScene(const DavisonMonoSlam& mono_slam, cv::Mat* out_image_bgr) const
+void DavisonMonoSlam2DDrawer::DrawScene(const DavisonMonoSlamPublishedState& tracker_state, cv::Mat* out_image_bgr) const
 {
-    for (SalPntId sal_pnt_id : mono_slam.GetSalientPoints())
+    for (const PublishedSalientPoint& sal_pnt : tracker_state.sal_pnts)
     {
-        DrawEstimatedSalientPoint(mono_slam, sal_pnt_id, out_image_bgr);
+        DrawEstimatedSalientPoint(sal_pnt, out_image_bgr);
     }
 }
 #endif
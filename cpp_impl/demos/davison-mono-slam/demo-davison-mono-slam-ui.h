@@ -23,6 +23,7 @@ struct SrkColor
 };
 
 SrkColor GetSalientPointColor(const TrackedSalientPoint& sal_pnt);
+SrkColor GetSalientPointColor(SalPntTrackStatus track_status);
 
 #if defined(SRK_HAS_PANGOLIN)
 
@@ -164,9 +165,9 @@ void SceneVisualizationThread(UIThreadParams ui_params);
 class DavisonMonoSlam2DDrawer
 {
 public:
-    void DrawScene(const DavisonMonoSlam& mono_slam, cv::Mat* out_image_bgr) const;
+    void DrawScene(const DavisonMonoSlamPublishedState& tracker_state, cv::Mat* out_image_bgr) const;
     
-    void DrawEstimatedSalientPoint(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id, cv::Mat* out_image_bgr) const;
+    void DrawEstimatedSalientPoint(const PublishedSalientPoint& sal_pnt, cv::Mat* out_image_bgr) const;
 public:
     // Determines confidence interval to convert error in 3D position covariance matrix into ellipsoid (x/a)^2+(y/b)^2+(z/c)^2=chi^2.
     // Here we take chi^2 instead of more user-friendly 'confidence interval', because in 3D there is no simple formula 'confidence interval'->chi^2.
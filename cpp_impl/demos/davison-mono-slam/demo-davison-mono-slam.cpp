@@ -5,6 +5,8 @@
 #include <fstream>
 #include <functional>
 #include <numeric>
+#include <algorithm>
+#include <limits>
 #include <utility>
 #include <cassert>
 #include <cmath>
@@ -12,6 +14,7 @@
 #include <tuple>
 #include <chrono>
 #include <thread>
+#include <future>
 #include <condition_variable>
 #include <sstream>
 #include <filesystem>
@@ -403,6 +406,14 @@ public:
         std::memcpy(&frag.user_obj, &sal_pnt_id, sizeof(sal_pnt_id));
     }
 
+    void OnSalientPointIsRemoved(SalPntId sal_pnt_id) override
+    {
+        // the id of the removed salient point may be reused by a new one
+        std::optional<size_t> frag_id = DemoGetSalPntFramgmentId(entire_map_, sal_pnt_id);
+        if (frag_id.has_value())
+            entire_map_.GetSalientPointNew(frag_id.value()).user_obj = nullptr;
+    }
+
     suriko::Point2f GetBlobCoord(CornersMatcherBlobId blob_id) override
     {
         return detected_blobs_[blob_id.Ind].Coord;
@@ -427,14 +438,42 @@ public:
 
 class ImageTemplCornersMatcher : public CornersMatcherBase
 {
+protected:
     cv::Ptr<cv::ORB> detector_;
     std::vector<cv::KeyPoint> new_keypoints_;
+    std::vector<cv::KeyPoint> candidate_keypoints_;  // detected in current frame, sorted from high quality to low
+    std::map<SalPntId, suriko::Point2f> prev_centers_;  // salient points, observed in the previous frame
+    std::map<SalPntId, suriko::Point2f> cur_centers_;
+    cv::Mat prev_gray_;
+    BlockChangeMap block_change_map_;  // the blocks of current frame, which differ from the previous frame
+    size_t reused_matches_count_ = 0;
+
+    // The appearance of the template of a salient point in current frame.
+    struct PredictedTemplate
+    {
+        cv::Mat templ_gray;
+        Scalar templ_mean;
+        Scalar templ_sqrt_sum_sqr_diff;
+        std::array<Eigen::Matrix<Scalar, 2, 1>, 4> corner_offsets;  // the corners of the warp relative to their centroid
+    };
+    std::map<SalPntId, PredictedTemplate> warped_templs_;  // the last warp of each salient point
 public:
     bool stop_on_sal_pnt_moved_too_far_ = false;
     std::function<void(DavisonMonoSlam&, SalPntId, cv::Mat*)> draw_sal_pnt_fun_;
     std::function<void(std::string_view, cv::Mat)> show_image_fun_;
     std::optional<suriko::Sizei> min_search_rect_size_;
     std::optional<Scalar> min_templ_corr_coeff_;
+
+    // In a static scene the previous match of a salient point is reused without the search when the predicted position
+    // of the salient point barely moved and the image around it didn't change.
+    std::optional<Scalar> static_scene_max_block_diff_;  // the max mean absolute difference of intensity in unchanged block; null=never reuse
+    Scalar static_scene_max_predicted_shift_pix_ = 0.5;
+    int static_scene_block_size_ = 16;
+
+    // The template is warped into the predicted view by the homography, induced by the plane of the template.
+    // The warp of the salient point is recomputed only when a corner of the template moves further than this threshold
+    // (relative to the others); null=never warp.
+    std::optional<Scalar> templ_warp_min_corner_shift_pix_;
 public:
     ImageTemplCornersMatcher()
     {
@@ -446,10 +485,155 @@ public:
     void AnalyzeFrame(size_t frame_ind, const Picture& image) override
     {
         new_keypoints_.clear();
+        reused_matches_count_ = 0;
+        prev_centers_ = std::move(cur_centers_);
+        cur_centers_.clear();
+
+        if (static_scene_max_block_diff_.has_value())
+        {
+            block_change_map_ = BlockChangeMap{};
+            bool same_size = prev_gray_.rows == image.gray.rows && prev_gray_.cols == image.gray.cols;
+            if (!prev_gray_.empty() && same_size)
+                CalcBlockChangeMap(prev_gray_, image.gray, static_scene_block_size_, static_cast<float>(static_scene_max_block_diff_.value()), &block_change_map_);
+            prev_gray_ = image.gray;
+        }
 
         if (suppress_observations_) return;
     }
 
+    size_t ReusedMatchesCount() const override { return reused_matches_count_; }
+
+    /// Gets the match of the salient point in the previous frame, if it is still valid in current frame.
+    std::optional<suriko::Point2f> ReuseMatchInStaticScene(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id) const
+    {
+        if (!static_scene_max_block_diff_.has_value())
+            return std::nullopt;
+
+        auto prev_it = prev_centers_.find(sal_pnt_id);
+        if (prev_it == prev_centers_.end())
+            return std::nullopt;
+        const suriko::Point2f& prev_center = prev_it->second;
+
+        auto [op, predicted_center] = mono_slam.GetSalientPointProjected2DPosWithUncertainty(FilterStageType::Predicted, sal_pnt_id);
+        static_assert(std::is_same_v<decltype(predicted_center), MeanAndCov2D>);
+        if (!op || (predicted_center.mean - prev_center.Mat()).norm() > static_scene_max_predicted_shift_pix_)
+            return std::nullopt;
+
+        Point2i top_left = mono_slam.TemplateTopLeftInt(prev_center);
+        Recti templ_rect{ top_left.x, top_left.y, mono_slam.sal_pnt_templ_size_.width, mono_slam.sal_pnt_templ_size_.height };
+        if (block_change_map_.AnyChanged(templ_rect))
+            return std::nullopt;
+        return prev_center;
+    }
+
+    /// The corners of the unwarped template in its own coordinates, in the order of SalPntRectFacet.
+    static std::array<suriko::Point2f, 4> TemplateRectCorners(suriko::Sizei templ_size)
+    {
+        std::array<suriko::Point2f, 4> result;
+        result[SalPntRectFacet::kTopLeftInd] = suriko::Point2f{ 0, 0 };
+        result[SalPntRectFacet::kTopRightInd] = suriko::Point2f{ templ_size.width, 0 };
+        result[SalPntRectFacet::kBotLeftInd] = suriko::Point2f{ 0, templ_size.height };
+        result[SalPntRectFacet::kBotRightInd] = suriko::Point2f{ templ_size.width, templ_size.height };
+        return result;
+    }
+
+    static std::array<Eigen::Matrix<Scalar, 2, 1>, 4> CornerOffsetsFromCentroid(const std::array<suriko::Point2f, 4>& corners)
+    {
+        Eigen::Matrix<Scalar, 2, 1> centroid = Eigen::Matrix<Scalar, 2, 1>::Zero();
+        for (const auto& c : corners)
+            centroid += c.Mat();
+        centroid /= static_cast<Scalar>(corners.size());
+
+        std::array<Eigen::Matrix<Scalar, 2, 1>, 4> result;
+        for (size_t i = 0; i < corners.size(); ++i)
+            result[i] = corners[i].Mat() - centroid;
+        return result;
+    }
+
+    static Scalar MaxCornerShift(const std::array<Eigen::Matrix<Scalar, 2, 1>, 4>& a, const std::array<Eigen::Matrix<Scalar, 2, 1>, 4>& b)
+    {
+        Scalar result = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            result = std::max(result, (a[i] - b[i]).norm());
+        return result;
+    }
+
+    /// Warps the initial template of the salient point into the quadrangle with given corners.
+    /// The salient point stays at the same offset from the top-left corner of the warped template.
+    std::optional<PredictedTemplate> WarpSalientPointTemplate(const DavisonMonoSlam& mono_slam, const TrackedSalientPoint& sal_pnt,
+        const std::array<suriko::Point2f, 4>& corners) const
+    {
+        std::optional<Eigen::Matrix<Scalar, 3, 3>> templ_to_image = HomographyFrom4Points(TemplateRectCorners(mono_slam.sal_pnt_templ_size_), corners);
+        if (!templ_to_image.has_value())
+            return std::nullopt;
+
+        // shift the warped template, so that the salient point is kept in place
+        const suriko::Point2f& center_offset = sal_pnt.OffsetFromTopLeft();
+        Eigen::Matrix<Scalar, 3, 1> center_img = templ_to_image.value() * Eigen::Matrix<Scalar, 3, 1>{ center_offset[0], center_offset[1], 1 };
+        if (IsClose(0, center_img[2]))
+            return std::nullopt;
+        Eigen::Matrix<Scalar, 2, 1> shift = center_img.head<2>() / center_img[2] - center_offset.Mat();
+
+        Eigen::Matrix<Scalar, 3, 3> templ_to_warped = Eigen::Matrix<Scalar, 3, 3>::Identity();
+        templ_to_warped.topRightCorner<2, 1>() = -shift;
+        templ_to_warped = templ_to_warped * templ_to_image.value();
+
+        cv::Mat templ_to_warped_cv(3, 3, CV_64F);
+        for (int row = 0; row < 3; ++row)
+            for (int col = 0; col < 3; ++col)
+                templ_to_warped_cv.at<double>(row, col) = static_cast<double>(templ_to_warped(row, col));
+
+        const suriko::Sizei templ_size = mono_slam.sal_pnt_templ_size_;
+        PredictedTemplate result;
+        cv::warpPerspective(sal_pnt.initial_templ_gray_, result.templ_gray, templ_to_warped_cv, cv::Size{ templ_size.width, templ_size.height },
+            cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+        auto templ_roi = Recti{ 0, 0, templ_size.width, templ_size.height };
+        result.templ_mean = GetGrayImageMean(result.templ_gray, templ_roi);
+        Scalar templ_sum_sqr_diff = GetGrayImageSumSqrDiff(result.templ_gray, templ_roi, result.templ_mean);
+        if (IsClose(0, templ_sum_sqr_diff))
+            return std::nullopt;  // correlation coefficient is undefined
+        result.templ_sqrt_sum_sqr_diff = std::sqrt(templ_sum_sqr_diff);
+        result.corner_offsets = CornerOffsetsFromCentroid(corners);
+        return result;
+    }
+
+    /// Gets the template of the salient point as it is expected to look in current frame.
+    /// Falls back to the initial template, when the view barely changed or the warp can't be predicted.
+    PredictedTemplate GetPredictedTemplate(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id)
+    {
+        const TrackedSalientPoint& sal_pnt = mono_slam.GetSalientPoint(sal_pnt_id);
+        PredictedTemplate initial_templ{ sal_pnt.initial_templ_gray_, sal_pnt.templ_stats.templ_mean_, sal_pnt.templ_stats.templ_sqrt_sum_sqr_diff_ };
+        if (!templ_warp_min_corner_shift_pix_.has_value())
+            return initial_templ;
+
+        std::optional<std::array<suriko::Point2f, 4>> corners = mono_slam.PredictSalientPointTemplCorners(sal_pnt_id);
+        if (!corners.has_value())
+            return initial_templ;
+
+        const Scalar min_shift = templ_warp_min_corner_shift_pix_.value();
+        std::array<Eigen::Matrix<Scalar, 2, 1>, 4> corner_offsets = CornerOffsetsFromCentroid(corners.value());
+
+        // the template hasn't changed its shape since it was cut from the image
+        if (MaxCornerShift(corner_offsets, CornerOffsetsFromCentroid(TemplateRectCorners(mono_slam.sal_pnt_templ_size_))) <= min_shift)
+        {
+            warped_templs_.erase(sal_pnt_id);
+            return initial_templ;
+        }
+
+        // reuse the last warp while the view barely changes
+        auto warp_it = warped_templs_.find(sal_pnt_id);
+        if (warp_it != warped_templs_.end() && MaxCornerShift(corner_offsets, warp_it->second.corner_offsets) <= min_shift)
+            return warp_it->second;
+
+        std::optional<PredictedTemplate> warped_templ = WarpSalientPointTemplate(mono_slam, sal_pnt, corners.value());
+        if (!warped_templ.has_value())
+            return initial_templ;
+
+        warped_templs_[sal_pnt_id] = warped_templ.value();
+        return warped_templ.value();
+    }
+
     struct TemplateMatchResult
     {
         bool success;
@@ -462,7 +646,8 @@ public:
 #endif
     };
 
-    TemplateMatchResult MatchSalientPointTemplCenterInRect(const DavisonMonoSlam& mono_slam, const TrackedSalientPoint& sal_pnt, const Picture& pic, Recti search_rect)
+    TemplateMatchResult MatchSalientPointTemplCenterInRect(const DavisonMonoSlam& mono_slam, const TrackedSalientPoint& sal_pnt,
+        const PredictedTemplate& templ, const Picture& pic, Recti search_rect)
     {
         Point2i search_center{ search_rect.x + search_rect.width / 2, search_rect.y + search_rect.height / 2 };
         const int search_radius_left = search_rect.width / 2;
@@ -486,9 +671,9 @@ public:
         PosAndErr best_match_info;
         int match_templ_call_order = 0;  // specify the order of calls to template match routine
 
-        Scalar templ_mean = sal_pnt.templ_stats.templ_mean_;
-        Scalar templ_sqrt_sum_sqr_diff = sal_pnt.templ_stats.templ_sqrt_sum_sqr_diff_;
-        const auto& templ_gray = sal_pnt.initial_templ_gray_;
+        Scalar templ_mean = templ.templ_mean;
+        Scalar templ_sqrt_sum_sqr_diff = templ.templ_sqrt_sum_sqr_diff;
+        const auto& templ_gray = templ.templ_gray;
 
         auto match_templ_at = [this, &templ_gray, &pic, &mono_slam,
             &max_corr_coeff, &best_match_info, templ_mean, templ_sqrt_sum_sqr_diff, &match_templ_call_order](Point2i search_center)
@@ -623,6 +808,10 @@ public:
         if (min_search_rect_size_.has_value())
             search_rect_unbounded = ClampRectWhenFixedCenter(search_rect_unbounded, min_search_rect_size_.value());
 
+        // the tracker may limit the search when it runs late
+        if (std::optional<suriko::Sizei> max_size = mono_slam.SearchRectMaxSize(); max_size.has_value())
+            search_rect_unbounded = ShrinkRectWhenFixedCenter(search_rect_unbounded, max_size.value());
+
         Recti image_bounds = { 0, 0, pic.gray.cols, pic.gray.rows };
         
         int radx = mono_slam.sal_pnt_templ_size_.width / 2;
@@ -642,7 +831,8 @@ public:
 
         const TrackedSalientPoint& sal_pnt = mono_slam.GetSalientPoint(sal_pnt_id);
 
-        TemplateMatchResult match_result = MatchSalientPointTemplCenterInRect(mono_slam, sal_pnt, pic, search_rect);
+        PredictedTemplate templ = GetPredictedTemplate(mono_slam, sal_pnt_id);
+        TemplateMatchResult match_result = MatchSalientPointTemplCenterInRect(mono_slam, sal_pnt, templ, pic, search_rect);
         if (!match_result.success)
             return std::nullopt;
 
@@ -713,7 +903,11 @@ public:
         {
             const TrackedSalientPoint& sal_pnt = mono_slam.GetSalientPoint(sal_pnt_id);
 
-            std::optional<suriko::Point2f> match_pnt_center = MatchSalientTempl(mono_slam, sal_pnt_id, image);
+            std::optional<suriko::Point2f> match_pnt_center = ReuseMatchInStaticScene(mono_slam, sal_pnt_id);
+            if (match_pnt_center.has_value())
+                ++reused_matches_count_;
+            else
+                match_pnt_center = MatchSalientTempl(mono_slam, sal_pnt_id, image);
             bool is_lost = !match_pnt_center.has_value();
             if (is_lost)
                 continue;
@@ -736,6 +930,8 @@ public:
                 }
             }
 #endif
+            cur_centers_[sal_pnt_id] = new_center;
+
             size_t blob_ind = new_keypoints_.size();
             cv::KeyPoint kp{};
             kp.pt = cv::Point2f{ static_cast<float>(new_center.Mat()[0]), static_cast<float>(new_center.Mat()[1]) };
@@ -753,21 +949,9 @@ public:
         const Picture& image,
         std::vector<CornersMatcherBlobId>* new_blob_ids) override
     {
-        std::vector<cv::KeyPoint> keypoints;
-        detector_->detect(image.gray, keypoints);  // keypoints are sorted by ascending size [W,H]
+        const std::vector<cv::KeyPoint>& keypoints = candidate_keypoints_;
 
-        // reorder the features from high quality to low
-        // this will lead to deterministic creation and matching of image features
-        // otherwise different features may be selected for the same picture for different program's executions
-        std::sort(keypoints.begin(), keypoints.end(), [](auto& a, auto& b) { return a.response > b.response; });
-
-        cv::Mat keyp_img;
         static bool debug_keypoints = false;
-        if (debug_keypoints)
-            cv::drawKeypoints(image.gray, keypoints, keyp_img, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-
-        cv::Mat descr_per_row;
-        detector_->compute(image.gray, keypoints, descr_per_row);
 
         std::vector<cv::KeyPoint> sparse_keypoints;
         Scalar closest_templ_min_dist = mono_slam.ClosestSalientPointTemplateMinDistance();
@@ -825,6 +1009,26 @@ public:
         }
     }
 
+    void DetectNewBlobCandidates(size_t frame_ind, const Picture& image) override
+    {
+        std::vector<cv::KeyPoint>& keypoints = candidate_keypoints_;
+        keypoints.clear();
+        detector_->detect(image.gray, keypoints);  // keypoints are sorted by ascending size [W,H]
+
+        // reorder the features from high quality to low
+        // this will lead to deterministic creation and matching of image features
+        // otherwise different features may be selected for the same picture for different program's executions
+        std::sort(keypoints.begin(), keypoints.end(), [](auto& a, auto& b) { return a.response > b.response; });
+
+        cv::Mat keyp_img;
+        static bool debug_keypoints = false;
+        if (debug_keypoints)
+            cv::drawKeypoints(image.gray, keypoints, keyp_img, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+
+        cv::Mat descr_per_row;
+        detector_->compute(image.gray, keypoints, descr_per_row);
+    }
+
     static void FilterOutClosest(const std::vector<cv::KeyPoint>& keypoints, Scalar exclude_radius, std::vector<cv::KeyPoint>* sparse_keypoints)
     {
         std::vector<char> processed(keypoints.size(), (char)false);
@@ -848,6 +1052,18 @@ public:
         }
     }
 
+    void OnSalientPointIsAssignedToBlobId(SalPntId sal_pnt_id, CornersMatcherBlobId blob_id, const Picture& image) override
+    {
+        cur_centers_[sal_pnt_id] = GetBlobCoord(blob_id);
+    }
+
+    void OnSalientPointIsRemoved(SalPntId sal_pnt_id) override
+    {
+        prev_centers_.erase(sal_pnt_id);
+        cur_centers_.erase(sal_pnt_id);
+        warped_templs_.erase(sal_pnt_id);
+    }
+
     suriko::Point2f GetBlobCoord(CornersMatcherBlobId blob_id) override
     {
         const cv::KeyPoint& kp = new_keypoints_[blob_id.Ind];
@@ -884,6 +1100,304 @@ public:
 };
 #endif
 
+#if defined(SRK_HAS_OPENCV)
+/// Matches salient points by pyramidal Lucas-Kanade tracking (KLT) of the patch around the salient point in the previous frame.
+/// The tracking starts at the position, predicted by the filter, and the result is accepted only inside the predicted
+/// uncertainty ellipse. Unlike the exhaustive search of the template, the cost per salient point doesn't depend on the size of the ellipse.
+/// The detection of new salient points is the same as in the base class.
+class PyramidalLKCornersMatcher : public ImageTemplCornersMatcher
+{
+    Picture prev_image_;  // shares the pixels and the pyramid with the previous frame
+    Picture cur_image_;
+public:
+    LucasKanadeParams lk_params_;
+public:
+    void AnalyzeFrame(size_t frame_ind, const Picture& image) override
+    {
+        ImageTemplCornersMatcher::AnalyzeFrame(frame_ind, image);
+
+        prev_image_ = std::move(cur_image_);
+        cur_image_ = image;
+    }
+
+    std::optional<suriko::Point2f> TrackSalientPoint(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id, const Picture& pic)
+    {
+        auto [op, predicted_center] = mono_slam.GetSalientPointProjected2DPosWithUncertainty(FilterStageType::Predicted, sal_pnt_id);
+        static_assert(std::is_same_v<decltype(predicted_center), MeanAndCov2D>);
+        if (!op)
+            return std::nullopt; // broken covariance matrix
+
+        const TrackedSalientPoint& sal_pnt = mono_slam.GetSalientPoint(sal_pnt_id);
+        suriko::Point2f guess_center{ predicted_center.mean };
+
+        std::optional<suriko::Point2f> center;
+        auto prev_it = prev_centers_.find(sal_pnt_id);
+        if (prev_it != prev_centers_.end() && !prev_image_.gray.empty())
+        {
+            center = TrackPointPyramidalLK(prev_image_, prev_it->second, pic, guess_center, lk_params_);
+        }
+        else
+        {
+            // the salient point wasn't observed in the previous frame, track its template on the finest level
+            Picture templ{};
+            templ.gray = GetPredictedTemplate(mono_slam, sal_pnt_id).templ_gray;
+
+            LucasKanadeParams templ_lk_params = lk_params_;
+            templ_lk_params.window.width = std::min(lk_params_.window.width, templ.gray.cols - 2);  // keep the gradient inside the template
+            templ_lk_params.window.height = std::min(lk_params_.window.height, templ.gray.rows - 2);
+            center = TrackPointPyramidalLK(templ, sal_pnt.OffsetFromTopLeft(), pic, guess_center, templ_lk_params);
+        }
+        if (!center.has_value())
+            return std::nullopt;
+
+        // gate by the predicted uncertainty ellipse; tiny ellipses are inflated to the min search rectangle
+        Eigen::Matrix<Scalar, 2, 1> offset = center.value().Mat() - predicted_center.mean;
+        bool in_min_search_rect = min_search_rect_size_.has_value() &&
+            std::abs(offset[0]) <= min_search_rect_size_.value().width / 2 &&
+            std::abs(offset[1]) <= min_search_rect_size_.value().height / 2;
+        if (!in_min_search_rect)
+        {
+            auto [op_2D_ellip, corner_ellipse] = mono_slam.GetPredictedSalientPointProjectedUncertEllipse(sal_pnt_id);
+            if (!op_2D_ellip || !IsPointInsideEllipse(corner_ellipse, center.value().Mat()))
+                return std::nullopt;
+        }
+
+        // the tracking from frame to frame drifts, hence check the appearance against the template
+        if (min_templ_corr_coeff_.has_value())
+        {
+            Point2i top_left = mono_slam.TemplateTopLeftInt(center.value());
+            Recti templ_rect{ top_left.x, top_left.y, mono_slam.sal_pnt_templ_size_.width, mono_slam.sal_pnt_templ_size_.height };
+            bool inside_image = templ_rect.x >= 0 && templ_rect.y >= 0 &&
+                templ_rect.Right() <= pic.gray.cols && templ_rect.Bottom() <= pic.gray.rows;
+            if (!inside_image)
+                return std::nullopt;
+
+            PredictedTemplate pred_templ = GetPredictedTemplate(mono_slam, sal_pnt_id);
+            std::optional<Scalar> corr_coeff = CalcCorrCoeff(pic, templ_rect, pred_templ.templ_gray,
+                pred_templ.templ_mean, pred_templ.templ_sqrt_sum_sqr_diff);
+            if (!corr_coeff.has_value() || corr_coeff.value() < min_templ_corr_coeff_.value())
+                return std::nullopt;
+        }
+        return center;
+    }
+
+    void MatchSalientPoints(
+        const DavisonMonoSlam& mono_slam,
+        const std::set<SalPntId>& tracking_sal_pnts,
+        size_t frame_ind,
+        const Picture& image,
+        std::vector<std::pair<DavisonMonoSlam::SalPntId, CornersMatcherBlobId>>* matched_sal_pnts) override
+    {
+        if (suppress_observations_) return;
+
+        for (auto sal_pnt_id : tracking_sal_pnts)
+        {
+            std::optional<suriko::Point2f> match_pnt_center = TrackSalientPoint(mono_slam, sal_pnt_id, image);
+            if (!match_pnt_center.has_value())
+                continue;
+
+            const auto& new_center = match_pnt_center.value();
+            cur_centers_[sal_pnt_id] = new_center;
+
+            size_t blob_ind = new_keypoints_.size();
+            cv::KeyPoint kp{};
+            kp.pt = cv::Point2f{ static_cast<float>(new_center.Mat()[0]), static_cast<float>(new_center.Mat()[1]) };
+            new_keypoints_.push_back(kp);
+
+            matched_sal_pnts->push_back(std::make_pair(sal_pnt_id, CornersMatcherBlobId{ blob_ind }));
+        }
+    }
+};
+#endif
+
+#if defined(SRK_HAS_OPENCV)
+/// Matches salient points by ORB descriptors. The keypoints are detected once per frame and bucketed in a grid of cells.
+/// Each salient point is compared only to the keypoints inside its predicted uncertainty ellipse, which costs
+/// one Hamming distance between descriptors per keypoint instead of one correlation of templates per pixel of the search rectangle.
+/// The keypoints of the frame are also the candidates for new salient points.
+class OrbDescriptorCornersMatcher : public ImageTemplCornersMatcher
+{
+    cv::Ptr<cv::ORB> frame_detector_;
+    std::vector<cv::KeyPoint> frame_keypoints_;  // detected in current frame, sorted from high quality to low; class_id is the row in frame_descr_
+    cv::Mat frame_descr_;  // descriptor per row
+    std::optional<size_t> frame_keypoints_frame_ind_;
+
+    // keypoints of the frame, bucketed in the grid of cells; the keypoints of the cell are cell_keypoint_inds_[cell_start_[cell]..cell_start_[cell+1])
+    int grid_cols_ = 0;
+    int grid_rows_ = 0;
+    std::vector<int> cell_start_;
+    std::vector<int> cell_keypoint_inds_;
+
+    std::map<SalPntId, cv::Mat> sal_pnt_descr_;  // the descriptor of the salient point when it was recruited
+public:
+    int grid_cell_size_pix_ = 16;
+    int max_hamming_dist_ = 64;  // the match is rejected when its descriptor is farther
+    float max_hamming_dist_ratio_ = 0.8f;  // the match is ambiguous when the ratio of the best and the second best distances is greater
+public:
+    explicit OrbDescriptorCornersMatcher(int frame_features_count)
+    {
+        frame_detector_ = cv::ORB::create(frame_features_count);
+    }
+
+    void DetectFrameKeypoints(size_t frame_ind, const Picture& image)
+    {
+        frame_keypoints_.clear();
+        frame_detector_->detect(image.gray, frame_keypoints_);
+        std::sort(frame_keypoints_.begin(), frame_keypoints_.end(), [](auto& a, auto& b) { return a.response > b.response; });
+        frame_detector_->compute(image.gray, frame_keypoints_, frame_descr_);  // drops the keypoints without descriptor
+        for (size_t i = 0; i < frame_keypoints_.size(); ++i)
+            frame_keypoints_[i].class_id = static_cast<int>(i);
+
+        grid_cols_ = (image.gray.cols + grid_cell_size_pix_ - 1) / grid_cell_size_pix_;
+        grid_rows_ = (image.gray.rows + grid_cell_size_pix_ - 1) / grid_cell_size_pix_;
+        auto cell_ind = [this](const cv::KeyPoint& kp)
+        {
+            int col = std::clamp(static_cast<int>(kp.pt.x) / grid_cell_size_pix_, 0, grid_cols_ - 1);
+            int row = std::clamp(static_cast<int>(kp.pt.y) / grid_cell_size_pix_, 0, grid_rows_ - 1);
+            return row * grid_cols_ + col;
+        };
+
+        // counting sort of keypoints by cells
+        cell_start_.assign(grid_cols_ * grid_rows_ + 1, 0);
+        for (const cv::KeyPoint& kp : frame_keypoints_)
+            ++cell_start_[cell_ind(kp) + 1];
+        std::partial_sum(cell_start_.begin(), cell_start_.end(), cell_start_.begin());
+
+        std::vector<int> cell_fill(cell_start_.begin(), cell_start_.end() - 1);
+        cell_keypoint_inds_.resize(frame_keypoints_.size());
+        for (size_t i = 0; i < frame_keypoints_.size(); ++i)
+            cell_keypoint_inds_[cell_fill[cell_ind(frame_keypoints_[i])]++] = static_cast<int>(i);
+
+        frame_keypoints_frame_ind_ = frame_ind;
+    }
+
+    /// Returns the index of the keypoint in current frame.
+    std::optional<size_t> MatchSalientPointDescriptor(const DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id)
+    {
+        auto descr_it = sal_pnt_descr_.find(sal_pnt_id);
+        if (descr_it == sal_pnt_descr_.end())
+            return std::nullopt;
+        const unsigned char* sal_pnt_descr = descr_it->second.ptr<unsigned char>(0);
+
+        auto [op_2D_ellip, corner_ellipse] = mono_slam.GetPredictedSalientPointProjectedUncertEllipse(sal_pnt_id);
+        if (!op_2D_ellip)
+            return std::nullopt; // broken covariance matrix
+
+        // tiny ellipses are inflated to the min search rectangle
+        Recti search_rect = EncompassRect(GetEllipseBounds2(corner_ellipse));
+        if (min_search_rect_size_.has_value())
+            search_rect = ClampRectWhenFixedCenter(search_rect, min_search_rect_size_.value());
+        const Eigen::Matrix<Scalar, 2, 1>& predicted_center = corner_ellipse.world_from_ellipse.T;
+
+        int col_min = std::max(0, search_rect.x / grid_cell_size_pix_);
+        int col_max = std::min(grid_cols_ - 1, search_rect.Right() / grid_cell_size_pix_);
+        int row_min = std::max(0, search_rect.y / grid_cell_size_pix_);
+        int row_max = std::min(grid_rows_ - 1, search_rect.Bottom() / grid_cell_size_pix_);
+
+        int best_dist = std::numeric_limits<int>::max();
+        int second_best_dist = std::numeric_limits<int>::max();
+        std::optional<size_t> best_kp_ind;
+        for (int row = row_min; row <= row_max; ++row)
+            for (int col = col_min; col <= col_max; ++col)
+            {
+                int cell = row * grid_cols_ + col;
+                for (int i = cell_start_[cell]; i < cell_start_[cell + 1]; ++i)
+                {
+                    int kp_ind = cell_keypoint_inds_[i];
+                    const cv::KeyPoint& kp = frame_keypoints_[kp_ind];
+                    Eigen::Matrix<Scalar, 2, 1> kp_pix{ kp.pt.x, kp.pt.y };
+
+                    Eigen::Matrix<Scalar, 2, 1> offset = kp_pix - predicted_center;
+                    bool in_min_search_rect = min_search_rect_size_.has_value() &&
+                        std::abs(offset[0]) <= min_search_rect_size_.value().width / 2 &&
+                        std::abs(offset[1]) <= min_search_rect_size_.value().height / 2;
+                    if (!in_min_search_rect && !IsPointInsideEllipse(corner_ellipse, kp_pix))
+                        continue;
+
+                    int dist = HammingDistance(sal_pnt_descr, frame_descr_.ptr<unsigned char>(kp_ind), frame_descr_.cols);
+                    if (dist < best_dist)
+                    {
+                        second_best_dist = best_dist;
+                        best_dist = dist;
+                        best_kp_ind = static_cast<size_t>(kp_ind);
+                    }
+                    else if (dist < second_best_dist)
+                        second_best_dist = dist;
+                }
+            }
+
+        if (!best_kp_ind.has_value() || best_dist > max_hamming_dist_)
+            return std::nullopt;
+        if (second_best_dist <= max_hamming_dist_ && best_dist > max_hamming_dist_ratio_ * second_best_dist)
+            return std::nullopt;  // ambiguous
+        return best_kp_ind;
+    }
+
+    void MatchSalientPoints(
+        const DavisonMonoSlam& mono_slam,
+        const std::set<SalPntId>& tracking_sal_pnts,
+        size_t frame_ind,
+        const Picture& image,
+        std::vector<std::pair<DavisonMonoSlam::SalPntId, CornersMatcherBlobId>>* matched_sal_pnts) override
+    {
+        if (suppress_observations_) return;
+
+        DetectFrameKeypoints(frame_ind, image);
+
+        for (auto sal_pnt_id : tracking_sal_pnts)
+        {
+            std::optional<size_t> kp_ind = MatchSalientPointDescriptor(mono_slam, sal_pnt_id);
+            if (!kp_ind.has_value())
+                continue;
+
+            size_t blob_ind = new_keypoints_.size();
+            new_keypoints_.push_back(frame_keypoints_[kp_ind.value()]);
+
+            matched_sal_pnts->push_back(std::make_pair(sal_pnt_id, CornersMatcherBlobId{ blob_ind }));
+        }
+    }
+
+    void DetectNewBlobCandidates(size_t frame_ind, const Picture& image) override
+    {
+        if (frame_keypoints_frame_ind_ == frame_ind)
+        {
+            // reuse the keypoints, detected for matching
+            candidate_keypoints_ = frame_keypoints_;
+            return;
+        }
+
+        ImageTemplCornersMatcher::DetectNewBlobCandidates(frame_ind, image);
+        for (cv::KeyPoint& kp : candidate_keypoints_)
+            kp.class_id = -1;  // no descriptor
+    }
+
+    void OnSalientPointIsRemoved(SalPntId sal_pnt_id) override
+    {
+        ImageTemplCornersMatcher::OnSalientPointIsRemoved(sal_pnt_id);
+        sal_pnt_descr_.erase(sal_pnt_id);
+    }
+
+    void OnSalientPointIsAssignedToBlobId(SalPntId sal_pnt_id, CornersMatcherBlobId blob_id, const Picture& image) override
+    {
+        ImageTemplCornersMatcher::OnSalientPointIsAssignedToBlobId(sal_pnt_id, blob_id, image);
+
+        const cv::KeyPoint& kp = new_keypoints_[blob_id.Ind];
+        if (kp.class_id >= 0)
+        {
+            sal_pnt_descr_[sal_pnt_id] = frame_descr_.row(kp.class_id).clone();
+            return;
+        }
+
+        std::vector<cv::KeyPoint> keypoints{ kp };
+        cv::Mat descr;
+        frame_detector_->compute(image.gray, keypoints, descr);
+        if (keypoints.empty())
+            return;  // the salient point is never matched
+        sal_pnt_descr_[sal_pnt_id] = descr;
+    }
+};
+#endif
+
 #if defined(SRK_HAS_OPENCV)
 template <typename EigenMat>
 void WriteMatElements(cv::FileStorage& fs, const EigenMat& m)
@@ -918,6 +1432,21 @@ bool WriteTrackerInternalsToFile(std::string_view file_name, const DavisonMonoSl
         cv::write(fs, "DeletedSalPnts", static_cast<int>(item.deleted_sal_pnts));
         cv::write(fs, "OptimalEstimMulErr", static_cast<float>(item.optimal_estim_mul_err));
         cv::write(fs, "FrameProcessingDur", item.frame_processing_dur.count()); // seconds
+        cv::write(fs, "DeadlineMissed", static_cast<int>(item.deadline_missed));
+        cv::write(fs, "DeadlineCappedSearchRects", static_cast<int>(item.deadline_capped_search_rects));
+        cv::write(fs, "DeadlineDroppedObs", static_cast<int>(item.deadline_dropped_obs));
+        cv::write(fs, "DeadlineSkippedRecruitment", static_cast<int>(item.deadline_skipped_recruitment));
+        cv::write(fs, "SalPntCandidates", static_cast<int>(item.sal_pnt_candidates));
+        cv::write(fs, "SalPntCandidatesPromoted", static_cast<int>(item.sal_pnt_candidates_promoted));
+        cv::write(fs, "SalPntsEvicted", static_cast<int>(item.sal_pnts_evicted));
+        cv::write(fs, "DroppedFrames", static_cast<int>(item.dropped_frames));
+        cv::write(fs, "PredictedInterval", static_cast<float>(item.predicted_interval));
+        cv::write(fs, "ProcessNoiseScale", static_cast<float>(item.process_noise_scale));
+        cv::write(fs, "ActiveSearchDeferredSalPnts", static_cast<int>(item.active_search_deferred_sal_pnts));
+        cv::write(fs, "UpdateImpl", item.update_impl);
+        cv::write(fs, "OnePointRansacHypotheses", static_cast<int>(item.one_point_ransac_hypotheses));
+        cv::write(fs, "SalPntsSwitchedToXyz", static_cast<int>(item.sal_pnts_switched_to_xyz));
+        cv::write(fs, "ReusedMatches", static_cast<int>(item.reused_matches));
 
         fs << "CamState" <<"[:";
         WriteMatElements(fs, item.cam_state);
@@ -1044,6 +1573,9 @@ static constexpr auto kImageSeqDirCStr = "imageseqdir";
 DEFINE_string(demo_params, "", "path to json file to read parameters for demo");
 DEFINE_bool(monoslam_cam_perfect_init_vel, false, "");
 DEFINE_bool(monoslam_cam_perfect_init_ang_vel, false, "");
+DEFINE_bool(monoslam_cam_distortion_lut, false, "true to precompute the undistortion of each pixel of the image, instead of solving the distortion model for each salient point");
+DEFINE_bool(monoslam_virtual_imu, false, "true to aid the prediction with the synthetic gyroscope of the virtual scene (the accelerometer requires metric scale of the map)");
+DEFINE_double(monoslam_virtual_imu_gyro_noise_std, 0.005, "noise of the synthetic gyroscope, in radians per second");
 DEFINE_double(monoslam_cam_pos_x_std_m, 0, "");
 DEFINE_double(monoslam_cam_pos_y_std_m, 0, "");
 DEFINE_double(monoslam_cam_pos_z_std_m, 0, "");
@@ -1061,7 +1593,21 @@ DEFINE_double(monoslam_sal_pnt_inv_dist_std_if_gt, 0, "");
 
 DEFINE_bool(monoslam_force_xyz_sal_pnt_pos_diagonal_uncert, false, "false to derive XYZ sal pnt uncertainty from spherical sal pnt; true to set diagonal covariance values");
 DEFINE_double(monoslam_sal_pnt_negative_inv_rho_substitute, -1, "");
-DEFINE_int32(monoslam_update_impl, 0, "");
+DEFINE_double(monoslam_sal_pnt_switch_to_xyz_linearity_index, -1, "[default=-1(off)] inverse depth salient point is converted to XYZ when its linearity index drops below this value, eg 0.1");
+DEFINE_bool(monoslam_sal_pnt_shared_anchor, false, "true to share the first camera position among inverse depth salient points, initialized in the same frame");
+DEFINE_int32(monoslam_sal_pnt_candidate_min_frames, -1, "[default=-1(off)] new salient points are tracked outside of the state for at least this number of frames, until their depth converges");
+DEFINE_int32(monoslam_sal_pnt_candidate_max_frames, 30, "the candidate is discarded if its depth doesn't converge in this number of frames");
+DEFINE_int32(monoslam_sal_pnt_candidate_max_missed_frames, 2, "the candidate is discarded if it isn't matched in more frames");
+DEFINE_double(monoslam_sal_pnt_candidate_min_depth_ratio, 0.2, "the range of depth hypotheses of the candidate, relative to the median distance to salient points");
+DEFINE_double(monoslam_sal_pnt_candidate_max_depth_ratio, 5, "");
+DEFINE_double(monoslam_sal_pnt_candidate_depth_converged_ratio, 0.3, "the depth is converged when std/mean of depth hypotheses is less than this value");
+DEFINE_bool(monoslam_process_noise_adaptive, false, "true to estimate the process noise from innovations; the configured process noise is the worst case");
+DEFINE_double(monoslam_process_noise_adaptive_min_scale, 0.05, "the lower bound of the scale of the process noise covariance in adaptive mode");
+DEFINE_int32(monoslam_sal_pnt_max_count, -1, "[default=-1(unbounded)] the budget of salient points in the state; salient points with the lowest score are evicted when it is exhausted");
+DEFINE_int32(monoslam_sal_pnt_evict_batch_size, 8, "the maximal number of salient points, evicted at once; only the salient points, scored lower than a new one, are evicted");
+DEFINE_int32(monoslam_freeze_map_after_frame, -1, "[default=-1(never)] the map is frozen after this frame, and the camera is only localized against it");
+DEFINE_int32(monoslam_update_impl, 0, "[default=0(tracker's default)] -1=auto, 1=stacked observations, 2=one observation, 3=one component of observation, 4=1-point RANSAC, 5=state space, 6=blocked, 7=square-root");
+DEFINE_int32(monoslam_update_block_sal_pnts, 8, "the number of corners in one block of the blocked update");
 DEFINE_int32(monoslam_max_new_blobs_in_first_frame, 7, "");
 DEFINE_int32(monoslam_max_new_blobs_per_frame, 1, "");
 DEFINE_double(monoslam_match_blob_prob, 1, "[0,1] portion of blobs which are matched with ones in the previous frame; 1=all matched, 0=none matched");
@@ -1071,14 +1617,28 @@ DEFINE_int32(monoslam_templ_min_search_rect_height, 7, "");
 DEFINE_double(monoslam_templ_min_corr_coeff, -1, "");
 DEFINE_double(monoslam_templ_center_detection_noise_std_pix, 0, "std of measurement noise(=sqrt(R), 0=no noise");
 DEFINE_double(monoslam_templ_closest_templ_min_dist_pix, 0, "");
+DEFINE_int32(monoslam_corners_matcher, 1, "the matcher of salient points in images, 1=exhaustive search of a template in the search rectangle, 2=pyramidal Lucas-Kanade tracking (KLT), 3=ORB descriptors");
+DEFINE_int32(monoslam_klt_pyramid_levels, 3, "the number of coarser levels in the image pyramid for KLT matcher");
+DEFINE_int32(monoslam_klt_window_width, 11, "the size of a patch, tracked by KLT matcher");
+DEFINE_int32(monoslam_klt_max_iters, 20, "the max number of iterations of KLT matcher per level of the pyramid");
+DEFINE_int32(monoslam_orb_frame_features, 500, "the max number of ORB keypoints, detected in each frame by ORB matcher");
+DEFINE_int32(monoslam_orb_max_hamming_dist, 64, "the max Hamming distance between ORB descriptors of matched salient points");
+DEFINE_double(monoslam_static_scene_max_block_diff, -1, "[default=-1(never)] the max mean absolute difference of intensity in an unchanged block of the image, where the previous match of a salient point is reused");
+DEFINE_double(monoslam_static_scene_max_shift_pix, 0.5, "the previous match of a salient point is reused if its predicted position is closer");
+DEFINE_double(monoslam_templ_warp_min_corner_shift_pix, -1, "[default=-1(never)] the template of a salient point is warped into the predicted view when its corners shift further");
 DEFINE_bool(monoslam_stop_on_sal_pnt_moved_too_far, false, "width of template");
 DEFINE_bool(monoslam_fix_estim_vars_covar_symmetry, true, "");
+DEFINE_bool(monoslam_jacobians_by_jets, false, "true to verify the hand-derived Jacobians of the motion model and projections by computing them by automatic differentiation");
 DEFINE_bool(monoslam_debug_estim_vars_cov, false, "");
 DEFINE_bool(monoslam_debug_predicted_vars_cov, false, "");
 DEFINE_int32(monoslam_debug_max_sal_pnt_count, -1, "[default=-1(none)] number of salient points won't be greater than this value");
 DEFINE_bool(monoslam_sal_pnt_perfect_init_inv_dist, false, "");
 DEFINE_int32(monoslam_set_estim_state_covar_to_gt_impl, 2, "1=ignore correlations, 2=set correlations as if 'AddNewSalientPoint' is called on each salient point");
 DEFINE_double(monoslam_covar2D_to_ellipse_confidence, 0.95f, "");
+DEFINE_int32(monoslam_deadline_min_fused_obs_count, 3, "the min number of observations, fused into the filter, when a frame runs late");
+DEFINE_int32(monoslam_deadline_max_search_rect_width, -1, "[default=-1(none)] the max size of a search rectangle after a frame has missed its deadline");
+DEFINE_int32(monoslam_active_search_max_sal_pnts, -1, "[default=-1(all)] the max number of the most informative salient points, matched in a frame");
+DEFINE_bool(monoslam_active_search_by_time_budget, false, "true to limit the number of matched salient points by the time left in a frame");
 
 DEFINE_bool(ui_swallow_exc, true, "true to ignore (swallow) exceptions in UI");
 DEFINE_int32(ui_loop_prolong_period_ms, 3000, "");
@@ -1095,6 +1655,34 @@ DEFINE_bool(ctrl_collect_tracker_internals, false, "");
 DEFINE_bool(ctrl_log_slam_images_cam0, false, "Whether to write images of camera to filesystem");
 DEFINE_bool(ctrl_log_slam_images_scene3D, false, "Whether to write images of 3D scene to filesystem");
 DEFINE_string(ctrl_log_slam_images_dir, "", "The directory where to output the images");
+DEFINE_int32(ctrl_frame_time_budget_ms, 0, "[default=0(none)] time budget to process one frame; the tracker degrades when it runs late");
+DEFINE_bool(ctrl_drop_late_frames, false, "true to drop frames when the tracker falls behind the frame time budget by one frame");
+DEFINE_bool(ctrl_pipeline_image_decoding, true, "true to decode the next image while the tracker processes the current one");
+DEFINE_bool(ctrl_pipeline_new_blobs_detection, true, "true to detect new salient points concurrently with the update of the tracker");
+
+struct DecodedImage
+{
+    std::filesystem::path file_path;
+    cv::Mat image_bgr;
+    Picture image;
+};
+
+DecodedImage DecodeImageFile(const std::filesystem::path& image_file_path)
+{
+    DecodedImage result;
+    result.file_path = image_file_path;
+    result.image_bgr = cv::imread(image_file_path.string());
+    if (result.image_bgr.empty())
+        return result;
+
+    cv::cvtColor(result.image_bgr, result.image.gray, cv::COLOR_BGR2GRAY);
+    if (FLAGS_monoslam_corners_matcher == 2)
+        BuildGrayPyramid(FLAGS_monoslam_klt_pyramid_levels, &result.image);  // built in the decoding thread
+#if defined(SRK_DEBUG)
+    result.image.bgr_debug = result.image_bgr;
+#endif
+    return result;
+}
 
 bool ApplyParamsFromConfigFile(DavisonMonoSlam* mono_slam, ConfigReader* config_reader)
 {
@@ -1124,6 +1712,7 @@ bool ApplyParamsFromConfigFile(DavisonMonoSlam* mono_slam, ConfigReader* config_
     opt_set(FloatParam<Scalar>(&cr, "monoslam_measurm_noise_std_pix"), &ms.measurm_noise_std_pix_);
     mono_slam->one_point_ransac_corner_max_divergence_pix_ = FloatParam<Scalar>(&cr, "monoslam_1pransac_corner_max_divergence_pix");
     mono_slam->one_point_ransac_high_innov_chi_square_thresh_pix2_ = FloatParam<Scalar>(&cr, "monoslam_1pransac_high_innov_chisq_thr_pix2");
+    opt_set(FloatParam<Scalar>(&cr, "monoslam_1pransac_success_prob"), &ms.one_point_ransac_success_prob_);
     opt_set(FloatParam<Scalar>(&cr, "monoslam_sal_pnt_init_inv_dist"), &ms.sal_pnt_init_inv_dist_);
     opt_set(FloatParam<Scalar>(&cr, "monoslam_sal_pnt_init_inv_dist_std"), &ms.sal_pnt_init_inv_dist_std_);
 
@@ -1445,6 +2034,33 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
         cam_distort_params.k2 = camera_distort_mikhail_k1k2.value()[1];
     }
 
+    // pinhole|mikhail_radial|equidistant_fisheye; when omitted, Mikhail radial distortion is used if it is enabled
+    bool cam_enable_distortion = config_reader.GetValue<bool>("camera_enable_distortion").value_or(true);
+    std::string camera_model = config_reader.GetValue<std::string>("camera_model").value_or(cam_enable_distortion ? "mikhail_radial" : "pinhole");
+    CameraModel cam_model;
+    if (camera_model == "pinhole")
+        cam_model = PinholeCameraModel{};
+    else if (camera_model == "mikhail_radial")
+    {
+        MikhailRadialCameraModel mikhail_model{ cam_distort_params };
+        if (FLAGS_monoslam_cam_distortion_lut)
+            mikhail_model.BuildLut(cam_intrinsics);
+        cam_model = std::move(mikhail_model);
+    }
+    else if (camera_model == "equidistant_fisheye")
+    {
+        EquidistantFisheyeCameraModel fisheye_model;
+        if (FLAGS_monoslam_cam_distortion_lut)
+            fisheye_model.BuildLut(cam_intrinsics);
+        cam_model = std::move(fisheye_model);
+    }
+    else
+    {
+        LOG(ERROR) << "Unknown camera_model=" << camera_model << ", expected pinhole|mikhail_radial|equidistant_fisheye";
+        return 1;
+    }
+    LOG(INFO) << "camera_model=" << camera_model << " lut=" << FLAGS_monoslam_cam_distortion_lut;
+
     //
     DavisonMonoSlam2DDrawer drawer;
     drawer.dots_per_uncert_ellipse_ = FLAGS_ui_dots_per_uncert_ellipse;
@@ -1476,22 +2092,47 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
     if (!ApplyParamsFromConfigFile(&mono_slam, &config_reader))
         return 1;
     mono_slam.in_multi_threaded_mode_ = FLAGS_ctrl_multi_threaded_mode;
+    mono_slam.publish_state_ = FLAGS_ctrl_visualize_during_processing || FLAGS_ctrl_visualize_after_processing;  // UI renders published snapshots
+    mono_slam.detect_new_blobs_concurrently_ = FLAGS_ctrl_pipeline_new_blobs_detection;
+    mono_slam.deadline_min_fused_obs_count_ = static_cast<size_t>(FLAGS_monoslam_deadline_min_fused_obs_count);
+    if (FLAGS_monoslam_deadline_max_search_rect_width > 0)
+        mono_slam.deadline_max_search_rect_size_ = suriko::Sizei{ FLAGS_monoslam_deadline_max_search_rect_width, FLAGS_monoslam_deadline_max_search_rect_width };
+    if (FLAGS_monoslam_active_search_max_sal_pnts >= 0)
+        mono_slam.active_search_max_sal_pnts_ = static_cast<size_t>(FLAGS_monoslam_active_search_max_sal_pnts);
+    mono_slam.active_search_by_time_budget_ = FLAGS_monoslam_active_search_by_time_budget;
     mono_slam.cam_intrinsics_ = cam_intrinsics;
-    mono_slam.cam_distort_params_ = cam_distort_params;
-    mono_slam.cam_enable_distortion_ = config_reader.GetValue<bool>("camera_enable_distortion").value_or(true);
+    mono_slam.cam_model_ = cam_model;
     mono_slam.force_xyz_sal_pnt_pos_diagonal_uncert_ = FLAGS_monoslam_force_xyz_sal_pnt_pos_diagonal_uncert;
     mono_slam.sal_pnt_templ_size_ = { FLAGS_monoslam_templ_width, FLAGS_monoslam_templ_width };
     if (FLAGS_monoslam_templ_closest_templ_min_dist_pix > 0)
         mono_slam.closest_sal_pnt_templ_min_dist_pix_ = static_cast<Scalar>(FLAGS_monoslam_templ_closest_templ_min_dist_pix);
     if (FLAGS_monoslam_sal_pnt_negative_inv_rho_substitute >= 0)
         mono_slam.sal_pnt_negative_inv_rho_substitute_ = static_cast<Scalar>(FLAGS_monoslam_sal_pnt_negative_inv_rho_substitute);
+    if (FLAGS_monoslam_sal_pnt_switch_to_xyz_linearity_index >= 0)
+        mono_slam.sal_pnt_switch_to_xyz_linearity_index_ = static_cast<Scalar>(FLAGS_monoslam_sal_pnt_switch_to_xyz_linearity_index);
+    mono_slam.sal_pnt_shared_anchor_ = FLAGS_monoslam_sal_pnt_shared_anchor;
+    if (FLAGS_monoslam_sal_pnt_candidate_min_frames >= 0)
+        mono_slam.sal_pnt_candidate_min_frames_ = static_cast<size_t>(FLAGS_monoslam_sal_pnt_candidate_min_frames);
+    mono_slam.sal_pnt_candidate_max_frames_ = static_cast<size_t>(FLAGS_monoslam_sal_pnt_candidate_max_frames);
+    mono_slam.sal_pnt_candidate_max_missed_frames_ = static_cast<size_t>(FLAGS_monoslam_sal_pnt_candidate_max_missed_frames);
+    mono_slam.sal_pnt_candidate_min_depth_ratio_ = static_cast<Scalar>(FLAGS_monoslam_sal_pnt_candidate_min_depth_ratio);
+    mono_slam.sal_pnt_candidate_max_depth_ratio_ = static_cast<Scalar>(FLAGS_monoslam_sal_pnt_candidate_max_depth_ratio);
+    mono_slam.sal_pnt_candidate_depth_converged_ratio_ = static_cast<Scalar>(FLAGS_monoslam_sal_pnt_candidate_depth_converged_ratio);
+    if (FLAGS_monoslam_sal_pnt_max_count >= 0)
+        mono_slam.sal_pnt_max_count_ = static_cast<size_t>(FLAGS_monoslam_sal_pnt_max_count);
+    mono_slam.sal_pnt_evict_batch_size_ = static_cast<size_t>(FLAGS_monoslam_sal_pnt_evict_batch_size);
+    mono_slam.process_noise_adaptive_ = FLAGS_monoslam_process_noise_adaptive;
+    mono_slam.process_noise_adaptive_min_scale_ = static_cast<Scalar>(FLAGS_monoslam_process_noise_adaptive_min_scale);
     mono_slam.covar2D_to_ellipse_confidence_ = static_cast<Scalar>(FLAGS_monoslam_covar2D_to_ellipse_confidence);
 
     if (FLAGS_monoslam_update_impl != 0)
         mono_slam.mono_slam_update_impl_ = FLAGS_monoslam_update_impl;
+    mono_slam.update_block_sal_pnts_ = static_cast<size_t>(FLAGS_monoslam_update_block_sal_pnts);
     mono_slam.fix_estim_vars_covar_symmetry_ = FLAGS_monoslam_fix_estim_vars_covar_symmetry;
+    mono_slam.jacobians_by_jets_ = FLAGS_monoslam_jacobians_by_jets;
     if (FLAGS_monoslam_debug_max_sal_pnt_count != -1)
         mono_slam.debug_max_sal_pnt_coun_ = FLAGS_monoslam_debug_max_sal_pnt_count;
+    std::vector<ImuSample> virtual_imu_samples;  // the i-th sample covers the interval from the i-th frame to the next one
     if (demo_data_source == DemoDataSource::kVirtualScene)
     {
         std::optional<suriko::Point3> cam_vel_tracker;
@@ -1504,6 +2145,14 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
         }
         mono_slam.SetCameraVelocity(cam_vel_tracker, cam_ang_vel_c);
 
+        if (FLAGS_monoslam_virtual_imu)
+        {
+            std::mt19937 imu_gen{ 811 };
+            GenerateImuSamples(gt_cam_orient_cfw, mono_slam.seconds_per_frame_, suriko::Point3{ 0, 0, -9.8 },
+                static_cast<Scalar>(FLAGS_monoslam_virtual_imu_gyro_noise_std), 0, &imu_gen, &virtual_imu_samples);
+            mono_slam.imu_gyro_noise_std_ = static_cast<Scalar>(FLAGS_monoslam_virtual_imu_gyro_noise_std);
+        }
+
         //
         mono_slam.sal_pnt_perfect_init_inv_dist_ = FLAGS_monoslam_sal_pnt_perfect_init_inv_dist;
         mono_slam.set_estim_state_covar_to_gt_impl_ = FLAGS_monoslam_set_estim_state_covar_to_gt_impl;
@@ -1570,6 +2219,17 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
     LOG(INFO) << "mono_slam_templ_min_dist=" << mono_slam.ClosestSalientPointTemplateMinDistance();
     LOG(INFO) << "mono_slam_templ_center_detection_noise_std_pix=" << FLAGS_monoslam_templ_center_detection_noise_std_pix;
     LOG(INFO) << "mono_slam_sal_pnt_negative_inv_rho_substitute=" << mono_slam.sal_pnt_negative_inv_rho_substitute_.value_or(static_cast<Scalar>(-1));
+    LOG(INFO) << "mono_slam_sal_pnt_switch_to_xyz_linearity_index=" << mono_slam.sal_pnt_switch_to_xyz_linearity_index_.value_or(static_cast<Scalar>(-1));
+    LOG(INFO) << "mono_slam_sal_pnt_shared_anchor=" << mono_slam.sal_pnt_shared_anchor_;
+    if (mono_slam.sal_pnt_candidate_min_frames_.has_value())
+        LOG(INFO) << "mono_slam_sal_pnt_candidate_min_frames=" << mono_slam.sal_pnt_candidate_min_frames_.value()
+            << " max_frames=" << mono_slam.sal_pnt_candidate_max_frames_
+            << " max_missed_frames=" << mono_slam.sal_pnt_candidate_max_missed_frames_
+            << " depth_ratio=[" << mono_slam.sal_pnt_candidate_min_depth_ratio_ << "," << mono_slam.sal_pnt_candidate_max_depth_ratio_ << "]"
+            << " converged_ratio=" << mono_slam.sal_pnt_candidate_depth_converged_ratio_;
+    if (mono_slam.sal_pnt_max_count_.has_value())
+        LOG(INFO) << "mono_slam_sal_pnt_max_count=" << mono_slam.sal_pnt_max_count_.value()
+            << " evict_batch_size=" << mono_slam.sal_pnt_evict_batch_size_;
 
     if (demo_data_source == DemoDataSource::kVirtualScene)
     {
@@ -1588,14 +2248,42 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
     }
     else if (demo_data_source == DemoDataSource::kImageSeqDir)
     {
-        auto corners_matcher = std::make_shared<ImageTemplCornersMatcher>();
+        std::shared_ptr<ImageTemplCornersMatcher> corners_matcher;
+        if (FLAGS_monoslam_corners_matcher == 2)
+        {
+            auto klt_matcher = std::make_shared<PyramidalLKCornersMatcher>();
+            klt_matcher->lk_params_.window = suriko::Sizei{ FLAGS_monoslam_klt_window_width, FLAGS_monoslam_klt_window_width };
+            klt_matcher->lk_params_.max_iters = FLAGS_monoslam_klt_max_iters;
+            corners_matcher = klt_matcher;
+        }
+        else if (FLAGS_monoslam_corners_matcher == 3)
+        {
+            auto orb_matcher = std::make_shared<OrbDescriptorCornersMatcher>(FLAGS_monoslam_orb_frame_features);
+            orb_matcher->max_hamming_dist_ = FLAGS_monoslam_orb_max_hamming_dist;
+            corners_matcher = orb_matcher;
+        }
+        else
+            corners_matcher = std::make_shared<ImageTemplCornersMatcher>();
         corners_matcher->stop_on_sal_pnt_moved_too_far_ = FLAGS_monoslam_stop_on_sal_pnt_moved_too_far;
         corners_matcher->min_search_rect_size_ = suriko::Sizei{ FLAGS_monoslam_templ_min_search_rect_width, FLAGS_monoslam_templ_min_search_rect_height };
         if (FLAGS_monoslam_templ_min_corr_coeff > -1)
             corners_matcher->min_templ_corr_coeff_ = static_cast<Scalar>(FLAGS_monoslam_templ_min_corr_coeff);
+        if (FLAGS_monoslam_static_scene_max_block_diff >= 0)
+        {
+            corners_matcher->static_scene_max_block_diff_ = static_cast<Scalar>(FLAGS_monoslam_static_scene_max_block_diff);
+            corners_matcher->static_scene_max_predicted_shift_pix_ = static_cast<Scalar>(FLAGS_monoslam_static_scene_max_shift_pix);
+        }
+        if (FLAGS_monoslam_templ_warp_min_corner_shift_pix >= 0)
+            corners_matcher->templ_warp_min_corner_shift_pix_ = static_cast<Scalar>(FLAGS_monoslam_templ_warp_min_corner_shift_pix);
         corners_matcher->draw_sal_pnt_fun_ = [&drawer](DavisonMonoSlam& mono_slam, SalPntId sal_pnt_id, cv::Mat* out_image_bgr)
         {
-            drawer.DrawEstimatedSalientPoint(mono_slam, sal_pnt_id, out_image_bgr);
+            std::shared_ptr<const DavisonMonoSlamPublishedState> tracker_state = mono_slam.GetPublishedState();
+            if (tracker_state == nullptr)
+                return;
+            auto it = std::find_if(tracker_state->sal_pnts.begin(), tracker_state->sal_pnts.end(),
+                [sal_pnt_id](const PublishedSalientPoint& p) { return p.sal_pnt_id == sal_pnt_id; });
+            if (it != tracker_state->sal_pnts.end())
+                drawer.DrawEstimatedSalientPoint(*it, out_image_bgr);
         };
         corners_matcher->show_image_fun_ = [](std::string_view wnd_name, const cv::Mat& image_bgr)
         {
@@ -1682,6 +2370,20 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
         LOG(INFO) << "imageseq_dir=" << scene_imageseq_dir;
         dir_it = std::filesystem::directory_iterator(scene_imageseq_dir);
     }
+    // the next image is decoded while the tracker processes the current one
+    std::future<DecodedImage> next_decoded_image;
+    auto start_decoding_next_image = [&dir_it, &next_decoded_image]() -> bool
+    {
+        if (dir_it == std::filesystem::directory_iterator()) return false;
+
+        std::filesystem::path image_file_path = dir_it->path();
+        dir_it++;
+
+        auto launch_policy = FLAGS_ctrl_pipeline_image_decoding ? std::launch::async : std::launch::deferred;
+        next_decoded_image = std::async(launch_policy, DecodeImageFile, image_file_path);
+        return true;
+    };
+
     bool iterate_frames = true;
     while(iterate_frames)  // for each frame
     {
@@ -1698,16 +2400,14 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
         }
         else if (demo_data_source == DemoDataSource::kImageSeqDir)
         {
-            if (dir_it == std::filesystem::directory_iterator()) break;
+            if (!next_decoded_image.valid() && !start_decoding_next_image()) break;
 
-            std::filesystem::directory_entry dir_entry = *dir_it;
-            dir_it++;
+            DecodedImage decoded = next_decoded_image.get();  // waits for decoding to finish
+            start_decoding_next_image();
 
-            auto image_file_path = dir_entry.path();
-            auto path_str = image_file_path.string();
-            LOG(INFO) << path_str;
+            LOG(INFO) << decoded.file_path.string();
 
-            image_bgr = cv::imread(image_file_path.string());
+            image_bgr = decoded.image_bgr;
             bool match_size =
                 image_bgr.cols == cam_intrinsics.image_size.width &&
                 image_bgr.rows == cam_intrinsics.image_size.height;
@@ -1719,13 +2419,14 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
                 break;
             }
 
-            cv::Mat image_gray;
-            cv::cvtColor(image_bgr, image_gray, cv::COLOR_BGR2GRAY);
+            image = decoded.image;
+        }
 
-            image.gray = image_gray;
-#if defined(SRK_DEBUG)
-            image.bgr_debug = image_bgr;
-#endif
+        if (FLAGS_ctrl_drop_late_frames && !FLAGS_ctrl_debug_skim_over && mono_slam.IsFrameDropAdvised())
+        {
+            mono_slam.DropFrame(frame_ind);
+            LOG(INFO) << "dropped frame " << frame_ind << " to catch up";
+            continue;
         }
 
         std::optional<std::chrono::duration<double>> frame_process_time; // time it took to process current frame by tracker
@@ -1735,7 +2436,21 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
         {
             auto t1 = std::chrono::high_resolution_clock::now();
 
-            mono_slam.ProcessFrame(frame_ind, image);
+            std::optional<std::chrono::duration<double>> frame_time_budget;
+            if (FLAGS_ctrl_frame_time_budget_ms > 0)
+                frame_time_budget = std::chrono::milliseconds(FLAGS_ctrl_frame_time_budget_ms);
+
+            // the sample covers the interval from the previous frame
+            if (frame_ind > 0 && frame_ind <= virtual_imu_samples.size())
+                mono_slam.SetImuSample(virtual_imu_samples[frame_ind - 1]);
+
+            mono_slam.ProcessFrame(frame_ind, image, frame_time_budget);
+
+            if (FLAGS_monoslam_freeze_map_after_frame >= 0 && frame_ind == static_cast<size_t>(FLAGS_monoslam_freeze_map_after_frame))
+            {
+                mono_slam.FreezeMap();
+                LOG(INFO) << "frozen map of " << mono_slam.FrozenSalientPointsCount() << " salient points, localization only";
+            }
 
             auto t2 = std::chrono::high_resolution_clock::now();
             frame_process_time = t2 - t1;
@@ -1799,7 +2514,8 @@ int DavisonMonoSlamDemo(int argc, char* argv[])
                 auto t1 = std::chrono::high_resolution_clock::now();
 
                 image_bgr.copyTo(camera_image_bgr);  // background
-                drawer.DrawScene(mono_slam, &camera_image_bgr);
+                if (auto tracker_state = mono_slam.GetPublishedState(); tracker_state != nullptr)
+                    drawer.DrawScene(*tracker_state, &camera_image_bgr);
 
                 std::stringstream strbuf;
                 strbuf << "f=" << frame_ind;
@@ -0,0 +1,235 @@
+#pragma once
+#include <algorithm> // std::min, std::copy
+#include <array>
+#include <cmath>
+#include <memory>
+#include <variant>
+#include <vector>
+#include <Eigen/Dense>
+#include "suriko/rt-config.h"
+#include "suriko/obs-geom.h"
+
+namespace suriko
+{
+/// ax=f/dx and ay=f/dy
+/// (alpha_x = focal_length_x_meters / pixel_width_meters)
+struct CameraIntrinsicParams
+{
+    suriko::Sizei image_size;  // [width, height] image resolution
+
+    std::array<Scalar, 2> principal_point_pix; // [Cx,Cy] in pixels
+
+    Scalar focal_length_mm;  // =f, focal length in millimeters
+
+    // Used in distortion model.
+    std::array<Scalar,2> pixel_size_mm; // [dx,dy] in millimeters
+
+    /// Focal length in pixels (alphax=f/dx, alphay=f/dy)
+    std::array<Scalar, 2> FocalLengthPix() const { return { focal_length_mm / pixel_size_mm[0], focal_length_mm / pixel_size_mm[1] }; }
+};
+
+Scalar Calc_rd(const CameraIntrinsicParams& cam_intrinsics, const Point2f& h_distorted);
+
+/// Radial distortion as described in "Introduction to modern photogrammetry", Mikhail, 2001.
+/// The distortion model uses the scale factor=1+k1*r^2+k2*r^4
+/// Reconstructed history:
+/// In 2007 Davison used Swaminathan and Nayar distortion model as per paper "MonoSLAM Real-Time Single Camera SLAM", Davison, 2007.
+/// In 2008 Davison switched to Mikhail distortion model as per paper "Inverse depth parametrization for monocular SLAM", Civera, Davison, Montiel, 2008.
+struct MikhailRadialDistortionParams
+{
+    // Radial distortion model as in A.26: ru=rd(1+k1*rd^2+k2*rd^4)
+    // (k1,k2)=(0,0) means no distortion.
+    Scalar k1 = 0;  // the coefficient before rd^2, measured in mm^-2
+    Scalar k2 = 0;  // the coefficient before rd^4, measured in mm^-4
+};
+
+// Camera models map between undistorted pixels hu (the image of the ideal pinhole camera) and distorted pixels hd
+// (the image, observed by the real camera). Each model provides:
+// UndistortPixel(hd)->hu, used to back-project observed corners,
+// DistortPixel(hu)->hd, used to project salient points,
+// Deriv_hu_by_hd(hd), the 2x2 Jacobian of the undistortion (its inverse is the Jacobian of the distortion, A.33).
+
+/// The ideal pinhole camera, the distorted pixel coincides with the undistorted one.
+struct PinholeCameraModel
+{
+    suriko::Point2f DistortPixel(const CameraIntrinsicParams&, const suriko::Point2f& hu) const { return hu; }
+
+    suriko::Point2f UndistortPixel(const CameraIntrinsicParams&, const suriko::Point2f& hd) const { return hd; }
+
+    void Deriv_hu_by_hd(const CameraIntrinsicParams&, const suriko::Point2f&, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const
+    {
+        hu_by_hd->setIdentity();
+    }
+};
+
+/// The grid of undistorted coordinates and undistortion Jacobians, precomputed at each pixel of the distorted image.
+/// The values between pixels are interpolated bilinearly.
+class DistortionLut
+{
+    static constexpr size_t kHu = 2;  // [uu,vu]
+    static constexpr size_t kHuByHd = 4;  // 2x2 in column-major order
+    using Cell = std::array<Scalar, kHu + kHuByHd>;
+
+    suriko::Sizei size_{};
+    std::vector<Cell> cells_;
+public:
+    /// @param undistort_fun (hd, hu*, hu_by_hd*) computes the undistorted pixel and the Jacobian at the given pixel
+    template <typename UndistortFun>
+    void Build(suriko::Sizei image_size, UndistortFun undistort_fun)
+    {
+        size_ = image_size;
+        cells_.resize(static_cast<size_t>(image_size.width) * image_size.height);
+        for (int y = 0; y < image_size.height; ++y)
+            for (int x = 0; x < image_size.width; ++x)
+            {
+                suriko::Point2f hu;
+                Eigen::Matrix<Scalar, 2, 2> hu_by_hd;
+                undistort_fun(suriko::Point2f{ x, y }, &hu, &hu_by_hd);
+
+                Cell& cell = cells_[static_cast<size_t>(y) * image_size.width + x];
+                cell[0] = hu[0];
+                cell[1] = hu[1];
+                std::copy(hu_by_hd.data(), hu_by_hd.data() + kHuByHd, cell.begin() + kHu);
+            }
+    }
+
+    /// Interpolates the undistorted pixel and (optionally) the Jacobian at the given distorted pixel.
+    /// Returns false when the pixel is outside of the grid.
+    bool Lookup(const suriko::Point2f& hd, suriko::Point2f* hu, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const
+    {
+        Scalar x = hd.X();
+        Scalar y = hd.Y();
+        if (!(x >= 0 && y >= 0 && x <= size_.width - 1 && y <= size_.height - 1) || size_.width < 2 || size_.height < 2)
+            return false;
+
+        int x0 = std::min(static_cast<int>(x), size_.width - 2);
+        int y0 = std::min(static_cast<int>(y), size_.height - 2);
+        Scalar tx = x - x0;
+        Scalar ty = y - y0;
+
+        const Cell& c00 = cells_[static_cast<size_t>(y0) * size_.width + x0];
+        const Cell& c01 = (&c00)[1];
+        const Cell& c10 = (&c00)[size_.width];
+        const Cell& c11 = (&c10)[1];
+        auto interp = [=, &c00, &c01, &c10, &c11](size_t i) -> Scalar
+        {
+            Scalar top = c00[i] + (c01[i] - c00[i]) * tx;
+            Scalar bot = c10[i] + (c11[i] - c10[i]) * tx;
+            return top + (bot - top) * ty;
+        };
+
+        if (hu != nullptr)
+        {
+            (*hu)[0] = interp(0);
+            (*hu)[1] = interp(1);
+        }
+        if (hu_by_hd != nullptr)
+        {
+            for (size_t i = 0; i < kHuByHd; ++i)
+                hu_by_hd->data()[i] = interp(kHu + i);
+        }
+        return true;
+    }
+};
+
+/// The base for camera models with distortion, which may have the lookup table precomputed.
+/// The derived class implements DistortPixelExact, UndistortPixelExact and Deriv_hu_by_hdExact.
+template <typename Derived>
+class DistortedCameraModel
+{
+    // the grid is shared between the copies of the model (eg. the copies of the tracker)
+    std::shared_ptr<const DistortionLut> lut_;
+public:
+    static constexpr int kDistortLutMaxIters = 5;
+    static constexpr Scalar kDistortLutTolPix = static_cast<Scalar>(1e-4);
+
+    /// Precomputes undistorted coordinates and Jacobians at each pixel of the image of the given camera.
+    /// The table must be rebuilt when the camera intrinsics change.
+    void BuildLut(const CameraIntrinsicParams& cam_intrinsics)
+    {
+        auto lut = std::make_shared<DistortionLut>();
+        lut->Build(cam_intrinsics.image_size,
+            [this, &cam_intrinsics](const suriko::Point2f& hd, suriko::Point2f* hu, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd)
+            {
+                *hu = Self().UndistortPixelExact(cam_intrinsics, hd);
+                Self().Deriv_hu_by_hdExact(cam_intrinsics, hd, hu_by_hd);
+            });
+        lut_ = std::move(lut);
+    }
+
+    void ResetLut() { lut_.reset(); }
+
+    bool HasLut() const { return lut_ != nullptr; }
+
+    suriko::Point2f UndistortPixel(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd) const
+    {
+        suriko::Point2f hu;
+        if (lut_ != nullptr && lut_->Lookup(hd, &hu, nullptr))
+            return hu;
+        return Self().UndistortPixelExact(cam_intrinsics, hd);
+    }
+
+    void Deriv_hu_by_hd(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const
+    {
+        if (lut_ != nullptr && lut_->Lookup(hd, nullptr, hu_by_hd))
+            return;
+        Self().Deriv_hu_by_hdExact(cam_intrinsics, hd, hu_by_hd);
+    }
+
+    /// With the lookup table, the distortion is inverted by Newton iterations on the table (usually 2-3 iterations),
+    /// instead of solving the distortion polynomial.
+    suriko::Point2f DistortPixel(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hu) const
+    {
+        if (lut_ != nullptr)
+        {
+            // distortion is small in the center of the image, hence hd=hu is a good first guess
+            suriko::Point2f hd = hu;
+            for (int iter = 0; iter < kDistortLutMaxIters; ++iter)
+            {
+                suriko::Point2f hu_iter;
+                Eigen::Matrix<Scalar, 2, 2> hu_by_hd;
+                if (!lut_->Lookup(hd, &hu_iter, &hu_by_hd))
+                    break;
+
+                Eigen::Matrix<Scalar, 2, 1> step = hu_by_hd.inverse() * (hu.Mat() - hu_iter.Mat());
+                hd.Mat() += step;
+                if (step.cwiseAbs().maxCoeff() < kDistortLutTolPix)
+                    return hd;
+            }
+            // the pixel is outside of the image, or the iterations didn't converge
+        }
+        return Self().DistortPixelExact(cam_intrinsics, hu);
+    }
+private:
+    const Derived& Self() const { return static_cast<const Derived&>(*this); }
+};
+
+/// Radial distortion by Mikhail, see MikhailRadialDistortionParams.
+class MikhailRadialCameraModel : public DistortedCameraModel<MikhailRadialCameraModel>
+{
+public:
+    MikhailRadialDistortionParams params;
+
+    MikhailRadialCameraModel() = default;
+    explicit MikhailRadialCameraModel(const MikhailRadialDistortionParams& distort_params) : params(distort_params) {}
+
+    suriko::Point2f DistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hu) const;
+    suriko::Point2f UndistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd) const;
+    void Deriv_hu_by_hdExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const;
+};
+
+/// Equidistant fisheye lens, the distance to the principal point is proportional to the angle of the incoming ray,
+/// rd=f*theta, while the pinhole camera has ru=f*tan(theta).
+/// The model is valid for the field of view up to 180 degrees.
+class EquidistantFisheyeCameraModel : public DistortedCameraModel<EquidistantFisheyeCameraModel>
+{
+public:
+    suriko::Point2f DistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hu) const;
+    suriko::Point2f UndistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd) const;
+    void Deriv_hu_by_hdExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const;
+};
+
+/// The camera model of the tracker. Each alternative is a separate type, so the distortion of the chosen model is
+/// compiled without the checks for the others (the pinhole model reduces to identity).
+using CameraModel = std::variant<PinholeCameraModel, MikhailRadialCameraModel, EquidistantFisheyeCameraModel>;
+}
@@ -3,8 +3,9 @@
 #include <vector>
 #include <memory>
 #include <set>
-#include <shared_mutex>
 #include <functional>
+#include <chrono>
+#include <random>
 #include <gsl/span>
 
 #if defined(SRK_HAS_OPENCV)
@@ -13,6 +14,7 @@
 
 #include "suriko/obs-geom.h"
 #include "suriko/image-proc.h"
+#include "suriko/camera-model.h"
 
 namespace suriko {
 namespace
@@ -20,6 +22,7 @@ namespace
     constexpr Scalar kNan = std::numeric_limits<Scalar>::quiet_NaN();
     constexpr size_t kEucl3 = 3; // x: 3 for position
     constexpr size_t kQuat4 = 4; // q: 4 for quaternion orientation
+    constexpr size_t kOrientErrComps = kEucl3; // dtheta: 3 for the orientation error, relative to the nominal orientation
     constexpr size_t kVelocComps = kEucl3; // v: 3 for velocity
     constexpr size_t kAngVelocComps = kEucl3; // w: 3 for angular velocity
     constexpr size_t kAccelComps = kEucl3; // a: 3 for acceleration
@@ -27,20 +30,21 @@ namespace
     constexpr size_t kPixPosComps = 2; // rows and columns
     constexpr Scalar kCamPlaneZ = 1; // z=1 in [x,y,1]
 
-    // [x q v w], x: 3 for position, q: 4 for quaternion orientation, v: 3 for velocity, w: 3 for angular velocity
-    constexpr size_t kCamStateComps = kEucl3 + kQuat4 + kVelocComps + kAngVelocComps; // 13
     constexpr size_t kProcessNoiseComps = kVelocComps + kAngVelocComps; // Qk.rows: velocity and angular velocity are updated an each iteration by noise
     constexpr size_t kSalientPointPolarCompsCount = 3; // [theta elevation rho], theta: 1 for azimuth angle, 1 for elevation angle, rho: 1 for distance
     constexpr size_t kRho = 1; // inverse distance
     constexpr size_t kXyzSalientPointComps = kEucl3;  // [XYZ]=[3x1]
     constexpr size_t kSphericalSalientPointComps = kEucl3 + kSalientPointPolarCompsCount;  // [FirstCamXYZ theta elevation rho]=[6x1]
+    constexpr size_t kAnchoredSalientPointComps = kSalientPointPolarCompsCount;  // [theta elevation rho]=[3x1], FirstCamXYZ is in the anchor
+}
 
-    /// Specifies the data to store for each salient point.
-    enum class SalPntComps
-    {
-        kXyz,                      // [3x1] [X Y Z] the Euclidean point case
-        kSphericalFirstCamInvDist  // [6x1] [x y z azim elev rho] inverse depth case
-    };
+/// Specifies the data to store for each salient point.
+enum class SalPntComps
+{
+    kXyz,                      // [3x1] [X Y Z] the Euclidean point case
+    kSphericalFirstCamInvDist, // [6x1] [x y z azim elev rho] inverse depth case
+    kSphericalAnchoredInvDist  // [3x1] [azim elev rho] inverse depth case, [x y z] of the first camera is shared (see SalPntAnchor)
+};
 
 // The flags to specify the representation of a salient point is for debugging 
 // (to demarcate the code which depends on a particular representation).
@@ -54,31 +58,75 @@ namespace
 #  define SAL_PNT_REPRES 2
 #endif
 
+#if SAL_PNT_REPRES == 1
+constexpr SalPntComps kSalPntRepres = SalPntComps::kXyz;
+#elif SAL_PNT_REPRES == 2
+constexpr SalPntComps kSalPntRepres = SalPntComps::kSphericalFirstCamInvDist;
+#endif
+
+namespace
+{
     namespace intern
     {
 #if SAL_PNT_REPRES == 1
         // XYZ salient point
         constexpr size_t kSalientPointComps = kXyzSalientPointComps;  // [3x1]
-        constexpr SalPntComps kSalPntRepres = SalPntComps::kXyz;
 #elif SAL_PNT_REPRES == 2
         // spherical salient point with first camera position and inverse distance
         constexpr size_t kSalientPointComps = kSphericalSalientPointComps;  // [6x1]
-        constexpr SalPntComps kSalPntRepres = SalPntComps::kSphericalFirstCamInvDist;
 #endif
     }
 
     // the index of a camera frame to choose for the origin of tracker
     constexpr size_t kTrackerOriginCamInd = 0;
 
-    struct DavisonMonoSlamConstants
+    // Motion models of the camera. The state of the camera starts with [x dtheta], the motion model appends the derivatives
+    // it keeps. The process noise is the change of velocities in one frame period, for all models.
+
+    /// The camera stays still, it is moved by the process noise only: [x dtheta] (6 variables).
+    /// Suits the mostly static cameras, the state is cheaper by 6 variables.
+    struct ConstantPositionMotionModel
+    {
+        static constexpr bool kHasVelocity = false;
+        static constexpr size_t kStateComps = kEucl3 + kOrientErrComps; // 6
+    };
+
+    /// Constant linear and angular velocity: [x dtheta v w] (12 variables), as in Davison's MonoSlam.
+    struct ConstantVelocityMotionModel
     {
-        static constexpr size_t kCamStateComps = kEucl3 + kQuat4 + kVelocComps + kAngVelocComps; // 13
+        static constexpr bool kHasVelocity = true;
+        static constexpr size_t kStateComps = kEucl3 + kOrientErrComps + kVelocComps + kAngVelocComps; // 12
     };
+
+// The motion model is chosen at compile time, so that the blocks of the camera state are fixed-size.
+// 1=constant position, 2=constant velocity
+#ifndef CAM_MOTION_MODEL
+#  define CAM_MOTION_MODEL 2
+#endif
+
     namespace intern
     {
-        constexpr size_t kCamStateComps = kEucl3 + kQuat4 + kVelocComps + kAngVelocComps; // 13
+#if CAM_MOTION_MODEL == 1
+        using CamMotionModel = ConstantPositionMotionModel;
+#elif CAM_MOTION_MODEL == 2
+        using CamMotionModel = ConstantVelocityMotionModel;
+#endif
+        constexpr size_t kCamStateComps = CamMotionModel::kStateComps;
+
+        // [x q v w], the camera state with the orientation as a quaternion, q: 4 for quaternion orientation
+        constexpr size_t kCamStateQuatComps = kEucl3 + kQuat4 + kVelocComps + kAngVelocComps; // 13
+    };
+
+    struct DavisonMonoSlamConstants
+    {
+        static constexpr size_t kCamStateComps = intern::kCamStateComps;
     };
 
+    // [x dtheta v w], x: 3 for position, dtheta: 3 for orientation error, v: 3 for velocity, w: 3 for angular velocity
+    // (velocities only in the constant velocity model)
+    constexpr size_t kCamStateComps = intern::kCamStateComps;
+    constexpr bool kCamStateHasVelocity = intern::CamMotionModel::kHasVelocity;
+
     void DependsOnOverallPackOrder() {}
     void DependsOnCameraPosPackOrder() {}
     void DependsOnSalientPointPackOrder() {}
@@ -117,14 +165,45 @@ enum class SalPntTemplCenterDeriveFrom
 // Internal
 suriko::Point2i TemplateTopLeftInt(const suriko::Point2f& center, suriko::Sizei templ_size);
 
+/// The number of estimated variables of a salient point in the given representation.
+inline size_t SalientPointVarsCount(SalPntComps repres)
+{
+    switch (repres)
+    {
+    case SalPntComps::kXyz: return kXyzSalientPointComps;
+    case SalPntComps::kSphericalFirstCamInvDist: return kSphericalSalientPointComps;
+    default: return kAnchoredSalientPointComps;
+    }
+}
+
+/// The position of the camera, shared by inverse depth salient points, which were seen for the first time in the same frame.
+/// The anchor is estimated once, instead of being duplicated in each salient point.
+struct SalPntAnchor
+{
+    size_t estim_vars_ind; // index of [3x1] first camera position in X and P matrices
+    size_t sal_pnts_count = 0;  // number of salient points, which refer to this anchor
+    size_t frame_ind;  // the frame in which salient points of this anchor were seen for the first time
+};
+
 /// Represents the portion of the image, which is the projection of salient image into a camera.
 struct TrackedSalientPoint
 {
     size_t sal_pnt_ind; // order of the salient point in the sequence of salient points
-    size_t estim_vars_ind; // index into X[13+6N,1] and P[13+6N,13+6N] matrices
+    size_t estim_vars_ind; // index into X[12+6N,1] and P[12+6N,12+6N] matrices
+    SalPntComps repres = kSalPntRepres;  // inverse depth salient point may be converted into XYZ one, when its depth is well estimated
+    SalPntAnchor* anchor = nullptr;  // the first camera position of the anchored inverse depth salient point
 
     SalPntTrackStatus track_status;
     size_t undetected_frames_count = 0;  // number of frames for which this salient point isn't detected; 0 if it is observed.
+    bool measurement_deferred = false;  // true if active search didn't select this salient point for matching in current frame
+    bool in_candidate_pool = false;  // true while the salient point is tracked outside of the state, until its depth converges
+    bool in_frozen_map = false;  // true for the salient point of the frozen map in localization-only mode; sal_pnt_ind is the order in the map
+
+    // the history of tracking, which is used to score the salient point, when the budget of salient points is exhausted
+    size_t search_count = 0;  // number of frames, in which the salient point was searched for
+    size_t match_count = 0;  // number of frames, in which the salient point was matched
+    size_t last_seen_frame_ind = 0;
+    Scalar innov_consistency = 1;  // running average of the normalized innovation squared per component of the observation; ~1 for consistent salient points
 
     // The distorted coordinates in the current camera, corresponds to the center of the image template.
     std::optional <suriko::Point2f> templ_center_pix_;
@@ -148,6 +227,11 @@ struct TrackedSalientPoint
 
     // Rectangular portion of the gray image corresponding to salient point, projected in current frame.
     cv::Mat initial_templ_gray_;
+
+    // the view in which the template was cut from the image, used to predict the appearance of the template in other views
+    suriko::Point2i initial_templ_top_left_pix_;
+    Point3 initial_cam_pos_w_;
+    Eigen::Matrix<Scalar, kQuat4, 1> initial_cam_orient_wfc_;
 #if defined(SRK_DEBUG)
     cv::Mat initial_templ_bgr_debug;
 #endif
@@ -160,6 +244,15 @@ struct TrackedSalientPoint
 
     bool IsDeleted() const { return track_status == SalPntTrackStatus::Deleted; }
 
+    /// The number of estimated variables of the salient point, 3 or 6.
+    size_t EstimVarsCount() const { return SalientPointVarsCount(repres); }
+
+    /// The number of variables of the salient point, including the variables of its anchor.
+    size_t EstimVarsCountWithAnchor() const
+    {
+        return EstimVarsCount() + (anchor != nullptr ? kEucl3 : 0);
+    }
+
     void SetTemplCenterPix(suriko::Point2f center, suriko::Sizei templ_size)
     {
         templ_center_pix_ = center;
@@ -217,6 +310,9 @@ public:
     virtual void AnalyzeFrame(size_t frame_ind, const Picture& image) {}
     virtual void OnSalientPointIsAssignedToBlobId(SalPntId sal_pnt_id, CornersMatcherBlobId blob_id, const Picture& image) {}
 
+    /// Called before the salient point is destroyed; its id may be reused by a new salient point afterwards.
+    virtual void OnSalientPointIsRemoved(SalPntId sal_pnt_id) {}
+
     virtual void MatchSalientPoints(
         const DavisonMonoSlam& mono_slam,
         const std::set<SalPntId>& tracking_sal_pnts,
@@ -224,6 +320,11 @@ public:
         const Picture& image,
         std::vector<std::pair<SalPntId, CornersMatcherBlobId>>* matched_sal_pnts) {}
 
+    /// Detects the candidates for new salient points, which are consumed later in RecruitNewSalientPoints.
+    /// This may be called concurrently with the update of the tracker's state, hence an implementation
+    /// must depend only on the image and must not touch the data, used by MatchSalientPoints.
+    virtual void DetectNewBlobCandidates(size_t frame_ind, const Picture& image) {}
+
     virtual void RecruitNewSalientPoints(
         const DavisonMonoSlam& mono_slam,
         const std::set<SalPntId>& tracking_sal_pnts,
@@ -242,39 +343,10 @@ public:
 
     virtual std::optional<Scalar> GetSalientPointGroundTruthInvDepth(CornersMatcherBlobId blob_id) { return std::nullopt; };
 
-    void SetSuppressObservations(bool value) { suppress_observations_ = value; }
-};
-
-/// ax=f/dx and ay=f/dy 
-/// (alpha_x = focal_length_x_meters / pixel_width_meters)
-struct CameraIntrinsicParams
-{
-    suriko::Sizei image_size;  // [width, height] image resolution
-
-    std::array<Scalar, 2> principal_point_pix; // [Cx,Cy] in pixels
+    /// The number of salient points in the latest MatchSalientPoints, whose match in the previous frame was reused without search.
+    virtual size_t ReusedMatchesCount() const { return 0; }
 
-    Scalar focal_length_mm;  // =f, focal length in millimeters
-    
-    // Used in distortion model.
-    std::array<Scalar,2> pixel_size_mm; // [dx,dy] in millimeters
-
-    /// Focal length in pixels (alphax=f/dx, alphay=f/dy)
-    std::array<Scalar, 2> FocalLengthPix() const { return { focal_length_mm / pixel_size_mm[0], focal_length_mm / pixel_size_mm[1] }; }
-};
-
-Scalar Calc_rd(const CameraIntrinsicParams& cam_intrinsics, const Point2f& h_distorted);
-
-/// Radial distortion as described in "Introduction to modern photogrammetry", Mikhail, 2001.
-/// The distortion model uses the scale factor=1+k1*r^2+k2*r^4
-/// Reconstructed history:
-/// In 2007 Davison used Swaminathan and Nayar distortion model as per paper "MonoSLAM Real-Time Single Camera SLAM", Davison, 2007.
-/// In 2008 Davison switched to Mikhail distortion model as per paper "Inverse depth parametrization for monocular SLAM", Civera, Davison, Montiel, 2008.
-struct MikhailRadialDistortionParams
-{
-    // Radial distortion model as in A.26: ru=rd(1+k1*rd^2+k2*rd^4)
-    // (k1,k2)=(0,0) means no distortion.
-    Scalar k1 = 0;  // the coefficient before rd^2, measured in mm^-2
-    Scalar k2 = 0;  // the coefficient before rd^4, measured in mm^-4
+    void SetSuppressObservations(bool value) { suppress_observations_ = value; }
 };
 
 /// Position and orientation of an object in 3D space.
@@ -328,10 +400,49 @@ struct SalPntRectFacet
     suriko::Point3& BotRight() { return points[kBotRightInd]; }
 };
 
+/// The salient point as it is seen by the readers of published tracker's state.
+struct PublishedSalientPoint
+{
+    SalPntId sal_pnt_id;
+    size_t sal_pnt_ind;
+    SalPntTrackStatus track_status;
+
+    std::optional<Point3> pos_w;  // null for a salient point in infinity
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> pos_uncert;
+
+    std::optional<suriko::Point2f> templ_center_pix;
+    std::optional<RotatedEllipse2D> estim_ellipse_pix;  // uncertainty of the salient point's projection in current frame
+    std::optional<RotatedEllipse2D> predicted_ellipse_pix;  // the search area in the next frame
+    std::optional<SalPntRectFacet> templ_rect_w;  // only for salient points, detected in current frame
+    cv::Mat initial_templ_gray;  // shared (not copied) with the tracker as the template doesn't change
+#if defined(SRK_DEBUG)
+    cv::Mat initial_templ_bgr_debug;
+#endif
+
+    bool IsDetected() const
+    {
+        return track_status == SalPntTrackStatus::New || track_status == SalPntTrackStatus::Matched;
+    }
+};
+
+/// The snapshot of the tracker's state, published at the end of each frame.
+/// Readers (eg UI thread) hold the latest snapshot and never see the tracker's internals; a published snapshot is immutable,
+/// so neither the tracker nor the readers wait for each other.
+struct DavisonMonoSlamPublishedState
+{
+    size_t version = 0;  // incremented on each publication
+    size_t frame_ind = 0;
+
+    CameraStateVars cam_state;
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_pos_uncert;
+
+    std::vector<PublishedSalientPoint> sal_pnts;
+};
+
 /// Represents a state of the tracker.
 struct DavisonMonoSlamTrackerInternalsSlice
 {
-    static constexpr auto kCamStateComps = intern::kCamStateComps;
+    static constexpr auto kCamStateQuatComps = intern::kCamStateQuatComps;
 
     std::chrono::duration<double> frame_processing_dur; // frame processing duration
     Scalar cur_reproj_err_meas = -1;  // measured
@@ -345,13 +456,33 @@ struct DavisonMonoSlamTrackerInternalsSlice
     std::optional<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> estim_err; // =x_estimated-x_ground_truth, available only in virtual mode
     Eigen::Matrix<Scalar, Eigen::Dynamic, 1> estim_err_std;
 
-    Eigen::Matrix<Scalar, kCamStateComps, 1> cam_state;
-    std::optional<Eigen::Matrix<Scalar, kCamStateComps, 1>> cam_state_gt; // available only in virtual mode
+    Eigen::Matrix<Scalar, kCamStateQuatComps, 1> cam_state; // [x q v w]
+    std::optional<Eigen::Matrix<Scalar, kCamStateQuatComps, 1>> cam_state_gt; // available only in virtual mode
 
     std::optional<Eigen::Matrix<Scalar, 3, 3>> sal_pnts_uncert_median; // median of uncertainty of all salient points; null if there are 0 salient points
 
     Eigen::Matrix<Scalar, Eigen::Dynamic, 1> meas_residual;  // =obs-project(estimate)=z-h(x_hat)
     Eigen::Matrix<Scalar, Eigen::Dynamic, 1> meas_residual_std;
+
+    // deadline-aware processing, available when a frame is processed with a time budget
+    bool deadline_missed = false;  // true if the frame was processed longer than its time budget
+    bool deadline_capped_search_rects = false;  // true if the search rectangles were capped because the previous frame was late
+    size_t deadline_dropped_obs = 0;  // number of matched salient points, which were not fused into the filter to meet the deadline
+    bool deadline_skipped_recruitment = false;  // true if no new salient points were searched for to meet the deadline
+
+    size_t active_search_deferred_sal_pnts = 0;  // number of tracked salient points, which active search didn't select for matching
+    size_t reused_matches = 0;  // number of salient points, whose match in the previous frame was reused by the corners matcher
+
+    int update_impl = 0;  // the implementation of the update step, used in the frame; see DavisonMonoSlam::mono_slam_update_impl_
+    size_t one_point_ransac_hypotheses = 0;  // number of hypotheses, evaluated by 1-point RANSAC
+    size_t sal_pnts_switched_to_xyz = 0;  // number of inverse depth salient points, converted into XYZ representation
+    size_t sal_pnt_candidates = 0;  // number of candidates for new salient points, tracked outside of the state
+    size_t sal_pnt_candidates_promoted = 0;  // number of candidates, which were put into the state in current frame
+    size_t sal_pnts_evicted = 0;  // number of salient points, evicted from the state to fit the budget of salient points
+    size_t dropped_frames = 0;  // number of frames, dropped right before current frame
+    Scalar predicted_interval = 0;  // in seconds, the time interval, spanned by the prediction for current frame
+    bool imu_aided_prediction = false;  // true if the prediction for current frame used inertial measurements
+    Scalar process_noise_scale = 1;  // the scale of process noise covariance for the next frame, see DavisonMonoSlam::process_noise_adaptive_
 };
 
 /// Represents the history of the tracker processing a sequence of frames.
@@ -393,11 +524,17 @@ class DavisonMonoSlam
 public:
     static constexpr auto kCamStateComps = intern::kCamStateComps;
     static constexpr size_t kSalientPointComps = intern::kSalientPointComps;
-    static constexpr SalPntComps kSalPntRepres = intern::kSalPntRepres;
+    static constexpr SalPntComps kSalPntRepres = suriko::kSalPntRepres;
     static constexpr Scalar kFiniteDiffEpsDebug = (Scalar)1e-5; // used for debugging derivatives
 
     using EigenDynMat = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
     using EigenDynVec = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+    // the number of variables of a salient point depends on its representation, but it doesn't exceed kSalientPointComps
+    using SalPntVec = Eigen::Matrix<Scalar, Eigen::Dynamic, 1, Eigen::ColMajor, kSalientPointComps, 1>;
+    using SalPntMat = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, kSalientPointComps, kSalientPointComps>;
+    using HdBySalPntMat = Eigen::Matrix<Scalar, kPixPosComps, Eigen::Dynamic, Eigen::ColMajor, kPixPosComps, kSalientPointComps>;
+    using SalPntCovarCols = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, Eigen::Dynamic, kSalientPointComps>;
 public:
     enum class DebugPathEnum
     {
@@ -415,18 +552,40 @@ public:
     using SalPntId = suriko::SalPntId;
 private:
     static DebugPathEnum s_debug_path_;
-    EigenDynVec estim_vars_; // x[13+N*6], camera position plus all salient points
-    EigenDynMat estim_vars_covar_; // P[13+N*6, 13+N*6], state's covariance matrix
+    EigenDynVec estim_vars_; // x[12+N*6], camera position plus all salient points
+    EigenDynMat estim_vars_covar_; // P[12+N*6, 12+N*6], state's covariance matrix
+
+    EigenDynVec predicted_estim_vars_; // x[12+N*6]
+    EigenDynMat predicted_estim_vars_covar_; // P[12+N*6, 12+N*6]
+
+    // Lower-triangular factors of the covariance matrices, P=L*Lt, maintained only by the square-root update
+    // (mono_slam_update_impl_=7). The empty factor is recomputed from its covariance matrix on demand.
+    EigenDynMat estim_vars_covar_sqrt_; // L[12+N*6, 12+N*6]
+    EigenDynMat predicted_estim_vars_covar_sqrt_; // L[12+N*6, 12+N*6]
 
-    std::shared_mutex predicted_estim_vars_mutex_;  // NOTE: this field prevents this tracker from copying
-    EigenDynVec predicted_estim_vars_; // x[13+N*6]
-    EigenDynMat predicted_estim_vars_covar_; // P[13+N*6, 13+N*6]
+    // True when the factors are the primary store of covariances. The covariance matrices keep only the rows of the camera
+    // and the blocks of each salient point (with its anchor), derived from the factors; the covariances between
+    // salient points are stale, they are recovered from the factors when the factors are dropped.
+    bool covar_marginals_only_ = false;
+
+    // The nominal orientation of the camera is kept outside of the state, which holds only the small orientation error
+    // dtheta, orientation_wfc=cam_orient_wfc_nominal_*exp(dtheta). It is shared by estimated and predicted variables.
+    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_wfc_nominal_;
 
     std::vector<std::unique_ptr<TrackedSalientPoint>> sal_pnts_; // the set of descriptors of salient points (including deleted salient points)
     size_t estim_sal_pnts_count_ = 0;  // number of salient points in error covariance matrix; this doesn't include deleted salient points
-
+    std::vector<std::unique_ptr<SalPntAnchor>> sal_pnt_anchors_; // anchors, shared by salient points, which were initialized in the same frame
+
+    // The tracker fills the spare snapshot, which readers never access, then replaces the published snapshot with it by
+    // std::atomic_exchange; readers take the published snapshot by std::atomic_load. The previous snapshot becomes the spare one,
+    // unless a reader still holds it.
+    std::shared_ptr<const DavisonMonoSlamPublishedState> published_state_;
+    std::shared_ptr<DavisonMonoSlamPublishedState> spare_published_state_;
+    size_t published_state_version_ = 0;
 public:
-    bool in_multi_threaded_mode_ = false;  // true to expect the clients to read predicted vars from different thread; locks are used to protect from conflicting access
+    bool in_multi_threaded_mode_ = false;  // true to expect the clients to read the tracker's state from different thread; see GetPublishedState()
+    bool publish_state_ = false;  // true to publish the snapshot of tracker's state at the end of each frame
+    bool detect_new_blobs_concurrently_ = false;  // true to overlap the detection of new salient points with the update of the filter
 
     // Civera used delta_t=1; Davison used delta_t=0.033333333 in original MonoSlam
     // Working configurations:
@@ -448,6 +607,21 @@ public:
 
     Eigen::Matrix<Scalar, kProcessNoiseComps, kProcessNoiseComps> process_noise_covar_; // Qk[6,6] process noise covariance matrix
 
+    /// True to estimate the process noise from the innovations: process_noise_covar_ is the worst case, it is scaled down
+    /// while the innovations are small relative to their predicted uncertainty and is widened back on aggressive motion.
+    bool process_noise_adaptive_ = false;
+
+    /// The lower bound of the scale of process_noise_covar_ in adaptive mode.
+    Scalar process_noise_adaptive_min_scale_ = 0.05f;
+
+    // The inertial measurements (see SetImuSample) replace the guesses of the motion model, hence the process noise
+    // shrinks to the noise of the sensors, and so do the search regions of salient points.
+    Scalar imu_gyro_noise_std_ = 0.01f;  // in radians per second
+    Scalar imu_accel_noise_std_ = 0.1f;  // in map units per second^2
+
+    /// The gravity in the tracker's frame, in map units per second^2. The accelerometer is used only when the gravity is known.
+    std::optional<suriko::Point3> imu_gravity_w_;
+
     Scalar measurm_noise_std_pix_ = 1;
 
     // default camera's uncertainty
@@ -473,6 +647,43 @@ public:
     std::optional<size_t> sal_pnt_max_undetected_frames_count_;  // salient points greater than this value are removed from tracker
     std::optional<Scalar> sal_pnt_negative_inv_rho_substitute_;  // >=0 value, this replaces negative inv rho of a salient point (SP), preventing SP from jumping behind the camera
 
+    /// The inverse depth salient point is converted into XYZ one, when the linearity index of its depth drops below this value.
+    /// Civera suggests 0.1; null to keep inverse depth representation of salient points.
+    std::optional<Scalar> sal_pnt_switch_to_xyz_linearity_index_;
+
+    /// True to store the first camera position once for all inverse depth salient points, initialized in the same frame.
+    /// Such salient points hold [azimuth, elevation, inverse distance] and refer the shared anchor,
+    /// which reduces the state from 6 to 3 variables per salient point.
+    bool sal_pnt_shared_anchor_ = false;
+
+    /// New salient points are tracked outside of the state as candidates, each with a set of hypotheses of its depth.
+    /// The candidate, tracked in this number of frames and with converged depth, is put into the state;
+    /// null to put new salient points into the state immediately. The salient points of the empty state always go into the state.
+    std::optional<size_t> sal_pnt_candidate_min_frames_;
+    size_t sal_pnt_candidate_max_frames_ = 30;  // the candidate, which depth doesn't converge in this number of frames, is discarded
+    size_t sal_pnt_candidate_max_missed_frames_ = 2;  // the candidate, which isn't matched in more frames, is discarded
+    size_t sal_pnt_candidate_depth_hypotheses_ = 100;  // number of hypotheses of the depth of a candidate
+    /// Depth hypotheses are uniformly distributed in inverse depth in [min_depth, max_depth], which is relative to the median distance
+    /// from the camera to the salient points in the state, because the scale of the monocular map is arbitrary.
+    Scalar sal_pnt_candidate_min_depth_ratio_ = 0.2;
+    Scalar sal_pnt_candidate_max_depth_ratio_ = 5;
+    Scalar sal_pnt_candidate_depth_converged_ratio_ = 0.3;  // depth is converged when std(depth)/depth drops below this value
+
+    /// The maximal number of salient points in the state; null for unbounded state.
+    /// The state of N salient points costs O(N^2) per frame, hence the budget bounds the cost of the filter.
+    /// When the budget is exhausted, the salient points with the lowest score are evicted in batches.
+    /// Only the salient points, which score lower than a new salient point, are evicted; hence the state of well tracked
+    /// salient points is not churned in every frame.
+    std::optional<size_t> sal_pnt_max_count_;
+    size_t sal_pnt_evict_batch_size_ = 8;  // the maximal number of salient points, evicted at once
+    Scalar sal_pnt_score_prior_frames_ = 2;  // the score of a salient point, searched for in a few frames, is biased towards the score of a new one
+
+    // weights of the components of the score of a salient point, each component is in [0,1]
+    Scalar sal_pnt_score_match_ratio_weight_ = 1;  // the share of frames, in which the salient point was matched
+    Scalar sal_pnt_score_recency_weight_ = 1;  // decreases with the number of frames since the salient point was seen
+    Scalar sal_pnt_score_innov_consistency_weight_ = 1;  // decreases when innovations are large relative to their uncertainty
+    Scalar sal_pnt_score_distance_weight_ = 1;  // decreases with the distance from the camera, relative to the median distance
+
     // width and height of an image template of a salient point
     // Davison used templates of 15x15 (see "Simultaneous localization and map-building using active vision" para 3.1, Davison, Murray, 2002)
     suriko::Sizei sal_pnt_templ_size_ = { 15, 15 };
@@ -491,8 +702,7 @@ public:
 
     // camera
     CameraIntrinsicParams cam_intrinsics_{};
-    bool cam_enable_distortion_ = true;
-    MikhailRadialDistortionParams cam_distort_params_{};
+    CameraModel cam_model_ = PinholeCameraModel{};  // the distortion of the lens; the lookup table of the model is built by the caller
 public:
     std::function<SE3Transform(size_t frame_ind)> gt_cami_from_world_fun_;  // used to get the first camera cam0 in the world coordinates
     std::function<SE3Transform(size_t frame_ind)> gt_cami_from_tracker_fun_;  // gets ground truth camera position in coordinates of tracker
@@ -507,48 +717,109 @@ public:
     /// 2. Process each corner individually. Require inverting m innovation matrices of size [2x2].
     /// 3. Process [x,y] component of each corner individually. Require inverting 2m scalars.
     /// 4. 1-Point RANSAC
+    /// 5. Information form in state space (Woodbury identity), Pnew=inv(inv(P)+Ht*inv(R)*H). Require inverting two [12+6N,12+6N] matrices.
+    /// 6. Stack corners in blocks of update_block_sal_pnts_ corners, the state is updated after each block. All blocks are
+    ///    linearized at the predicted state, hence the result equals the one of the stacked update.
+    /// 7. Square-root form, process [x,y] component of each corner individually. The Cholesky factor of the covariance
+    ///    is propagated and updated instead of the covariance; only the blocks of the covariance, used to project salient
+    ///    points, are derived from the factor.
+    /// -1. Automatic, chooses the cheapest of the equivalent forms (1 or 6) in each frame by the number of observed corners
+    ///    and estimated variables.
     int mono_slam_update_impl_ = 1;
 
+    /// The number of corners, processed in one block by the blocked update (mono_slam_update_impl_=6).
+    size_t update_block_sal_pnts_ = 8;
+
     /// Threshold to collect low-innovation salient points in 1-point RANSAC algorithm.
     std::optional<Scalar> one_point_ransac_corner_max_divergence_pix_;
     std::optional<Scalar> one_point_ransac_high_innov_chi_square_thresh_pix2_;
 
+    /// The probability for 1-point RANSAC to draw at least one hypothesis without mismatch; determines the number of hypotheses.
+    Scalar one_point_ransac_success_prob_ = 0.99f;
+
     bool fix_estim_vars_covar_symmetry_ = false;
+
+    /// A verification aid: true to compute the Jacobians of the filter by automatic differentiation (see jet.h)
+    /// instead of the hand-derived formulas, which remain the default. Jets are evaluated on the motion model of
+    /// the camera for F=dx'/dx and on the projection for the [2x(6+6)] block of camera and salient point variables.
+    /// Both must yield the same estimates up to rounding; a divergence points to an error in the hand-derived formulas.
+    bool jacobians_by_jets_ = false;
+
+    /// When a frame is processed with a time budget and the tracker runs late, the observations are fused starting
+    /// from the most informative ones; at least this number of observations is fused.
+    size_t deadline_min_fused_obs_count_ = 3;
+
+    /// The size of the search rectangles of salient points when the previous frame missed its deadline.
+    std::optional<suriko::Sizei> deadline_max_search_rect_size_;
+
+    /// Active search: only the salient points with the highest expected information gain per unit of matching cost
+    /// are matched and fused in a frame; null to match all salient points.
+    std::optional<size_t> active_search_max_sal_pnts_;
+
+    /// True to limit the number of matched salient points by the time left, when a frame is processed with a time budget.
+    bool active_search_by_time_budget_ = false;
 private:
     std::shared_ptr<CornersMatcherBase> corners_matcher_;
     std::shared_ptr<DavisonMonoSlamInternalsLogger> stats_logger_;
+    std::mt19937 one_point_ransac_gen_{ 811 };  // draws hypotheses in 1-point RANSAC
+    Scalar process_noise_scale_ = 1;  // the scale of process_noise_covar_, estimated in adaptive mode
 private:
     struct
     {
         EigenDynMat R; // R[2m,2m]
-        EigenDynMat H; // H[2m,13+N*6]
+        EigenDynMat H; // H[2m,12+N*6]
 
         EigenDynVec zk; // [2m,1]
         EigenDynVec projected_sal_pnts; // [2m,1]
-
-        EigenDynMat filter_gain; // P[13+N*6, 2m] m=number of observed points
-        EigenDynMat innov_var; // [13+N*6, 13+N*6]
-        EigenDynMat innov_var_inv; // P[13+N*6, 13+N*6]
-        EigenDynMat H_P; // H*P, [13+N*6, 13+N*6]
-        EigenDynMat Knew; // H*P, [13+N*6, 13+N*6]
-        EigenDynMat estim_vars_covar_new; // P[13+N*6, 13+N*6]
-        EigenDynMat K_S; // K*S, [13+N*6, 2m]
-        EigenDynMat K_H_minus_I; // K*H, [13+N*6, 13+N*6]
+        EigenDynVec innov; // z-h(x), [2m,1]
+        EigenDynVec estim_vars_lin_pnt; // the point of linearization, [12+N*6,1]
+
+        EigenDynMat filter_gain; // P[12+N*6, 2m] m=number of observed points
+        EigenDynMat innov_var; // [12+N*6, 12+N*6]
+        EigenDynMat innov_var_inv; // P[12+N*6, 12+N*6]
+        EigenDynMat H_P; // H*P, [12+N*6, 12+N*6]
+        EigenDynMat Knew; // H*P, [12+N*6, 12+N*6]
+        EigenDynMat estim_vars_covar_new; // P[12+N*6, 12+N*6]
+        EigenDynMat K_S; // K*S, [12+N*6, 2m]
+        EigenDynMat K_H_minus_I; // K*H, [12+N*6, 12+N*6]
+        EigenDynMat P_inv; // inv(P), [12+N*6, 12+N*6]
+        EigenDynMat info_mat; // inv(P)+Ht*inv(R)*H, [12+N*6, 12+N*6]
     } stacked_update_cache_;
     struct
     {
-        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> P_Hxy; // P*Hx or P*Hy, [13+N*6, 2]
-        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> Knew; // K[13+N*6, 2]
-        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> K_S; // K*S, [13+N*6, 2]
+        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> P_Hxy; // P*Hx or P*Hy, [12+N*6, 2]
+        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> Knew; // K[12+N*6, 2]
+        Eigen::Matrix<Scalar, Eigen::Dynamic, kPixPosComps> K_S; // K*S, [12+N*6, 2]
     } one_obs_per_update_cache_;
     struct
     {
-        EigenDynVec Knew; // [13+N*6, 1]
+        EigenDynVec Knew; // [12+N*6, 1]
     } one_comp_of_obs_per_update_cache_;
     struct
     {
-        Eigen::Matrix<Scalar, Eigen::Dynamic, kQuat4> P_down; // [dyn,4]
-    } quat_normalization_cache_;
+        EigenDynVec f; // Lt*Ht, [12+N*6, 1]
+        EigenDynVec Knew; // [12+N*6, 1]
+    } sqrt_update_cache_;
+    struct
+    {
+        using Clock = std::chrono::steady_clock;
+        std::optional<Clock::time_point> deadline;  // null if current frame has no time budget
+        bool prev_frame_missed_deadline = false;
+        bool cap_search_rects = false;
+        std::optional<std::chrono::duration<double>> update_dur_per_obs;  // running average of time to fuse one observation
+        std::optional<std::chrono::duration<double>> predict_dur;  // running average of time to predict the state
+        std::optional<std::chrono::duration<double>> match_dur_per_sal_pnt;  // running average of time to match one salient point
+        std::chrono::duration<double> lag = std::chrono::duration<double>::zero();  // how much the processing is behind the capture of frames
+        std::optional<std::chrono::duration<double>> frame_period;  // the time budget of the latest frame
+    } deadline_;
+    struct
+    {
+        std::optional<size_t> frame_ind;  // the latest processed frame; null if no frame was processed since the camera was reset
+        std::optional<std::chrono::duration<double>> capture_time;  // capture time of the latest processed frame, if known
+        size_t dropped_frames_count = 0;  // number of frames, dropped since the latest processed frame
+        std::optional<Scalar> dT;  // the time interval (in seconds), spanned by the prediction; null for one frame period
+        std::optional<ImuSample> imu;  // inertial measurements over the interval, spanned by the prediction
+    } frame_timing_;
 public:
     DavisonMonoSlam();
     DavisonMonoSlam(const DavisonMonoSlam& src);
@@ -566,6 +837,31 @@ public:
 
     void ProcessFrame(size_t frame_ind, const Picture& image);
 
+    /// Processes the frame, trying to finish in the given time budget. When the tracker runs late, it degrades
+    /// in a controlled way: fuses only the most informative observations, skips the search for new salient points
+    /// and caps search rectangles in the next frame. What was done is reported in DavisonMonoSlamTrackerInternalsSlice.
+    /// The capture time of the frame (in any clock with a fixed origin) makes the prediction span the actual time,
+    /// elapsed since the previous processed frame, hence the capture with jitter and skipped frames are supported.
+    /// Without the capture time, the prediction spans seconds_per_frame_ per each processed and dropped frame.
+    void ProcessFrame(size_t frame_ind, const Picture& image, std::optional<std::chrono::duration<double>> time_budget,
+        std::optional<std::chrono::duration<double>> capture_time = std::nullopt);
+
+    /// Skips the frame without processing. The elapsed time is folded into the prediction for the next processed frame,
+    /// which is done in one step.
+    void DropFrame(size_t frame_ind);
+
+    /// Sets the inertial measurements, averaged over the time interval from the latest processed frame to the next one.
+    /// The next frame is predicted with them: the gyroscope replaces the angular velocity of the motion model,
+    /// the accelerometer drives the linear velocity.
+    void SetImuSample(const ImuSample& imu_sample);
+
+    /// Whether the processing is behind the capture of frames by at least one frame period; then the host may drop the next
+    /// frame to catch up. Frames are considered late only when processed with a time budget, which is the frame period.
+    bool IsFrameDropAdvised() const;
+
+    /// The max size of a search rectangle of a salient point in current frame; null if it is not limited.
+    std::optional<suriko::Sizei> SearchRectMaxSize() const;
+
     suriko::Point2f ProjectCameraPoint(const suriko::Point3& pnt_camera) const;
 
     size_t EstimatedVarsCount() const;
@@ -603,6 +899,25 @@ public:
 
     const std::set<SalPntId>& GetSalientPoints() const;
 
+    /// Switches the tracker into localization-only mode. Salient points of the state are moved into the frozen map:
+    /// their means and marginal covariances become fixed priors without cross-covariance, and the state shrinks to the camera.
+    /// The cost of a frame is then linear in the number of observed salient points.
+    void FreezeMap();
+
+    /// Adds the salient point with the known position (eg from the map, built by MultiViewIterativeFactorizer) to the frozen map
+    /// and switches the tracker into localization-only mode.
+    /// The template of the salient point is cut from the image, in which the salient point is seen at the given corner.
+    SalPntId AddFrozenSalientPoint(const Point3& pos_w, const Eigen::Matrix<Scalar, kEucl3, kEucl3>& pos_uncert,
+        suriko::Point2f corner_pix, Picture templ_img);
+
+    bool IsLocalizationOnly() const;
+
+    size_t FrozenSalientPointsCount() const;
+
+    bool GetFrozenSalientPoint3DPosWithUncertainty(SalPntId sal_pnt_id,
+        Point3* pos_mean,
+        Eigen::Matrix<Scalar, kEucl3, kEucl3>* pos_uncert) const;
+
     TrackedSalientPoint& GetSalientPoint(SalPntId id);
     const TrackedSalientPoint& GetSalientPoint(SalPntId id) const;
     
@@ -622,6 +937,12 @@ public:
     /// This returns null if the salient point is in the infinity and finite coordinates of a template can't be calculated.
     std::optional<SalPntRectFacet> ProtrudeSalientTemplateIntoWorld(SalPntId sal_pnt_id) const;
 
+    /// Predicts the corners of the initial template of the salient point in current frame, in the order of SalPntRectFacet.
+    /// The template is protruded from the camera, which cut it, onto the plane through the predicted salient point, orthogonal
+    /// to the ray from that camera. The corners map the template into current frame by a homography.
+    /// This returns null for the salient point in the infinity or outside of the state.
+    std::optional<std::array<suriko::Point2f, 4>> PredictSalientPointTemplCorners(SalPntId sal_pnt_id) const;
+
     void SetCornersMatcher(std::shared_ptr<CornersMatcherBase> corners_matcher);
     CornersMatcherBase& CornersMatcher();
 
@@ -633,6 +954,14 @@ public:
     void SetEstimStateAndCovarToGroundTruth(size_t frame_ind);
 
     void DumpTrackerState(std::ostringstream& os) const;
+
+    /// Gets the latest published snapshot of tracker's state. Returns null if nothing is published yet.
+    /// Can be called from any thread; the snapshot stays valid while it is held, even if the tracker publishes the next one.
+    std::shared_ptr<const DavisonMonoSlamPublishedState> GetPublishedState() const;
+
+    /// Chooses the cheapest of the equivalent forms of the update, stacked (1) or blocked (6), for m observed salient points
+    /// and n estimated variables; see mono_slam_update_impl_=-1.
+    static int ChooseUpdateImpl(size_t obs_sal_pnt_count, size_t estim_vars_count, size_t update_block_sal_pnts);
 private:
     struct SalPntProjectionIntermidVars
     {
@@ -680,6 +1009,7 @@ private:
     /// The union of all  possible representations of a salient point
     struct MorphableSalientPoint
     {
+        SalPntComps repres = kSalPntRepres;  // the representation, which fields are valid
 #if defined(XYZ_SAL_PNT_REPRES)
         Point3 pos_w; // the salient point's position
 #endif
@@ -701,6 +1031,32 @@ private:
         dst->inverse_dist_rho = s.inverse_dist_rho;
     }
 
+    /// Candidate for a new salient point, which is tracked outside of the state.
+    /// The depth along the ray from the first camera is represented by a set of weighted hypotheses
+    /// ("Real-Time Simultaneous Localisation and Mapping with a Single Camera", Davison, 2003, para 3.3).
+    struct SalPntCandidate
+    {
+        std::unique_ptr<TrackedSalientPoint> sal_pnt;
+        size_t first_frame_ind;
+        SphericalSalientPoint ray;  // the first camera and the direction to the salient point; the inverse distance is unknown
+        std::vector<Scalar> inv_dist_hypotheses;
+        std::vector<Scalar> hypotheses_weights;  // sums up to one
+        size_t missed_frames_count = 0;  // number of frames, in which the candidate wasn't matched
+    };
+
+    std::vector<std::unique_ptr<SalPntCandidate>> sal_pnt_candidates_;
+
+    /// Salient point of the map, which is not estimated in localization-only mode.
+    struct FrozenSalientPoint
+    {
+        std::unique_ptr<TrackedSalientPoint> sal_pnt;
+        Point3 pos_w;
+        Eigen::Matrix<Scalar, kEucl3, kEucl3> pos_uncert;  // the prior, which is not correlated with the camera
+    };
+
+    bool localization_only_ = false;
+    std::vector<FrozenSalientPoint> frozen_sal_pnts_;
+
     /// Spherical salient point can't be transformed into XYZ representation when the point is in infinity.
     static bool ConvertXyzFromSphericalSalientPoint(const SphericalSalientPoint& sal_pnt_vars, Point3* pos_mean);
 
@@ -708,9 +1064,8 @@ private:
         const SE3Transform& first_cam_tfc,
         SphericalSalientPoint* spher_sal_pnt);
 
-    static void ConvertMorphableFromSphericalSalientPoints(const std::vector<SphericalSalientPointWithBuildInfo>& sal_pnt_build_infos,
-        SalPntComps sal_pnt_repres,
-        std::vector<MorphableSalientPoint>* sal_pnts);
+    void ConvertMorphableFromSphericalSalientPoints(const std::vector<SphericalSalientPointWithBuildInfo>& sal_pnt_build_infos,
+        std::vector<MorphableSalientPoint>* sal_pnts) const;
 
     void CheckCameraAndSalientPointsCovs(
         const EigenDynVec& src_estim_vars,
@@ -738,19 +1093,89 @@ private:
         const Eigen::Matrix<Scalar, kProcessNoiseComps, 1>* noise_state = nullptr) const;
     void PredictEstimVars(
         const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
-        EigenDynVec* predicted_estim_vars, EigenDynMat* predicted_estim_vars_covar) const;
+        EigenDynVec* predicted_estim_vars, EigenDynMat* predicted_estim_vars_covar,
+        const EigenDynMat* src_estim_vars_covar_sqrt = nullptr, EigenDynMat* predicted_estim_vars_covar_sqrt = nullptr) const;
+
+    /// Propagates the factor of the covariance, L=[Lcc 0;Lmc Lmm], through the motion model of the camera.
+    /// [F*Lcc G*sqrt(Q)] is triangularized by QR decomposition, the rotated part of Lmc goes into the rank-6 update of Lmm.
+    void PredictEstimVarsCovarSqrt(const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& F,
+        const Eigen::Matrix<Scalar, kCamStateComps, kProcessNoiseComps>& G,
+        const Eigen::Matrix<Scalar, kProcessNoiseComps, kProcessNoiseComps>& process_noise_covar,
+        const EigenDynMat& src_estim_vars_covar_sqrt, EigenDynMat* predicted_estim_vars_covar_sqrt) const;
+
+    /// True if the factors of covariance matrices are maintained (square-root update).
+    bool CovarSqrtForm() const;
+
+    /// Makes the factor consistent with the covariance matrix. The factor is extended when variables are appended
+    /// to the covariance matrix, the empty factor is recomputed.
+    void SyncCovarSqrt(const EigenDynMat& src_estim_vars_covar, EigenDynMat* src_estim_vars_covar_sqrt) const;
+
+    /// Derives the rows of the camera and the blocks of each salient point of the covariance matrix from its factor.
+    /// The cost is O(N^2), the covariances between salient points are not computed.
+    void SyncCovarMarginalsFromSqrt(const EigenDynMat& src_estim_vars_covar_sqrt, EigenDynMat* src_estim_vars_covar) const;
+
+    /// Drops the factors of covariance matrices, when covariance matrices are modified not through their factors.
+    /// The complete covariance matrices are recovered from the factors first.
+    void InvalidateCovarSqrt();
 
     /// Removes salient points' state in estimation matrices. Salient point's descriptors are marked deleted.
     void RemoveSalientPointsState(gsl::span<size_t> sal_pnt_inds_to_delete_desc);
     void RemoveLongTermUnobservedSalientPoints(std::vector<SalPntId>* deleted_sal_pnt_ids);
+
+    /// Updates the history of tracking of salient points, which is used to score them.
+    void UpdateSalientPointsTrackingHistory(size_t frame_ind);
+
+    /// The normalized innovation squared (per degree of freedom) of the matched salient point, predicted from the previous frame.
+    std::optional<Scalar> GetSalientPointPredictedNis(SalPntId sal_pnt_id) const;
+
+    /// Scales the process noise by matching the predicted covariance of innovations to the actual innovations.
+    void AdaptProcessNoiseScale(const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
+
+    /// Scores salient points in the state; salient points with low score are evicted first.
+    void GetSalientPointsScore(size_t frame_ind, std::vector<Scalar>* sal_pnt_scores) const;
+
+    /// The score of a new salient point, which wasn't searched for yet.
+    Scalar GetNewSalientPointScore() const;
+
+    /// Evicts the salient points with the lowest score, when the budget of salient points is exhausted.
+    /// Returns the number of evicted salient points.
+    size_t EvictLowScoreSalientPoints(size_t frame_ind);
+
+    /// The number of salient points, which may be added to the state without exceeding the budget.
+    size_t SalientPointsBudgetRoom() const;
     void RemoveSalientPointsWithNonextractableUncertEllipsoid(EigenDynVec* src_estim_vars,
         EigenDynMat* src_estim_vars_covar);
     void RemoveMarkedDeletedSalientPointsDescriptors();
 
-    void ProcessFrame_StackedObservationsPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
-    void ProcessFrame_StackedObservationsPerUpdateCore(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids, EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar);
+    /// Removes the variables of the marked salient points and of the anchors without salient points from the estimation matrices.
+    void CompactEstimatedVars(const std::vector<bool>& remove_sal_pnt);
+
+    void ProcessFrame_StackedObservationsPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids, int update_impl = 1);
+    void ProcessFrame_StackedObservationsPerUpdateCore(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids, EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar,
+        bool state_space_form = false);
+
+    /// Fuses the observations in blocks of update_block_sal_pnts_ salient points, linearized at the same point.
+    void ProcessFrame_BlockedObservationsPerUpdateCore(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids,
+        EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar);
     void ProcessFrame_OneObservationPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
 
+    /// Localization-only update of the camera, one observation of a frozen salient point at a time.
+    void ProcessFrame_FrozenMapUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
+
+    /// Frozen salient points, which are projected into the image of the predicted camera.
+    void SelectVisibleFrozenSalientPoints(std::set<SalPntId>* sal_pnt_ids) const;
+
+    /// Projects the frozen salient point; the uncertainty of the salient point is added to the uncertainty of the camera.
+    auto GetFrozenSalientPointProjected2DPosWithUncertainty(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+        const FrozenSalientPoint& frozen_sal_pnt) const -> std::tuple<bool, MeanAndCov2D>;
+
+    /// Gets derivatives of the projection of the frozen salient point by the camera and by the salient point.
+    Eigen::Matrix<Scalar, kPixPosComps, 1> Deriv_hd_by_cam_state_and_frozen_sal_pnt(const CameraStateVars& cam_state,
+        const FrozenSalientPoint& frozen_sal_pnt,
+        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
+        Eigen::Matrix<Scalar, kPixPosComps, kEucl3>* hd_by_sal_pnt,
+        SalPntProjectionIntermidVars* proj_hist) const;
+
     void OnePointRansac_GetConsensusMatches(const std::vector<std::pair<SalPntId, suriko::Point2f>>& matched_sal_pnt_to_corner,
         const EigenDynVec& src_estim_vars, const EigenDynMat& Pprev, Scalar corner_max_divergence_pix,
         std::vector<std::pair<SalPntId, suriko::Point2f>>* low_innov_inliers);
@@ -758,22 +1183,102 @@ private:
     void ProcessFrame_OnePointRansacUpdate(size_t frame_ind, const std::vector<std::pair<SalPntId, suriko::Point2f>>& matched_sal_pnt_to_corner);
 
     void ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
+
+    /// Square-root form of the update, one component of observation at a time. The rows of the camera and the blocks of
+    /// salient points of the covariance are derived from the factor, hence they are symmetric and positive semi-definite.
+    void ProcessFrame_SquareRootUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids);
     void ComputeEstimSalientPointSearchRects(const std::vector<SalPntId>& latest_frame_sal_pnt_ids, const EigenDynMat& innov_var);
-    void NormalizeCameraOrientationQuaternionAndCovariances(EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar);
+    void InjectCameraOrientationError();
     void EnsureSalientPointPositiveInvDepth(EigenDynVec* src_estim_vars);
+    Scalar GetSalientPointDepthLinearityIndex(const TrackedSalientPoint& sal_pnt) const;
+    void SwitchSalientPointsToXyzRepresentation();
+    void SwitchSalientPointToXyzRepresentation(const TrackedSalientPoint& sal_pnt, EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar) const;
     void EnsureNonnegativeStateVariance(EigenDynMat* src_estim_vars_covar);
     void OnEstimVarsChanged(size_t frame_ind);
     void FinishFrameStats(size_t frame_ind);
+    void PublishState(size_t frame_ind);
+
+    // The covariance of the uncertainty ellipse of the salient point's projection; the predicted one includes the measurement noise.
+    auto GetSalientPointProjectedUncertEllipseCovar(FilterStageType filter_stage, SalPntId sal_pnt_id) const
+        ->std::tuple<bool, MeanAndCov2D>;
+    /// Sorts salient points from the most informative to the least. If unprojected_sal_pnt_ids is not null, the salient points,
+    /// which can't be projected into current frame, are moved there instead of being ranked last.
+    void SortSalientPointsByExpectedInformation(std::vector<SalPntId>* sal_pnt_ids, bool per_matching_cost = false,
+        std::vector<SalPntId>* unprojected_sal_pnt_ids = nullptr) const;
+    void SelectSalientPointsForActiveSearch(std::set<SalPntId>* sal_pnt_ids_to_match);
+    void LimitFusedObservationsToMeetDeadline(std::vector<SalPntId>* latest_frame_sal_pnt_ids,
+        std::vector<std::pair<SalPntId, suriko::Point2f>>* matched_sal_pnt_to_corner);
+    bool IsDeadlineClose(std::chrono::duration<double> reserve) const;
     size_t RecruitNewSalientPoints(size_t frame_ind, const Picture& image, const std::vector<std::pair<SalPntId, CornersMatcherBlobId>>& matched_sal_pnts);
+
+    /// Calculates the statistics of the template, used for matching templates.
+    /// Returns false for the template with zero variance, for which the correlation coefficient is undefined.
+    bool CalcTemplMatchStats(const Picture& templ_img, TemplMatchStats* templ_stats) const;
+    void AddSalientPointCandidate(size_t frame_ind, const CameraStateVars& cam_state, suriko::Point2f corner_pix,
+        Scalar map_median_dist, std::unique_ptr<TrackedSalientPoint> sal_pnt);
+    void ExtractMatchedSalientPointCandidates(std::vector<std::pair<SalPntId, CornersMatcherBlobId>>* matched_sal_pnts);
+    void UpdateSalientPointCandidates(size_t frame_ind);
+    bool ReweightSalientPointCandidateHypotheses(SalPntCandidate* candidate) const;
+    size_t PromoteSalientPointCandidates(size_t frame_ind);
+    const SalPntCandidate* FindSalientPointCandidate(const TrackedSalientPoint& sal_pnt) const;
+
+    /// Gets the mean and the standard deviation of the distance from the given position to the salient point candidate.
+    /// Each hypothesis stands for the interval of inverse depths up to its neighbours, hence the deviation doesn't vanish
+    /// when the weight concentrates in one hypothesis.
+    std::tuple<Scalar, Scalar> GetSalientPointCandidateDistance(const SalPntCandidate& candidate, const Point3& pos_w) const;
+
+    bool IsSalientPointCandidateDepthConverged(const SalPntCandidate& candidate) const;
+
+    /// True when the most probable hypothesis is the first or the last one, so that the depth may be out of the range of hypotheses.
+    static bool IsSalientPointCandidateDepthOnRangeBound(const SalPntCandidate& candidate);
+
+    /// The median distance from the given position to the salient points in the state; null when there are no salient points
+    /// at a finite distance.
+    std::optional<Scalar> GetSalientPointsMedianDistance(const Point3& pos_w) const;
+
+    /// Projects the depth hypotheses of the candidate into the camera. The uncertainty of the camera is propagated at the mean hypothesis.
+    bool ProjectSalientPointCandidateHypotheses(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+        const SalPntCandidate& candidate,
+        std::vector<std::optional<suriko::Point2f>>* hypotheses_pix,
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>* cam_uncert) const;
+
+    auto GetSalientPointCandidateProjected2DPosWithUncertainty(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+        const SalPntCandidate& candidate) const -> std::tuple<bool, MeanAndCov2D>;
     void PredictStateAndCovariance();
 
+    /// The time interval (in seconds), spanned by the prediction of the motion of the camera.
+    Scalar PredictionInterval() const;
+
+    /// Predicts the state again, when the time, elapsed since the previous processed frame, differs from one frame period,
+    /// assumed by the prediction at the end of the previous frame, or when the inertial measurements are available.
+    void RepredictWithFrameInputs(std::optional<std::chrono::duration<double>> capture_time);
+
+    /// The angular velocity, measured by the gyroscope for the current prediction, if any.
+    std::optional<Point3> ImuAngularVelocity() const;
+
+    /// True if the accelerometer and the gravity are known for the current prediction.
+    bool ImuAccelerationAvailable() const;
+
+    /// The acceleration of the camera in the tracker's frame, computed from the accelerometer for the current prediction, if any.
+    std::optional<Point3> ImuAcceleration(const Point3& cam_orient_err) const;
+
     // Updates the centers of detected template.
     void ProcessFrameOnExit_UpdateSalientPoint(size_t frame_ind);
 
     void SetNonObservedSalientPointCorner(const EigenDynVec& src_estim_vars);
 
-    void AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_var_ind,
+    void AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_var_ind, SalPntComps sal_pnt_repres,
         const CameraStateVars& cam_state, suriko::Point2f corner_pix, std::optional<Scalar> pnt_inv_dist_gt);
+
+    /// Initializes the variables of a new salient point, for which the space in the state is already allocated.
+    /// The salient point is correlated with all variables, preceding it.
+    /// The inverse distance init_inv_dist (with init_inv_dist_std), if any, is the one estimated outside of the state.
+    void InitStateForNewSalientPoint(size_t new_sal_pnt_var_ind, SalPntComps sal_pnt_repres,
+        const CameraStateVars& cam_state, suriko::Point2f corner_pix, std::optional<Scalar> pnt_inv_dist_gt,
+        std::optional<Scalar> init_inv_dist = std::nullopt, std::optional<Scalar> init_inv_dist_std = std::nullopt);
+
+    /// Appends the current camera position to the state, as an anchor for salient points, initialized in the given frame.
+    SalPntAnchor* AddSalientPointAnchor(size_t frame_ind);
     
     SphericalSalientPoint GetNewSphericalSalientPointState(
         const CameraStateVars& first_cam_state,
@@ -787,7 +1292,8 @@ private:
         const SphericalSalientPointIntermProjVars& proj_side_effect_vars,
         size_t take_estim_vars_count,
         Eigen::Matrix<Scalar, kSphericalSalientPointComps, kSphericalSalientPointComps>* spher_sal_pnt_autocovar,
-        Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic>* spher_sal_pnt_to_other_covar) const;
+        Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic>* spher_sal_pnt_to_other_covar,
+        std::optional<Scalar> inv_dist_std = std::nullopt) const;
 
     void GetDefaultXyzSalientPointCovarOrConvertFromSpherical(
         const SphericalSalientPoint& spher_sal_pnt_vars,
@@ -799,10 +1305,17 @@ private:
 
     SalPntId AddSalientPoint(size_t frame_ind, const CameraStateVars& cam_state, suriko::Point2f corner, 
         Picture templ_img, TemplMatchStats templ_stats,
-        std::optional<Scalar> pnt_inv_dist_gt);
+        std::optional<Scalar> pnt_inv_dist_gt, SalPntAnchor* anchor = nullptr);
+
+    /// Creates the descriptor of a salient point, which is seen for the first time in the given frame.
+    std::unique_ptr<TrackedSalientPoint> NewSalientPointDescriptor(size_t frame_ind, suriko::Point2f corner_pix,
+        Picture templ_img, TemplMatchStats templ_stats) const;
+
+    /// Puts the descriptor of a salient point, which state is already initialized, into the list of tracked salient points.
+    SalPntId InsertSalientPointDescriptor(std::unique_ptr<TrackedSalientPoint> sal_pnt, size_t sal_pnt_var_ind,
+        SalPntComps sal_pnt_repres, SalPntAnchor* anchor);
 
     gsl::span<Scalar> EstimVarsCamPosW();
-    Eigen::Matrix<Scalar, kQuat4, 1> EstimVarsCamQuat() const;
     Eigen::Matrix<Scalar, kAngVelocComps, 1> EstimVarsCamAngularVelocity() const;
     size_t SalientPointOffset(size_t sal_pnt_ind) const;
     //inline SalPntInternal& GetSalPnt(SalPntId id);
@@ -810,10 +1323,24 @@ private:
 
     void LoadCameraStateVarsFromArray(gsl::span<const Scalar> src, CameraStateVars* result) const;
 
+    /// Gets the orientation error of the camera, relative to the nominal orientation.
+    Point3 CameraOrientationError(const Eigen::Matrix<Scalar, kQuat4, 1>& cam_orient_wfc) const;
+    Scalar CameraOrientationErrorVariance() const;
+
     void LoadSalientPointDataFromArray(gsl::span<const Scalar> src, MorphableSalientPoint* result) const;
-    MorphableSalientPoint LoadSalientPointDataFromSrcEstimVars(const EigenDynVec& src_estim_vars, size_t estim_vars_ind) const;
     MorphableSalientPoint LoadSalientPointDataFromSrcEstimVars(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const;
 
+    /// Gets the variables of a salient point, prepended with the variables of its anchor (if any).
+    SalPntVec GetSalientPointVars(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const;
+    void SetSalientPointVars(gsl::span<const Scalar> sal_pnt_vars, const TrackedSalientPoint& sal_pnt, EigenDynVec* src_estim_vars) const;
+
+    /// Gets the covariance between the given range of variables and the variables of a salient point (with its anchor).
+    void GetSalientPointCovarCols(const EigenDynMat& src_estim_vars_covar, size_t first_var_ind, size_t vars_count,
+        const TrackedSalientPoint& sal_pnt, SalPntCovarCols* covar_cols) const;
+
+    /// Gets the covariance between the variables of two salient points (with their anchors).
+    SalPntMat GetSalientPointsCovar(const EigenDynMat& src_estim_vars_covar, const TrackedSalientPoint& row_sal_pnt, const TrackedSalientPoint& col_sal_pnt) const;
+
     void SaveSalientPointDataToArray(const MorphableSalientPoint& sal_pnt_vars, gsl::span<Scalar> dst) const;
     void SaveSalientPointDataToArray(const SphericalSalientPoint& sal_pnt_vars, gsl::span<Scalar> dst) const;
     void SaveCameraStateToArray(const CameraStateVars& cam_state, gsl::span<Scalar> dst) const;
@@ -863,10 +1390,22 @@ private:
 
     Point3 BackprojectPixelIntoCameraPlane(const Eigen::Matrix<Scalar, kPixPosComps, 1>& hu) const;
 
+    // hu->hd and hd->hu by the camera model.
+    suriko::Point2f DistortPixel(const suriko::Point2f& hu) const;
+    suriko::Point2f UndistortPixel(const suriko::Point2f& hd) const;
+
     //
 
     void Deriv_cam_state_by_cam_state(Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const;
 
+    /// The motion model of PredictCameraMotionByKinematicModel without the process noise, written generically on
+    /// the scalar type to be evaluated on jets.
+    template <typename T>
+    Eigen::Matrix<T, kCamStateComps, 1> PredictCameraState(const Eigen::Matrix<T, kCamStateComps, 1>& cam_state) const;
+
+    // Derivative of the predicted camera state by the camera state, obtained by jets.
+    void Deriv_cam_state_by_cam_state_ByJets(Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const;
+
     void FiniteDiff_cam_state_by_cam_state(gsl::span<const Scalar> cam_state, Scalar finite_diff_eps,
         Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const;
 
@@ -881,7 +1420,7 @@ private:
         const TrackedSalientPoint& sal_pnt,
         const MorphableSalientPoint& sal_pnt_vars,
         Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_sal_pnt,
+        HdBySalPntMat* hd_by_sal_pnt,
         Eigen::Matrix<Scalar, kPixPosComps, 1>* hd = nullptr) const;
 
     void Deriv_H_by_estim_vars(const CameraStateVars& cam_state,
@@ -899,13 +1438,7 @@ private:
 
     void Deriv_hc_by_hu(Eigen::Matrix<Scalar, kEucl3, kPixPosComps>* hc_by_hu) const;
 
-    void Deriv_R_by_q(const Eigen::Matrix<Scalar, kQuat4, 1>& q,
-        Eigen::Matrix<Scalar, 3, 3>* dR_by_dq0,
-        Eigen::Matrix<Scalar, 3, 3>* dR_by_dq1,
-        Eigen::Matrix<Scalar, 3, 3>* dR_by_dq2,
-        Eigen::Matrix<Scalar, 3, 3>* dR_by_dq3) const;
-
-    // Derivative of distorted observed corner (in pixels) by camera's state variables (13 vars).
+    // Derivative of distorted observed corner (in pixels) by camera's state variables (12 vars).
     void Deriv_hd_by_camera_state(const MorphableSalientPoint& sal_pnt,
         const CameraStateVars& cam_state,
         const Eigen::Matrix<Scalar, kEucl3, kEucl3>& cam_orient_wfc,
@@ -920,7 +1453,31 @@ private:
         const Eigen::Matrix<Scalar, kEucl3, kEucl3>& cam_orient_wfc,
         const Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>& hd_by_dhu,
         const Eigen::Matrix<Scalar, kPixPosComps, kEucl3>& hu_by_dhc,
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_sal_pnt) const;
+        HdBySalPntMat* hd_by_sal_pnt) const;
+
+    /// The quaternion of the rotation by the axis-angle vector and the inverse conversion, written generically on the
+    /// scalar type to be evaluated on jets. The Taylor series is used for small angles, where the derivatives of
+    /// sqrt(ang^2) are undefined.
+    template <typename T>
+    static Eigen::Matrix<T, kQuat4, 1> QuatFromAxisAngleGeneric(const Eigen::Matrix<T, kEucl3, 1>& axis_ang);
+    template <typename T>
+    static Eigen::Matrix<T, kEucl3, 1> AxisAngleFromQuatGeneric(const Eigen::Matrix<T, kQuat4, 1>& q);
+
+    /// The projection of the salient point onto the undistorted image, written generically on the scalar type to be
+    /// evaluated on jets. The camera is represented by its position and the orientation error (cam_orient_err=dtheta).
+    /// The salient point is packed as in the state; the xyz salient point occupies the first components.
+    template <typename T>
+    Eigen::Matrix<T, kPixPosComps, 1> ProjectSalientPointUndistorted(const Eigen::Matrix<T, kEucl3, 1>& cam_pos_w,
+        const Eigen::Matrix<T, kOrientErrComps, 1>& cam_orient_err,
+        SalPntComps sal_pnt_repres,
+        const Eigen::Matrix<T, kSalientPointComps, 1>& sal_pnt) const;
+
+    // Derivative of distorted observed corner (in pixels) by camera's and salient point's variables, obtained by jets.
+    void Deriv_hd_by_cam_state_and_sal_pnt_ByJets(const CameraStateVars& cam_state,
+        const MorphableSalientPoint& sal_pnt_vars,
+        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
+        HdBySalPntMat* hd_by_sal_pnt,
+        Eigen::Matrix<Scalar, kPixPosComps, 1>* hd) const;
 
     void Deriv_azim_theta_elev_phi_by_hw(
         const Point3& hw,
@@ -936,12 +1493,12 @@ private:
         const TrackedSalientPoint& sal_pnt,
         const EigenDynVec& derive_at_pnt,
         Scalar finite_diff_eps,
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_y) const;
-
+        HdBySalPntMat* hd_by_y) const;
 
-    // derivative of qk+1 (next step camera orientation) by wk (camera orientation)
-    void Deriv_q3_by_w(Scalar deltaT, Eigen::Matrix<Scalar, kQuat4, kEucl3>* result) const;
-    void Deriv_q1_by_w(Scalar deltaT, Eigen::Matrix<Scalar, kQuat4, kEucl3>* result) const;
+    // derivative of dthetak+1 (next step camera orientation error) by dthetak and wk (camera angular velocity)
+    void Deriv_orient_err_by_orient_err_and_w(Scalar deltaT,
+        Eigen::Matrix<Scalar, kOrientErrComps, kOrientErrComps>* err_by_err,
+        Eigen::Matrix<Scalar, kOrientErrComps, kAngVelocComps>* err_by_w) const;
     
     static Point3 CameraCoordinatesEuclidUnityDirFromPolarAngles(Scalar azimuth_theta, Scalar elevation_phi);
     
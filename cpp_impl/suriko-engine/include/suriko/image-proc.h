@@ -1,4 +1,7 @@
 #pragma once
+#include <vector>
+#include "suriko/rt-config.h" // SRK_DEBUG
+#include "suriko/obs-geom.h" // Recti
 
 #if defined(SRK_HAS_OPENCV)
 #include <opencv2/core/core.hpp> // cv::Mat
@@ -9,10 +12,37 @@ namespace suriko {
 struct Picture
 {
     cv::Mat gray;
+    std::vector<cv::Mat> gray_pyramid;  // coarser levels of the gray image, each is half the size of the previous one; may be empty
 #if defined(SRK_DEBUG)
     cv::Mat bgr_debug;
 #endif
 };
 
 void CopyBgr(const Picture& image, cv::Mat* out_image_bgr);
+
+/// Builds the pyramid of the gray image once per frame, so that all consumers of the picture share it.
+/// @param levels_count the number of coarser levels (0=no pyramid)
+void BuildGrayPyramid(int levels_count, Picture* image);
+
+/// Gets the gray image at given level of the pyramid (0=original image).
+const cv::Mat& GrayPyramidLevel(const Picture& image, int level);
+
+/// The number of levels in the pyramid, including the original image.
+inline int GrayPyramidLevelsCount(const Picture& image) { return 1 + static_cast<int>(image.gray_pyramid.size()); }
+
+/// Marks the square blocks of the image, which changed since the previous frame.
+struct BlockChangeMap
+{
+    int block_size = 0;
+    int cols = 0;  // number of blocks
+    int rows = 0;
+    std::vector<char> changed;  // per block, row-major
+
+    /// Checks whether any block, overlapped by the rectangle, changed. The blocks outside of the image and the blocks
+    /// of the empty map are treated as changed.
+    bool AnyChanged(const Recti& rect) const;
+};
+
+/// Finds the blocks in which the mean absolute difference of the gray images is greater than the threshold.
+void CalcBlockChangeMap(const cv::Mat& prev_gray, const cv::Mat& gray, int block_size, float max_mean_abs_diff, BlockChangeMap* change_map);
 }
@@ -0,0 +1,192 @@
+#pragma once
+#include <cmath>
+#include <Eigen/Dense>
+#include "suriko/rt-config.h"
+
+namespace suriko
+{
+// Forward-mode automatic differentiation by dual numbers (jets).
+// The jet a+v*eps (eps^2=0) carries the value of the function and its derivatives by N independent variables.
+// The function, written generically on the scalar type, evaluated on jets, yields the exact (up to rounding) Jacobian
+// in one pass. The derivatives are held in fixed-size vector, hence no heap allocation.
+//
+// The generic code should call math functions unqualified (eg. `using std::sqrt; sqrt(x)`), so that the overloads
+// for jets are found by argument-dependent lookup.
+
+template <typename F, int N>
+struct Jet
+{
+    using DerivVec = Eigen::Matrix<F, N, 1>;
+
+    F a;  // the value
+    DerivVec v;  // the derivatives by independent variables
+
+    Jet() : a(0), v(DerivVec::Zero()) {}
+
+    /// The constant, all derivatives are zero.
+    explicit Jet(F value) : a(value), v(DerivVec::Zero()) {}
+
+    /// The independent variable with given index.
+    Jet(F value, int var_ind) : a(value), v(DerivVec::Unit(var_ind)) {}
+
+    Jet(F value, const DerivVec& deriv) : a(value), v(deriv) {}
+
+    Jet& operator+=(const Jet& b) { a += b.a; v += b.v; return *this; }
+    Jet& operator-=(const Jet& b) { a -= b.a; v -= b.v; return *this; }
+    Jet& operator*=(const Jet& b) { v = v * b.a + b.v * a; a *= b.a; return *this; }
+    Jet& operator/=(const Jet& b) { F inv_b = 1 / b.a; a *= inv_b; v = (v - a * b.v) * inv_b; return *this; }
+
+    Jet& operator+=(F b) { a += b; return *this; }
+    Jet& operator-=(F b) { a -= b; return *this; }
+    Jet& operator*=(F b) { a *= b; v *= b; return *this; }
+    Jet& operator/=(F b) { F inv_b = 1 / b; a *= inv_b; v *= inv_b; return *this; }
+};
+
+template <typename F, int N> Jet<F, N> operator+(const Jet<F, N>& x) { return x; }
+template <typename F, int N> Jet<F, N> operator-(const Jet<F, N>& x) { return Jet<F, N>(-x.a, -x.v); }
+
+template <typename F, int N> Jet<F, N> operator+(Jet<F, N> x, const Jet<F, N>& y) { return x += y; }
+template <typename F, int N> Jet<F, N> operator-(Jet<F, N> x, const Jet<F, N>& y) { return x -= y; }
+template <typename F, int N> Jet<F, N> operator*(Jet<F, N> x, const Jet<F, N>& y) { return x *= y; }
+template <typename F, int N> Jet<F, N> operator/(Jet<F, N> x, const Jet<F, N>& y) { return x /= y; }
+
+template <typename F, int N> Jet<F, N> operator+(Jet<F, N> x, NonDeduced<F> s) { return x += s; }
+template <typename F, int N> Jet<F, N> operator-(Jet<F, N> x, NonDeduced<F> s) { return x -= s; }
+template <typename F, int N> Jet<F, N> operator*(Jet<F, N> x, NonDeduced<F> s) { return x *= s; }
+template <typename F, int N> Jet<F, N> operator/(Jet<F, N> x, NonDeduced<F> s) { return x /= s; }
+
+template <typename F, int N> Jet<F, N> operator+(NonDeduced<F> s, Jet<F, N> x) { return x += s; }
+template <typename F, int N> Jet<F, N> operator-(NonDeduced<F> s, const Jet<F, N>& x) { return Jet<F, N>(s - x.a, -x.v); }
+template <typename F, int N> Jet<F, N> operator*(NonDeduced<F> s, Jet<F, N> x) { return x *= s; }
+template <typename F, int N> Jet<F, N> operator/(NonDeduced<F> s, const Jet<F, N>& x)
+{
+    F inv_x = 1 / x.a;
+    return Jet<F, N>(s * inv_x, x.v * (-s * inv_x * inv_x));
+}
+
+// comparisons consider only the values (the branches of the function are assumed to be chosen by values)
+template <typename F, int N> bool operator<(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a < y.a; }
+template <typename F, int N> bool operator>(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a > y.a; }
+template <typename F, int N> bool operator<=(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a <= y.a; }
+template <typename F, int N> bool operator>=(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a >= y.a; }
+template <typename F, int N> bool operator==(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a == y.a; }
+template <typename F, int N> bool operator!=(const Jet<F, N>& x, const Jet<F, N>& y) { return x.a != y.a; }
+template <typename F, int N> bool operator<(const Jet<F, N>& x, NonDeduced<F> s) { return x.a < s; }
+template <typename F, int N> bool operator>(const Jet<F, N>& x, NonDeduced<F> s) { return x.a > s; }
+template <typename F, int N> bool operator<(NonDeduced<F> s, const Jet<F, N>& x) { return s < x.a; }
+template <typename F, int N> bool operator>(NonDeduced<F> s, const Jet<F, N>& x) { return s > x.a; }
+
+// f(a+v*eps)=f(a)+f'(a)*v*eps
+
+template <typename F, int N> Jet<F, N> sqrt(const Jet<F, N>& x)
+{
+    F s = std::sqrt(x.a);
+    return Jet<F, N>(s, x.v * (1 / (2 * s)));
+}
+
+template <typename F, int N> Jet<F, N> sin(const Jet<F, N>& x) { return Jet<F, N>(std::sin(x.a), x.v * std::cos(x.a)); }
+template <typename F, int N> Jet<F, N> cos(const Jet<F, N>& x) { return Jet<F, N>(std::cos(x.a), x.v * -std::sin(x.a)); }
+
+template <typename F, int N> Jet<F, N> tan(const Jet<F, N>& x)
+{
+    F t = std::tan(x.a);
+    return Jet<F, N>(t, x.v * (1 + t * t));
+}
+
+template <typename F, int N> Jet<F, N> atan(const Jet<F, N>& x) { return Jet<F, N>(std::atan(x.a), x.v * (1 / (1 + x.a * x.a))); }
+
+template <typename F, int N> Jet<F, N> atan2(const Jet<F, N>& y, const Jet<F, N>& x)
+{
+    // d(atan2(y,x))=(x*dy-y*dx)/(x^2+y^2)
+    F inv_r2 = 1 / (x.a * x.a + y.a * y.a);
+    return Jet<F, N>(std::atan2(y.a, x.a), (y.v * x.a - x.v * y.a) * inv_r2);
+}
+
+template <typename F, int N> Jet<F, N> exp(const Jet<F, N>& x)
+{
+    F e = std::exp(x.a);
+    return Jet<F, N>(e, x.v * e);
+}
+
+template <typename F, int N> Jet<F, N> log(const Jet<F, N>& x) { return Jet<F, N>(std::log(x.a), x.v * (1 / x.a)); }
+
+template <typename F, int N> Jet<F, N> abs(const Jet<F, N>& x) { return x.a < 0 ? -x : x; }
+
+template <typename F, int N> bool isfinite(const Jet<F, N>& x) { return std::isfinite(x.a) && x.v.allFinite(); }
+
+/// The value of the scalar, which is either the plain number or the jet.
+template <typename F> F JetValue(F x) { return x; }
+template <typename F, int N> F JetValue(const Jet<F, N>& x) { return x.a; }
+
+/// Makes the independent variables var_offset+[0..M) of the jets from the given values.
+template <int N, typename F, int M>
+Eigen::Matrix<Jet<F, N>, M, 1> JetVariables(const Eigen::Matrix<F, M, 1>& x, int var_offset = 0)
+{
+    static_assert(M <= N);
+    Eigen::Matrix<Jet<F, N>, M, 1> result;
+    for (int i = 0; i < M; ++i)
+        result[i] = Jet<F, N>(x[i], var_offset + i);
+    return result;
+}
+
+/// Splits the jets into the values and the Jacobian [M,N].
+template <typename F, int N, int M>
+void JetToJacobian(const Eigen::Matrix<Jet<F, N>, M, 1>& y, Eigen::Matrix<F, M, 1>* value, Eigen::Matrix<F, M, N>* jacobian)
+{
+    for (int i = 0; i < M; ++i)
+    {
+        if (value != nullptr) (*value)[i] = y[i].a;
+        if (jacobian != nullptr) jacobian->row(i) = y[i].v.transpose();
+    }
+}
+
+/// Computes the function y=fun(x) and its Jacobian [M,N] by one evaluation of the function on jets.
+/// @param fun (const Eigen::Matrix<Jet<F,N>,N,1>& x) -> Eigen::Matrix<Jet<F,N>,M,1>
+template <int M, typename F, int N, typename Fun>
+void JetJacobian(Fun fun, const Eigen::Matrix<F, N, 1>& x, Eigen::Matrix<F, M, 1>* value, Eigen::Matrix<F, M, N>* jacobian)
+{
+    Eigen::Matrix<Jet<F, N>, M, 1> y = fun(JetVariables<N>(x));
+    JetToJacobian(y, value, jacobian);
+}
+}
+
+namespace Eigen
+{
+// Allows Eigen matrices of jets.
+template <typename F, int N>
+struct NumTraits<suriko::Jet<F, N>> : NumTraits<F>
+{
+    using Real = suriko::Jet<F, N>;
+    using NonInteger = suriko::Jet<F, N>;
+    using Nested = suriko::Jet<F, N>;
+    using Literal = suriko::Jet<F, N>;
+
+    enum
+    {
+        IsComplex = 0,
+        IsInteger = 0,
+        IsSigned = 1,
+        RequireInitialization = 1,
+        ReadCost = (N + 1) * NumTraits<F>::ReadCost,
+        AddCost = (N + 1) * NumTraits<F>::AddCost,
+        MulCost = (2 * N + 1) * NumTraits<F>::MulCost
+    };
+
+    static inline Real epsilon() { return Real(NumTraits<F>::epsilon()); }
+    static inline Real dummy_precision() { return Real(NumTraits<F>::dummy_precision()); }
+    static inline Real highest() { return Real(NumTraits<F>::highest()); }
+    static inline Real lowest() { return Real(NumTraits<F>::lowest()); }
+};
+
+template <typename F, int N, typename BinaryOp>
+struct ScalarBinaryOpTraits<suriko::Jet<F, N>, F, BinaryOp>
+{
+    using ReturnType = suriko::Jet<F, N>;
+};
+
+template <typename F, int N, typename BinaryOp>
+struct ScalarBinaryOpTraits<F, suriko::Jet<F, N>, BinaryOp>
+{
+    using ReturnType = suriko::Jet<F, N>;
+};
+}
@@ -1,8 +1,150 @@
 #pragma once
+#include <cmath>
+#include <vector>
 #include <Eigen/Dense>
 #include "suriko/rt-config.h"
 
 namespace suriko
 {
 void OrthonormalizeGramSchmidtInplace(Eigen::Matrix<Scalar, 3, 3>* mat);
-}
\ No newline at end of file
+
+// Kernels of the square-root form of the Kalman filter. The covariance P=L*Lt is represented by its lower-triangular
+// factor L, which is updated by orthogonal transformations and rank-one updates. P, recovered from L, is symmetric and
+// positive semi-definite by construction, and L needs half of the dynamic range of P.
+
+/// Computes the lower-triangular factor L of the positive semi-definite matrix, mat=L*Lt.
+/// The column with non-positive pivot (the matrix is singular) is set to zero.
+void CholeskyFactorPsd(const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& mat,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor);
+
+/// Transforms the lower-triangular factor L of P=L*Lt into the factor of P+x*xt.
+/// The columns of L are mixed with x by Givens rotations. The vector x is used as a scratch space.
+void CholeskyFactorRankOneUpdate(Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> lower_factor,
+    Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> x);
+
+/// Incorporates the scalar measurement z=h*x+v, v~N(0,r), into the lower-triangular factor L of the covariance P=L*Lt,
+/// without forming P (Carlson's algorithm). f=Lt*ht is the measurement projected into the factor.
+/// Computes the filter gain K=P*ht/s and returns the innovation variance s=h*P*ht+r.
+/// The cost is O(n*j), where j is the index of the last non-zero component of f.
+Scalar CholeskyFactorScalarMeasurementUpdate(Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> lower_factor,
+    const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, 1>>& f, Scalar r,
+    Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> gain);
+
+/// Extends the lower-triangular factor of the leading block of the matrix to the factor of the whole matrix.
+/// Used when variables are appended to the covariance matrix, the leading block must be unchanged.
+void CholeskyFactorExtend(const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& mat,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor);
+
+/// Transforms the lower-triangular factor L of P=L*Lt into the factor of the submatrix of P, which consists of rows and
+/// columns with given indices (sorted in ascending order). The columns of removed variables are folded into the remaining
+/// ones by rank-one updates.
+void CholeskyFactorKeepVars(const std::vector<size_t>& keep_var_inds,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor);
+
+/// Computes the block of P=L*Lt with given rows and columns from the lower-triangular factor L, without forming P.
+/// The cost is O(rows*cols*k), where k=min(first_row+rows, first_col+cols) is the number of columns of L, which
+/// may be non-zero in both the rows and the columns.
+Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> CovarBlockFromCholeskyFactor(
+    const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& lower_factor,
+    Eigen::Index first_row, Eigen::Index rows, Eigen::Index first_col, Eigen::Index cols);
+
+// Closed-form kernels for small symmetric matrices, such as the covariances of the salient points' positions, which
+// are decomposed per salient point per frame. They replace the iterative Eigen::SelfAdjointEigenSolver.
+
+/// Checks if the symmetric matrix is positive semi-definite by its Cholesky decomposition, which is cheaper than the
+/// eigen decomposition. The pivots in [-atol,atol] are treated as zeros; the rest of the column of the zero pivot must
+/// be zero too, otherwise the matrix is indefinite.
+template <int N>
+bool IsPositiveSemidefinite(const Eigen::Matrix<Scalar, N, N>& mat, Scalar atol = static_cast<Scalar>(1e-8))
+{
+    Eigen::Matrix<Scalar, N, N> L = mat;  // the lower triangle is overwritten with the factor
+    for (int k = 0; k < N; ++k)
+    {
+        Scalar pivot = L(k, k) - L.row(k).head(k).squaredNorm();
+        if (!(pivot >= -atol))  // negative or NaN
+            return false;
+
+        if (pivot <= atol)
+        {
+            for (int i = k + 1; i < N; ++i)
+            {
+                // for the PSD matrix |m(i,k)|^2 <= m(i,i)*m(k,k)
+                Scalar off = L(i, k) - L.row(i).head(k).dot(L.row(k).head(k));
+                if (std::abs(off) > std::sqrt(atol * (std::abs(mat(i, i)) + atol)))
+                    return false;
+                L(i, k) = 0;
+            }
+            L(k, k) = 0;
+            continue;
+        }
+
+        Scalar diag = std::sqrt(pivot);
+        L(k, k) = diag;
+        for (int i = k + 1; i < N; ++i)
+            L(i, k) = (L(i, k) - L.row(i).head(k).dot(L.row(k).head(k))) / diag;
+    }
+    return true;
+}
+
+/// Closed-form eigen decomposition of the symmetric matrix [xx xy; xy yy].
+/// Finds eigenvalues (eig_val_max>=eig_val_min) and the unity eigenvector [cos_major,sin_major] of the largest eigenvalue.
+/// The eigenvector of the smallest eigenvalue is [-sin_major,cos_major].
+inline void SymmetricEigenDecomp2x2(Scalar xx, Scalar xy, Scalar yy,
+    Scalar* eig_val_max, Scalar* eig_val_min, Scalar* cos_major, Scalar* sin_major)
+{
+    // eigenvalues are mean+-d, where d is the radius of Mohr's circle
+    Scalar mean = (xx + yy) / 2;
+    Scalar half_diff = (xx - yy) / 2;
+    Scalar d = std::sqrt(half_diff * half_diff + xy * xy);
+    *eig_val_max = mean + d;
+    *eig_val_min = mean - d;
+
+    // (A-eig_val_max*I)*v=0 has two solutions v=[d+half_diff,xy] and v=[xy,d-half_diff],
+    // the one without cancellation is taken
+    bool use_row0 = half_diff >= 0;
+    Scalar vx = use_row0 ? d + half_diff : xy;
+    Scalar vy = use_row0 ? xy : d - half_diff;
+    Scalar v_norm = std::sqrt(vx * vx + vy * vy);
+
+    // all directions are eigenvectors of the scaled identity matrix
+    bool is_round = v_norm == 0;
+    *cos_major = is_round ? 1 : vx / v_norm;
+    *sin_major = is_round ? 0 : vy / v_norm;
+}
+
+/// The structure of arrays of symmetric 2x2 matrices [xx xy; xy yy].
+struct SymMat2x2Batch
+{
+    std::vector<Scalar> xx;
+    std::vector<Scalar> xy;
+    std::vector<Scalar> yy;
+
+    size_t Size() const { return xx.size(); }
+
+    void Clear()
+    {
+        xx.clear();
+        xy.clear();
+        yy.clear();
+    }
+
+    void PushBack(const Eigen::Matrix<Scalar, 2, 2>& mat)
+    {
+        xx.push_back(mat(0, 0));
+        xy.push_back(mat(0, 1));
+        yy.push_back(mat(1, 1));
+    }
+};
+
+/// The results of SymmetricEigenDecomp2x2 for the batch of matrices.
+struct SymEigen2x2Batch
+{
+    std::vector<Scalar> eig_val_max;
+    std::vector<Scalar> eig_val_min;
+    std::vector<Scalar> cos_major;
+    std::vector<Scalar> sin_major;
+};
+
+/// Decomposes all matrices of the batch. The loop has no branches, so that the compiler vectorizes it.
+void SymmetricEigenDecomp2x2Batch(const SymMat2x2Batch& mats, SymEigen2x2Batch* eigs);
+}
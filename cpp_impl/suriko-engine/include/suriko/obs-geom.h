@@ -153,6 +153,7 @@ Recti DeflateRect(const Recti& a, int left, int top, int right, int bottom);
 Recti TruncateRect(const Rect& a);
 Recti EncompassRect(const Rect& a);
 Recti ClampRectWhenFixedCenter(const Recti& r, suriko::Sizei min_size);
+Recti ShrinkRectWhenFixedCenter(const Recti& r, suriko::Sizei max_size);
 
 //auto ToPoint(const Eigen::Matrix<Scalar,3,1>& m) -> suriko::Point3;
 
@@ -195,6 +196,13 @@ auto SE3Apply(const SE3Transform& rt, const suriko::Point3& x) -> suriko::Point3
 auto SE3Compose(const SE3Transform& rt1, const SE3Transform& rt2) -> suriko::SE3Transform;
 auto SE3AFromB(const SE3Transform& a_from_world, const SE3Transform& b_from_world) -> suriko::SE3Transform;
 
+/// Inertial measurements of the moving camera, averaged over the time interval between two frames.
+struct ImuSample
+{
+    std::optional<Point3> angular_velocity_c;  // gyroscope, in radians per second, in the camera frame
+    std::optional<Point3> specific_force_c;  // accelerometer (the acceleration minus gravity), in map units per second^2, in the camera frame
+};
+
 /// The 3D point inside the map.
 struct SalientPointFragment
 {
@@ -314,6 +322,12 @@ auto RotMatFromUnityDirAndAngle(const Point3& unity_dir, Scalar ang, gsl::not_nu
 [[nodiscard]]
 auto RotMatFromAxisAngle(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<Scalar, 3, 3>*> rot_mat) -> bool;
 
+/// Right Jacobian of SO(3): Exp(v+dv) = Exp(v)*Exp(Jr(v)*dv) for small dv.
+void RightJacobianSO3(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<Scalar, 3, 3>*> jr);
+
+/// Inverse of the right Jacobian of SO(3): Log(Exp(v)*Exp(dv)) = v + inv(Jr(v))*dv for small dv.
+void RightJacobianInvSO3(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<Scalar, 3, 3>*> jr_inv);
+
 /// Checks if Rt*R=I.
 [[nodiscard]]
 bool IsOrthogonal(const Eigen::Matrix<Scalar,3,3>& R, std::string* msg = nullptr);
@@ -401,6 +415,13 @@ struct RotatedEllipse2D
 
 Rect GetEllipseBounds2(const RotatedEllipse2D& rotated_ellipse);
 
+/// Checks whether the point lies inside the ellipse or on its border.
+bool IsPointInsideEllipse(const RotatedEllipse2D& rotated_ellipse, const Eigen::Matrix<Scalar, 2, 1>& pnt);
+
+/// Finds the homography H, which maps each of 4 source points into the corresponding destination point, dst~H*src.
+/// This returns null if three of the points are collinear.
+std::optional<Eigen::Matrix<Scalar, 3, 3>> HomographyFrom4Points(const std::array<suriko::Point2f, 4>& src, const std::array<suriko::Point2f, 4>& dst);
+
 /// Represents a 2D ellipse, for which the eigenvectors are found.
 struct RotatedEllipsoid3D
 {
@@ -425,6 +446,15 @@ std::tuple<bool,RotatedEllipse2D> Get2DRotatedEllipseFromCovMat(
     const Eigen::Matrix<Scalar, 2, 1>& mean,
     Scalar covar2D_to_ellipse_confidence);
 
+struct SymMat2x2Batch;
+
+/// Extracts the ellipses from many covariance matrices at once, see Get2DRotatedEllipseFromCovMat.
+/// The ellipse is null if it can't be extracted from the corresponding covariance.
+void Get2DRotatedEllipsesFromCovMats(const SymMat2x2Batch& covars,
+    const std::vector<Eigen::Matrix<Scalar, 2, 1>>& means,
+    Scalar covar2D_to_ellipse_confidence,
+    std::vector<std::optional<RotatedEllipse2D>>* ellipses);
+
 bool GetRotatedEllipsoid(const Ellipsoid3DWithCenter& ellipsoid, bool can_throw, RotatedEllipsoid3D* result);
 RotatedEllipsoid3D GetRotatedEllipsoid(const Ellipsoid3DWithCenter& ellipsoid);
 
@@ -47,6 +47,14 @@ typedef
 #endif
     Scalar;
 
+/// Excludes the parameter from template argument deduction, eg. to let the operators of Jet<F,N> accept arguments,
+/// which are convertible to F (like int).
+template <typename T>
+struct NonDeducedHelper { using type = T; };
+
+template <typename T>
+using NonDeduced = typename NonDeducedHelper<T>::type;
+
 /// Indicates that the point of function call is never reached. This allows to satisfy the compiler,
 /// which otherwise emits a warning "not all control paths return a value".
 //[[noreturn]] inline void AssertFalse() { std::terminate(); }
@@ -32,4 +32,25 @@ std::optional<Scalar> CalcCorrCoeff(const Picture& pic,
     const cv::Mat& templ_gray,
     Scalar templ_mean,
     Scalar templ_sqrt_sum_sqr_diff);
+
+struct LucasKanadeParams
+{
+    suriko::Sizei window{ 11, 11 };  // the size of the patch around the point
+    int max_iters = 20;  // per level of the pyramid
+    Scalar min_step_pix = 0.01;  // stop iterating when the shift of the patch is smaller
+    Scalar min_eigen_value = 1e-3;  // the patch is textureless if min eigenvalue of the gradient matrix (per pixel) is smaller
+};
+
+/// Tracks the point from the reference picture into the target picture by pyramidal Lucas-Kanade (the translation of the patch).
+/// The tracking starts at the guessed position in the target picture on the coarsest level of the pyramids, common to both pictures.
+/// The cost doesn't depend on the distance between the guess and the result.
+/// Returns null if the patch is textureless or the point leaves the target picture.
+std::optional<suriko::Point2f> TrackPointPyramidalLK(const Picture& ref_pic,
+    suriko::Point2f ref_center,
+    const Picture& pic,
+    suriko::Point2f guess_center,
+    const LucasKanadeParams& params);
+
+/// Gets the number of bits which differ in two binary descriptors (eg. ORB or BRIEF) of the given length in bytes.
+int HammingDistance(const unsigned char* a, const unsigned char* b, int descr_bytes);
 } // ns
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <random>
 #include <gsl/span>
 #include "suriko/rt-config.h"
 #include "suriko/obs-geom.h"
@@ -56,4 +57,12 @@ void GenerateCameraShots3DPath(const WorldBounds& wb,
     const std::vector<LookAtComponents>& cam_poses, int periods_count,
     std::vector<SE3Transform>* inverse_orient_cams);
 
+/// Generates the inertial measurements of the camera, moving along the path with the given period of frames.
+/// The i-th sample is averaged over the interval from the i-th frame to the next one. The acceleration is found by finite
+/// differences of the positions of the camera. The gaussian noise is added when the generator of random numbers is given.
+void GenerateImuSamples(const std::vector<SE3Transform>& inverse_orient_cams, Scalar seconds_per_frame,
+    const suriko::Point3& gravity_w,
+    Scalar gyro_noise_std, Scalar accel_noise_std, std::mt19937* gen,
+    std::vector<ImuSample>* imu_samples);
+
 }}
\ No newline at end of file
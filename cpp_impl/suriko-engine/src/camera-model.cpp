@@ -0,0 +1,166 @@
+#include <cmath>
+#include <vector>
+#include <unsupported/Eigen/Polynomials>
+#include "suriko/camera-model.h"
+#include "suriko/approx-alg.h"
+
+namespace suriko
+{
+Scalar Calc_rd(const CameraIntrinsicParams& cam_intrinsics, const Point2f& h_distorted)
+{
+    const auto& Cx = cam_intrinsics.principal_point_pix[0];
+    const auto& Cy = cam_intrinsics.principal_point_pix[1];
+    const auto& dx = cam_intrinsics.pixel_size_mm[0];
+    const auto& dy = cam_intrinsics.pixel_size_mm[1];
+
+    using suriko::Sqr, suriko::Pow4;
+    const auto& hd = h_distorted;
+    Scalar rd = std::sqrt(Sqr(dx * (hd.X() - Cx)) + Sqr(dy * (hd.Y() - Cy)));  // A.24
+    return rd;
+}
+
+/// Computes the Jacobian of the radial undistortion hu=C+(hd-C)*stretch(rd).
+/// @param stretch_by_rd_div_rd d(stretch)/d(rd)/rd
+void Deriv_hu_by_hd_Radial(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd,
+    Scalar stretch, Scalar stretch_by_rd_div_rd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd)
+{
+    auto [Cx, Cy] = cam_intrinsics.principal_point_pix;
+    auto [dx, dy] = cam_intrinsics.pixel_size_mm;
+
+    using suriko::Sqr;
+    const Scalar& g = stretch_by_rd_div_rd;
+    Scalar side = g * (hd.Y() - Cy) * (hd.X() - Cx);
+
+    // A.32
+    auto& r = *hu_by_hd;
+    r(0, 0) = stretch + g * Sqr(dx * (hd.X() - Cx));
+    r(1, 1) = stretch + g * Sqr(dy * (hd.Y() - Cy));
+    r(1, 0) = side * Sqr(dx);
+    r(0, 1) = side * Sqr(dy);
+}
+
+suriko::Point2f MikhailRadialCameraModel::DistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& h_undistorted) const
+{
+    // hu->hd: distort image coordinates
+    using suriko::Sqr, suriko::Pow4;
+    Scalar Cx = cam_intrinsics.principal_point_pix[0];
+    Scalar Cy = cam_intrinsics.principal_point_pix[1];
+    const auto& dx = cam_intrinsics.pixel_size_mm[0];
+    const auto& dy = cam_intrinsics.pixel_size_mm[1];
+    Scalar ru = std::sqrt(Sqr(dx * (h_undistorted[0] - Cx)) + Sqr(dy * (h_undistorted[1] - Cy)));
+
+    // solve polynomial fun(rd)=0=-ru+rd+k1*rd^3+k2*rd^5
+    Scalar rd = -1;
+    const auto& k1 = params.k1;
+    const auto& k2 = params.k2;
+    if (k2 != 0)  // Eigen impl requires nonzero highest degree coefficient
+    {
+        // https://eigen.tuxfamily.org/dox/unsupported/group__Polynomials__Module.html
+        constexpr auto PolyDeg = 5;
+        Eigen::Matrix<Scalar, PolyDeg+1, 1> distort_poly{};
+        distort_poly << -ru, 1, 0, k1, 0, k2;
+        Eigen::PolynomialSolver<Scalar, PolyDeg> poly_solver{ distort_poly };
+        std::vector<Scalar> rd_roots;
+        poly_solver.realRoots(rd_roots);
+        SRK_ASSERT(rd_roots.size() == 1);
+        rd = rd_roots[0];
+    }
+    else
+    {
+        if (k1 == 0) rd = ru;
+        else
+        {
+            // polynomial fun(rd)=0=-ru+rd+k1*rd^3
+            Scalar e = std::pow(9 * k1 * k1 * ru + std::sqrt(3 * k1 * k1 * k1 * (4 + 27 * k1 * ru * ru)), 1.0f / 3);
+            rd = (-2 * std::pow(3, 1.0f / 3) * k1 + std::pow(2, 1.0f / 3) * e * e) / (std::pow<Scalar>(6, 2.0 / 3) * k1 * e);
+        }
+    }
+    SRK_ASSERT(rd != -1);
+    Scalar stretch = 1 + k1 * Sqr(rd) + k2 * Pow4(rd);
+
+    suriko::Point2f h_distorted{};
+    h_distorted[0] = Cx + (h_undistorted[0] - Cx) / stretch;
+    h_distorted[1] = Cy + (h_undistorted[1] - Cy) / stretch;
+    return h_distorted;
+}
+
+suriko::Point2f MikhailRadialCameraModel::UndistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& h_distorted) const
+{
+    using suriko::Sqr, suriko::Pow4;
+    auto [Cx, Cy] = cam_intrinsics.principal_point_pix;
+    Scalar rd = Calc_rd(cam_intrinsics, h_distorted);
+
+    Scalar stretch = 1 + params.k1 * Sqr(rd) + params.k2 * Pow4(rd);
+
+    suriko::Point2f h_undistorted{};
+    h_undistorted[0] = Cx + (h_distorted.X() - Cx) * stretch;
+    h_undistorted[1] = Cy + (h_distorted.Y() - Cy) * stretch;
+    return h_undistorted;
+}
+
+void MikhailRadialCameraModel::Deriv_hu_by_hdExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const
+{
+    using suriko::Sqr, suriko::Pow4;
+    Scalar rd = Calc_rd(cam_intrinsics, hd);
+
+    Scalar stretch = 1 + params.k1 * Sqr(rd) + params.k2 * Pow4(rd);
+
+    Scalar kk = params.k1 + 2 * params.k2 * Sqr(rd);
+    Deriv_hu_by_hd_Radial(cam_intrinsics, hd, stretch, 2 * kk, hu_by_hd);
+}
+
+suriko::Point2f EquidistantFisheyeCameraModel::DistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& h_undistorted) const
+{
+    // ru=f*tan(theta) -> rd=f*theta
+    Scalar ru = Calc_rd(cam_intrinsics, h_undistorted);  // same formula for undistorted pixels
+    const Scalar f = cam_intrinsics.focal_length_mm;
+    Scalar theta = std::atan(ru / f);
+    Scalar rd = f * theta;
+
+    // shrink = rd/ru = theta/tan(theta) ~ 1-theta^2/3 near the principal point
+    Scalar shrink = ru > 0 ? rd / ru : 1;
+
+    auto [Cx, Cy] = cam_intrinsics.principal_point_pix;
+    suriko::Point2f h_distorted{};
+    h_distorted[0] = Cx + (h_undistorted[0] - Cx) * shrink;
+    h_distorted[1] = Cy + (h_undistorted[1] - Cy) * shrink;
+    return h_distorted;
+}
+
+suriko::Point2f EquidistantFisheyeCameraModel::UndistortPixelExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& h_distorted) const
+{
+    // rd=f*theta -> ru=f*tan(theta)
+    Scalar rd = Calc_rd(cam_intrinsics, h_distorted);
+    Scalar theta = rd / cam_intrinsics.focal_length_mm;
+
+    Scalar stretch = theta > 0 ? std::tan(theta) / theta : 1;
+
+    auto [Cx, Cy] = cam_intrinsics.principal_point_pix;
+    suriko::Point2f h_undistorted{};
+    h_undistorted[0] = Cx + (h_distorted.X() - Cx) * stretch;
+    h_undistorted[1] = Cy + (h_distorted.Y() - Cy) * stretch;
+    return h_undistorted;
+}
+
+void EquidistantFisheyeCameraModel::Deriv_hu_by_hdExact(const CameraIntrinsicParams& cam_intrinsics, const suriko::Point2f& hd, Eigen::Matrix<Scalar, 2, 2>* hu_by_hd) const
+{
+    using suriko::Sqr;
+    Scalar rd = Calc_rd(cam_intrinsics, hd);
+    const Scalar f = cam_intrinsics.focal_length_mm;
+    Scalar theta = rd / f;
+
+    Scalar stretch = 1;
+    Scalar stretch_by_rd_div_rd = 2 / (3 * Sqr(f));  // the limit for theta->0
+    constexpr Scalar kSmallTheta = static_cast<Scalar>(1e-4);
+    if (theta > kSmallTheta)
+    {
+        Scalar tan_theta = std::tan(theta);
+        stretch = tan_theta / theta;
+
+        // stretch=tan(theta)/theta, d(stretch)/d(theta)=(theta/cos^2(theta)-tan(theta))/theta^2, d(theta)/d(rd)=1/f
+        Scalar stretch_by_theta = (theta / Sqr(std::cos(theta)) - tan_theta) / Sqr(theta);
+        stretch_by_rd_div_rd = stretch_by_theta / (f * rd);
+    }
+    Deriv_hu_by_hd_Radial(cam_intrinsics, hd, stretch, stretch_by_rd_div_rd, hu_by_hd);
+}
+}
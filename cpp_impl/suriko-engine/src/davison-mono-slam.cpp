@@ -1,12 +1,15 @@
 #include <random>
-#include <numeric> // accumulate
+#include <numeric> // accumulate, iota
+#include <future>
+#include <map>
 #include "suriko/davison-mono-slam.h"
 #include <glog/logging.h>
-#include <unsupported/Eigen/Polynomials>
 #include <opencv2/imgproc.hpp>
 #include "suriko/approx-alg.h"
 #include "suriko/quat.h"
 #include "suriko/eigen-helpers.hpp"
+#include "suriko/jet.h"
+#include "suriko/lin-alg.h"
 #include "suriko/templ-match.h"
 #include "suriko/rand-stuff.h"
 #include "suriko/stat-helpers.h"
@@ -45,19 +48,6 @@ auto SpanAu(EigenMat& m, size_t count) -> gsl::span<typename EigenMat::Scalar>
     return gsl::make_span<S>(m.data(), static_cast<typename gsl::span<S>::index_type>(count));
 }
 
-Scalar Calc_rd(const CameraIntrinsicParams& cam_intrinsics, const Point2f& h_distorted)
-{
-    const auto& Cx = cam_intrinsics.principal_point_pix[0];
-    const auto& Cy = cam_intrinsics.principal_point_pix[1];
-    const auto& dx = cam_intrinsics.pixel_size_mm[0];
-    const auto& dy = cam_intrinsics.pixel_size_mm[1];
-
-    using suriko::Sqr, suriko::Pow4;
-    const auto& hd = h_distorted;
-    Scalar rd = std::sqrt(Sqr(dx * (hd.X() - Cx)) + Sqr(dy * (hd.Y() - Cy)));  // A.24
-    return rd;
-}
-
 SE3Transform CamWfc(const CameraStateVars& cam_state)
 {
     Eigen::Matrix<Scalar, kEucl3, kEucl3> Rwfc;
@@ -75,6 +65,21 @@ suriko::Point2i TemplateTopLeftInt(const suriko::Point2f& center, suriko::Sizei
         static_cast<int>(center[1] - rad_y) };
 }
 
+/// Calls fun(var_ind, sal_pnt_var_ind, vars_count) for each contiguous segment of the salient point's variables in the estimated state,
+/// where sal_pnt_var_ind is the position of the segment among the variables of the salient point.
+/// The variables of the anchor go first, so that the anchored salient point is laid out as the self-contained inverse depth salient point.
+template <typename F>
+void ForEachSalientPointVarsSegment(const TrackedSalientPoint& sal_pnt, F fun)
+{
+    size_t sal_pnt_var_ind = 0;
+    if (sal_pnt.anchor != nullptr)
+    {
+        fun(sal_pnt.anchor->estim_vars_ind, sal_pnt_var_ind, kEucl3);
+        sal_pnt_var_ind += kEucl3;
+    }
+    fun(sal_pnt.estim_vars_ind, sal_pnt_var_ind, sal_pnt.EstimVarsCount());
+}
+
 DavisonMonoSlamInternalsLogger::DavisonMonoSlamInternalsLogger()
 {
 }
@@ -196,6 +201,45 @@ void DavisonMonoSlam::CopyFrom(const DavisonMonoSlam& src)
         d.sal_pnts_.push_back(std::move(dst_sal_pnt));
     }
 
+    // deep copy of anchors; salient points are redirected to the copies
+    std::map<const SalPntAnchor*, SalPntAnchor*> src_to_dst_anchor;
+    d.sal_pnt_anchors_.clear();
+    for (const auto& p_src_anchor : src.sal_pnt_anchors_)
+    {
+        auto dst_anchor = std::make_unique<SalPntAnchor>(*p_src_anchor);
+        src_to_dst_anchor[p_src_anchor.get()] = dst_anchor.get();
+        d.sal_pnt_anchors_.push_back(std::move(dst_anchor));
+    }
+    for (auto& p_dst_sal_pnt : d.sal_pnts_)
+    {
+        if (p_dst_sal_pnt->anchor != nullptr)
+            p_dst_sal_pnt->anchor = src_to_dst_anchor.at(p_dst_sal_pnt->anchor);
+    }
+
+    d.localization_only_ = src.localization_only_;
+    d.frozen_sal_pnts_.clear();
+    for (const FrozenSalientPoint& src_frozen_sal_pnt : src.frozen_sal_pnts_)
+    {
+        FrozenSalientPoint dst_frozen_sal_pnt;
+        dst_frozen_sal_pnt.sal_pnt = std::make_unique<TrackedSalientPoint>(*src_frozen_sal_pnt.sal_pnt);
+        dst_frozen_sal_pnt.pos_w = src_frozen_sal_pnt.pos_w;
+        dst_frozen_sal_pnt.pos_uncert = src_frozen_sal_pnt.pos_uncert;
+        d.frozen_sal_pnts_.push_back(std::move(dst_frozen_sal_pnt));
+    }
+
+    d.sal_pnt_candidates_.clear();
+    for (const auto& p_src_candidate : src.sal_pnt_candidates_)
+    {
+        auto dst_candidate = std::make_unique<SalPntCandidate>();
+        dst_candidate->sal_pnt = std::make_unique<TrackedSalientPoint>(*p_src_candidate->sal_pnt);
+        dst_candidate->first_frame_ind = p_src_candidate->first_frame_ind;
+        dst_candidate->ray = p_src_candidate->ray;
+        dst_candidate->inv_dist_hypotheses = p_src_candidate->inv_dist_hypotheses;
+        dst_candidate->hypotheses_weights = p_src_candidate->hypotheses_weights;
+        dst_candidate->missed_frames_count = p_src_candidate->missed_frames_count;
+        d.sal_pnt_candidates_.push_back(std::move(dst_candidate));
+    }
+
     // other fields
 
     d.estim_vars_ = src.estim_vars_;
@@ -203,15 +247,28 @@ void DavisonMonoSlam::CopyFrom(const DavisonMonoSlam& src)
 
     d.predicted_estim_vars_ = src.predicted_estim_vars_;
     d.predicted_estim_vars_covar_ = src.predicted_estim_vars_covar_;
+    d.estim_vars_covar_sqrt_ = src.estim_vars_covar_sqrt_;
+    d.predicted_estim_vars_covar_sqrt_ = src.predicted_estim_vars_covar_sqrt_;
+    d.covar_marginals_only_ = src.covar_marginals_only_;
+    d.cam_orient_wfc_nominal_ = src.cam_orient_wfc_nominal_;
+    d.frame_timing_ = src.frame_timing_;
 
     d.estim_sal_pnts_count_ = src.estim_sal_pnts_count_;
 
     d.in_multi_threaded_mode_ = src.in_multi_threaded_mode_;
+    d.publish_state_ = src.publish_state_;
+    d.detect_new_blobs_concurrently_ = src.detect_new_blobs_concurrently_;
     d.seconds_per_frame_ = src.seconds_per_frame_;
 
     d.process_noise_linear_velocity_std_ = src.process_noise_linear_velocity_std_;
     d.process_noise_angular_velocity_std_ = src.process_noise_angular_velocity_std_;
     d.process_noise_covar_ = src.process_noise_covar_;
+    d.process_noise_adaptive_ = src.process_noise_adaptive_;
+    d.process_noise_adaptive_min_scale_ = src.process_noise_adaptive_min_scale_;
+    d.process_noise_scale_ = src.process_noise_scale_;
+    d.imu_gyro_noise_std_ = src.imu_gyro_noise_std_;
+    d.imu_accel_noise_std_ = src.imu_accel_noise_std_;
+    d.imu_gravity_w_ = src.imu_gravity_w_;
     d.measurm_noise_std_pix_ = src.measurm_noise_std_pix_;
 
     d.cam_pos_x_std_m_ = src.cam_pos_x_std_m_;
@@ -234,6 +291,22 @@ void DavisonMonoSlam::CopyFrom(const DavisonMonoSlam& src)
     d.force_xyz_sal_pnt_pos_diagonal_uncert_ = src.force_xyz_sal_pnt_pos_diagonal_uncert_;
     d.sal_pnt_max_undetected_frames_count_ = src.sal_pnt_max_undetected_frames_count_;
     d.sal_pnt_negative_inv_rho_substitute_ = src.sal_pnt_negative_inv_rho_substitute_;
+    d.sal_pnt_switch_to_xyz_linearity_index_ = src.sal_pnt_switch_to_xyz_linearity_index_;
+    d.sal_pnt_shared_anchor_ = src.sal_pnt_shared_anchor_;
+    d.sal_pnt_candidate_min_frames_ = src.sal_pnt_candidate_min_frames_;
+    d.sal_pnt_candidate_max_frames_ = src.sal_pnt_candidate_max_frames_;
+    d.sal_pnt_candidate_max_missed_frames_ = src.sal_pnt_candidate_max_missed_frames_;
+    d.sal_pnt_candidate_depth_hypotheses_ = src.sal_pnt_candidate_depth_hypotheses_;
+    d.sal_pnt_candidate_min_depth_ratio_ = src.sal_pnt_candidate_min_depth_ratio_;
+    d.sal_pnt_candidate_max_depth_ratio_ = src.sal_pnt_candidate_max_depth_ratio_;
+    d.sal_pnt_candidate_depth_converged_ratio_ = src.sal_pnt_candidate_depth_converged_ratio_;
+    d.sal_pnt_max_count_ = src.sal_pnt_max_count_;
+    d.sal_pnt_evict_batch_size_ = src.sal_pnt_evict_batch_size_;
+    d.sal_pnt_score_prior_frames_ = src.sal_pnt_score_prior_frames_;
+    d.sal_pnt_score_match_ratio_weight_ = src.sal_pnt_score_match_ratio_weight_;
+    d.sal_pnt_score_recency_weight_ = src.sal_pnt_score_recency_weight_;
+    d.sal_pnt_score_innov_consistency_weight_ = src.sal_pnt_score_innov_consistency_weight_;
+    d.sal_pnt_score_distance_weight_ = src.sal_pnt_score_distance_weight_;
 
     d.sal_pnt_templ_size_ = src.sal_pnt_templ_size_;
 
@@ -244,8 +317,7 @@ void DavisonMonoSlam::CopyFrom(const DavisonMonoSlam& src)
     d.debug_max_sal_pnt_coun_ = src.debug_max_sal_pnt_coun_;
 
     d.cam_intrinsics_ = src.cam_intrinsics_;
-    d.cam_enable_distortion_ = src.cam_enable_distortion_;
-    d.cam_distort_params_ = src.cam_distort_params_;
+    d.cam_model_ = src.cam_model_;
 
     d.gt_cami_from_world_fun_ = src.gt_cami_from_world_fun_;
     d.gt_cami_from_tracker_fun_ = src.gt_cami_from_tracker_fun_;
@@ -256,12 +328,20 @@ void DavisonMonoSlam::CopyFrom(const DavisonMonoSlam& src)
     d.set_estim_state_covar_to_gt_impl_ = src.set_estim_state_covar_to_gt_impl_;
 
     d.mono_slam_update_impl_ = src.mono_slam_update_impl_;
+    d.update_block_sal_pnts_ = src.update_block_sal_pnts_;
 
     d.one_point_ransac_corner_max_divergence_pix_ = src.one_point_ransac_corner_max_divergence_pix_;
     d.one_point_ransac_high_innov_chi_square_thresh_pix2_ = src.one_point_ransac_high_innov_chi_square_thresh_pix2_;
+    d.one_point_ransac_success_prob_ = src.one_point_ransac_success_prob_;
+    d.one_point_ransac_gen_ = src.one_point_ransac_gen_;
 
     d.fix_estim_vars_covar_symmetry_ = src.fix_estim_vars_covar_symmetry_;
 
+    d.deadline_min_fused_obs_count_ = src.deadline_min_fused_obs_count_;
+    d.deadline_max_search_rect_size_ = src.deadline_max_search_rect_size_;
+    d.active_search_max_sal_pnts_ = src.active_search_max_sal_pnts_;
+    d.active_search_by_time_budget_ = src.active_search_by_time_budget_;
+
     d.corners_matcher_ = src.corners_matcher_;
     d.stats_logger_ = src.stats_logger_;
 }
@@ -274,6 +354,8 @@ DavisonMonoSlam& DavisonMonoSlam::operator=(const DavisonMonoSlam& src)
 
 void DavisonMonoSlam::ResetCamera()
 {
+    InvalidateCovarSqrt();
+
     // the first time initialization goes to predicted state
     // here it seems we need to initialize only predicted state
     auto& src_estim_vars = predicted_estim_vars_;
@@ -289,6 +371,9 @@ void DavisonMonoSlam::ResetCamera()
     // ui (SetCameraBehindTracker) shows estimated state (so just for ui, we initialize estimated state here too)
     estim_vars_ = predicted_estim_vars_;
     estim_vars_covar_ = predicted_estim_vars_covar_;
+
+    frame_timing_ = {};
+    process_noise_scale_ = 1;
 }
 
 void DavisonMonoSlam::SetCameraState(EigenDynVec* src_estim_vars)
@@ -301,31 +386,37 @@ void DavisonMonoSlam::SetCameraState(EigenDynVec* src_estim_vars)
     state_span[1] = 0;
     state_span[2] = 0;
 
-    // camera orientation
-    state_span[3] = 1;
+    // camera orientation; the nominal orientation is the identity rotation, the orientation error is zero
+    cam_orient_wfc_nominal_ = Eigen::Matrix<Scalar, kQuat4, 1>(1, 0, 0, 0);
+    state_span[3] = 0;
     state_span[4] = 0;
     state_span[5] = 0;
-    state_span[6] = 0;
 
-    // camera velocity; at each iteration is increased by acceleration in the form of the gaussian noise
-    state_span[7] = 0;
-    state_span[8] = 0;
-    state_span[9] = 0;
+    if constexpr (kCamStateHasVelocity)
+    {
+        // camera velocity; at each iteration is increased by acceleration in the form of the gaussian noise
+        state_span[6] = 0;
+        state_span[7] = 0;
+        state_span[8] = 0;
 
-    // camera angular velocity; at each iteration is increased by acceleration in the form of the gaussian noise
-    state_span[10] = 0;
-    state_span[11] = 0;
-    state_span[12] = 0;
+        // camera angular velocity; at each iteration is increased by acceleration in the form of the gaussian noise
+        state_span[9] = 0;
+        state_span[10] = 0;
+        state_span[11] = 0;
+    }
 }
 
 void DavisonMonoSlam::SetCameraVelocity(std::optional<suriko::Point3> cam_vel_tracker, std::optional<suriko::Point3> cam_ang_vel_c)
 {
+    if constexpr (!kCamStateHasVelocity)
+        return;  // the camera is assumed to be still
+
     gsl::span<Scalar> cam_state = gsl::make_span(predicted_estim_vars_.data(), kCamStateComps);
 
     if (cam_vel_tracker.has_value())
     {
         // camera velocity; at each iteration is increased by acceleration in the form of the gaussian noise
-        constexpr auto cam_vel_offset = kEucl3 + kQuat4;
+        constexpr auto cam_vel_offset = kEucl3 + kOrientErrComps;
         DependsOnCameraPosPackOrder();
         cam_state[cam_vel_offset + 0] = cam_vel_tracker.value()[0];
         cam_state[cam_vel_offset + 1] = cam_vel_tracker.value()[1];
@@ -335,7 +426,7 @@ void DavisonMonoSlam::SetCameraVelocity(std::optional<suriko::Point3> cam_vel_tr
     if (cam_ang_vel_c.has_value())
     {
         // camera angular velocity; at each iteration is increased by acceleration in the form of the gaussian noise
-        constexpr auto cam_ang_vel_offset = kEucl3 + kQuat4 + kEucl3;
+        constexpr auto cam_ang_vel_offset = kEucl3 + kOrientErrComps + kVelocComps;
         cam_state[cam_ang_vel_offset + 0] = cam_ang_vel_c.value()[0];
         cam_state[cam_ang_vel_offset + 1] = cam_ang_vel_c.value()[1];
         cam_state[cam_ang_vel_offset + 2] = cam_ang_vel_c.value()[2];
@@ -349,7 +440,7 @@ void DavisonMonoSlam::SetCameraStateCovar(EigenDynMat* src_estim_vars_covar_tmp)
     // It seems, these values should always be const and equal zero (except orientation quaternion is an identity rotation)
     // then the first camera has certain position and orientation and further frames are built upon it.
     // Otherwise, if we put some uncertainty into position of the first camera, the uncertainty will propagate into consequent frames.
-    Scalar cam_orient_q_comp_var = suriko::Sqr(cam_orient_q_comp_std_);
+    Scalar cam_orient_err_var = CameraOrientationErrorVariance();
     Scalar cam_vel_var = suriko::Sqr(cam_vel_std_);
     Scalar cam_ang_vel_var = suriko::Sqr(cam_ang_vel_std_);
 
@@ -357,23 +448,32 @@ void DavisonMonoSlam::SetCameraStateCovar(EigenDynMat* src_estim_vars_covar_tmp)
     covar(0, 0) = suriko::Sqr(cam_pos_x_std_m_);;
     covar(1, 1) = suriko::Sqr(cam_pos_y_std_m_);;
     covar(2, 2) = suriko::Sqr(cam_pos_z_std_m_);;
-    // camera orientation (quaternion)
-    covar(3, 3) = cam_orient_q_comp_var;
-    covar(4, 4) = cam_orient_q_comp_var;
-    covar(5, 5) = cam_orient_q_comp_var;
-    covar(6, 6) = cam_orient_q_comp_var;
-    // camera speed
-    covar(7, 7) = cam_vel_var;
-    covar(8, 8) = cam_vel_var;
-    covar(9, 9) = cam_vel_var;
-    // camera angular speed
-    covar(10, 10) = cam_ang_vel_var;
-    covar(11, 11) = cam_ang_vel_var;
-    covar(12, 12) = cam_ang_vel_var;
+    // camera orientation error
+    covar(3, 3) = cam_orient_err_var;
+    covar(4, 4) = cam_orient_err_var;
+    covar(5, 5) = cam_orient_err_var;
+    if constexpr (kCamStateHasVelocity)
+    {
+        // camera speed
+        covar(6, 6) = cam_vel_var;
+        covar(7, 7) = cam_vel_var;
+        covar(8, 8) = cam_vel_var;
+        // camera angular speed
+        covar(9, 9) = cam_ang_vel_var;
+        covar(10, 10) = cam_ang_vel_var;
+        covar(11, 11) = cam_ang_vel_var;
+    }
+}
+
+Scalar DavisonMonoSlam::CameraOrientationErrorVariance() const
+{
+    // the vector part of the quaternion of a small rotation is the half of the rotation's angle-vector
+    return suriko::Sqr(2 * cam_orient_q_comp_std_);
 }
 
 void DavisonMonoSlam::SetCameraStateCovarHelper()
 {
+    InvalidateCovarSqrt();
     SetCameraStateCovar(&predicted_estim_vars_covar_);
 }
 
@@ -444,12 +544,21 @@ bool DavisonMonoSlam::ConvertSphericalFromXyzSalientPoint(const Point3& sal_pnt_
 
 void DavisonMonoSlam::ConvertMorphableFromSphericalSalientPoints(
     const std::vector<SphericalSalientPointWithBuildInfo>& sal_pnt_build_infos,
-    SalPntComps sal_pnt_repres,
-    std::vector<MorphableSalientPoint>* sal_pnts)
+    std::vector<MorphableSalientPoint>* sal_pnts) const
 {
-    for (const auto& sbi : sal_pnt_build_infos)
+    SRK_ASSERT(sal_pnt_build_infos.size() == SalientPointsCount());
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < sal_pnt_build_infos.size(); ++sal_pnt_ind)
     {
+        const auto& sbi = sal_pnt_build_infos[sal_pnt_ind];
+
+        // the salient point is converted into the representation, in which it is estimated;
+        // the anchored salient point is represented by the inverse depth salient point with the first camera of its anchor
+        SalPntComps sal_pnt_repres = sal_pnts_[sal_pnt_ind]->repres;
+        if (sal_pnt_repres == SalPntComps::kSphericalAnchoredInvDist)
+            sal_pnt_repres = SalPntComps::kSphericalFirstCamInvDist;
+
         MorphableSalientPoint sp;
+        sp.repres = sal_pnt_repres;
         if (sal_pnt_repres == SalPntComps::kXyz)
         {
             bool op = ConvertXyzFromSphericalSalientPoint(sbi.spher_sal_pnt, &sp.pos_w);
@@ -486,27 +595,18 @@ Point3 DavisonMonoSlam::CameraCoordinatesEuclidUnityDirFromPolarAngles(Scalar az
 template <typename EigenMat>
 bool CheckUncertCovMat(const EigenMat& pos_uncert, bool can_throw)
 {
-    constexpr Scalar covar_3d_to_ellipsoid_chi_square = 7.81473f;  // chi-square value determines confidence interval {chi-square,CI}={7.81473,95%}
-
-    Point3 pnt_pos{ 0, 0, 0 };
-
-    // Successfully extracted ellipsoid means 3D view can be rendered,
+    // Positive semi-definite covariance means the uncertainty ellipsoid is extractable, so 3D view can be rendered,
     // as well as 2D ellipse can be constructed in camera's plane by projection.
-    auto [op, rot_ellipsoid] = GetRotatedUncertaintyEllipsoidFromCovMat(pos_uncert, pnt_pos, covar_3d_to_ellipsoid_chi_square);
-    if (!op)
-    {
-        if (can_throw) SRK_ASSERT(op);
-        return op;
-    }
-    return true;
+    // Cholesky decomposition checks it without extracting the ellipsoid.
+    bool op = IsPositiveSemidefinite(pos_uncert);
+    if (can_throw) SRK_ASSERT(op);
+    return op;
 }
 
 template <typename EigenMat>
 bool CheckEllipseIsExtractableFrom2DCovarMat(const EigenMat& covar_2D, bool can_throw)
 {
-    constexpr Scalar covar2D_to_ellipse_confidence = 0.95f;
-    Eigen::Matrix<Scalar, 2, 1> mean{0, 0};
-    auto [op, rot_ellipse] = Get2DRotatedEllipseFromCovMat(covar_2D, mean, covar2D_to_ellipse_confidence);
+    bool op = IsPositiveSemidefinite(covar_2D);
     if (can_throw) SRK_ASSERT(op);
     return op;
 }
@@ -547,7 +647,6 @@ void DavisonMonoSlam::RemoveSalientPointsWithNonextractableUncertEllipsoid(Eigen
     {
         const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
 
-        // TODO: need quick way to find out if position uncertainty ellipsoid of salient point is extractable from covariance matrix
         if (!CheckSalientPoint(*src_estim_vars, *src_estim_vars_covar, sal_pnt, false))
             bad_sal_pnt_inds.push_back(sal_pnt.sal_pnt_ind);
     }
@@ -586,23 +685,31 @@ void DavisonMonoSlam::PredictCameraMotionByKinematicModel(gsl::span<const Scalar
 {
     Eigen::Map<const Eigen::Matrix<Scalar, kCamStateComps, 1>> cam_state_mat(cam_state.data());
 
-    //Eigen::Map<const Eigen::Matrix<Scalar, kEucl3, 1>> cam_pos(&cam_state[0]);
-    //Eigen::Map<const Eigen::Matrix<Scalar, kQuat4, 1>> cam_orient_quat(&cam_state[kEucl3]);
-    //Eigen::Map<const Eigen::Matrix<Scalar, kVelocComps, 1>> cam_vel(&cam_state[kEucl3 + kQuat4]);
-    //Eigen::Map<const Eigen::Matrix<Scalar, kAngVelocComps, 1>> cam_ang_vel(&cam_state[kEucl3 + kQuat4 + kVelocComps]);
     Eigen::Matrix<Scalar, kEucl3, 1> cam_pos = cam_state_mat.middleRows<kEucl3>(0);
-    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_quat = cam_state_mat.middleRows<kQuat4>(kEucl3);
-    Eigen::Matrix<Scalar, kVelocComps, 1> cam_vel = cam_state_mat.middleRows< kVelocComps>(kEucl3 + kQuat4);
-    Eigen::Matrix<Scalar, kAngVelocComps, 1> cam_ang_vel = cam_state_mat.middleRows<kAngVelocComps>(kEucl3 + kQuat4 + kVelocComps);
+    Eigen::Matrix<Scalar, kOrientErrComps, 1> cam_orient_err = cam_state_mat.middleRows<kOrientErrComps>(kEucl3);
+    Eigen::Matrix<Scalar, kVelocComps, 1> cam_vel = Eigen::Matrix<Scalar, kVelocComps, 1>::Zero();
+    Eigen::Matrix<Scalar, kAngVelocComps, 1> cam_ang_vel = Eigen::Matrix<Scalar, kAngVelocComps, 1>::Zero();
+    if constexpr (kCamStateHasVelocity)
+    {
+        cam_vel = cam_state_mat.middleRows< kVelocComps>(kEucl3 + kOrientErrComps);
+        cam_ang_vel = cam_state_mat.middleRows<kAngVelocComps>(kEucl3 + kOrientErrComps + kVelocComps);
+    }
 
     Eigen::Map<Eigen::Matrix<Scalar, kEucl3, 1>> new_cam_pos(&new_cam_state[0]);
-    Eigen::Map<Eigen::Matrix<Scalar, kQuat4, 1>> new_cam_orient_quat(&new_cam_state[kEucl3]);
-    Eigen::Map<Eigen::Matrix<Scalar, kVelocComps, 1>> new_cam_vel(&new_cam_state[kEucl3 + kQuat4]);
-    Eigen::Map<Eigen::Matrix<Scalar, kAngVelocComps, 1>> new_cam_ang_vel(&new_cam_state[kEucl3 + kQuat4 + kVelocComps]);
+    Eigen::Map<Eigen::Matrix<Scalar, kOrientErrComps, 1>> new_cam_orient_err(&new_cam_state[kEucl3]);
+
+    // the gyroscope replaces the angular velocity of the motion model
+    std::optional<Point3> imu_ang_vel = ImuAngularVelocity();
+    if (imu_ang_vel.has_value())
+        cam_ang_vel = imu_ang_vel.value();
+
+    std::optional<Point3> imu_accel = ImuAcceleration(cam_orient_err);
 
     // camera position
-    Scalar dT = seconds_per_frame_;
+    Scalar dT = PredictionInterval();
     new_cam_pos = cam_pos + cam_vel * dT;
+    if (imu_accel.has_value())
+        new_cam_pos += imu_accel.value() * (dT * dT / 2);
 
     DependsOnInputNoisePackOrder();
     if (noise_state != nullptr)
@@ -616,17 +723,27 @@ void DavisonMonoSlam::PredictCameraMotionByKinematicModel(gsl::span<const Scalar
     Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_delta_quat{};
     QuatFromAxisAngle(cam_orient_delta, &cam_orient_delta_quat);
 
-    Eigen::Matrix<Scalar, kQuat4, 1> new_cam_orient_quat_tmp;
-    QuatMult(cam_orient_quat, cam_orient_delta_quat, &new_cam_orient_quat_tmp);
+    // the nominal orientation is the same for the old and new state, hence exp(new_err)=exp(err)*q(delta)
+    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_err_quat{};
+    QuatFromAxisAngle(cam_orient_err, &cam_orient_err_quat);
+
+    Eigen::Matrix<Scalar, kQuat4, 1> new_cam_orient_err_quat;
+    QuatMult(cam_orient_err_quat, cam_orient_delta_quat, &new_cam_orient_err_quat);
 
-    // the product of two unity quaternions must result into the unity quaternion
-    Scalar q_len_normed = new_cam_orient_quat_tmp.norm();
-    SRK_ASSERT(IsCloseAbs(1, q_len_normed, 0.001)) << "quaternion must have unity length";
+    Eigen::Matrix<Scalar, kOrientErrComps, 1> new_cam_orient_err_tmp;
+    AxisAngleFromQuat(new_cam_orient_err_quat, &new_cam_orient_err_tmp);
+    new_cam_orient_err = new_cam_orient_err_tmp;
 
-    new_cam_orient_quat = new_cam_orient_quat_tmp;
+    if constexpr (!kCamStateHasVelocity)
+        return;
+
+    Eigen::Map<Eigen::Matrix<Scalar, kVelocComps, 1>> new_cam_vel(&new_cam_state[kEucl3 + kOrientErrComps]);
+    Eigen::Map<Eigen::Matrix<Scalar, kAngVelocComps, 1>> new_cam_ang_vel(&new_cam_state[kEucl3 + kOrientErrComps + kVelocComps]);
 
-    // camera velocity is unchanged
+    // camera velocity is unchanged, unless the acceleration is measured
     new_cam_vel = cam_vel;
+    if (imu_accel.has_value())
+        new_cam_vel += imu_accel.value() * dT;
     if (noise_state != nullptr)
         new_cam_vel += noise_state->middleRows<kAccelComps>(0);
 
@@ -638,7 +755,8 @@ void DavisonMonoSlam::PredictCameraMotionByKinematicModel(gsl::span<const Scalar
 
 void DavisonMonoSlam::PredictEstimVars(
     const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
-    EigenDynVec* predicted_estim_vars, EigenDynMat* predicted_estim_vars_covar) const
+    EigenDynVec* predicted_estim_vars, EigenDynMat* predicted_estim_vars_covar,
+    const EigenDynMat* src_estim_vars_covar_sqrt, EigenDynMat* predicted_estim_vars_covar_sqrt) const
 {
     // estimated vars
     std::array<Scalar, kCamStateComps> new_cam{};
@@ -666,16 +784,42 @@ void DavisonMonoSlam::PredictEstimVars(
         SRK_ASSERT(true);
     }
 
-    // Pvv = F*Pvv*Ft+G*Q*Gt
-    Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps> Pvv_new =
-        F * src_estim_vars_covar.topLeftCorner<kCamStateComps, kCamStateComps>() * F.transpose() +
-        G * process_noise_covar_ * G.transpose();
-    
-    // Pvm = F*Pvm
+    // the process noise is the change of velocities in one frame period; the velocities make a random walk,
+    // hence the variance of the noise grows linearly with the elapsed time
+    Eigen::Matrix<Scalar, kProcessNoiseComps, kProcessNoiseComps> Q = process_noise_covar_ * process_noise_scale_;
+    if (frame_timing_.dT.has_value())
+        Q *= frame_timing_.dT.value() / seconds_per_frame_;
+
+    // the measured velocities are as uncertain as the inertial sensors
+    if (ImuAngularVelocity().has_value())
+        Q.bottomRightCorner<kAngAccelComps, kAngAccelComps>() = Eigen::Matrix<Scalar, kAngAccelComps, kAngAccelComps>::Identity() * suriko::Sqr(imu_gyro_noise_std_);
+    if (ImuAccelerationAvailable())
+        Q.topLeftCorner<kAccelComps, kAccelComps>() = Eigen::Matrix<Scalar, kAccelComps, kAccelComps>::Identity() * suriko::Sqr(imu_accel_noise_std_ * PredictionInterval());
+
     DependsOnOverallPackOrder();
-    size_t sal_pnts_vars_count = SalientPointsCount() * kSalientPointComps;
-    Eigen::Matrix<Scalar, kCamStateComps, Eigen::Dynamic> Pvm_new = 
-        F * src_estim_vars_covar.topRightCorner(kCamStateComps, sal_pnts_vars_count);
+    size_t sal_pnts_vars_count = src_estim_vars.size() - kCamStateComps;
+
+    Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps> Pvv_new;
+    Eigen::Matrix<Scalar, kCamStateComps, Eigen::Dynamic> Pvm_new;
+    if (predicted_estim_vars_covar_sqrt != nullptr)
+    {
+        PredictEstimVarsCovarSqrt(F, G, Q, *src_estim_vars_covar_sqrt, predicted_estim_vars_covar_sqrt);
+
+        // Pvv=Lcc*Lcct, Pvm=Lcc*Lmct
+        const EigenDynMat& L = *predicted_estim_vars_covar_sqrt;
+        Pvv_new.noalias() = L.topLeftCorner<kCamStateComps, kCamStateComps>() * L.topLeftCorner<kCamStateComps, kCamStateComps>().transpose();
+        Pvm_new.noalias() = L.topLeftCorner<kCamStateComps, kCamStateComps>() * L.bottomLeftCorner(sal_pnts_vars_count, kCamStateComps).transpose();
+    }
+    else
+    {
+        // Pvv = F*Pvv*Ft+G*Q*Gt
+        Pvv_new =
+            F * src_estim_vars_covar.topLeftCorner<kCamStateComps, kCamStateComps>() * F.transpose() +
+            G * Q * G.transpose();
+
+        // Pvm = F*Pvm
+        Pvm_new.noalias() = F * src_estim_vars_covar.topRightCorner(kCamStateComps, sal_pnts_vars_count);
+    }
 
     // Pmm is unchanged
 
@@ -693,12 +837,116 @@ void DavisonMonoSlam::PredictEstimVars(
         FixSymmetricMat(predicted_estim_vars_covar);
 }
 
+void DavisonMonoSlam::PredictEstimVarsCovarSqrt(const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& F,
+    const Eigen::Matrix<Scalar, kCamStateComps, kProcessNoiseComps>& G,
+    const Eigen::Matrix<Scalar, kProcessNoiseComps, kProcessNoiseComps>& process_noise_covar,
+    const EigenDynMat& src_estim_vars_covar_sqrt, EigenDynMat* predicted_estim_vars_covar_sqrt) const
+{
+    // the factor of P=F*P*Ft+G*Q*Gt is [F*Lcc 0 G*sqrt(Q); Lmc Lmm 0]; the orthogonal transformation of the columns
+    // of the camera and the process noise, which triangularizes [F*Lcc G*sqrt(Q)], is found by QR decomposition of its transpose
+    constexpr size_t kPreArrayCols = kCamStateComps + kProcessNoiseComps;
+    const EigenDynMat& L = src_estim_vars_covar_sqrt;
+    const Eigen::Index sal_pnts_vars_count = L.rows() - kCamStateComps;
+
+    // the process noise covariance is diagonal
+    Eigen::Matrix<Scalar, kCamStateComps, kProcessNoiseComps> G_Qsqrt = G * process_noise_covar.diagonal().cwiseSqrt().asDiagonal();
+
+    Eigen::Matrix<Scalar, kPreArrayCols, kCamStateComps> pre_array_t;
+    pre_array_t.topRows<kCamStateComps>() = (F * L.topLeftCorner<kCamStateComps, kCamStateComps>()).transpose();
+    pre_array_t.bottomRows<kProcessNoiseComps>() = G_Qsqrt.transpose();
+
+    Eigen::HouseholderQR<Eigen::Matrix<Scalar, kPreArrayCols, kCamStateComps>> qr(pre_array_t);
+    Eigen::Matrix<Scalar, kPreArrayCols, kPreArrayCols> Q = qr.householderQ();
+    Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps> R = qr.matrixQR().topRows<kCamStateComps>().triangularView<Eigen::Upper>();
+
+    // the diagonal of the factor is kept positive
+    Eigen::Matrix<Scalar, kCamStateComps, 1> signs;
+    for (size_t i = 0; i < kCamStateComps; ++i)
+        signs[i] = R(i, i) < 0 ? -1 : 1;
+
+    auto& Lnew = *predicted_estim_vars_covar_sqrt;
+    Lnew = L;
+    Lnew.topLeftCorner<kCamStateComps, kCamStateComps>() = R.transpose() * signs.asDiagonal();
+
+    // the rows of salient points are transformed too, [Lmc 0]*Q
+    Eigen::Matrix<Scalar, Eigen::Dynamic, kPreArrayCols> Lmc_Q = L.bottomLeftCorner(sal_pnts_vars_count, kCamStateComps) * Q.topRows<kCamStateComps>();
+    Lnew.bottomLeftCorner(sal_pnts_vars_count, kCamStateComps) = Lmc_Q.leftCols<kCamStateComps>() * signs.asDiagonal();
+
+    // the columns of the process noise are non-zero in the rows of salient points; they are folded into Lmm
+    for (size_t i = 0; i < kProcessNoiseComps; ++i)
+    {
+        EigenDynVec x = Lmc_Q.col(kCamStateComps + i);
+        CholeskyFactorRankOneUpdate(Lnew.bottomRightCorner(sal_pnts_vars_count, sal_pnts_vars_count), x);
+    }
+}
+
+bool DavisonMonoSlam::CovarSqrtForm() const
+{
+    return mono_slam_update_impl_ == 7 && !localization_only_;
+}
+
+void DavisonMonoSlam::SyncCovarSqrt(const EigenDynMat& src_estim_vars_covar, EigenDynMat* src_estim_vars_covar_sqrt) const
+{
+    if (src_estim_vars_covar_sqrt->rows() > 0 && src_estim_vars_covar_sqrt->rows() <= src_estim_vars_covar.rows())
+        CholeskyFactorExtend(src_estim_vars_covar, src_estim_vars_covar_sqrt);
+    else
+        CholeskyFactorPsd(src_estim_vars_covar, src_estim_vars_covar_sqrt);
+}
+
+void DavisonMonoSlam::SyncCovarMarginalsFromSqrt(const EigenDynMat& src_estim_vars_covar_sqrt, EigenDynMat* src_estim_vars_covar) const
+{
+    const EigenDynMat& L = src_estim_vars_covar_sqrt;
+    EigenDynMat& P = *src_estim_vars_covar;
+    SRK_ASSERT(L.rows() == P.rows());
+    const Eigen::Index sal_pnts_vars_count = L.rows() - kCamStateComps;
+
+    // Pc=Lcc*Lt, the camera is correlated with all variables
+    DependsOnOverallPackOrder();
+    P.topRows<kCamStateComps>().noalias() = L.topLeftCorner<kCamStateComps, kCamStateComps>() * L.leftCols<kCamStateComps>().transpose();
+    P.bottomLeftCorner(sal_pnts_vars_count, kCamStateComps) = P.topRightCorner(kCamStateComps, sal_pnts_vars_count).transpose();
+
+    // the blocks of the salient point and of its anchor, used to project the salient point
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
+    {
+        const TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+        ForEachSalientPointVarsSegment(sal_pnt, [&](size_t row_var_ind, size_t, size_t rows)
+        {
+            ForEachSalientPointVarsSegment(sal_pnt, [&](size_t col_var_ind, size_t, size_t cols)
+            {
+                P.block(row_var_ind, col_var_ind, rows, cols) = CovarBlockFromCholeskyFactor(L, row_var_ind, rows, col_var_ind, cols);
+            });
+        });
+    }
+}
+
+void DavisonMonoSlam::InvalidateCovarSqrt()
+{
+    if (covar_marginals_only_)
+    {
+        // the factor of the state, which was shrunk, is dropped as is
+        auto recover_covar = [this](EigenDynMat* src_estim_vars_covar_sqrt, EigenDynMat* src_estim_vars_covar)
+        {
+            if (src_estim_vars_covar_sqrt->rows() == 0 || src_estim_vars_covar_sqrt->rows() > src_estim_vars_covar->rows())
+                return;
+            SyncCovarSqrt(*src_estim_vars_covar, src_estim_vars_covar_sqrt);  // salient points may have been appended
+            const EigenDynMat& L = *src_estim_vars_covar_sqrt;
+            src_estim_vars_covar->noalias() = L.triangularView<Eigen::Lower>() * L.transpose();
+        };
+        recover_covar(&estim_vars_covar_sqrt_, &estim_vars_covar_);
+        recover_covar(&predicted_estim_vars_covar_sqrt_, &predicted_estim_vars_covar_);
+        covar_marginals_only_ = false;
+    }
+    estim_vars_covar_sqrt_.resize(0, 0);
+    predicted_estim_vars_covar_sqrt_.resize(0, 0);
+}
+
 void DavisonMonoSlam::RemoveSalientPointsState(gsl::span<size_t> sal_pnt_inds_to_delete_desc)
 {
-    size_t last_sal_pnt_ind = SalientPointsCount();
-    size_t last_sal_pnt_var_ind = SalientPointOffset(last_sal_pnt_ind);
+    if (sal_pnt_inds_to_delete_desc.empty())
+        return;
 
-    // Stage1: move estimated state to the end of array or to the right/bottom of error covariance matrix.
+    const size_t sal_pnts_count = SalientPointsCount();
+    std::vector<bool> remove_sal_pnt(sal_pnts_count, false);
     for (auto remove_sal_pnt_ind : sal_pnt_inds_to_delete_desc)
     {
         if (kSurikoDebug)
@@ -713,76 +961,117 @@ void DavisonMonoSlam::RemoveSalientPointsState(gsl::span<size_t> sal_pnt_inds_to
 #endif
             VLOG(4) << ss.str();
         }
+        remove_sal_pnt[remove_sal_pnt_ind] = true;
+    }
 
-        last_sal_pnt_ind--;
-        last_sal_pnt_var_ind -= kSalientPointComps;
-
-        // collect all salient points, which are marked for removing, in the back of corresponding array by
-        // swapping each removing salient point with the back salient point
-        // then all salient points in the back may be swept in one pass
-
-        auto remove_sal_pnt_id = GetSalientPointIdByOrderInEstimCovMat(remove_sal_pnt_ind);
-        auto last_sal_pnt_id = GetSalientPointIdByOrderInEstimCovMat(last_sal_pnt_ind);
-        TrackedSalientPoint& last_sal_pnt = GetSalientPoint(last_sal_pnt_id);
-
-        bool need_moving = remove_sal_pnt_ind != last_sal_pnt_ind;  // otherwise it is already in the end and ready to be truncated
-        if (need_moving)
+    // the anchor is removed together with the last of its salient points
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < sal_pnts_count; ++sal_pnt_ind)
+    {
+        TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+        if (remove_sal_pnt[sal_pnt_ind] && sal_pnt.anchor != nullptr)
         {
-            // process indices in the order from high to low
-            size_t remove_var_ind = SalientPointOffset(remove_sal_pnt_ind);
-
-            auto move_estim_vars_back = [](size_t rem_ind, size_t back_ind, EigenDynVec* src_estim_vars)
-            {
-                // move last salient point into the place of deleting salient point
-                src_estim_vars->middleRows<kSalientPointComps>(rem_ind) =
-                    src_estim_vars->middleRows<kSalientPointComps>(back_ind);
-            };
-            move_estim_vars_back(remove_var_ind, last_sal_pnt_var_ind, &estim_vars_);
-            move_estim_vars_back(remove_var_ind, last_sal_pnt_var_ind, &predicted_estim_vars_);
-
-            auto move_estim_vars_covar_back = [](size_t rem_ind, size_t back_ind, EigenDynMat* src_estim_vars_covar)
-            {
-                src_estim_vars_covar->middleRows<kSalientPointComps>(rem_ind) =
-                    src_estim_vars_covar->middleRows<kSalientPointComps>(back_ind);
-                src_estim_vars_covar->middleCols<kSalientPointComps>(rem_ind) =
-                    src_estim_vars_covar->middleCols<kSalientPointComps>(back_ind);
-            };
-            move_estim_vars_covar_back(remove_var_ind, last_sal_pnt_var_ind, &estim_vars_covar_);
-            move_estim_vars_covar_back(remove_var_ind, last_sal_pnt_var_ind, &predicted_estim_vars_covar_);
-
-            std::swap(sal_pnts_[remove_sal_pnt_ind], sal_pnts_[last_sal_pnt_ind]);
-
-            // maintain indices
-            SRK_ASSERT(last_sal_pnt.sal_pnt_ind == last_sal_pnt_ind);
-            last_sal_pnt.sal_pnt_ind = remove_sal_pnt_ind;
-
-            SRK_ASSERT(last_sal_pnt.estim_vars_ind == last_sal_pnt_var_ind);
-            last_sal_pnt.estim_vars_ind = remove_var_ind;
+            --sal_pnt.anchor->sal_pnts_count;
+            sal_pnt.anchor = nullptr;
         }
     }
 
-    // stage2: Actual resize of estimation state array and error covariance matrix.
+    // stage1: remove the variables from the estimation matrices
+    CompactEstimatedVars(remove_sal_pnt);
+
+    // stage2: move descriptors of removed salient points to the back, keeping the order of the remaining ones.
     // Salient points are only marked as deleted to allow the propagation of changes to other parts of the filter.
-    if (!sal_pnt_inds_to_delete_desc.empty())
+    SRK_ASSERT(sal_pnt_inds_to_delete_desc.size() <= estim_sal_pnts_count_);
+    std::stable_partition(sal_pnts_.begin(), sal_pnts_.begin() + sal_pnts_count,
+        [&remove_sal_pnt](const auto& p_sal_pnt) { return !remove_sal_pnt[p_sal_pnt->sal_pnt_ind]; });
+
+    estim_sal_pnts_count_ -= sal_pnt_inds_to_delete_desc.size();
+
+    for (size_t i = 0; i < estim_sal_pnts_count_; ++i)
+        sal_pnts_[i]->sal_pnt_ind = i;
+
+    for (size_t i = estim_sal_pnts_count_; i < sal_pnts_.size(); ++i)
     {
-        // mark salient points as deleted
-        SRK_ASSERT(sal_pnt_inds_to_delete_desc.size() <= estim_sal_pnts_count_);
+        sal_pnts_[i]->track_status = SalPntTrackStatus::Deleted;
+    }
 
-        estim_sal_pnts_count_ -= sal_pnt_inds_to_delete_desc.size();
+    if (kSurikoDebug) CheckSalientPointsConsistency();
+}
 
-        for (size_t i = estim_sal_pnts_count_; i < sal_pnts_.size(); ++i)
-        {
-            sal_pnts_[i]->track_status = SalPntTrackStatus::Deleted;
-        }
+void DavisonMonoSlam::CompactEstimatedVars(const std::vector<bool>& remove_sal_pnt)
+{
+    // Collect the indices of the estimated variables to keep: the camera, the remaining salient points and
+    // the anchors, which are referred by salient points. Salient points may have different number of variables,
+    // hence the remaining variables are shifted to the beginning of the estimation matrices, keeping their order.
+    struct EstimVarsBlock
+    {
+        size_t* estim_vars_ind;
+        size_t vars_count;
+    };
+    std::vector<EstimVarsBlock> blocks;
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
+    {
+        if (remove_sal_pnt[sal_pnt_ind]) continue;
+
+        TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+        blocks.push_back(EstimVarsBlock{ &sal_pnt.estim_vars_ind, sal_pnt.EstimVarsCount() });
+    }
+    for (auto& p_anchor : sal_pnt_anchors_)
+    {
+        if (p_anchor->sal_pnts_count > 0)
+            blocks.push_back(EstimVarsBlock{ &p_anchor->estim_vars_ind, kEucl3 });
+    }
+    std::sort(blocks.begin(), blocks.end(),
+        [](const auto& a, const auto& b) { return *a.estim_vars_ind < *b.estim_vars_ind; });
 
-        estim_vars_.conservativeResize(last_sal_pnt_var_ind);
-        predicted_estim_vars_.conservativeResize(last_sal_pnt_var_ind);
+    std::vector<size_t> keep_var_inds;
+    keep_var_inds.reserve(EstimatedVarsCount());
+    for (size_t i = 0; i < kCamStateComps; ++i)
+        keep_var_inds.push_back(i);
 
-        estim_vars_covar_.conservativeResize(last_sal_pnt_var_ind, last_sal_pnt_var_ind);
-        predicted_estim_vars_covar_.conservativeResize(last_sal_pnt_var_ind, last_sal_pnt_var_ind);
+    for (const EstimVarsBlock& block : blocks)
+    {
+        size_t new_var_ind = keep_var_inds.size();
+        for (size_t i = 0; i < block.vars_count; ++i)
+            keep_var_inds.push_back(*block.estim_vars_ind + i);
+        *block.estim_vars_ind = new_var_ind;
     }
 
-    if (kSurikoDebug) CheckSalientPointsConsistency();
+    sal_pnt_anchors_.erase(std::remove_if(sal_pnt_anchors_.begin(), sal_pnt_anchors_.end(),
+        [](const auto& p_anchor) { return p_anchor->sal_pnts_count == 0; }),
+        sal_pnt_anchors_.end());
+
+    // the destination index never exceeds the source index, hence the variables may be moved in place
+    auto move_estim_vars = [&keep_var_inds](EigenDynVec* src_estim_vars)
+    {
+        for (size_t i = 0; i < keep_var_inds.size(); ++i)
+            (*src_estim_vars)[i] = (*src_estim_vars)[keep_var_inds[i]];
+        src_estim_vars->conservativeResize(keep_var_inds.size());
+    };
+    move_estim_vars(&estim_vars_);
+    move_estim_vars(&predicted_estim_vars_);
+
+    auto move_estim_vars_covar = [&keep_var_inds](EigenDynMat* src_estim_vars_covar)
+    {
+        for (size_t i = 0; i < keep_var_inds.size(); ++i)
+            src_estim_vars_covar->row(i) = src_estim_vars_covar->row(keep_var_inds[i]);
+        for (size_t i = 0; i < keep_var_inds.size(); ++i)
+            src_estim_vars_covar->col(i) = src_estim_vars_covar->col(keep_var_inds[i]);
+        src_estim_vars_covar->conservativeResize(keep_var_inds.size(), keep_var_inds.size());
+    };
+    const Eigen::Index vars_count_before = estim_vars_covar_.rows();
+    move_estim_vars_covar(&estim_vars_covar_);
+    move_estim_vars_covar(&predicted_estim_vars_covar_);
+
+    // the factor of the covariance is compacted in O(n^2) per removed variable, the inconsistent factor is dropped
+    auto compact_estim_vars_covar_sqrt = [&keep_var_inds, vars_count_before](EigenDynMat* src_estim_vars_covar_sqrt)
+    {
+        if (src_estim_vars_covar_sqrt->rows() == vars_count_before)
+            CholeskyFactorKeepVars(keep_var_inds, src_estim_vars_covar_sqrt);
+        else
+            src_estim_vars_covar_sqrt->resize(0, 0);
+    };
+    compact_estim_vars_covar_sqrt(&estim_vars_covar_sqrt_);
+    compact_estim_vars_covar_sqrt(&predicted_estim_vars_covar_sqrt_);
 }
 
 void DavisonMonoSlam::RemoveMarkedDeletedSalientPointsDescriptors()
@@ -791,6 +1080,8 @@ void DavisonMonoSlam::RemoveMarkedDeletedSalientPointsDescriptors()
     for (size_t i = estim_sal_pnts_count_; i < sal_pnts_.size(); ++i)
     {
         SRK_ASSERT(sal_pnts_[i]->track_status == SalPntTrackStatus::Deleted);
+        if (corners_matcher_ != nullptr)
+            corners_matcher_->OnSalientPointIsRemoved(SalPntId(sal_pnts_[i].get()));
     }
 
     sal_pnts_.resize(estim_sal_pnts_count_);  // deletes descriptors
@@ -806,7 +1097,11 @@ void DavisonMonoSlam::RemoveLongTermUnobservedSalientPoints(std::vector<SalPntId
     for (auto& p_sal_pnt : sal_pnts_)
     {
         TrackedSalientPoint& sal_pnt = *p_sal_pnt;
-        if (sal_pnt.track_status == SalPntTrackStatus::Unobserved)
+        if (sal_pnt.measurement_deferred)
+        {
+            // the salient point wasn't searched for, hence it can't be blamed for being undetected
+        }
+        else if (sal_pnt.track_status == SalPntTrackStatus::Unobserved)
             ++sal_pnt.undetected_frames_count;
         else
             sal_pnt.undetected_frames_count = 0;  // reset counter
@@ -839,23 +1134,268 @@ void DavisonMonoSlam::RemoveLongTermUnobservedSalientPoints(std::vector<SalPntId
     RemoveSalientPointsState(sal_pnt_inds_to_delete);
 }
 
+void DavisonMonoSlam::UpdateSalientPointsTrackingHistory(size_t frame_ind)
+{
+    constexpr Scalar kRecentWeight = 0.2;  // weight of the latest sample in the running average
+
+    for (SalPntId sal_pnt_id : GetSalientPoints())
+    {
+        TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+        if (sal_pnt.measurement_deferred)
+            continue;  // the salient point wasn't searched for
+
+        ++sal_pnt.search_count;
+        if (sal_pnt.track_status != SalPntTrackStatus::Matched)
+            continue;
+
+        ++sal_pnt.match_count;
+        sal_pnt.last_seen_frame_ind = frame_ind;
+
+        // the innovation is compared to its covariance, predicted from the previous frame
+        std::optional<Scalar> nis = GetSalientPointPredictedNis(sal_pnt_id);
+        if (!nis.has_value()) continue;
+
+        sal_pnt.innov_consistency = (1 - kRecentWeight) * sal_pnt.innov_consistency + kRecentWeight * nis.value();
+    }
+}
+
+std::optional<Scalar> DavisonMonoSlam::GetSalientPointPredictedNis(SalPntId sal_pnt_id) const
+{
+    const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+    if (!sal_pnt.templ_center_pix_.has_value())
+        return std::nullopt;
+
+    auto [op, corner] = GetSalientPointProjected2DPosWithUncertainty(FilterStageType::Predicted, sal_pnt_id);
+    if (!op)
+        return std::nullopt;
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
+
+    Eigen::Matrix<Scalar, kPixPosComps, 1> innov = sal_pnt.templ_center_pix_.value().Mat() - corner.mean;
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var = corner.cov + Rk;
+    return innov.dot(innov_var.inverse() * innov) / kPixPosComps;
+}
+
+void DavisonMonoSlam::AdaptProcessNoiseScale(const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
+{
+    constexpr size_t kMinObsCount = 3;  // the scale is not changed when there are less observations
+    constexpr Scalar kShrinkWeight = 0.1f;  // the process noise is widened at once, but shrinks slowly
+
+    std::vector<Scalar> nis_list;
+    nis_list.reserve(latest_frame_sal_pnt_ids.size());
+    for (SalPntId sal_pnt_id : latest_frame_sal_pnt_ids)
+    {
+        std::optional<Scalar> nis = GetSalientPointPredictedNis(sal_pnt_id);
+        if (nis.has_value())
+            nis_list.push_back(nis.value());
+    }
+    if (nis_list.size() < kMinObsCount)
+        return;
+
+    // the median is robust to mismatches; for the consistent filter, 2*NIS is distributed as chi^2(2) with median=2*ln(2)
+    auto median_it = nis_list.begin() + nis_list.size() / 2;
+    std::nth_element(nis_list.begin(), median_it, nis_list.end());
+    Scalar nis_ratio = *median_it / std::log(Scalar{ 2 });
+
+    // the innovation variance grows with the process noise, hence the scale moves toward the one, matching the innovations
+    Scalar weight = nis_ratio > 1 ? 1 : kShrinkWeight;
+    Scalar new_scale = process_noise_scale_ * std::pow(nis_ratio, weight);
+    process_noise_scale_ = std::clamp(new_scale, process_noise_adaptive_min_scale_, Scalar{ 1 });
+    VLOG(4) << "process noise: median NIS=" << *median_it << " scale=" << process_noise_scale_;
+}
+
+void DavisonMonoSlam::GetSalientPointsScore(size_t frame_ind, std::vector<Scalar>* sal_pnt_scores) const
+{
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+
+    // the distance from the camera is scored relative to the median distance, so that the score doesn't depend on the scale of the scene
+    std::vector<std::optional<Scalar>> sal_pnt_dists(SalientPointsCount());
+    std::vector<Scalar> dists;
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
+    {
+        Point3 pos_mean;
+        bool op = GetSalientPoint3DPosWithUncertainty(estim_vars_, estim_vars_covar_, *sal_pnts_[sal_pnt_ind], false, &pos_mean, nullptr);
+        if (!op) continue;  // the salient point in infinity
+
+        Scalar dist = Norm(pos_mean - cam_state.pos_w);
+        sal_pnt_dists[sal_pnt_ind] = dist;
+        dists.push_back(dist);
+    }
+
+    Scalar median_dist = 0;
+    if (!dists.empty())
+    {
+        auto median_it = dists.begin() + dists.size() / 2;
+        std::nth_element(dists.begin(), median_it, dists.end());
+        median_dist = *median_it;
+    }
+
+    sal_pnt_scores->resize(SalientPointsCount());
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
+    {
+        const TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+
+        // the components are biased towards 1/2 for salient points, which were searched for in a few frames,
+        // so that a new salient point doesn't outrank the established ones
+        // (the innovation consistency starts from the neutral value and is biased by its running average)
+        Scalar prior_weight = sal_pnt_score_prior_frames_ / (sal_pnt.search_count + sal_pnt_score_prior_frames_);
+        auto with_prior = [prior_weight](Scalar x) { return (1 - prior_weight) * x + prior_weight * Scalar{ 0.5 }; };
+
+        Scalar match_ratio = (sal_pnt.match_count + sal_pnt_score_prior_frames_ / 2) / (sal_pnt.search_count + sal_pnt_score_prior_frames_);
+        Scalar recency = with_prior(1 / (1 + static_cast<Scalar>(frame_ind - sal_pnt.last_seen_frame_ind)));
+        Scalar innov_consistency = 1 / (1 + sal_pnt.innov_consistency);
+
+        Scalar closeness = 0;
+        if (sal_pnt_dists[sal_pnt_ind].has_value() && median_dist > 0)
+            closeness = 1 / (1 + sal_pnt_dists[sal_pnt_ind].value() / median_dist);
+        closeness = with_prior(closeness);
+
+        (*sal_pnt_scores)[sal_pnt_ind] =
+            sal_pnt_score_match_ratio_weight_ * match_ratio +
+            sal_pnt_score_recency_weight_ * recency +
+            sal_pnt_score_innov_consistency_weight_ * innov_consistency +
+            sal_pnt_score_distance_weight_ * closeness;
+    }
+}
+
+Scalar DavisonMonoSlam::GetNewSalientPointScore() const
+{
+    // each component of the score of a new salient point is 1/2
+    return (sal_pnt_score_match_ratio_weight_ + sal_pnt_score_recency_weight_ +
+        sal_pnt_score_innov_consistency_weight_ + sal_pnt_score_distance_weight_) / 2;
+}
+
+size_t DavisonMonoSlam::EvictLowScoreSalientPoints(size_t frame_ind)
+{
+    if (!sal_pnt_max_count_.has_value() || SalientPointsCount() < sal_pnt_max_count_.value())
+        return 0;
+
+    // the budget is exhausted, evict a batch of salient points to make room for new ones
+    size_t evict_count = std::min(SalientPointsCount(),
+        SalientPointsCount() - sal_pnt_max_count_.value() + sal_pnt_evict_batch_size_);
+    if (evict_count == 0)
+        return 0;
+
+    std::vector<Scalar> sal_pnt_scores;
+    GetSalientPointsScore(frame_ind, &sal_pnt_scores);
+
+    std::vector<size_t> sal_pnt_inds(SalientPointsCount());
+    std::iota(sal_pnt_inds.begin(), sal_pnt_inds.end(), 0);
+    std::sort(sal_pnt_inds.begin(), sal_pnt_inds.end(),
+        [&sal_pnt_scores](size_t a, size_t b) { return sal_pnt_scores[a] < sal_pnt_scores[b]; });
+
+    // the salient point is replaced only by a better one, the excess of the budget is evicted regardless of the score
+    const Scalar new_sal_pnt_score = GetNewSalientPointScore();
+    const size_t excess_count = SalientPointsCount() - std::min(SalientPointsCount(), sal_pnt_max_count_.value());
+    while (evict_count > excess_count && sal_pnt_scores[sal_pnt_inds[evict_count - 1]] >= new_sal_pnt_score)
+        --evict_count;
+    if (evict_count == 0)
+        return 0;
+    sal_pnt_inds.resize(evict_count);
+
+    std::sort(sal_pnt_inds.begin(), sal_pnt_inds.end(), [](auto x, auto y) { return x > y; });
+    RemoveSalientPointsState(sal_pnt_inds);
+    return evict_count;
+}
+
+size_t DavisonMonoSlam::SalientPointsBudgetRoom() const
+{
+    if (!sal_pnt_max_count_.has_value())
+        return std::numeric_limits<size_t>::max();
+    return sal_pnt_max_count_.value() - std::min(sal_pnt_max_count_.value(), SalientPointsCount());
+}
+
+/// Updates the running average of a duration, so that recent samples weight more.
+static void UpdateRunningAverage(std::chrono::duration<double> sample, std::optional<std::chrono::duration<double>>* avg)
+{
+    constexpr double kRecentWeight = 0.2;  // weight of the latest sample in the running average
+    *avg = avg->has_value()
+        ? (1 - kRecentWeight) * avg->value() + kRecentWeight * sample
+        : sample;
+}
+
 void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image)
 {
+    ProcessFrame(frame_ind, image, std::nullopt);
+}
+
+void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image, std::optional<std::chrono::duration<double>> time_budget,
+    std::optional<std::chrono::duration<double>> capture_time)
+{
+    using Clock = decltype(deadline_)::Clock;
+    const auto frame_start_time = Clock::now();
+
     if (stats_logger_ != nullptr) stats_logger_->StartNewFrameStats();
 
+    RepredictWithFrameInputs(capture_time);
+
+    deadline_.deadline = std::nullopt;
+    if (time_budget.has_value())
+        deadline_.deadline = frame_start_time + std::chrono::duration_cast<Clock::duration>(time_budget.value());
+
+    // the late previous frame makes the current one late too, hence reduce the matching work
+    deadline_.cap_search_rects = time_budget.has_value() && deadline_.prev_frame_missed_deadline &&
+        deadline_max_search_rect_size_.has_value();
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().deadline_capped_search_rects = deadline_.cap_search_rects;
+
     // initial status of a salient point is 'not observed'
     // later we will overwrite status for the matched salient points as 'matched'
     for (auto& p_sal_pnt : sal_pnts_)
     {
         TrackedSalientPoint& sal_pnt = *p_sal_pnt;
         sal_pnt.track_status = SalPntTrackStatus::Unobserved;
+        sal_pnt.measurement_deferred = false;
         sal_pnt.ResetTemplCenterPix();
     }
+    for (auto& p_candidate : sal_pnt_candidates_)
+    {
+        p_candidate->sal_pnt->track_status = SalPntTrackStatus::Unobserved;
+        p_candidate->sal_pnt->ResetTemplCenterPix();
+    }
+    for (auto& frozen_sal_pnt : frozen_sal_pnts_)
+    {
+        frozen_sal_pnt.sal_pnt->track_status = SalPntTrackStatus::Unobserved;
+        frozen_sal_pnt.sal_pnt->measurement_deferred = false;
+        frozen_sal_pnt.sal_pnt->ResetTemplCenterPix();
+    }
 
     corners_matcher_->AnalyzeFrame(frame_ind, image);
 
+    std::set<SalPntId> sal_pnt_ids_to_match = GetSalientPoints();
+    if (localization_only_)
+        SelectVisibleFrozenSalientPoints(&sal_pnt_ids_to_match);
+    SelectSalientPointsForActiveSearch(&sal_pnt_ids_to_match);
+
+    // candidates for new salient points are searched in each frame
+    for (const auto& p_candidate : sal_pnt_candidates_)
+        sal_pnt_ids_to_match.insert(SalPntId{ p_candidate->sal_pnt.get() });
+
+    const auto match_start_time = Clock::now();
+
     std::vector<std::pair<SalPntId, CornersMatcherBlobId>> matched_sal_pnts;
-    corners_matcher_->MatchSalientPoints(*this, GetSalientPoints(), frame_ind, image, &matched_sal_pnts);
+    corners_matcher_->MatchSalientPoints(*this, sal_pnt_ids_to_match, frame_ind, image, &matched_sal_pnts);
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().reused_matches = corners_matcher_->ReusedMatchesCount();
+
+    if (!sal_pnt_ids_to_match.empty())
+        UpdateRunningAverage((Clock::now() - match_start_time) / sal_pnt_ids_to_match.size(), &deadline_.match_dur_per_sal_pnt);
+
+    if (!sal_pnt_candidates_.empty())
+        ExtractMatchedSalientPointCandidates(&matched_sal_pnts);
+
+    // Detection of new salient points depends only on the image, hence it may overlap the update of the filter.
+    // The hand-off point is the recruitment of new salient points, which waits for the detection to finish.
+    std::future<void> detect_new_blobs;
+    if (detect_new_blobs_concurrently_ && !localization_only_)
+    {
+        detect_new_blobs = std::async(std::launch::async, [this, frame_ind, &image]()
+        {
+            corners_matcher_->DetectNewBlobCandidates(frame_ind, image);
+        });
+    }
 
     std::vector<std::pair<SalPntId, suriko::Point2f>> matched_sal_pnt_to_corner;
 
@@ -877,6 +1417,9 @@ void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image)
 
     RemoveLongTermUnobservedSalientPoints(nullptr);
 
+    if (sal_pnt_max_count_.has_value())
+        UpdateSalientPointsTrackingHistory(frame_ind);
+
     // construct the set of salient points, visible in the current frame
     std::vector<SalPntId> latest_frame_sal_pnt_ids;
     for (auto[sal_pnt_id, blob_id] : matched_sal_pnts)
@@ -886,22 +1429,45 @@ void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image)
             latest_frame_sal_pnt_ids.push_back(sal_pnt_id);
     }
 
-    std::unique_lock<std::shared_mutex> lk(predicted_estim_vars_mutex_, std::defer_lock);
-    if (in_multi_threaded_mode_)
-        lk.lock();
+    // the innovations are compared to the prediction, hence before the update
+    if (process_noise_adaptive_)
+        AdaptProcessNoiseScale(latest_frame_sal_pnt_ids);
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().process_noise_scale = process_noise_scale_;
+
+    if (deadline_.deadline.has_value())
+        LimitFusedObservationsToMeetDeadline(&latest_frame_sal_pnt_ids, &matched_sal_pnt_to_corner);
+
+    int update_impl = mono_slam_update_impl_;
+    if (update_impl == -1)
+        update_impl = ChooseUpdateImpl(latest_frame_sal_pnt_ids.size(), EstimatedVarsCount(), update_block_sal_pnts_);
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().update_impl = update_impl;
+
+    const size_t fused_obs_count = update_impl == 4 ? matched_sal_pnt_to_corner.size() : latest_frame_sal_pnt_ids.size();
+    const auto update_start_time = Clock::now();
+
+    // only the square-root update maintains the factors of covariance matrices
+    if (!CovarSqrtForm())
+        InvalidateCovarSqrt();
 
     if (latest_frame_sal_pnt_ids.empty())
     {
         // we have no observations => current state <- prediction
         std::swap(estim_vars_, predicted_estim_vars_);
         std::swap(estim_vars_covar_, predicted_estim_vars_covar_);
+        std::swap(estim_vars_covar_sqrt_, predicted_estim_vars_covar_sqrt_);
     }
+    else if (localization_only_)
+        ProcessFrame_FrozenMapUpdate(frame_ind, latest_frame_sal_pnt_ids);
     else
-        switch (mono_slam_update_impl_)
+        switch (update_impl)
         {
         default:
         case 1:
-            ProcessFrame_StackedObservationsPerUpdate(frame_ind, latest_frame_sal_pnt_ids);
+        case 5:
+        case 6:
+            ProcessFrame_StackedObservationsPerUpdate(frame_ind, latest_frame_sal_pnt_ids, update_impl);
             break;
         case 2:
             ProcessFrame_OneObservationPerUpdate(frame_ind, latest_frame_sal_pnt_ids);
@@ -912,27 +1478,64 @@ void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image)
         case 4:
             ProcessFrame_OnePointRansacUpdate(frame_ind, matched_sal_pnt_to_corner);
             break;
+        case 7:
+            ProcessFrame_SquareRootUpdate(frame_ind, latest_frame_sal_pnt_ids);
+            break;
         }
 
     OnEstimVarsChanged(frame_ind);
 
+    if (fused_obs_count > 0)
+        UpdateRunningAverage((Clock::now() - update_start_time) / fused_obs_count, &deadline_.update_dur_per_obs);
+
     latest_frame_sal_pnt_ids.clear();  // recognize that processing routines may have invalidated the list
 
+    SwitchSalientPointsToXyzRepresentation();
+
     SetNonObservedSalientPointCorner(estim_vars_);
 
-    size_t new_blobs_size = RecruitNewSalientPoints(frame_ind, image, matched_sal_pnts);
+    size_t evicted_sal_pnts_count = EvictLowScoreSalientPoints(frame_ind);
+
+    UpdateSalientPointCandidates(frame_ind);
+    size_t promoted_candidates_count = PromoteSalientPointCandidates(frame_ind);
+
+    // search for new salient points is skipped when there is no time left, except when there are no salient points at all;
+    // the frozen map is never extended
+    bool skip_recruitment = localization_only_ || (SalientPointsCount() > 0 &&
+        IsDeadlineClose(deadline_.predict_dur.value_or(std::chrono::duration<double>::zero())));
+
+    if (detect_new_blobs.valid())
+        detect_new_blobs.get();  // rethrows the exception of detection, if any
+    else if (!skip_recruitment)
+        corners_matcher_->DetectNewBlobCandidates(frame_ind, image);
+
+    size_t new_blobs_size = promoted_candidates_count;
+    if (!skip_recruitment)
+        new_blobs_size += RecruitNewSalientPoints(frame_ind, image, matched_sal_pnts);
 
     if (stats_logger_ != nullptr)
     {
-        stats_logger_->NotifyNewComDelSalPnts(new_blobs_size, matched_sal_pnts.size(), 0);
+        stats_logger_->NotifyNewComDelSalPnts(new_blobs_size, matched_sal_pnts.size(), evicted_sal_pnts_count);
         stats_logger_->NotifyEstimatedSalPnts(SalientPointsCount());
+        stats_logger_->CurStats().deadline_skipped_recruitment = skip_recruitment;
+        stats_logger_->CurStats().sal_pnt_candidates = sal_pnt_candidates_.size();
+        stats_logger_->CurStats().sal_pnt_candidates_promoted = promoted_candidates_count;
+        stats_logger_->CurStats().sal_pnts_evicted = evicted_sal_pnts_count;
     }
 
+    // the capture time of the next frame is unknown yet, hence one frame period is assumed
+    frame_timing_.frame_ind = frame_ind;
+    frame_timing_.capture_time = capture_time;
+    frame_timing_.dropped_frames_count = 0;
+    frame_timing_.dT = std::nullopt;
+    frame_timing_.imu = std::nullopt;
+
+    const auto predict_start_time = Clock::now();
+
     PredictStateAndCovariance();
     EnsureNonnegativeStateVariance(&predicted_estim_vars_covar_);
 
-    if (in_multi_threaded_mode_)
-        lk.unlock();
+    UpdateRunningAverage(Clock::now() - predict_start_time, &deadline_.predict_dur);
 
     static bool debug_predicted_vars = false;
     if (debug_predicted_vars || DebugPath(DebugPathEnum::DebugPredictedVarsCov))
@@ -944,15 +1547,291 @@ void DavisonMonoSlam::ProcessFrame(size_t frame_ind, const Picture& image)
 
     RemoveMarkedDeletedSalientPointsDescriptors();
 
-    FinishFrameStats(frame_ind);
-}
+    if (publish_state_)
+        PublishState(frame_ind);
+
+    if (deadline_.deadline.has_value())
+    {
+        deadline_.prev_frame_missed_deadline = Clock::now() > deadline_.deadline.value();
+        if (stats_logger_ != nullptr)
+            stats_logger_->CurStats().deadline_missed = deadline_.prev_frame_missed_deadline;
+
+        // the time budget is the frame period, the lag accumulates over the late frames and is reduced by the early ones
+        std::chrono::duration<double> frame_dur = Clock::now() - frame_start_time;
+        deadline_.lag = std::max(std::chrono::duration<double>::zero(), deadline_.lag + frame_dur - time_budget.value());
+        deadline_.frame_period = time_budget;
+    }
+
+    FinishFrameStats(frame_ind);
+}
+
+void DavisonMonoSlam::DropFrame(size_t frame_ind)
+{
+    // the camera is predicted from the latest processed frame
+    if (!frame_timing_.frame_ind.has_value())
+        return;
+    SRK_ASSERT(frame_ind > frame_timing_.frame_ind.value());
+
+    frame_timing_.dropped_frames_count += 1;
+
+    // the dropped frame takes no time to process
+    if (deadline_.frame_period.has_value())
+        deadline_.lag = std::max(std::chrono::duration<double>::zero(), deadline_.lag - deadline_.frame_period.value());
+}
+
+bool DavisonMonoSlam::IsFrameDropAdvised() const
+{
+    return deadline_.frame_period.has_value() && deadline_.lag >= deadline_.frame_period.value();
+}
+
+void DavisonMonoSlam::SetImuSample(const ImuSample& imu_sample)
+{
+    frame_timing_.imu = imu_sample;
+}
+
+Scalar DavisonMonoSlam::PredictionInterval() const
+{
+    return frame_timing_.dT.value_or(seconds_per_frame_);
+}
+
+std::optional<Point3> DavisonMonoSlam::ImuAngularVelocity() const
+{
+    if (!frame_timing_.imu.has_value())
+        return std::nullopt;
+    return frame_timing_.imu.value().angular_velocity_c;
+}
+
+bool DavisonMonoSlam::ImuAccelerationAvailable() const
+{
+    // the acceleration is integrated into the velocity, which the constant position model doesn't have
+    if constexpr (!kCamStateHasVelocity)
+        return false;
+    return frame_timing_.imu.has_value() && frame_timing_.imu.value().specific_force_c.has_value() && imu_gravity_w_.has_value();
+}
+
+std::optional<Point3> DavisonMonoSlam::ImuAcceleration(const Point3& cam_orient_err) const
+{
+    if (!ImuAccelerationAvailable())
+        return std::nullopt;
+
+    // a=R*f+g
+    Eigen::Matrix<Scalar, kQuat4, 1> err_quat;
+    QuatFromAxisAngle(cam_orient_err, &err_quat);
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc = RotMat(cam_orient_wfc_nominal_) * RotMat(err_quat);
+    return Point3{ cam_orient_wfc * frame_timing_.imu.value().specific_force_c.value() + imu_gravity_w_.value() };
+}
+
+void DavisonMonoSlam::RepredictWithFrameInputs(std::optional<std::chrono::duration<double>> capture_time)
+{
+    // the first frame is processed from the initial state of the camera
+    if (!frame_timing_.frame_ind.has_value())
+        return;
+
+    // all intervals, elapsed since the previous processed frame, are folded into one prediction
+    Scalar elapsed_sec = seconds_per_frame_ * (1 + frame_timing_.dropped_frames_count);
+    if (capture_time.has_value() && frame_timing_.capture_time.has_value())
+    {
+        auto elapsed = capture_time.value() - frame_timing_.capture_time.value();
+        if (elapsed.count() > 0)
+            elapsed_sec = static_cast<Scalar>(elapsed.count());
+        else
+            VLOG(4) << "capture time is not increasing, assuming " << elapsed_sec << "s elapsed since previous frame";
+    }
+
+    bool imu_aided = frame_timing_.imu.has_value();
+    if (stats_logger_ != nullptr)
+    {
+        stats_logger_->CurStats().dropped_frames = frame_timing_.dropped_frames_count;
+        stats_logger_->CurStats().predicted_interval = elapsed_sec;
+        stats_logger_->CurStats().imu_aided_prediction = imu_aided;
+    }
+
+    static constexpr Scalar kRelTol = 1e-3f;
+    if (std::abs(elapsed_sec - seconds_per_frame_) <= kRelTol * seconds_per_frame_ && !imu_aided)
+        return;
+
+    // the predicted state, assuming one frame period without inertial measurements, is replaced
+    frame_timing_.dT = elapsed_sec;
+    PredictStateAndCovariance();
+    EnsureNonnegativeStateVariance(&predicted_estim_vars_covar_);
+}
+
+std::optional<suriko::Sizei> DavisonMonoSlam::SearchRectMaxSize() const
+{
+    if (deadline_.cap_search_rects)
+        return deadline_max_search_rect_size_;
+    return std::nullopt;
+}
+
+bool DavisonMonoSlam::IsDeadlineClose(std::chrono::duration<double> reserve) const
+{
+    if (!deadline_.deadline.has_value())
+        return false;
+    using Clock = decltype(deadline_)::Clock;
+    return Clock::now() + std::chrono::duration_cast<Clock::duration>(reserve) >= deadline_.deadline.value();
+}
+
+void DavisonMonoSlam::SortSalientPointsByExpectedInformation(std::vector<SalPntId>* sal_pnt_ids, bool per_matching_cost,
+    std::vector<SalPntId>* unprojected_sal_pnt_ids) const
+{
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
+    const Scalar Rk_det = Rk.determinant();
+
+    // chi^2 with 2 degrees of freedom for the confidence of a search ellipse
+    const Scalar search_chi_square = -2 * std::log(1 - covar2D_to_ellipse_confidence_);
+
+    // The mutual information between the state and a measurement of salient point is I=0.5*ln(det(S)/det(R)),
+    // where S=H*P*Ht+R is the innovation variance; the larger the predicted uncertainty of a projection, the more
+    // information we get from measuring it.
+    std::vector<std::pair<Scalar, SalPntId>> info_and_ids;
+    info_and_ids.reserve(sal_pnt_ids->size());
+    for (SalPntId sal_pnt_id : *sal_pnt_ids)
+    {
+        Scalar info = 0;
+        auto [op, corner] = GetSalientPointProjected2DPosWithUncertainty(FilterStageType::Predicted, sal_pnt_id);
+        static_assert(std::is_same_v<decltype(corner), MeanAndCov2D>);
+        if (!op && unprojected_sal_pnt_ids != nullptr)
+        {
+            unprojected_sal_pnt_ids->push_back(sal_pnt_id);
+            continue;
+        }
+        if (op)
+        {
+            Scalar innov_var_det = (corner.cov + Rk).determinant();
+            if (innov_var_det > 0 && Rk_det > 0)
+                info = std::log(innov_var_det / Rk_det) / 2;
+
+            if (per_matching_cost)
+            {
+                // the template is matched in each pixel of the search ellipse with area=pi*chi^2*sqrt(det(S))
+                Scalar search_area_pix = Pi<Scalar>() * search_chi_square * std::sqrt(std::max<Scalar>(0, innov_var_det));
+                info /= std::max<Scalar>(1, search_area_pix);
+            }
+        }
+        info_and_ids.push_back(std::make_pair(info, sal_pnt_id));
+    }
+
+    // stable sort keeps the order of matching for equally informative salient points
+    std::stable_sort(info_and_ids.begin(), info_and_ids.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    sal_pnt_ids->resize(info_and_ids.size());
+    for (size_t i = 0; i < info_and_ids.size(); ++i)
+        (*sal_pnt_ids)[i] = info_and_ids[i].second;
+}
+
+void DavisonMonoSlam::SelectSalientPointsForActiveSearch(std::set<SalPntId>* sal_pnt_ids_to_match)
+{
+    std::optional<size_t> max_count = active_search_max_sal_pnts_;
+
+    if (active_search_by_time_budget_ && deadline_.deadline.has_value() &&
+        deadline_.match_dur_per_sal_pnt.has_value() && deadline_.update_dur_per_obs.has_value())
+    {
+        // each selected salient point is matched and then fused
+        using Clock = decltype(deadline_)::Clock;
+        std::chrono::duration<double> remaining = deadline_.deadline.value() - Clock::now();
+        remaining -= deadline_.predict_dur.value_or(std::chrono::duration<double>::zero());
+
+        double max_count_by_time = std::max(0.0, remaining / (deadline_.match_dur_per_sal_pnt.value() + deadline_.update_dur_per_obs.value()));
+        size_t count_by_time = std::max(deadline_min_fused_obs_count_, static_cast<size_t>(max_count_by_time));
+        max_count = std::min(max_count.value_or(count_by_time), count_by_time);
+    }
+
+    if (!max_count.has_value() || sal_pnt_ids_to_match->size() <= max_count.value())
+        return;
+
+    std::vector<SalPntId> ranked_ids{ sal_pnt_ids_to_match->begin(), sal_pnt_ids_to_match->end() };
+    std::vector<SalPntId> unprojected_ids;
+    SortSalientPointsByExpectedInformation(&ranked_ids, true, &unprojected_ids);
+
+    // the salient point, which can't be projected, can't be searched for either; it is not deferred but stays unobserved,
+    // so that it ages and is eventually removed
+    for (SalPntId sal_pnt_id : unprojected_ids)
+        sal_pnt_ids_to_match->erase(sal_pnt_id);
+    if (ranked_ids.size() <= max_count.value())
+        return;
+
+    for (size_t i = max_count.value(); i < ranked_ids.size(); ++i)
+    {
+        SalPntId sal_pnt_id = ranked_ids[i];
+        GetSalientPoint(sal_pnt_id).measurement_deferred = true;
+        sal_pnt_ids_to_match->erase(sal_pnt_id);
+    }
+
+    size_t deferred_count = ranked_ids.size() - max_count.value();
+    VLOG(4) << "active search: matching " << max_count.value() << " salient points, deferred " << deferred_count;
+
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().active_search_deferred_sal_pnts = deferred_count;
+}
+
+void DavisonMonoSlam::LimitFusedObservationsToMeetDeadline(std::vector<SalPntId>* latest_frame_sal_pnt_ids,
+    std::vector<std::pair<SalPntId, suriko::Point2f>>* matched_sal_pnt_to_corner)
+{
+    // the cost of fusion is unknown until the first update
+    if (!deadline_.update_dur_per_obs.has_value())
+        return;
+
+    using Clock = decltype(deadline_)::Clock;
+    std::chrono::duration<double> remaining = deadline_.deadline.value() - Clock::now();
+    remaining -= deadline_.predict_dur.value_or(std::chrono::duration<double>::zero());
+
+    double max_obs_by_time = std::max(0.0, remaining / deadline_.update_dur_per_obs.value());
+    size_t max_obs_count = std::max(deadline_min_fused_obs_count_, static_cast<size_t>(max_obs_by_time));
+    if (latest_frame_sal_pnt_ids->size() <= max_obs_count)
+        return;
+
+    size_t dropped_count = latest_frame_sal_pnt_ids->size() - max_obs_count;
+    VLOG(4) << "deadline: fusing " << max_obs_count << " most informative observations, dropped " << dropped_count;
+
+    SortSalientPointsByExpectedInformation(latest_frame_sal_pnt_ids);
+    latest_frame_sal_pnt_ids->resize(max_obs_count);
+
+    // keep the matched corners of the same salient points (used by 1-point RANSAC)
+    std::set<SalPntId> fused_ids{ latest_frame_sal_pnt_ids->begin(), latest_frame_sal_pnt_ids->end() };
+    auto new_end = std::remove_if(matched_sal_pnt_to_corner->begin(), matched_sal_pnt_to_corner->end(),
+        [&fused_ids](const auto& p) { return fused_ids.find(p.first) == fused_ids.end(); });
+    matched_sal_pnt_to_corner->erase(new_end, matched_sal_pnt_to_corner->end());
+
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().deadline_dropped_obs = dropped_count;
+}
 
 /// Only portion of the salient points is observed in each frame. Thus index of a salient point in the estimated variables vector is different from 
 /// ordering of observed salient points (sal_pnt_ind != obs_sal_pnt_ind)
 /// Ordering of observed salient points may be arbitrary.
 void MarkOrderingOfObservedSalientPoints() {}
 
-void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
+int DavisonMonoSlam::ChooseUpdateImpl(size_t obs_sal_pnt_count, size_t estim_vars_count, size_t update_block_sal_pnts)
+{
+    // Choose the form with the least number of flops (leading terms only).
+    // r=2m is the number of rows in stacked observations, n is the number of estimated variables.
+    //
+    // The information form in state space (5) is not considered. It inverts two [n,n] matrices (~2n^3), which is cheaper
+    // than the measurement space (~2rn^2) only when r>n. But each observed salient point has 2 rows in H and at least
+    // 3 estimated variables, so r<n always holds.
+    // The per-observation updates (2, 3) relinearize the state after each observation, hence they are not equivalent.
+    const double r = static_cast<double>(obs_sal_pnt_count * kPixPosComps);
+    const double n = static_cast<double>(estim_vars_count);
+
+    // 1. H*P and K*S*Kt ~ 2rn^2, H*P*Ht and K=(H*P)t*inv(S) ~ 3r^2n, inv(S) ~ r^3
+    auto measurement_space_cost = [n](double rows) { return 2 * rows * n * n + 3 * rows * rows * n + rows * rows * rows; };
+    const double cost1 = measurement_space_cost(r);
+
+    // 6. each block is processed in measurement space; the update of P[n,n] by a block is bandwidth bound, hence a few
+    // passes over P are charged per block
+    const double block_rows = std::min(r, static_cast<double>(std::max<size_t>(1, update_block_sal_pnts) * kPixPosComps));
+    const double blocks_count = block_rows > 0 ? std::ceil(r / block_rows) : 0;
+    const double cost6 = blocks_count * (measurement_space_cost(block_rows) + 4 * n * n);
+
+    int impl = cost6 < cost1 ? 6 : 1;
+    VLOG(4) << "update impl=" << impl << " m=" << obs_sal_pnt_count << " n=" << n
+        << " cost1=" << cost1 << " cost6=" << cost6;
+    return impl;
+}
+
+void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids,
+    int update_impl)
 {
     SRK_ASSERT(!latest_frame_sal_pnt_ids.empty());
 
@@ -971,11 +1850,18 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdate(size_t frame_ind
         //predicted_estim_vars_covar_ = estim_vars_covar_;
     }
 
-    ProcessFrame_StackedObservationsPerUpdateCore(frame_ind, latest_frame_sal_pnt_ids, &estim_vars_, &estim_vars_covar_);
+    if (update_impl == 6)
+    {
+        ProcessFrame_BlockedObservationsPerUpdateCore(frame_ind, latest_frame_sal_pnt_ids, &estim_vars_, &estim_vars_covar_);
+        return;
+    }
+
+    bool state_space_form = update_impl == 5;
+    ProcessFrame_StackedObservationsPerUpdateCore(frame_ind, latest_frame_sal_pnt_ids, &estim_vars_, &estim_vars_covar_, state_space_form);
 }
 
 void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids,
-    EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar)
+    EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar, bool state_space_form)
 {
     const auto& derive_at_pnt = *src_estim_vars;
     const auto& Pprev = *src_estim_vars_covar;
@@ -989,7 +1875,7 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
     auto& cache = stacked_update_cache_;
 
     //
-    //EigenDynMat Hk; // [2m,13+6n]
+    //EigenDynMat Hk; // [2m,12+6n]
     auto& Hk = cache.H;
     Deriv_H_by_estim_vars(cam_state, cam_orient_wfc, derive_at_pnt, latest_frame_sal_pnt_ids, &Hk);
 
@@ -999,34 +1885,71 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
     size_t obs_sal_pnt_count = latest_frame_sal_pnt_ids.size();
     FillRk(obs_sal_pnt_count, &Rk);
 
-    // innovation variance S=H*P*Ht
-    //auto innov_var = Hk * Pprev * Hk.transpose() + Rk; // [2m,2m]
-    cache.H_P.noalias() = Hk * Pprev;
+    auto& Knew = cache.Knew;
     auto& innov_var = cache.innov_var;
-    innov_var.noalias() = cache.H_P * Hk.transpose(); // [2m,2m]
-    innov_var.noalias() += Rk;
 
-    if (stats_logger_ != nullptr)
+    if (state_space_form)
     {
-        auto diag = innov_var.diagonal().array().eval();
-        stats_logger_->CurStats().meas_residual_std = diag.sqrt();
+        // information form (Woodbury identity): Pnew=inv(inv(P)+Ht*inv(R)*H), K=Pnew*Ht*inv(R)
+        // the [2m,2m] innovation matrix is not inverted, instead the [12+6n,12+6n] matrices are inverted
+        state_space_form = false;
+        const size_t n = EstimatedVarsCount();
+        Eigen::LLT<EigenDynMat> llt_of_P(Pprev);
+        if (llt_of_P.info() == Eigen::Success)
+        {
+            cache.P_inv.noalias() = llt_of_P.solve(EigenDynMat::Identity(n, n));
+
+            EigenDynVec R_inv_diag = Rk.diagonal().cwiseInverse();  // R is diagonal
+            cache.info_mat = cache.P_inv;
+            cache.info_mat.noalias() += Hk.transpose() * R_inv_diag.asDiagonal() * Hk;
+
+            Eigen::LLT<EigenDynMat> llt_of_info_mat(cache.info_mat);
+            if (llt_of_info_mat.info() == Eigen::Success)
+            {
+                cache.estim_vars_covar_new.noalias() = llt_of_info_mat.solve(EigenDynMat::Identity(n, n));
+                Knew.noalias() = cache.estim_vars_covar_new * Hk.transpose() * R_inv_diag.asDiagonal(); // [12+6n,2m]
+                state_space_form = true;
+            }
+        }
+        if (!state_space_form)
+            VLOG(4) << "state space update requires positive definite covariance, fallback to measurement space";
+        else if (stats_logger_ != nullptr)
+        {
+            // diagonal of innovation variance S=H*P*Ht+R
+            EigenDynVec innov_var_diag = (Hk * Pprev).cwiseProduct(Hk).rowwise().sum() + Rk.diagonal();
+            stats_logger_->CurStats().meas_residual_std = innov_var_diag.array().sqrt();
+        }
     }
 
-    //EigenDynMat innov_var_inv = innov_var.inverse();
-    auto& innov_var_inv = cache.innov_var_inv;
-    static int innov_var_inv_impl = 1;
-    if (innov_var_inv_impl == 1)
-        innov_var_inv.noalias() = innov_var.inverse();
-    else if (innov_var_inv_impl == 2)
+    if (!state_space_form)
     {
-        Eigen::FullPivLU<EigenDynMat> llt_of_innov_var(innov_var);
-        innov_var_inv.noalias() = llt_of_innov_var.inverse();
-    }
+        // innovation variance S=H*P*Ht
+        //auto innov_var = Hk * Pprev * Hk.transpose() + Rk; // [2m,2m]
+        cache.H_P.noalias() = Hk * Pprev;
+        innov_var.noalias() = cache.H_P * Hk.transpose(); // [2m,2m]
+        innov_var.noalias() += Rk;
 
-    // K=P*Ht*inv(S)
-    //EigenDynMat Knew = Pprev * Hk.transpose() * innov_var_inv; // [13+6n,2m]
-    auto& Knew = cache.Knew;
-    Knew.noalias() = cache.H_P.transpose() * innov_var_inv; // [13+6n,2m]
+        if (stats_logger_ != nullptr)
+        {
+            auto diag = innov_var.diagonal().array().eval();
+            stats_logger_->CurStats().meas_residual_std = diag.sqrt();
+        }
+
+        //EigenDynMat innov_var_inv = innov_var.inverse();
+        auto& innov_var_inv = cache.innov_var_inv;
+        static int innov_var_inv_impl = 1;
+        if (innov_var_inv_impl == 1)
+            innov_var_inv.noalias() = innov_var.inverse();
+        else if (innov_var_inv_impl == 2)
+        {
+            Eigen::FullPivLU<EigenDynMat> llt_of_innov_var(innov_var);
+            innov_var_inv.noalias() = llt_of_innov_var.inverse();
+        }
+
+        // K=P*Ht*inv(S)
+        //EigenDynMat Knew = Pprev * Hk.transpose() * innov_var_inv; // [12+6n,2m]
+        Knew.noalias() = cache.H_P.transpose() * innov_var_inv; // [12+6n,2m]
+    }
 
     //
     //Eigen::Matrix<Scalar, Eigen::Dynamic, 1> zk;
@@ -1051,8 +1974,7 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
 
         // project salient point into current camera
 
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(Span(derive_at_pnt).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
         projected_sal_pnts.middleRows<kPixPosComps>(obs_sal_pnt_ind * kPixPosComps) = hd;
@@ -1069,11 +1991,11 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
     if (kSurikoDebug)
     {
         EigenDynVec estim_vars_delta = Knew * (zk - projected_sal_pnts);
-        Eigen::Map<Eigen::Matrix<Scalar, kQuat4, 1>> cam_quat(estim_vars_delta.data() + kEucl3);
-        Scalar cam_quat_len = cam_quat.norm();
-        bool change = cam_quat_len > 0.1;
+        Eigen::Map<Eigen::Matrix<Scalar, kOrientErrComps, 1>> cam_orient_err(estim_vars_delta.data() + kEucl3);
+        Scalar cam_orient_err_len = cam_orient_err.norm();
+        bool change = cam_orient_err_len > 0.1;
         if (change)
-            VLOG(5) << "estim_vars cam_q_len=" << cam_quat_len;
+            VLOG(5) << "estim_vars cam_orient_err_len=" << cam_orient_err_len;
 
         src_estim_vars->noalias() += estim_vars_delta;
     }
@@ -1089,7 +2011,13 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
     //estim_vars_covar_.noalias() = Pprev - Knew * innov_var * Knew.transpose(); // way2, 10% faster than way1
 
     static int upd_cov_mat_impl = 2;
-    if (upd_cov_mat_impl == 1)
+    if (state_space_form)
+    {
+        // Pnew is already computed; the inverse, found by Cholesky solver, is not exactly symmetric
+        src_estim_vars_covar->swap(cache.estim_vars_covar_new);
+        FixSymmetricMat(src_estim_vars_covar);
+    }
+    else if (upd_cov_mat_impl == 1)
     {
         // way1, impl of Pnew=(I-K*H)Pold=Pold-K*H*Pold
         size_t n = EstimatedVarsCount();
@@ -1114,9 +2042,6 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
         src_estim_vars_covar->noalias() -= cache.K_S * Knew.transpose();
     }
 
-    // 'update' step may result into quaternion of camera's orientation being non-unity
-    NormalizeCameraOrientationQuaternionAndCovariances(src_estim_vars, src_estim_vars_covar);
-
     if (fix_estim_vars_covar_symmetry_)
         FixSymmetricMat(src_estim_vars_covar);
 
@@ -1150,108 +2075,322 @@ void DavisonMonoSlam::ProcessFrame_StackedObservationsPerUpdateCore(size_t frame
     }
 }
 
-void DavisonMonoSlam::ProcessFrame_OneObservationPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
+void DavisonMonoSlam::ProcessFrame_BlockedObservationsPerUpdateCore(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids,
+    EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar)
 {
-    SRK_ASSERT(!latest_frame_sal_pnt_ids.empty());
-    // improve predicted estimation with the info from observations
-    std::swap(estim_vars_, predicted_estim_vars_);
-    std::swap(estim_vars_covar_, predicted_estim_vars_covar_);
-    
-    if (kSurikoDebug)
-    {
-        //predicted_estim_vars_.setConstant(kNan);
-        //predicted_estim_vars_covar_.setConstant(kNan);
-        // TODO: fix me; initialize predicted, because UI reads it without sync!
-        predicted_estim_vars_ = estim_vars_;
-        predicted_estim_vars_covar_ = estim_vars_covar_;
-    }
+    auto& cache = stacked_update_cache_;
 
-    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
-    FillRk2x2(&Rk);
+    // all blocks are linearized at the prior estimate x0, thus the blocked update is algebraically equivalent to the stacked one
+    // (the noise of observations is uncorrelated): the block b is fused as z[b]-h[b](x0)-H[b]*(x-x0), x is the current estimate
+    cache.estim_vars_lin_pnt = *src_estim_vars;
+    const EigenDynVec& derive_at_pnt = cache.estim_vars_lin_pnt;
 
-    Scalar diff_vars_total = 0;
-    Scalar diff_cov_total = 0;
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(derive_at_pnt, kCamStateComps), &cam_state);
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
+    RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+
+    auto& Hk = cache.H;
+    Deriv_H_by_estim_vars(cam_state, cam_orient_wfc, derive_at_pnt, latest_frame_sal_pnt_ids, &Hk);
+
+    const size_t obs_sal_pnt_count = latest_frame_sal_pnt_ids.size();
+    auto& zk = cache.zk;
+    zk.resize(obs_sal_pnt_count * kPixPosComps, 1);
+    auto& projected_sal_pnts = cache.projected_sal_pnts;
+    projected_sal_pnts.resizeLike(zk);
+
+    size_t obs_sal_pnt_ind = -1;
     for (SalPntId obs_sal_pnt_id : latest_frame_sal_pnt_ids)
     {
+        MarkOrderingOfObservedSalientPoints();
+        ++obs_sal_pnt_ind;
+
         const TrackedSalientPoint& sal_pnt = GetSalientPoint(obs_sal_pnt_id);
+        SRK_ASSERT(sal_pnt.IsDetected());
 
-        // the point where derivatives are calculated at
-        const EigenDynVec& derive_at_pnt = estim_vars_;
-        const EigenDynMat& Pprev = estim_vars_covar_;
+        Point2f corner_pix = sal_pnt.templ_center_pix_.value();
+        zk.middleRows<kPixPosComps>(obs_sal_pnt_ind * kPixPosComps) = corner_pix.Mat();
 
-        CameraStateVars cam_state;
-        LoadCameraStateVarsFromArray(Span(derive_at_pnt, kCamStateComps), &cam_state);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
+        projected_sal_pnts.middleRows<kPixPosComps>(obs_sal_pnt_ind * kPixPosComps) = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
+    }
 
-        Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
-        RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+    const Scalar measurm_noise_variance = suriko::Sqr(static_cast<Scalar>(measurm_noise_std_pix_)); // R[1,1]
+    EigenDynVec meas_residual_var(zk.rows());
 
-        DependsOnOverallPackOrder();
-        const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& Pxx =
-            Pprev.topLeftCorner<kCamStateComps, kCamStateComps>(); // camera-camera covariance
+    const size_t block_rows = std::max<size_t>(1, update_block_sal_pnts_) * kPixPosComps;
+    auto& Knew = cache.Knew;
+    auto& innov_var = cache.innov_var;
+    for (size_t row0 = 0; row0 < static_cast<size_t>(zk.rows()); row0 += block_rows)
+    {
+        const Eigen::Index rows = static_cast<Eigen::Index>(std::min(block_rows, zk.rows() - row0));
+        auto Hb = Hk.middleRows(row0, rows);
 
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(Span(derive_at_pnt).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+        // innovation variance S=H*P*Ht+R, R is diagonal
+        cache.H_P.noalias() = Hb * (*src_estim_vars_covar);
+        innov_var.noalias() = cache.H_P * Hb.transpose();
+        innov_var.diagonal().array() += measurm_noise_variance;
+        meas_residual_var.middleRows(row0, rows) = innov_var.diagonal();
 
-        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> hd_by_sal_pnt;
-        Deriv_hd_by_cam_state_and_sal_pnt(derive_at_pnt, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
+        // K=P*Ht*inv(S)
+        cache.innov_var_inv.noalias() = innov_var.inverse();
+        Knew.noalias() = cache.H_P.transpose() * cache.innov_var_inv;
 
-        // 1. innovation variance S[2,2]
+        // Xnew=Xold+K(z-h(x0)-H*(Xold-x0))
+        cache.innov.noalias() = zk.middleRows(row0, rows) - projected_sal_pnts.middleRows(row0, rows);
+        cache.innov.noalias() -= Hb * (*src_estim_vars - derive_at_pnt);
+        src_estim_vars->noalias() += Knew * cache.innov;
 
-        size_t off = sal_pnt.estim_vars_ind;
-        const Eigen::Matrix<Scalar, kCamStateComps, kSalientPointComps>& Pxy = 
-            Pprev.block<kCamStateComps, kSalientPointComps>(0, off); // camera-sal_pnt covariance
-        const Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps>& Pyy =
-            Pprev.block<kSalientPointComps, kSalientPointComps>(off, off); // sal_pnt-sal_pnt covariance
+        // Pnew=Pold-K*S*Kt
+        cache.K_S.noalias() = Knew * innov_var;
+        src_estim_vars_covar->noalias() -= cache.K_S * Knew.transpose();
+    }
 
-        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> mid = 
-            hd_by_cam_state * Pxy * hd_by_sal_pnt.transpose();
+    if (stats_logger_ != nullptr)
+    {
+        stats_logger_->CurStats().meas_residual = (zk - projected_sal_pnts).eval();
+        stats_logger_->CurStats().meas_residual_std = meas_residual_var.array().sqrt();
+    }
 
-        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_2x2 =
-            hd_by_cam_state * Pxx * hd_by_cam_state.transpose() +
-            mid + mid.transpose() +
-            hd_by_sal_pnt * Pyy * hd_by_sal_pnt.transpose() +
-            Rk;
-        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_inv_2x2 = innov_var_2x2.inverse();
+    EnsureSalientPointPositiveInvDepth(src_estim_vars);
 
-        // 2. filter gain [13+6n, 2]: K=(Px*Hx+Py*Hy)*inv(S)
+    if (fix_estim_vars_covar_symmetry_)
+        FixSymmetricMat(src_estim_vars_covar);
 
-        one_obs_per_update_cache_.P_Hxy.noalias() = Pprev.leftCols<kCamStateComps>() * hd_by_cam_state.transpose(); // P*Hx
-        one_obs_per_update_cache_.P_Hxy.noalias() += Pprev.middleCols<kSalientPointComps>(off) * hd_by_sal_pnt.transpose(); // P*Hy
+    EnsureNonnegativeStateVariance(src_estim_vars_covar);
 
-        auto& Knew = one_obs_per_update_cache_.Knew;
-        Knew.noalias() = one_obs_per_update_cache_.P_Hxy * innov_var_inv_2x2;
+    RemoveSalientPointsWithNonextractableUncertEllipsoid(src_estim_vars, src_estim_vars_covar);
+}
 
-        // 3. update X and P using info derived from salient point observation
-        SRK_ASSERT(sal_pnt.IsDetected());
-        suriko::Point2f corner_pix = sal_pnt.templ_center_pix_.value();
-        
-        // project salient point into current camera
-        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
+void DavisonMonoSlam::ProcessFrame_FrozenMapUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
+{
+    SRK_ASSERT(!latest_frame_sal_pnt_ids.empty());
+    SRK_ASSERT(EstimatedVarsCount() == kCamStateComps) << "The state consists of the camera only";
 
-        //
-        auto estim_vars_delta = Knew * (corner_pix.Mat() - hd);
-        auto estim_vars_delta_debug = estim_vars_delta.eval();
+    // improve predicted estimation with the info from observations
+    std::swap(estim_vars_, predicted_estim_vars_);
+    std::swap(estim_vars_covar_, predicted_estim_vars_covar_);
 
-        one_obs_per_update_cache_.K_S.noalias() = Knew * innov_var_2x2; // cache
-        auto estim_vars_covar_delta = one_obs_per_update_cache_.K_S * Knew.transpose();
-        auto estim_vars_covar_delta_debug = estim_vars_covar_delta.eval();
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
 
-        if (kSurikoDebug)
-        {
-            Scalar estim_vars_delta_norm = estim_vars_delta.norm();
-            diff_vars_total += estim_vars_delta_norm;
-            
-            Scalar estim_vars_covar_delta_norm = estim_vars_covar_delta.norm();
-            diff_cov_total += estim_vars_covar_delta_norm;
-        }
+    // Salient points are not correlated with the camera, hence observations are independent
+    // and are fused one at a time at the cost of O(12^2) each.
+    for (SalPntId obs_sal_pnt_id : latest_frame_sal_pnt_ids)
+    {
+        const TrackedSalientPoint& sal_pnt = GetSalientPoint(obs_sal_pnt_id);
+        SRK_ASSERT(sal_pnt.in_frozen_map);
+        SRK_ASSERT(sal_pnt.IsDetected());
+        const FrozenSalientPoint& frozen_sal_pnt = frozen_sal_pnts_[sal_pnt.sal_pnt_ind];
+
+        CameraStateVars cam_state;
+        LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+
+        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+        Eigen::Matrix<Scalar, kPixPosComps, kEucl3> hd_by_sal_pnt;
+        SalPntProjectionIntermidVars proj_hist{};
+        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = Deriv_hd_by_cam_state_and_frozen_sal_pnt(cam_state, frozen_sal_pnt,
+            &hd_by_cam_state, &hd_by_sal_pnt, &proj_hist);
+        if (proj_hist.hc[2] <= 0)
+            continue;  // the salient point is behind the camera
+
+        const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps> P = estim_vars_covar_;
+        Eigen::Matrix<Scalar, kCamStateComps, kPixPosComps> P_Ht = P * hd_by_cam_state.transpose();
+
+        // the uncertainty of the salient point is added to the noise of the measurement
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var =
+            hd_by_cam_state * P_Ht +
+            hd_by_sal_pnt * frozen_sal_pnt.pos_uncert * hd_by_sal_pnt.transpose() +
+            Rk;
+
+        Eigen::Matrix<Scalar, kCamStateComps, kPixPosComps> K = P_Ht * innov_var.inverse();
+
+        suriko::Point2f corner_pix = sal_pnt.templ_center_pix_.value();
+        estim_vars_.noalias() += K * (corner_pix.Mat() - hd);
+        estim_vars_covar_.noalias() -= K * innov_var * K.transpose();
+
+        if (fix_estim_vars_covar_symmetry_)
+            FixSymmetricMat(&estim_vars_covar_);
+    }
+}
+
+void DavisonMonoSlam::SelectVisibleFrozenSalientPoints(std::set<SalPntId>* sal_pnt_ids) const
+{
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(predicted_estim_vars_, kCamStateComps), &cam_state);
+
+    MorphableSalientPoint sal_pnt_vars;
+    sal_pnt_vars.repres = SalPntComps::kXyz;
+    for (const FrozenSalientPoint& frozen_sal_pnt : frozen_sal_pnts_)
+    {
+        sal_pnt_vars.pos_w = frozen_sal_pnt.pos_w;
+
+        SalPntProjectionIntermidVars proj_hist{};
+        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, &proj_hist);
+        if (proj_hist.hc[2] <= 0)
+            continue;
+
+        bool in_image = hd[0] >= 0 && hd[0] < cam_intrinsics_.image_size.width &&
+            hd[1] >= 0 && hd[1] < cam_intrinsics_.image_size.height;
+        if (in_image)
+            sal_pnt_ids->insert(SalPntId{ frozen_sal_pnt.sal_pnt.get() });
+    }
+}
+
+Eigen::Matrix<Scalar, kPixPosComps, 1> DavisonMonoSlam::Deriv_hd_by_cam_state_and_frozen_sal_pnt(const CameraStateVars& cam_state,
+    const FrozenSalientPoint& frozen_sal_pnt,
+    Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
+    Eigen::Matrix<Scalar, kPixPosComps, kEucl3>* hd_by_sal_pnt,
+    SalPntProjectionIntermidVars* proj_hist) const
+{
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
+    RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+
+    MorphableSalientPoint sal_pnt_vars;
+    sal_pnt_vars.repres = SalPntComps::kXyz;
+    sal_pnt_vars.pos_w = frozen_sal_pnt.pos_w;
+
+    Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, proj_hist);
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> hd_by_hu;
+    Deriv_hd_by_hu(suriko::Point2f{ hd[0], hd[1] }, &hd_by_hu);
+
+    Eigen::Matrix<Scalar, kPixPosComps, kEucl3> hu_by_hc;
+    Deriv_hu_by_hc(*proj_hist, &hu_by_hc);
+
+    Deriv_hd_by_camera_state(sal_pnt_vars, cam_state, cam_orient_wfc, *proj_hist, hd_by_hu, hu_by_hc, hd_by_cam_state);
+
+    HdBySalPntMat hd_by_xyz;
+    Deriv_hd_by_sal_pnt(sal_pnt_vars, cam_state, cam_orient_wfc, hd_by_hu, hu_by_hc, &hd_by_xyz);
+    *hd_by_sal_pnt = hd_by_xyz;
+    return hd;
+}
+
+auto DavisonMonoSlam::GetFrozenSalientPointProjected2DPosWithUncertainty(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+    const FrozenSalientPoint& frozen_sal_pnt) const -> std::tuple<bool, MeanAndCov2D>
+{
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(src_estim_vars, kCamStateComps), &cam_state);
+
+    Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+    Eigen::Matrix<Scalar, kPixPosComps, kEucl3> hd_by_sal_pnt;
+    SalPntProjectionIntermidVars proj_hist{};
+    Eigen::Matrix<Scalar, kPixPosComps, 1> hd = Deriv_hd_by_cam_state_and_frozen_sal_pnt(cam_state, frozen_sal_pnt,
+        &hd_by_cam_state, &hd_by_sal_pnt, &proj_hist);
+    if (proj_hist.hc[2] <= 0)
+        return std::make_tuple(false, MeanAndCov2D{});
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> covar2D =
+        hd_by_cam_state * src_estim_vars_covar.topLeftCorner<kCamStateComps, kCamStateComps>() * hd_by_cam_state.transpose() +
+        hd_by_sal_pnt * frozen_sal_pnt.pos_uncert * hd_by_sal_pnt.transpose();
+    FixAlmostSymmetricMat(&covar2D);
+
+    if (!CheckEllipseIsExtractableFrom2DCovarMat(covar2D, false))
+        return std::make_tuple(false, MeanAndCov2D{});
+    return std::make_tuple(true, MeanAndCov2D{ hd, covar2D });
+}
+
+void DavisonMonoSlam::ProcessFrame_OneObservationPerUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
+{
+    SRK_ASSERT(!latest_frame_sal_pnt_ids.empty());
+    // improve predicted estimation with the info from observations
+    std::swap(estim_vars_, predicted_estim_vars_);
+    std::swap(estim_vars_covar_, predicted_estim_vars_covar_);
+    
+    if (kSurikoDebug)
+    {
+        //predicted_estim_vars_.setConstant(kNan);
+        //predicted_estim_vars_covar_.setConstant(kNan);
+        // TODO: fix me; initialize predicted, because UI reads it without sync!
+        predicted_estim_vars_ = estim_vars_;
+        predicted_estim_vars_covar_ = estim_vars_covar_;
+    }
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
+
+    Scalar diff_vars_total = 0;
+    Scalar diff_cov_total = 0;
+    for (SalPntId obs_sal_pnt_id : latest_frame_sal_pnt_ids)
+    {
+        const TrackedSalientPoint& sal_pnt = GetSalientPoint(obs_sal_pnt_id);
+
+        // the point where derivatives are calculated at
+        const EigenDynVec& derive_at_pnt = estim_vars_;
+        const EigenDynMat& Pprev = estim_vars_covar_;
+
+        CameraStateVars cam_state;
+        LoadCameraStateVarsFromArray(Span(derive_at_pnt, kCamStateComps), &cam_state);
+
+        Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
+        RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+
+        DependsOnOverallPackOrder();
+        const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& Pxx =
+            Pprev.topLeftCorner<kCamStateComps, kCamStateComps>(); // camera-camera covariance
+
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
+
+        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+        HdBySalPntMat hd_by_sal_pnt;
+        Deriv_hd_by_cam_state_and_sal_pnt(derive_at_pnt, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
+
+        // 1. innovation variance S[2,2]
+
+        SalPntCovarCols Pxy;
+        GetSalientPointCovarCols(Pprev, 0, kCamStateComps, sal_pnt, &Pxy); // camera-sal_pnt covariance
+        const SalPntMat Pyy = GetSalientPointsCovar(Pprev, sal_pnt, sal_pnt); // sal_pnt-sal_pnt covariance
+
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> mid = 
+            hd_by_cam_state * Pxy * hd_by_sal_pnt.transpose();
+
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_2x2 =
+            hd_by_cam_state * Pxx * hd_by_cam_state.transpose() +
+            mid + mid.transpose() +
+            hd_by_sal_pnt * Pyy * hd_by_sal_pnt.transpose() +
+            Rk;
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_inv_2x2 = innov_var_2x2.inverse();
+
+        // 2. filter gain [12+6n, 2]: K=(Px*Hx+Py*Hy)*inv(S)
+
+        one_obs_per_update_cache_.P_Hxy.noalias() = Pprev.leftCols<kCamStateComps>() * hd_by_cam_state.transpose(); // P*Hx
+        ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+        {
+            one_obs_per_update_cache_.P_Hxy.noalias() += Pprev.middleCols(var_ind, vars_count) * hd_by_sal_pnt.middleCols(sal_pnt_var_ind, vars_count).transpose(); // P*Hy
+        });
+
+        auto& Knew = one_obs_per_update_cache_.Knew;
+        Knew.noalias() = one_obs_per_update_cache_.P_Hxy * innov_var_inv_2x2;
+
+        // 3. update X and P using info derived from salient point observation
+        SRK_ASSERT(sal_pnt.IsDetected());
+        suriko::Point2f corner_pix = sal_pnt.templ_center_pix_.value();
+        
+        // project salient point into current camera
+        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
+
+        //
+        auto estim_vars_delta = Knew * (corner_pix.Mat() - hd);
+        auto estim_vars_delta_debug = estim_vars_delta.eval();
+
+        one_obs_per_update_cache_.K_S.noalias() = Knew * innov_var_2x2; // cache
+        auto estim_vars_covar_delta = one_obs_per_update_cache_.K_S * Knew.transpose();
+        auto estim_vars_covar_delta_debug = estim_vars_covar_delta.eval();
+
+        if (kSurikoDebug)
+        {
+            Scalar estim_vars_delta_norm = estim_vars_delta.norm();
+            diff_vars_total += estim_vars_delta_norm;
+            
+            Scalar estim_vars_covar_delta_norm = estim_vars_covar_delta.norm();
+            diff_cov_total += estim_vars_covar_delta_norm;
+        }
 
         //
         estim_vars_.noalias() += estim_vars_delta;
         estim_vars_covar_.noalias() -= estim_vars_covar_delta;
 
-        NormalizeCameraOrientationQuaternionAndCovariances(&estim_vars_, &estim_vars_covar_);
-        
         if (fix_estim_vars_covar_symmetry_)
             FixSymmetricMat(&estim_vars_covar_);
     }
@@ -1276,9 +2415,11 @@ void DavisonMonoSlam::OnePointRansac_GetConsensusMatches(const std::vector<std::
     // When a salient point A is integrated into the estimated state, it slightly offsets other points.
     // If some salient point Bi has small such an offset (less than threshold THR),
     // we say that it agrees (is in consensus) with A.
-    // This method iterates over salient points to find one (A) with maximum consensus set (set of Bi).
+    // This method randomly selects salient points to find one (A) with maximum consensus set (set of Bi).
     // The threshold THR should be small, less than 1 standard deviation of measurement noise, to keep
     // consensus set small and reliable.
+    // The number of hypotheses is adapted to the ratio of inliers eps of the best hypothesis so far,
+    // n_hyp=log(1-p)/log(1-eps), where p is the probability of choosing at least one inlier [SfM_EKF_Civera] Ch5.
     CameraStateVars cam_state;
     LoadCameraStateVarsFromArray(Span(src_estim_vars, kCamStateComps), &cam_state);
 
@@ -1294,100 +2435,130 @@ void DavisonMonoSlam::OnePointRansac_GetConsensusMatches(const std::vector<std::
     const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& Pxx =
         src_estim_vars_covar.topLeftCorner<kCamStateComps, kCamStateComps>(); // camera-camera covariance
 
-    size_t low_innov_inliers_count = 0;
+    // the derivatives and innovation of each matched salient point don't depend on a hypothesis
+    struct MatchedSalPnt
+    {
+        const TrackedSalientPoint* sal_pnt;
+        suriko::Point2f corner_pix;
+        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+        HdBySalPntMat hd_by_sal_pnt;
+        Eigen::Matrix<Scalar, kPixPosComps, 1> innov;  // =corner-projection
+    };
 
-    // Stage 1: find low-innovation inliers, which are distant salient points.
-    // Original algorithm iterates here, by randomly selecting matched corner
-    for (auto [matched_sal_pnt_id, corner_pixel] : matched_sal_pnt_to_corner)
+    const size_t matches_count = matched_sal_pnt_to_corner.size();
+    std::vector<MatchedSalPnt> matches(matches_count);
+    for (size_t i = 0; i < matches_count; ++i)
     {
+        auto [matched_sal_pnt_id, corner_pixel] = matched_sal_pnt_to_corner[i];
         const TrackedSalientPoint& sal_pnt = GetSalientPoint(matched_sal_pnt_id);
+        SRK_ASSERT(sal_pnt.IsDetected());
 
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
-        Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> hd_by_sal_pnt;
-        Deriv_hd_by_cam_state_and_sal_pnt(src_estim_vars, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
+        MatchedSalPnt& m = matches[i];
+        m.sal_pnt = &sal_pnt;
+        m.corner_pix = corner_pixel;
+        Deriv_hd_by_cam_state_and_sal_pnt(src_estim_vars, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &m.hd_by_cam_state, &m.hd_by_sal_pnt);
+
+        // project salient point into current camera
+        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
+        m.innov = corner_pixel.Mat() - hd;
+    }
+
+    std::vector<size_t> hyp_order(matches_count);
+    std::iota(hyp_order.begin(), hyp_order.end(), 0);
+    std::shuffle(hyp_order.begin(), hyp_order.end(), one_point_ransac_gen_);
+
+    const Scalar log_fail_prob = std::log(1 - one_point_ransac_success_prob_);
+    size_t max_hyp_count = matches_count;
+
+    std::vector<size_t> support_inds;
+    std::vector<size_t> best_support_inds;
+    SalPntCovarCols a_Pxy;
+    size_t hyp_ind = 0;
+    for (; hyp_ind < max_hyp_count; ++hyp_ind)
+    {
+        const MatchedSalPnt& hyp = matches[hyp_order[hyp_ind]];
 
         // 1. innovation variance S[2,2]
 
-        size_t off = sal_pnt.estim_vars_ind;
-        const Eigen::Matrix<Scalar, kCamStateComps, kSalientPointComps>& Pxy =
-            src_estim_vars_covar.block<kCamStateComps, kSalientPointComps>(0, off); // camera-sal_pnt covariance
-        const Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps>& Pyy =
-            src_estim_vars_covar.block<kSalientPointComps, kSalientPointComps>(off, off); // sal_pnt-sal_pnt covariance
+        SalPntCovarCols Pxy;
+        GetSalientPointCovarCols(src_estim_vars_covar, 0, kCamStateComps, *hyp.sal_pnt, &Pxy); // camera-sal_pnt covariance
+        const SalPntMat Pyy = GetSalientPointsCovar(src_estim_vars_covar, *hyp.sal_pnt, *hyp.sal_pnt); // sal_pnt-sal_pnt covariance
 
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> mid =
-            hd_by_cam_state * Pxy * hd_by_sal_pnt.transpose();
+            hyp.hd_by_cam_state * Pxy * hyp.hd_by_sal_pnt.transpose();
 
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_2x2 =
-            hd_by_cam_state * Pxx * hd_by_cam_state.transpose() +
+            hyp.hd_by_cam_state * Pxx * hyp.hd_by_cam_state.transpose() +
             mid + mid.transpose() +
-            hd_by_sal_pnt * Pyy * hd_by_sal_pnt.transpose() +
+            hyp.hd_by_sal_pnt * Pyy * hyp.hd_by_sal_pnt.transpose() +
             Rk;
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_inv_2x2 = innov_var_2x2.inverse();
 
-        // 2. filter gain [13+6n, 2]: K=(Px*Hx+Py*Hy)*inv(S)
+        // 2. the increment of the state K*innov=(P*Hxt+Py*Hyt)*inv(S)*innov is required only in the rows
+        // of the camera and of the matched salient points, hence the [12+6n,2] filter gain isn't computed
 
-        one_obs_per_update_cache_.P_Hxy.noalias() = src_estim_vars_covar.leftCols<kCamStateComps>() * hd_by_cam_state.transpose(); // P*Hx
-        one_obs_per_update_cache_.P_Hxy.noalias() += src_estim_vars_covar.middleCols<kSalientPointComps>(off) * hd_by_sal_pnt.transpose(); // P*Hy
+        Eigen::Matrix<Scalar, kPixPosComps, 1> innov_weighted = innov_var_inv_2x2 * hyp.innov;
+        Eigen::Matrix<Scalar, kCamStateComps, 1> Hxt_w = hyp.hd_by_cam_state.transpose() * innov_weighted;
+        SalPntVec Hyt_w = hyp.hd_by_sal_pnt.transpose() * innov_weighted;
 
-        auto& Knew = one_obs_per_update_cache_.Knew;
-        Knew.noalias() = one_obs_per_update_cache_.P_Hxy * innov_var_inv_2x2;
+        Eigen::Matrix<Scalar, kCamStateComps, 1> try_cam_vars = src_estim_vars.topRows<kCamStateComps>();
+        try_cam_vars.noalias() += Pxx * Hxt_w;
+        try_cam_vars.noalias() += Pxy * Hyt_w;
 
-        // 3. update X and P using info derived from salient point observation
-        SRK_ASSERT(sal_pnt.IsDetected());
-        //suriko::Point2f corner_pix = sal_pnt.templ_center_pix_.value();
-        suriko::Point2f corner_pix = corner_pixel;
+        CameraStateVars try_cam_state;
+        LoadCameraStateVarsFromArray(Span(try_cam_vars), &try_cam_state);
 
-        // project salient point into current camera
-        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
-
-        //
-        EigenDynVec estim_vars_delta = Knew * (corner_pix.Mat() - hd);
-        EigenDynVec new_estim_vars = src_estim_vars + estim_vars_delta;
-
-        auto find_support_fun = [this](const std::vector<std::pair<SalPntId, suriko::Point2f>>& matched_sal_pnt_to_corner,
-            const EigenDynVec& new_estim_vars, Scalar max_diverge_pix,
-            std::vector<std::pair<SalPntId, suriko::Point2f>>* support_salient_points) -> int
+        // 3. count the salient points which agree with the hypothesis
+        support_inds.clear();
+        for (size_t i = 0; i < matches_count; ++i)
         {
-            int result = 0;
-            CameraStateVars try_cam_state;
-            LoadCameraStateVarsFromArray(Span(new_estim_vars, kCamStateComps), &try_cam_state);
+            const MatchedSalPnt& a = matches[i];
+            GetSalientPointCovarCols(src_estim_vars_covar, 0, kCamStateComps, *a.sal_pnt, &a_Pxy);
 
-            for (auto sal_pnt_to_corner : matched_sal_pnt_to_corner)
-            {
-                auto [a_sal_pnt_id, a_corner_pixel] = sal_pnt_to_corner;
-
-                const TrackedSalientPoint& a_sal_pnt = GetSalientPoint(a_sal_pnt_id);
+            SalPntVec try_sal_pnt_vars = GetSalientPointVars(src_estim_vars, *a.sal_pnt);
+            try_sal_pnt_vars.noalias() += a_Pxy.transpose() * Hxt_w;
+            try_sal_pnt_vars.noalias() += GetSalientPointsCovar(src_estim_vars_covar, *a.sal_pnt, *hyp.sal_pnt) * Hyt_w;
 
-                MorphableSalientPoint a_sal_pnt_vars;
-                LoadSalientPointDataFromArray(Span(new_estim_vars).subspan(a_sal_pnt.estim_vars_ind, kSalientPointComps), &a_sal_pnt_vars);
+            MorphableSalientPoint a_sal_pnt_vars;
+            LoadSalientPointDataFromArray(Span(try_sal_pnt_vars), &a_sal_pnt_vars);
 
-                Eigen::Matrix<Scalar, kPixPosComps, 1> a_hd = ProjectInternalSalientPoint(try_cam_state, a_sal_pnt_vars, nullptr);
+            Eigen::Matrix<Scalar, kPixPosComps, 1> a_hd = ProjectInternalSalientPoint(try_cam_state, a_sal_pnt_vars, nullptr);
 
-                Scalar dist = (a_corner_pixel.Mat() - a_hd).norm();
-                static bool debug_sp_dist = false;
-                if (debug_sp_dist)
-                    LOG(INFO) << "[" <<(int)a_sal_pnt.templ_center_pix_.value().X() << "," << (int)a_sal_pnt.templ_center_pix_.value().Y()
-                              << "] dist=" << dist;
-                if (dist < max_diverge_pix)
-                {
-                    result++;
-                    support_salient_points->push_back(sal_pnt_to_corner);
-                }
-            }
-            return result;
-        };
+            Scalar dist = (a.corner_pix.Mat() - a_hd).norm();
+            static bool debug_sp_dist = false;
+            if (debug_sp_dist)
+                LOG(INFO) << "[" << (int)a.corner_pix.X() << "," << (int)a.corner_pix.Y() << "] dist=" << dist;
+            if (dist < corner_max_divergence_pix)
+                support_inds.push_back(i);
+        }
 
-        std::vector<std::pair<SalPntId, suriko::Point2f>> support_salient_points;
-        int support = find_support_fun(matched_sal_pnt_to_corner, new_estim_vars, corner_max_divergence_pix, &support_salient_points);
-        if (support > low_innov_inliers_count)
+        if (support_inds.size() > best_support_inds.size())
         {
-            low_innov_inliers_count = support;
-            low_innov_inliers->swap(support_salient_points);
+            best_support_inds.swap(support_inds);
+
+            Scalar inlier_ratio = best_support_inds.size() / static_cast<Scalar>(matches_count);
+            size_t hyp_count_bound = matches_count;
+            if (inlier_ratio >= 1)
+                hyp_count_bound = hyp_ind + 1;
+            else
+            {
+                Scalar bound = std::ceil(log_fail_prob / std::log(1 - inlier_ratio));
+                if (bound < matches_count)
+                    hyp_count_bound = static_cast<size_t>(bound);
+            }
+            max_hyp_count = std::min(max_hyp_count, hyp_count_bound);
         }
     }
+
+    VLOG(5) << "1-P RANSAC hypotheses=" << hyp_ind << "/" << matches_count << " support=" << best_support_inds.size();
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().one_point_ransac_hypotheses = hyp_ind;
+
+    low_innov_inliers->clear();
+    for (size_t i : best_support_inds)
+        low_innov_inliers->push_back(matched_sal_pnt_to_corner[i]);
 }
 
 std::tuple<size_t, size_t> DavisonMonoSlam::ProcessFrame_OnePointRansacUpdateCore(size_t frame_ind, const std::vector<std::pair<SalPntId, suriko::Point2f>>& matched_sal_pnt_to_corner)
@@ -1412,8 +2583,7 @@ std::tuple<size_t, size_t> DavisonMonoSlam::ProcessFrame_OnePointRansacUpdateCor
         {
             const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
 
-            MorphableSalientPoint sal_pnt_vars;
-            LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+            MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
             Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
 
@@ -1468,6 +2638,10 @@ std::tuple<size_t, size_t> DavisonMonoSlam::ProcessFrame_OnePointRansacUpdateCor
     if (high_innov_count == 0)  // no candidates to rescue?
         return std::make_tuple(low_innov_inliers.size(), size_t{ 0 });
 
+    // the offset of the corner is compared to the innovation covariance S=H*P*Ht+R [SfM_EKF_Civera] Ch5
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
+
     std::vector<SalPntWithCenter> high_innov_true_sal_pnts;
     for (auto sal_pnt_to_corner : matched_sal_pnt_to_corner)
     {
@@ -1482,9 +2656,10 @@ std::tuple<size_t, size_t> DavisonMonoSlam::ProcessFrame_OnePointRansacUpdateCor
 
         auto [op_cov, corner] = GetSalientPointProjected2DPosWithUncertainty(src_estim_vars, src_estim_vars_covar, sal_pnt);
         static_assert(std::is_same_v<decltype(corner), MeanAndCov2D>);
-        SRK_ASSERT(op_cov);
+        if (!op_cov)
+            continue;  // the salient point, which is updated by Stage-1 to be behind the camera, isn't rescued
 
-        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> sigma_inv = corner.cov.inverse();
+        Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> sigma_inv = (corner.cov + Rk).inverse();
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> off_center = corner_pixel.Mat() - corner.mean;
         Scalar off_dist = (off_center.transpose() * sigma_inv * off_center)[0];
@@ -1509,6 +2684,18 @@ std::tuple<size_t, size_t> DavisonMonoSlam::ProcessFrame_OnePointRansacUpdateCor
         if (kSurikoDebug) log_stats("stats after Stage-2");
     }
 
+    // None of observations agrees with the prediction, which happens when the prediction is much more certain than the actual
+    // motion of the camera. Without a fallback, the filter would coast on the prediction and drift further with every frame.
+    // Then all matches, which passed the search of the matcher, are fused as by the stacked update.
+    if (low_innov_sal_pnt_ids.empty() && high_innov_true_sal_pnts.empty())
+    {
+        std::vector<SalPntId> matched_sal_pnt_ids;
+        std::transform(matched_sal_pnt_to_corner.begin(), matched_sal_pnt_to_corner.end(), std::back_inserter(matched_sal_pnt_ids),
+            [](auto& p) { return p.first; });
+        ProcessFrame_StackedObservationsPerUpdateCore(frame_ind, matched_sal_pnt_ids, &src_estim_vars, &src_estim_vars_covar);
+        return std::make_tuple(size_t{ 0 }, matched_sal_pnt_ids.size());
+    }
+
     return std::make_tuple(low_innov_sal_pnt_ids.size(), high_innov_true_sal_pnts.size());
 }
 
@@ -1568,21 +2755,18 @@ void DavisonMonoSlam::ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t
             const Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>& Pxx =
                 Pprev.topLeftCorner<kCamStateComps, kCamStateComps>(); // camera-camera covariance
 
-            size_t off = sal_pnt.estim_vars_ind;
-            const Eigen::Matrix<Scalar, kCamStateComps, kSalientPointComps>& Pxy =
-                Pprev.block<kCamStateComps, kSalientPointComps>(0, off); // camera-sal_pnt covariance
-            const Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps>& Pyy =
-                Pprev.block<kSalientPointComps, kSalientPointComps>(off, off); // sal_pnt-sal_pnt covariance
+            SalPntCovarCols Pxy;
+            GetSalientPointCovarCols(Pprev, 0, kCamStateComps, sal_pnt, &Pxy); // camera-sal_pnt covariance
+            const SalPntMat Pyy = GetSalientPointsCovar(Pprev, sal_pnt, sal_pnt); // sal_pnt-sal_pnt covariance
 
-            MorphableSalientPoint sal_pnt_vars;
-            LoadSalientPointDataFromArray(Span(derive_at_pnt).subspan(off, kSalientPointComps), &sal_pnt_vars);
+            MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
 
             Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
-            Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> hd_by_sal_pnt;
+            HdBySalPntMat hd_by_sal_pnt;
             Deriv_hd_by_cam_state_and_sal_pnt(derive_at_pnt, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
 
             // 1. innovation variance is a scalar (one element matrix S[1,1])
-            auto obs_comp_by_cam_state = hd_by_cam_state.middleRows<1>(obs_comp_ind); // [1,13]
+            auto obs_comp_by_cam_state = hd_by_cam_state.middleRows<1>(obs_comp_ind); // [1,12]
             auto obs_comp_by_sal_pnt = hd_by_sal_pnt.middleRows<1>(obs_comp_ind); // [1,6]
 
             typedef Eigen::Matrix<Scalar, 1, 1> EigenMat11;
@@ -1597,10 +2781,13 @@ void DavisonMonoSlam::ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t
 
             Scalar innov_var_inv = 1 / innov_var;
 
-            // 2. filter gain [13+6n, 1]: K=(Px*Hx+Py*Hy)*inv(S)
+            // 2. filter gain [12+6n, 1]: K=(Px*Hx+Py*Hy)*inv(S)
             auto& Knew = one_comp_of_obs_per_update_cache_.Knew;
             Knew.noalias() = innov_var_inv * Pprev.leftCols<kCamStateComps>() * obs_comp_by_cam_state.transpose();
-            Knew.noalias() += innov_var_inv * Pprev.middleCols<kSalientPointComps>(off) * obs_comp_by_sal_pnt.transpose();
+            ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+            {
+                Knew.noalias() += innov_var_inv * Pprev.middleCols(var_ind, vars_count) * obs_comp_by_sal_pnt.middleCols(sal_pnt_var_ind, vars_count).transpose();
+            });
 
             //
             // project salient point into current camera
@@ -1610,12 +2797,12 @@ void DavisonMonoSlam::ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t
 
             auto estim_vars_delta = Knew * (corner_pix[obs_comp_ind] - hd[obs_comp_ind]);
 
-            // keep outer product K*Kt lazy ([13+6n,1]*[1,13+6n]=[13+6n,13+6n])
+            // keep outer product K*Kt lazy ([12+6n,1]*[1,12+6n]=[12+6n,12+6n])
             
-            auto estim_vars_covar_delta = innov_var * (Knew * Knew.transpose()); // [13+6n,13+6n]
+            auto estim_vars_covar_delta = innov_var * (Knew * Knew.transpose()); // [12+6n,12+6n]
 
             // NOTE: (K*Kt)S is 3 times slower than S*(K*Kt) or (S*K)Kt, S=scalar. Why?
-            //auto estim_vars_covar_delta = (Knew * Knew.transpose()) * innov_var; // [13+6n,13+6n] slow!!!
+            //auto estim_vars_covar_delta = (Knew * Knew.transpose()) * innov_var; // [12+6n,12+6n] slow!!!
             
             if (kSurikoDebug)
             {
@@ -1630,8 +2817,6 @@ void DavisonMonoSlam::ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t
             estim_vars_.noalias() += estim_vars_delta;
             estim_vars_covar_.noalias() -= estim_vars_covar_delta;
 
-            NormalizeCameraOrientationQuaternionAndCovariances(&estim_vars_, &estim_vars_covar_);
-            
             if (fix_estim_vars_covar_symmetry_)
                 FixSymmetricMat(&estim_vars_covar_);
         }
@@ -1649,65 +2834,113 @@ void DavisonMonoSlam::ProcessFrame_OneComponentOfOneObservationPerUpdate(size_t
     }
 }
 
-void DavisonMonoSlam::NormalizeCameraOrientationQuaternionAndCovariances(EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar)
+void DavisonMonoSlam::ProcessFrame_SquareRootUpdate(size_t frame_ind, const std::vector<SalPntId>& latest_frame_sal_pnt_ids)
 {
-    CameraStateVars cam_state_vars;
-    LoadCameraStateVarsFromArray(Span(*src_estim_vars, kCamStateComps), &cam_state_vars);
+    SRK_ASSERT(!latest_frame_sal_pnt_ids.empty());
 
-    auto q = cam_state_vars.orientation_wfc; // cam_orient_quat
-    Scalar q_len = q.norm();
+    SyncCovarSqrt(predicted_estim_vars_covar_, &predicted_estim_vars_covar_sqrt_);
 
-    static bool always_normalize = false;
-    bool do_normalize = always_normalize || !IsClose(1, q_len);
-    if (!do_normalize)
-        return;
+    // improve predicted estimation with the info from observations
+    std::swap(estim_vars_, predicted_estim_vars_);
+    std::swap(estim_vars_covar_, predicted_estim_vars_covar_);
+    std::swap(estim_vars_covar_sqrt_, predicted_estim_vars_covar_sqrt_);
+
+    EigenDynMat& L = estim_vars_covar_sqrt_;
+    auto& f = sqrt_update_cache_.f;
+    auto& Knew = sqrt_update_cache_.Knew;
+    f.resize(L.rows());
+    Knew.resize(L.rows());
 
-    // normalize quaternion (formula A.141)
-    Eigen::Matrix<Scalar, kQuat4, 1> new_cam_orient_quat = q / q_len;
-    auto& est_vars = *src_estim_vars;
+    Scalar measurm_noise_variance = suriko::Sqr(static_cast<Scalar>(measurm_noise_std_pix_)); // R[1,1]
+
+    for (SalPntId obs_sal_pnt_id : latest_frame_sal_pnt_ids)
+    {
+        const TrackedSalientPoint& sal_pnt = GetSalientPoint(obs_sal_pnt_id);
+
+        // get observation corner
+        SRK_ASSERT(sal_pnt.IsDetected());
+        Point2f corner_pix = sal_pnt.templ_center_pix_.value();
+
+        for (size_t obs_comp_ind = 0; obs_comp_ind < kPixPosComps; ++obs_comp_ind)
+        {
+            // the point where derivatives are calculated at
+            const EigenDynVec& derive_at_pnt = estim_vars_;
+
+            CameraStateVars cam_state;
+            LoadCameraStateVarsFromArray(Span(derive_at_pnt, kCamStateComps), &cam_state);
+
+            Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
+            RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+
+            MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
+
+            Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+            HdBySalPntMat hd_by_sal_pnt;
+            Deriv_hd_by_cam_state_and_sal_pnt(derive_at_pnt, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
+
+            // f=Lt*Ht[1,12+6n], H is non-zero only in the columns of the camera and of the salient point
+            DependsOnOverallPackOrder();
+            f.noalias() = L.topRows<kCamStateComps>().transpose() * hd_by_cam_state.middleRows<1>(obs_comp_ind).transpose();
+            ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+            {
+                f.noalias() += L.middleRows(var_ind, vars_count).transpose() *
+                    hd_by_sal_pnt.middleRows<1>(obs_comp_ind).middleCols(sal_pnt_var_ind, vars_count).transpose();
+            });
+
+            // the factor is updated in place, K=P*Ht/S
+            CholeskyFactorScalarMeasurementUpdate(L, f, measurm_noise_variance, Knew);
+
+            // project salient point into current camera
+            Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
+
+            estim_vars_.noalias() += Knew * (corner_pix[obs_comp_ind] - hd[obs_comp_ind]);
+        }
+    }
+
+    // the factor is the primary store; the covariances, which are used to project salient points, are derived from
+    // the factor, hence they are symmetric and positive semi-definite by construction
+    SyncCovarMarginalsFromSqrt(L, &estim_vars_covar_);
+    covar_marginals_only_ = true;
+
+    static bool debug_estim_vars = false;
+    if (debug_estim_vars || DebugPath(DebugPathEnum::DebugEstimVarsCov))
+    {
+        CheckCameraAndSalientPointsCovs(estim_vars_, estim_vars_covar_);
+    }
+}
+
+void DavisonMonoSlam::InjectCameraOrientationError()
+{
+    // The orientation error is moved into the nominal orientation, which is kept out of the state. This replaces
+    // the normalization of the orientation quaternion, which had to update 4 rows and columns of the whole covariance.
+    // The covariance of the error is kept, because the Jacobian of the reset, I-skew(dtheta/2), is close to identity.
     DependsOnCameraPosPackOrder();
-    est_vars[kEucl3 + 0] = new_cam_orient_quat[0];
-    est_vars[kEucl3 + 1] = new_cam_orient_quat[1];
-    est_vars[kEucl3 + 2] = new_cam_orient_quat[2];
-    est_vars[kEucl3 + 3] = new_cam_orient_quat[3];
-
-    // normalize quaternion
-    Eigen::Matrix<Scalar, kQuat4, kQuat4> dq4x4;
-    using suriko::Sqr;
-    dq4x4(0, 0) = Sqr(q[1]) + Sqr(q[2]) + Sqr(q[3]);
-    dq4x4(1, 1) = Sqr(q[0]) + Sqr(q[2]) + Sqr(q[3]);
-    dq4x4(2, 2) = Sqr(q[0]) + Sqr(q[1]) + Sqr(q[3]);
-    dq4x4(3, 3) = Sqr(q[0]) + Sqr(q[1]) + Sqr(q[2]);
-    dq4x4(0, 1) = dq4x4(1, 0) = -q[0] * q[1];
-    dq4x4(0, 2) = dq4x4(2, 0) = -q[0] * q[2];
-    dq4x4(0, 3) = dq4x4(3, 0) = -q[0] * q[3];
-    dq4x4(1, 2) = dq4x4(2, 1) = -q[1] * q[2];
-    dq4x4(1, 3) = dq4x4(3, 1) = -q[1] * q[3];
-    dq4x4(2, 3) = dq4x4(3, 2) = -q[2] * q[3];
-
-    Scalar q_mult = std::pow(Sqr(q[0]) + Sqr(q[1]) + Sqr(q[2]) + Sqr(q[3]), -1.5f);
-    dq4x4 *= q_mult;
-
-    auto& est_vars_covar = *src_estim_vars_covar;
-
-    auto q_up = (est_vars_covar.block<kEucl3, kQuat4>(0, kEucl3) * dq4x4.transpose()).eval();
-
-    auto q_down_size = est_vars_covar.rows() - kEucl3 - kQuat4;
-    auto& q_down = quat_normalization_cache_.P_down;
-    q_down.noalias() = est_vars_covar.block<Eigen::Dynamic, kQuat4>(kEucl3 + kQuat4, kEucl3, q_down_size, kQuat4) * dq4x4.transpose();
-
-    // mutate inplace
-    est_vars_covar.block<kEucl3, kQuat4>(0, kEucl3) = q_up;  // to the up
-    est_vars_covar.block<kQuat4, kEucl3>(kEucl3, 0) = q_up.transpose();  // to the left
-
-    // the central block is not mutated yet
-    est_vars_covar.block<kQuat4, kQuat4>(kEucl3, kEucl3) =
-        dq4x4 *
-        est_vars_covar.block<kQuat4, kQuat4>(kEucl3, kEucl3) *
-        dq4x4.transpose();
-
-    est_vars_covar.block<Eigen::Dynamic, kQuat4>(kEucl3 + kQuat4, kEucl3, q_down_size, kQuat4).noalias() = q_down;  // to the down
-    est_vars_covar.block<kQuat4, Eigen::Dynamic>(kEucl3, kEucl3 + kQuat4, kQuat4, q_down_size).noalias() = q_down.transpose();  // to the right
+    Point3 cam_orient_err = estim_vars_.middleRows<kOrientErrComps>(kEucl3);
+
+    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_err_quat;
+    QuatFromAxisAngle(cam_orient_err, &cam_orient_err_quat);
+
+    Eigen::Matrix<Scalar, kQuat4, 1> new_cam_orient_wfc_nominal;
+    QuatMult(cam_orient_wfc_nominal_, cam_orient_err_quat, &new_cam_orient_wfc_nominal);
+
+    // the product of unity quaternions is normalized only to stop the accumulation of rounding errors
+    cam_orient_wfc_nominal_ = new_cam_orient_wfc_nominal.normalized();
+    estim_vars_.middleRows<kOrientErrComps>(kEucl3).setZero();
+
+    // the predicted state shares the nominal orientation, hence its error is re-expressed too
+    if (predicted_estim_vars_.size() >= static_cast<Eigen::Index>(kCamStateComps))
+    {
+        Point3 pred_cam_orient_err = predicted_estim_vars_.middleRows<kOrientErrComps>(kEucl3);
+
+        Eigen::Matrix<Scalar, kQuat4, 1> pred_cam_orient_err_quat;
+        QuatFromAxisAngle(pred_cam_orient_err, &pred_cam_orient_err_quat);
+
+        Eigen::Matrix<Scalar, kQuat4, 1> new_pred_cam_orient_err_quat;
+        QuatMult(QuatInverse(cam_orient_err_quat), pred_cam_orient_err_quat, &new_pred_cam_orient_err_quat);
+
+        AxisAngleFromQuat(new_pred_cam_orient_err_quat, &pred_cam_orient_err);
+        predicted_estim_vars_.middleRows<kOrientErrComps>(kEucl3) = pred_cam_orient_err;
+    }
 }
 
 void DavisonMonoSlam::EnsureSalientPointPositiveInvDepth(EigenDynVec* src_estim_vars)
@@ -1722,20 +2955,146 @@ void DavisonMonoSlam::EnsureSalientPointPositiveInvDepth(EigenDynVec* src_estim_
     // doing it after all updates to the state have completed
     for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
     {
-        size_t sal_pnt_var_ind = SalientPointOffset(sal_pnt_ind);
-        MorphableSalientPoint morph_sal_pnt = LoadSalientPointDataFromSrcEstimVars(*src_estim_vars, sal_pnt_var_ind);
-        if (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+        const TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+        MorphableSalientPoint morph_sal_pnt = LoadSalientPointDataFromSrcEstimVars(*src_estim_vars, sal_pnt);
+        if (morph_sal_pnt.repres == SalPntComps::kSphericalFirstCamInvDist)
         {
             if (morph_sal_pnt.inverse_dist_rho < 0)
             {
                 //SRK_ASSERT(morph_sal_pnt.inverse_dist_rho >= -0.1) << "Got big negative estimated inverse depth";
                 DependsOnSalientPointPackOrder();
-                (*src_estim_vars)[sal_pnt_var_ind + kEucl3 + 2] = sal_pnt_negative_inv_rho_substitute_.value();  // +2 (=azim+elev) is offset of inv depth
+                size_t rho_var_ind = sal_pnt.estim_vars_ind + sal_pnt.EstimVarsCount() - kRho;  // inv depth is the last variable
+                (*src_estim_vars)[rho_var_ind] = sal_pnt_negative_inv_rho_substitute_.value();
             }
         }
     }
 }
 
+Scalar DavisonMonoSlam::GetSalientPointDepthLinearityIndex(const TrackedSalientPoint& sal_pnt) const
+{
+    // The linearity index of the depth of inverse depth salient point is L=4*std(d)/d1*|cos(alpha)|, where
+    // std(d)=std(rho)/rho^2 is the uncertainty of the depth, d1 is the distance from the current camera to the salient point,
+    // alpha is the angle between the rays to the salient point from the first and from the current camera.
+    // Small index means that the depth is estimated well enough for XYZ representation to be nearly linear.
+    // [Civera, Davison, Montiel "Inverse Depth Parametrization for Monocular SLAM", 2008, para 5]
+    SRK_ASSERT(sal_pnt.repres == SalPntComps::kSphericalFirstCamInvDist ||
+        sal_pnt.repres == SalPntComps::kSphericalAnchoredInvDist);
+    MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(estim_vars_, sal_pnt);
+
+    const Scalar rho = sal_pnt_vars.inverse_dist_rho;
+    if (rho <= 0)
+        return std::numeric_limits<Scalar>::infinity();  // the salient point is in infinity
+
+    DependsOnSalientPointPackOrder();
+    size_t rho_var_ind = sal_pnt.estim_vars_ind + sal_pnt.EstimVarsCount() - kRho;  // inv depth is the last variable
+    Scalar rho_std = std::sqrt(std::max<Scalar>(0, estim_vars_covar_(rho_var_ind, rho_var_ind)));
+    Scalar depth_std = rho_std / suriko::Sqr(rho);
+
+    Point3 m = CameraCoordinatesEuclidUnityDirFromPolarAngles(sal_pnt_vars.azimuth_theta_w, sal_pnt_vars.elevation_phi_w);
+    Point3 sal_pnt_pos_w = sal_pnt_vars.first_cam_pos_w + (1 / rho) * m;
+
+    DependsOnCameraPosPackOrder();
+    Point3 cam_pos_w{ estim_vars_[0], estim_vars_[1], estim_vars_[2] };
+
+    Point3 cam_to_sal_pnt = sal_pnt_pos_w - cam_pos_w;
+    Scalar dist = Norm(cam_to_sal_pnt);
+    if (IsClose(0, dist))
+        return std::numeric_limits<Scalar>::infinity();
+
+    Scalar cos_alpha = Dot(m, cam_to_sal_pnt) / dist;
+    return 4 * depth_std / dist * std::abs(cos_alpha);
+}
+
+void DavisonMonoSlam::SwitchSalientPointsToXyzRepresentation()
+{
+    if (!sal_pnt_switch_to_xyz_linearity_index_.has_value())
+        return;
+
+    size_t switched_count = 0;
+    for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
+    {
+        TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
+        if (sal_pnt.repres != SalPntComps::kSphericalFirstCamInvDist &&
+            sal_pnt.repres != SalPntComps::kSphericalAnchoredInvDist)
+            continue;
+
+        Scalar linearity_index = GetSalientPointDepthLinearityIndex(sal_pnt);
+        if (linearity_index >= sal_pnt_switch_to_xyz_linearity_index_.value())
+            continue;
+
+        VLOG(5) << "Switching SPind=" << sal_pnt_ind << " to XYZ, linearity index=" << linearity_index;
+
+        // the covariances of the salient point with all variables are transformed
+        if (switched_count == 0)
+            InvalidateCovarSqrt();
+
+        SwitchSalientPointToXyzRepresentation(sal_pnt, &estim_vars_, &estim_vars_covar_);
+
+        // XYZ salient point occupies the first variables of the inverse depth salient point, the rest variables are removed below
+        sal_pnt.repres = SalPntComps::kXyz;
+        if (sal_pnt.anchor != nullptr)
+        {
+            --sal_pnt.anchor->sal_pnts_count;
+            sal_pnt.anchor = nullptr;
+        }
+        ++switched_count;
+    }
+
+    if (switched_count > 0)
+    {
+        InvalidateCovarSqrt();
+        CompactEstimatedVars(std::vector<bool>(SalientPointsCount(), false));
+
+        // after the update the predicted state is a scratch space; it is kept of the same size as the estimated state
+        predicted_estim_vars_ = estim_vars_;
+        predicted_estim_vars_covar_ = estim_vars_covar_;
+    }
+
+    if (stats_logger_ != nullptr)
+        stats_logger_->CurStats().sal_pnts_switched_to_xyz = switched_count;
+
+    if (kSurikoDebug) CheckSalientPointsConsistency();
+}
+
+void DavisonMonoSlam::SwitchSalientPointToXyzRepresentation(const TrackedSalientPoint& sal_pnt,
+    EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar) const
+{
+    MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(*src_estim_vars, sal_pnt);
+
+    SphericalSalientPoint spher_sal_pnt;
+    CopyFrom(&spher_sal_pnt, sal_pnt_vars);
+
+    Point3 pos_w;
+    bool op = ConvertXyzFromSphericalSalientPoint(spher_sal_pnt, &pos_w);
+    SRK_ASSERT(op) << "Can't convert salient point in infinity into XYZ";
+
+    // the uncertainty is propagated by the Jacobian J of the conversion:
+    // Pnew=T*P*Tt, where T=diag(I,J,I) replaces the [6x6] block of the salient point with [3x3] block
+    Eigen::Matrix<Scalar, kXyzSalientPointComps, kSphericalSalientPointComps> xyz_by_spher;
+    DerivSalPnt_xyz_by_spher(spher_sal_pnt, &xyz_by_spher);
+
+    auto& P = *src_estim_vars_covar;
+
+    // [n,3] covariance between all variables and the XYZ salient point
+    Eigen::Matrix<Scalar, Eigen::Dynamic, kXyzSalientPointComps> covar_to_xyz;
+    covar_to_xyz.setZero(P.rows(), Eigen::NoChange);
+    ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+    {
+        covar_to_xyz.noalias() += P.middleCols(var_ind, vars_count) * xyz_by_spher.middleCols(sal_pnt_var_ind, vars_count).transpose();
+    });
+    Eigen::Matrix<Scalar, kXyzSalientPointComps, kXyzSalientPointComps> xyz_autocovar =
+        xyz_by_spher * GetSalientPointsCovar(P, sal_pnt, sal_pnt) * xyz_by_spher.transpose();
+
+    // XYZ salient point is put in place of the first own variables of the salient point;
+    // the anchor of the anchored salient point is kept, because it may be shared with other salient points
+    const size_t off = sal_pnt.estim_vars_ind;
+    src_estim_vars->middleRows<kXyzSalientPointComps>(off) = Mat(pos_w);
+
+    P.middleCols<kXyzSalientPointComps>(off) = covar_to_xyz;
+    P.middleRows<kXyzSalientPointComps>(off) = covar_to_xyz.transpose();
+    P.block<kXyzSalientPointComps, kXyzSalientPointComps>(off, off) = xyz_autocovar;
+}
+
 void DavisonMonoSlam::EnsureNonnegativeStateVariance(EigenDynMat* src_estim_vars_covar)
 {
     // zeroize tiny negative numbers on diagonal of error covariance (may appear when subtracting tiny numbers)
@@ -1751,6 +3110,7 @@ void DavisonMonoSlam::EnsureNonnegativeStateVariance(EigenDynMat* src_estim_vars
 
 void DavisonMonoSlam::OnEstimVarsChanged(size_t frame_ind)
 {
+    InjectCameraOrientationError();
 }
 
 void DavisonMonoSlam::FinishFrameStats(size_t frame_ind)
@@ -1773,8 +3133,17 @@ void DavisonMonoSlam::FinishFrameStats(size_t frame_ind)
     Eigen::Matrix<Scalar, kCam, kCam> cam_state_covar;
     GetCameraEstimatedVarsUncertainty(&cam_state_covar);
 
-    cur_stats.cam_state = estim_vars_.topRows<kCamStateComps>();
-    cur_stats.cam_state_gt = estim_vars_covar_.topLeftCorner<kCamStateComps, kCamStateComps>().diagonal().array().sqrt();
+    // the camera orientation is logged as a quaternion rather than as an error relative to the nominal orientation
+    auto cam_state_as_quat_vector = [](const CameraStateVars& s)
+    {
+        Eigen::Matrix<Scalar, DavisonMonoSlamTrackerInternalsSlice::kCamStateQuatComps, 1> result;
+        result.middleRows<kEucl3>(0) = s.pos_w;
+        result.middleRows<kQuat4>(kEucl3) = s.orientation_wfc;
+        result.middleRows<kVelocComps>(kEucl3 + kQuat4) = s.velocity_w;
+        result.middleRows<kAngVelocComps>(kEucl3 + kQuat4 + kVelocComps) = s.angular_velocity_c;
+        return result;
+    };
+    cur_stats.cam_state = cam_state_as_quat_vector(cam_state);
 
     cur_stats.sal_pnts_uncert_median = GetRepresentiveSalientPointUncertainty(this);
 
@@ -1788,85 +3157,547 @@ void DavisonMonoSlam::FinishFrameStats(size_t frame_ind)
         std::vector<SphericalSalientPointWithBuildInfo> gt_sal_pnt_build_infos;
         GetGroundTruthEstimVars(frame_ind, &gt_cam_state, &gt_sal_pnt_build_infos);
 
-        std::vector<MorphableSalientPoint> gt_sal_pnts;
-        ConvertMorphableFromSphericalSalientPoints(gt_sal_pnt_build_infos, kSalPntRepres, &gt_sal_pnts);
+        std::vector<MorphableSalientPoint> gt_sal_pnts;
+        ConvertMorphableFromSphericalSalientPoints(gt_sal_pnt_build_infos, &gt_sal_pnts);
+
+        // estimated variables
+        EigenDynVec gt_measured_estim_vars;
+        gt_measured_estim_vars.resizeLike(estim_vars_);
+        SaveEstimVars(gt_cam_state, gt_sal_pnts, &gt_measured_estim_vars);
+
+        cur_stats.cam_state_gt = cam_state_as_quat_vector(gt_cam_state);
+
+        EigenDynVec estim_errs = estim_vars_ - gt_measured_estim_vars;
+        cur_stats.estim_err = estim_errs;
+
+        // check that optimal estimate and its error are uncorrelated E[x_hat*x_err']=0
+        Scalar est_mul_err = (estim_vars_ * estim_errs.transpose()).norm();
+        cur_stats.optimal_estim_mul_err = est_mul_err;
+    }
+
+    stats_logger_->PushCurFrameStats();
+}
+
+void DavisonMonoSlam::PublishState(size_t frame_ind)
+{
+    // the spare snapshot is accessed only by the tracker; its storage is reused from frame to frame
+    if (spare_published_state_ == nullptr)
+        spare_published_state_ = std::make_shared<DavisonMonoSlamPublishedState>();
+    DavisonMonoSlamPublishedState* state = spare_published_state_.get();
+
+    state->version = ++published_state_version_;
+    state->frame_ind = frame_ind;
+    state->cam_state = GetCameraEstimatedVars();
+    state->cam_pos_uncert = estim_vars_covar_.topLeftCorner<kEucl3, kEucl3>();
+
+    state->sal_pnts.clear();
+    state->sal_pnts.reserve(SalientPointsCount());
+
+    // uncertainty ellipses of the estimated and predicted (search area) projections
+    constexpr std::array<FilterStageType, 2> ellipse_stages = { FilterStageType::Estimated, FilterStageType::Predicted };
+    SymMat2x2Batch ellipse_covars;
+    std::vector<Eigen::Matrix<Scalar, kPixPosComps, 1>> ellipse_means;
+    std::vector<std::pair<size_t, size_t>> ellipse_owners;  // [index of the published salient point, index of the stage]
+    std::vector<std::optional<RotatedEllipse2D>> ellipses;
+    for (const auto& p_sal_pnt : sal_pnts_)
+    {
+        const TrackedSalientPoint& sal_pnt = *p_sal_pnt;
+        if (sal_pnt.IsDeleted()) continue;
+
+        SalPntId sal_pnt_id{ p_sal_pnt.get() };
+
+        PublishedSalientPoint pub{};
+        pub.sal_pnt_id = sal_pnt_id;
+        pub.sal_pnt_ind = sal_pnt.sal_pnt_ind;
+        pub.track_status = sal_pnt.track_status;
+        pub.templ_center_pix = sal_pnt.templ_center_pix_;
+        pub.initial_templ_gray = sal_pnt.initial_templ_gray_;
+#if defined(SRK_DEBUG)
+        pub.initial_templ_bgr_debug = sal_pnt.initial_templ_bgr_debug;
+#endif
+
+        Point3 pos_w;
+        if (GetSalientPointEstimated3DPosWithUncertaintyNew(sal_pnt_id, &pos_w, &pub.pos_uncert))
+            pub.pos_w = pos_w;
+
+        // the ellipses are extracted for all salient points at once, below
+        for (size_t stage_ind = 0; stage_ind < ellipse_stages.size(); ++stage_ind)
+        {
+            if (auto [op, corner] = GetSalientPointProjectedUncertEllipseCovar(ellipse_stages[stage_ind], sal_pnt_id); op)
+            {
+                ellipse_covars.PushBack(corner.cov);
+                ellipse_means.push_back(corner.mean);
+                ellipse_owners.push_back({ state->sal_pnts.size(), stage_ind });
+            }
+        }
+
+        if (sal_pnt.IsDetected())
+            pub.templ_rect_w = ProtrudeSalientTemplateIntoWorld(sal_pnt_id);
+        state->sal_pnts.push_back(std::move(pub));
+    }
+
+    Get2DRotatedEllipsesFromCovMats(ellipse_covars, ellipse_means, covar2D_to_ellipse_confidence_, &ellipses);
+    for (size_t i = 0; i < ellipses.size(); ++i)
+    {
+        auto [pub_ind, stage_ind] = ellipse_owners[i];
+        PublishedSalientPoint& pub = state->sal_pnts[pub_ind];
+        (stage_ind == 0 ? pub.estim_ellipse_pix : pub.predicted_ellipse_pix) = ellipses[i];
+    }
+
+    std::shared_ptr<const DavisonMonoSlamPublishedState> prev_state = std::atomic_exchange(&published_state_,
+        std::shared_ptr<const DavisonMonoSlamPublishedState>{ std::move(spare_published_state_) });
+
+    // the previous snapshot is reused only if no reader holds it; it is unreachable for new readers after the exchange
+    if (prev_state != nullptr && prev_state.use_count() == 1)
+        spare_published_state_ = std::const_pointer_cast<DavisonMonoSlamPublishedState>(std::move(prev_state));
+}
+
+std::shared_ptr<const DavisonMonoSlamPublishedState> DavisonMonoSlam::GetPublishedState() const
+{
+    return std::atomic_load(&published_state_);
+}
+
+size_t DavisonMonoSlam::RecruitNewSalientPoints(size_t frame_ind, const Picture& image,
+    const std::vector<std::pair<SalPntId, CornersMatcherBlobId>>& matched_sal_pnts)
+{
+    // eagerly try allocate new salient points
+    std::vector<CornersMatcherBlobId> new_blobs;
+    if (sal_pnt_candidates_.empty())
+        this->corners_matcher_->RecruitNewSalientPoints(*this, GetSalientPoints(), matched_sal_pnts, frame_ind, image, &new_blobs);
+    else
+    {
+        // prevent recruiting the blobs of candidates again
+        std::set<SalPntId> tracking_sal_pnts = GetSalientPoints();
+        for (const auto& p_candidate : sal_pnt_candidates_)
+            tracking_sal_pnts.insert(SalPntId{ p_candidate->sal_pnt.get() });
+        this->corners_matcher_->RecruitNewSalientPoints(*this, tracking_sal_pnts, matched_sal_pnts, frame_ind, image, &new_blobs);
+    }
+    if (new_blobs.empty())
+        return 0;
+
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+
+    // all new salient points share the same anchor, which is allocated along with the first of them
+    SalPntAnchor* anchor = nullptr;
+
+    // the depth of a candidate is inferred from the camera motion, hence the initial salient points, against which the camera
+    // is localized, go directly into the state
+    std::optional<Scalar> map_median_dist;
+    if (sal_pnt_candidate_min_frames_.has_value())
+        map_median_dist = GetSalientPointsMedianDistance(cam_state.pos_w);
+    bool to_candidate_pool = map_median_dist.has_value();
+    size_t new_candidates_count = 0;
+
+    for (auto blob_id : new_blobs)
+    {
+        if (debug_max_sal_pnt_coun_.has_value() &&
+            SalientPointsCount() >= debug_max_sal_pnt_coun_.value()) break;
+        if (!to_candidate_pool && SalientPointsBudgetRoom() == 0) break;
+
+        Point2f coord = corners_matcher_->GetBlobCoord(blob_id);
+
+        std::optional<Scalar> pnt_inv_dist_gt;
+        if (sal_pnt_perfect_init_inv_dist_)
+        {
+            pnt_inv_dist_gt = corners_matcher_->GetSalientPointGroundTruthInvDepth(blob_id);
+        }
+
+        TemplMatchStats templ_stats{};
+        Picture templ_img = corners_matcher_->GetBlobTemplate(blob_id, image, sal_pnt_templ_size_);
+        if (!CalcTemplMatchStats(templ_img, &templ_stats))
+            continue;
+
+        if (to_candidate_pool)
+        {
+            // the salient point is tracked outside of the state, until its depth converges
+            auto new_sal_pnt = NewSalientPointDescriptor(frame_ind, coord, std::move(templ_img), templ_stats);
+            SalPntId sal_pnt_id = SalPntId(new_sal_pnt.get());
+            AddSalientPointCandidate(frame_ind, cam_state, coord, map_median_dist.value(), std::move(new_sal_pnt));
+            corners_matcher_->OnSalientPointIsAssignedToBlobId(sal_pnt_id, blob_id, image);
+            ++new_candidates_count;
+            continue;
+        }
+
+        if (anchor == nullptr && sal_pnt_shared_anchor_ && kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+            anchor = AddSalientPointAnchor(frame_ind);
+
+        // current camera frame is the 'first' camera where a salient point is seen the first time: first_cam=cur_cam
+        SalPntId sal_pnt_id = AddSalientPoint(frame_ind, cam_state, coord, templ_img, templ_stats, pnt_inv_dist_gt, anchor);
+        corners_matcher_->OnSalientPointIsAssignedToBlobId(sal_pnt_id, blob_id, image);
+    }
+
+    if (kSurikoDebug) CheckCameraAndSalientPointsCovs(estim_vars_, estim_vars_covar_);  // TODO: seems unnecessary
+
+    // now the estimated variables are changed, the dependent predicted variables must be updated too
+    predicted_estim_vars_.resizeLike(estim_vars_);
+    predicted_estim_vars_covar_.resizeLike(estim_vars_covar_);
+    return new_blobs.size() - new_candidates_count;
+}
+
+bool DavisonMonoSlam::CalcTemplMatchStats(const Picture& templ_img, TemplMatchStats* templ_stats) const
+{
+    if (templ_img.gray.empty())
+        return true;  // the template is not used for matching
+
+    // calculate the statistics of this template (mean and variance), used for matching templates
+    auto templ_roi = Recti{ 0, 0, sal_pnt_templ_size_.width, sal_pnt_templ_size_.height };
+    Scalar templ_mean = GetGrayImageMean(templ_img.gray, templ_roi);
+    Scalar templ_sum_sqr_diff = GetGrayImageSumSqrDiff(templ_img.gray, templ_roi, templ_mean);
+
+    // correlation coefficient is undefined for templates with zero variance (because variance goes into the denominator of corr coef)
+    if (IsClose(0, templ_sum_sqr_diff))
+        return false;
+
+    templ_stats->templ_mean_ = templ_mean;
+    templ_stats->templ_sqrt_sum_sqr_diff_ = std::sqrt(templ_sum_sqr_diff);
+    return true;
+}
+
+void DavisonMonoSlam::AddSalientPointCandidate(size_t frame_ind, const CameraStateVars& cam_state, suriko::Point2f corner_pix,
+    Scalar map_median_dist, std::unique_ptr<TrackedSalientPoint> sal_pnt)
+{
+    auto candidate = std::make_unique<SalPntCandidate>();
+    candidate->first_frame_ind = frame_ind;
+
+    SphericalSalientPointIntermProjVars interm_proj_vars;
+    candidate->ray = GetNewSphericalSalientPointState(cam_state, corner_pix, std::nullopt, &interm_proj_vars);
+
+    // hypotheses are uniformly distributed in inverse depth, so that their projections are evenly spaced along the epipolar line
+    const size_t hyps_count = sal_pnt_candidate_depth_hypotheses_;
+    SRK_ASSERT(hyps_count >= 2);
+    SRK_ASSERT(sal_pnt_candidate_min_depth_ratio_ > 0 && sal_pnt_candidate_min_depth_ratio_ < sal_pnt_candidate_max_depth_ratio_);
+    Scalar min_rho = 1 / (sal_pnt_candidate_max_depth_ratio_ * map_median_dist);
+    Scalar max_rho = 1 / (sal_pnt_candidate_min_depth_ratio_ * map_median_dist);
+
+    candidate->inv_dist_hypotheses.resize(hyps_count);
+    for (size_t i = 0; i < hyps_count; ++i)
+        candidate->inv_dist_hypotheses[i] = min_rho + (max_rho - min_rho) * i / (hyps_count - 1);
+    candidate->hypotheses_weights.assign(hyps_count, Scalar{ 1 } / hyps_count);
+
+    sal_pnt->in_candidate_pool = true;
+    candidate->sal_pnt = std::move(sal_pnt);
+    sal_pnt_candidates_.push_back(std::move(candidate));
+}
+
+void DavisonMonoSlam::ExtractMatchedSalientPointCandidates(std::vector<std::pair<SalPntId, CornersMatcherBlobId>>* matched_sal_pnts)
+{
+    // candidates are tracked outside of the state, hence their observations don't go into the filter
+    auto candidates_it = std::stable_partition(matched_sal_pnts->begin(), matched_sal_pnts->end(),
+        [this](const auto& match) { return !GetSalientPoint(match.first).in_candidate_pool; });
+
+    for (auto it = candidates_it; it != matched_sal_pnts->end(); ++it)
+    {
+        auto [sal_pnt_id, blob_id] = *it;
+        TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+        sal_pnt.track_status = SalPntTrackStatus::Matched;
+        sal_pnt.SetTemplCenterPix(corners_matcher_->GetBlobCoord(blob_id), sal_pnt_templ_size_);
+    }
+    matched_sal_pnts->erase(candidates_it, matched_sal_pnts->end());
+}
+
+void DavisonMonoSlam::UpdateSalientPointCandidates(size_t frame_ind)
+{
+    // the candidate is discarded when it is missed too often, when none of hypotheses explains the observation
+    // or when its depth doesn't converge for a long time
+    auto discard = [this, frame_ind](std::unique_ptr<SalPntCandidate>& p_candidate)
+    {
+        if (!p_candidate->sal_pnt->IsDetected())
+        {
+            // no observation, the hypotheses are kept intact
+            ++p_candidate->missed_frames_count;
+            if (p_candidate->missed_frames_count > sal_pnt_candidate_max_missed_frames_)
+                return true;
+        }
+        else if (!ReweightSalientPointCandidateHypotheses(p_candidate.get()))
+            return true;
+
+        // the converged depth, which is on the bound of the range of hypotheses, may be out of the range
+        if (IsSalientPointCandidateDepthOnRangeBound(*p_candidate) && IsSalientPointCandidateDepthConverged(*p_candidate))
+            return true;
+
+        return frame_ind - p_candidate->first_frame_ind >= sal_pnt_candidate_max_frames_;
+    };
+    auto discard_it = std::partition(sal_pnt_candidates_.begin(), sal_pnt_candidates_.end(),
+        [&discard](std::unique_ptr<SalPntCandidate>& p_candidate) { return !discard(p_candidate); });
+    if (corners_matcher_ != nullptr)
+        for (auto it = discard_it; it != sal_pnt_candidates_.end(); ++it)
+            corners_matcher_->OnSalientPointIsRemoved(SalPntId((*it)->sal_pnt.get()));
+    sal_pnt_candidates_.erase(discard_it, sal_pnt_candidates_.end());
+}
+
+bool DavisonMonoSlam::ReweightSalientPointCandidateHypotheses(SalPntCandidate* candidate) const
+{
+    std::vector<std::optional<suriko::Point2f>> hypotheses_pix;
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> cam_uncert;
+    if (!ProjectSalientPointCandidateHypotheses(estim_vars_, estim_vars_covar_, *candidate, &hypotheses_pix, &cam_uncert))
+        return false;
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
+    FillRk2x2(&Rk);
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> innov_var_inv = (cam_uncert + Rk).inverse();
+
+    // Bayes rule: the weight of a hypothesis is multiplied by the likelihood of the observation, given the hypothesis
+    const Eigen::Matrix<Scalar, kPixPosComps, 1> corner_pix = candidate->sal_pnt->templ_center_pix_.value().Mat();
+    Scalar weights_sum = 0;
+    for (size_t i = 0; i < hypotheses_pix.size(); ++i)
+    {
+        Scalar& weight = candidate->hypotheses_weights[i];
+        if (!hypotheses_pix[i].has_value())
+        {
+            weight = 0;  // the hypothesis is behind the camera
+            continue;
+        }
+
+        Eigen::Matrix<Scalar, kPixPosComps, 1> innov = corner_pix - hypotheses_pix[i].value().Mat();
+        weight *= std::exp(-innov.dot(innov_var_inv * innov) / 2);
+        weights_sum += weight;
+    }
+
+    if (!(weights_sum > 0))
+        return false;
+
+    for (Scalar& weight : candidate->hypotheses_weights)
+        weight /= weights_sum;
+    return true;
+}
+
+std::tuple<Scalar, Scalar> DavisonMonoSlam::GetSalientPointCandidateDistance(const SalPntCandidate& candidate, const Point3& pos_w) const
+{
+    Point3 m = CameraCoordinatesEuclidUnityDirFromPolarAngles(candidate.ray.azimuth_theta_w, candidate.ray.elevation_phi_w);
+
+    // hypotheses are evenly spaced in inverse depth; the interval of one hypothesis spans drho/rho^2 in depth,
+    // which is uniformly distributed with variance=len^2/12
+    const Scalar inv_dist_step = candidate.inv_dist_hypotheses[1] - candidate.inv_dist_hypotheses[0];
+
+    Scalar dist_mean = 0;
+    Scalar dist_sqr_mean = 0;
+    Scalar interval_var = 0;
+    for (size_t i = 0; i < candidate.inv_dist_hypotheses.size(); ++i)
+    {
+        Scalar inv_dist = candidate.inv_dist_hypotheses[i];
+        Point3 sal_pnt_pos_w = candidate.ray.first_cam_pos_w + (1 / inv_dist) * m;
+        Scalar dist = Norm(sal_pnt_pos_w - pos_w);
+
+        Scalar weight = candidate.hypotheses_weights[i];
+        dist_mean += weight * dist;
+        dist_sqr_mean += weight * suriko::Sqr(dist);
+        interval_var += weight * suriko::Sqr(inv_dist_step / suriko::Sqr(inv_dist)) / 12;
+    }
+    Scalar dist_std = std::sqrt(std::max<Scalar>(0, dist_sqr_mean - suriko::Sqr(dist_mean)) + interval_var);
+    return std::make_tuple(dist_mean, dist_std);
+}
+
+bool DavisonMonoSlam::IsSalientPointCandidateDepthConverged(const SalPntCandidate& candidate) const
+{
+    auto [depth, depth_std] = GetSalientPointCandidateDistance(candidate, candidate.ray.first_cam_pos_w);
+    return depth_std < sal_pnt_candidate_depth_converged_ratio_ * depth;
+}
+
+bool DavisonMonoSlam::IsSalientPointCandidateDepthOnRangeBound(const SalPntCandidate& candidate)
+{
+    const auto& weights = candidate.hypotheses_weights;
+    auto most_probable_it = std::max_element(weights.begin(), weights.end());
+    return most_probable_it == weights.begin() || most_probable_it == weights.end() - 1;
+}
+
+std::optional<Scalar> DavisonMonoSlam::GetSalientPointsMedianDistance(const Point3& pos_w) const
+{
+    std::vector<Scalar> dists;
+    dists.reserve(SalientPointsCount());
+    for (const auto& sal_pnt : sal_pnts_)
+    {
+        Point3 pos_mean;
+        bool op = GetSalientPoint3DPosWithUncertainty(estim_vars_, estim_vars_covar_, *sal_pnt, false, &pos_mean, nullptr);
+        if (!op) continue;  // the salient point in infinity
+
+        dists.push_back(Norm(pos_mean - pos_w));
+    }
+    if (dists.empty())
+        return std::nullopt;
+
+    auto median_it = dists.begin() + dists.size() / 2;
+    std::nth_element(dists.begin(), median_it, dists.end());
+    return *median_it;
+}
+
+size_t DavisonMonoSlam::PromoteSalientPointCandidates(size_t frame_ind)
+{
+    if (sal_pnt_candidates_.empty())
+        return 0;
+
+    auto ready_to_promote = [this, frame_ind](const std::unique_ptr<SalPntCandidate>& p_candidate)
+    {
+        if (frame_ind - p_candidate->first_frame_ind < sal_pnt_candidate_min_frames_.value_or(0))
+            return false;
+
+        // the salient point is initialized from its observation in current frame
+        if (!p_candidate->sal_pnt->IsDetected())
+            return false;
+
+        return IsSalientPointCandidateDepthConverged(*p_candidate);
+    };
+    auto promote_it = std::stable_partition(sal_pnt_candidates_.begin(), sal_pnt_candidates_.end(),
+        [&ready_to_promote](const auto& p_candidate) { return !ready_to_promote(p_candidate); });
+
+    // the rest of candidates wait until there is room in the budget of salient points
+    const size_t promote_count = std::min<size_t>(std::distance(promote_it, sal_pnt_candidates_.end()), SalientPointsBudgetRoom());
+    promote_it = sal_pnt_candidates_.end() - promote_count;
+    if (promote_count == 0)
+        return 0;
+
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+
+    // the candidates are initialized in the current camera, hence they may share the anchor
+    SalPntAnchor* anchor = nullptr;
+    if (sal_pnt_shared_anchor_ && kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+        anchor = AddSalientPointAnchor(frame_ind);
+    SalPntComps sal_pnt_repres = anchor != nullptr ? SalPntComps::kSphericalAnchoredInvDist : kSalPntRepres;
 
-        // estimated variables
-        EigenDynVec gt_measured_estim_vars;
-        gt_measured_estim_vars.resizeLike(estim_vars_);
-        SaveEstimVars(gt_cam_state, gt_sal_pnts, &gt_measured_estim_vars);
+    // batch augmentation: the state is resized once for all promoted salient points
+    const size_t vars_count_before = EstimatedVarsCount();
+    const size_t vars_count_after = vars_count_before + promote_count * SalientPointVarsCount(sal_pnt_repres);
+    estim_vars_.conservativeResize(vars_count_after);
+    estim_vars_covar_.conservativeResize(vars_count_after, vars_count_after);
+
+    std::vector<size_t> sal_pnt_var_inds;
+    size_t sal_pnt_var_ind = vars_count_before;
+    for (auto it = promote_it; it != sal_pnt_candidates_.end(); ++it)
+    {
+        const SalPntCandidate& candidate = **it;
 
-        cur_stats.cam_state_gt = gt_measured_estim_vars.topRows<kCamStateComps>();
+        // the distance to the salient point is taken from the hypotheses of its depth
+        auto [dist, dist_std] = GetSalientPointCandidateDistance(candidate, cam_state.pos_w);
+        Scalar inv_dist = 1 / dist;
+        Scalar inv_dist_std = dist_std / suriko::Sqr(dist);
 
-        EigenDynVec estim_errs = estim_vars_ - gt_measured_estim_vars;
-        cur_stats.estim_err = estim_errs;
+        suriko::Point2f corner_pix = candidate.sal_pnt->templ_center_pix_.value();
+        InitStateForNewSalientPoint(sal_pnt_var_ind, sal_pnt_repres, cam_state, corner_pix, std::nullopt, inv_dist, inv_dist_std);
 
-        // check that optimal estimate and its error are uncorrelated E[x_hat*x_err']=0
-        Scalar est_mul_err = (estim_vars_ * estim_errs.transpose()).norm();
-        cur_stats.optimal_estim_mul_err = est_mul_err;
+        sal_pnt_var_inds.push_back(sal_pnt_var_ind);
+        sal_pnt_var_ind += SalientPointVarsCount(sal_pnt_repres);
     }
 
-    stats_logger_->PushCurFrameStats();
+    for (size_t i = 0; i < promote_count; ++i)
+    {
+        std::unique_ptr<TrackedSalientPoint> sal_pnt = std::move((*(promote_it + i))->sal_pnt);
+        sal_pnt->in_candidate_pool = false;
+        InsertSalientPointDescriptor(std::move(sal_pnt), sal_pnt_var_inds[i], sal_pnt_repres, anchor);
+    }
+    sal_pnt_candidates_.erase(promote_it, sal_pnt_candidates_.end());
+
+    // now the estimated variables are changed, the dependent predicted variables must be updated too
+    predicted_estim_vars_.resizeLike(estim_vars_);
+    predicted_estim_vars_covar_.resizeLike(estim_vars_covar_);
+    return promote_count;
 }
 
-size_t DavisonMonoSlam::RecruitNewSalientPoints(size_t frame_ind, const Picture& image,
-    const std::vector<std::pair<SalPntId, CornersMatcherBlobId>>& matched_sal_pnts)
+const DavisonMonoSlam::SalPntCandidate* DavisonMonoSlam::FindSalientPointCandidate(const TrackedSalientPoint& sal_pnt) const
 {
-    // eagerly try allocate new salient points
-    std::vector<CornersMatcherBlobId> new_blobs;
-    this->corners_matcher_->RecruitNewSalientPoints(*this, GetSalientPoints(), matched_sal_pnts, frame_ind, image, &new_blobs);
-    if (new_blobs.empty())
-        return 0;
+    auto it = std::find_if(sal_pnt_candidates_.begin(), sal_pnt_candidates_.end(),
+        [&sal_pnt](const auto& p_candidate) { return p_candidate->sal_pnt.get() == &sal_pnt; });
+    return it != sal_pnt_candidates_.end() ? it->get() : nullptr;
+}
 
+bool DavisonMonoSlam::ProjectSalientPointCandidateHypotheses(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+    const SalPntCandidate& candidate,
+    std::vector<std::optional<suriko::Point2f>>* hypotheses_pix,
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>* cam_uncert) const
+{
     CameraStateVars cam_state;
-    LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+    LoadCameraStateVarsFromArray(Span(src_estim_vars, kCamStateComps), &cam_state);
 
-    for (auto blob_id : new_blobs)
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
+    RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
+
+    MorphableSalientPoint hyp_vars;
+    hyp_vars.repres = SalPntComps::kSphericalFirstCamInvDist;
+    hyp_vars.first_cam_pos_w = candidate.ray.first_cam_pos_w;
+    hyp_vars.azimuth_theta_w = candidate.ray.azimuth_theta_w;
+    hyp_vars.elevation_phi_w = candidate.ray.elevation_phi_w;
+
+    Scalar mean_inv_dist = 0;
+    hypotheses_pix->resize(candidate.inv_dist_hypotheses.size());
+    for (size_t i = 0; i < candidate.inv_dist_hypotheses.size(); ++i)
     {
-        if (debug_max_sal_pnt_coun_.has_value() &&
-            SalientPointsCount() >= debug_max_sal_pnt_coun_.value()) break;
+        hyp_vars.inverse_dist_rho = candidate.inv_dist_hypotheses[i];
+        mean_inv_dist += candidate.hypotheses_weights[i] * hyp_vars.inverse_dist_rho;
 
-        Point2f coord = corners_matcher_->GetBlobCoord(blob_id);
+        SalPntProjectionIntermidVars proj_hist{};
+        Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, hyp_vars, &proj_hist);
 
-        std::optional<Scalar> pnt_inv_dist_gt;
-        if (sal_pnt_perfect_init_inv_dist_)
-        {
-            pnt_inv_dist_gt = corners_matcher_->GetSalientPointGroundTruthInvDepth(blob_id);
-        }
+        // the hypothesis behind the camera has no projection
+        (*hypotheses_pix)[i] = std::nullopt;
+        if (proj_hist.hc[2] > 0)
+            (*hypotheses_pix)[i] = suriko::Point2f{ hd };
+    }
 
-        TemplMatchStats templ_stats{};
-        Picture templ_img = corners_matcher_->GetBlobTemplate(blob_id, image, sal_pnt_templ_size_);
-        if (!templ_img.gray.empty())
-        {
-            // calculate the statistics of this template (mean and variance), used for matching templates
-            auto templ_roi = Recti{ 0, 0, sal_pnt_templ_size_.width, sal_pnt_templ_size_.height };
-            Scalar templ_mean = GetGrayImageMean(templ_img.gray, templ_roi);
-            Scalar templ_sum_sqr_diff = GetGrayImageSumSqrDiff(templ_img.gray, templ_roi, templ_mean);
+    hyp_vars.inverse_dist_rho = mean_inv_dist;
 
-            // correlation coefficient is undefined for templates with zero variance (because variance goes into the denominator of corr coef)
-            if (IsClose(0, templ_sum_sqr_diff))
-                continue;
+    SalPntProjectionIntermidVars proj_hist{};
+    Eigen::Matrix<Scalar, kPixPosComps, 1> hd = ProjectInternalSalientPoint(cam_state, hyp_vars, &proj_hist);
+    if (proj_hist.hc[2] <= 0)
+        return false;
 
-            templ_stats.templ_mean_ = templ_mean;
-            templ_stats.templ_sqrt_sum_sqr_diff_ = std::sqrt(templ_sum_sqr_diff);
-        }
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> hd_by_hu;
+    Deriv_hd_by_hu(suriko::Point2f{ hd[0], hd[1] }, &hd_by_hu);
 
-        // current camera frame is the 'first' camera where a salient point is seen the first time: first_cam=cur_cam
-        SalPntId sal_pnt_id = AddSalientPoint(frame_ind, cam_state, coord, templ_img, templ_stats, pnt_inv_dist_gt);
-        corners_matcher_->OnSalientPointIsAssignedToBlobId(sal_pnt_id, blob_id, image);
+    Eigen::Matrix<Scalar, kPixPosComps, kEucl3> hu_by_hc;
+    Deriv_hu_by_hc(proj_hist, &hu_by_hc);
+
+    Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
+    Deriv_hd_by_camera_state(hyp_vars, cam_state, cam_orient_wfc, proj_hist, hd_by_hu, hu_by_hc, &hd_by_cam_state);
+
+    *cam_uncert = hd_by_cam_state * src_estim_vars_covar.topLeftCorner<kCamStateComps, kCamStateComps>() * hd_by_cam_state.transpose();
+    return true;
+}
+
+auto DavisonMonoSlam::GetSalientPointCandidateProjected2DPosWithUncertainty(const EigenDynVec& src_estim_vars, const EigenDynMat& src_estim_vars_covar,
+    const SalPntCandidate& candidate) const -> std::tuple<bool, MeanAndCov2D>
+{
+    std::vector<std::optional<suriko::Point2f>> hypotheses_pix;
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> cam_uncert;
+    if (!ProjectSalientPointCandidateHypotheses(src_estim_vars, src_estim_vars_covar, candidate, &hypotheses_pix, &cam_uncert))
+        return std::make_tuple(false, MeanAndCov2D{});
+
+    // the projections of the hypotheses spread along the epipolar line
+    Scalar weights_sum = 0;
+    Eigen::Matrix<Scalar, kPixPosComps, 1> mean = Eigen::Matrix<Scalar, kPixPosComps, 1>::Zero();
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> second_moment = Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>::Zero();
+    for (size_t i = 0; i < hypotheses_pix.size(); ++i)
+    {
+        if (!hypotheses_pix[i].has_value()) continue;
+
+        Scalar weight = candidate.hypotheses_weights[i];
+        const auto hd = hypotheses_pix[i].value().Mat();
+        weights_sum += weight;
+        mean += weight * hd;
+        second_moment += weight * hd * hd.transpose();
     }
+    if (!(weights_sum > 0))
+        return std::make_tuple(false, MeanAndCov2D{});
 
-    if (kSurikoDebug) CheckCameraAndSalientPointsCovs(estim_vars_, estim_vars_covar_);  // TODO: seems unnecessary
+    MeanAndCov2D result;
+    result.mean = mean / weights_sum;
+    result.cov = second_moment / weights_sum - result.mean * result.mean.transpose() + cam_uncert;
 
-    // now the estimated variables are changed, the dependent predicted variables must be updated too
-    predicted_estim_vars_.resizeLike(estim_vars_);
-    predicted_estim_vars_covar_.resizeLike(estim_vars_covar_);
-    return new_blobs.size();
+    // the rounding errors of the sum, which is of the order of the spread along the epipolar line, break the symmetry
+    FixAlmostSymmetricMat(&result.cov);
+    return std::make_tuple(true, result);
 }
 
 void DavisonMonoSlam::PredictStateAndCovariance()
 {
     // make predictions
+    if (CovarSqrtForm())
+    {
+        // salient points may have been added to the state since the update
+        SyncCovarSqrt(estim_vars_covar_, &estim_vars_covar_sqrt_);
+        PredictEstimVars(estim_vars_, estim_vars_covar_, &predicted_estim_vars_, &predicted_estim_vars_covar_,
+            &estim_vars_covar_sqrt_, &predicted_estim_vars_covar_sqrt_);
+        return;
+    }
     PredictEstimVars(estim_vars_, estim_vars_covar_, &predicted_estim_vars_, &predicted_estim_vars_covar_);
 }
 
@@ -1981,21 +3812,24 @@ void DavisonMonoSlam::GetGroundTruthEstimVars(size_t frame_ind,
 void DavisonMonoSlam::SetCamStateCovarToGroundTruth(EigenDynMat* src_estim_vars_covar) const
 {
     auto& est_covar = *src_estim_vars_covar;
-    const Scalar cam_orient_q_variance = suriko::Sqr(cam_orient_q_comp_std_);
+    const Scalar cam_orient_err_variance = CameraOrientationErrorVariance();
     const Scalar cam_vel_variance = suriko::Sqr(cam_vel_std_);
     const Scalar cam_ang_vel_variance = suriko::Sqr(cam_ang_vel_std_);
     est_covar(0, 0) = suriko::Sqr(cam_pos_x_std_m_);
     est_covar(1, 1) = suriko::Sqr(cam_pos_y_std_m_);
     est_covar(2, 2) = suriko::Sqr(cam_pos_z_std_m_);
-    est_covar(3, 3) = cam_orient_q_variance;
-    est_covar(4, 4) = cam_orient_q_variance;
-    est_covar(5, 5) = cam_orient_q_variance;
-    est_covar(6, 6) = cam_vel_variance;
-    est_covar(7, 7) = cam_vel_variance;
-    est_covar(8, 8) = cam_vel_variance;
-    est_covar(6, 6) = cam_ang_vel_variance;
-    est_covar(7, 7) = cam_ang_vel_variance;
-    est_covar(8, 8) = cam_ang_vel_variance;
+    est_covar(3, 3) = cam_orient_err_variance;
+    est_covar(4, 4) = cam_orient_err_variance;
+    est_covar(5, 5) = cam_orient_err_variance;
+    if constexpr (kCamStateHasVelocity)
+    {
+        est_covar(6, 6) = cam_vel_variance;
+        est_covar(7, 7) = cam_vel_variance;
+        est_covar(8, 8) = cam_vel_variance;
+        est_covar(9, 9) = cam_ang_vel_variance;
+        est_covar(10, 10) = cam_ang_vel_variance;
+        est_covar(11, 11) = cam_ang_vel_variance;
+    }
 }
 
 Eigen::Matrix<Scalar, kEucl3, kEucl3> DavisonMonoSlam::GetDefaultXyzSalientPointCovar() const
@@ -2026,13 +3860,14 @@ void DavisonMonoSlam::SetEstimStateCovarInEstimSpace(size_t frame_ind)
     for (size_t sal_pnt_ind = 0; sal_pnt_ind < SalientPointsCount(); ++sal_pnt_ind)
     {
         size_t sal_pnt_offset = SalientPointOffset(sal_pnt_ind);
+        SalPntComps sal_pnt_repres = sal_pnts_[sal_pnt_ind]->repres;
 
-        if (kSalPntRepres == SalPntComps::kXyz)
+        if (sal_pnt_repres == SalPntComps::kXyz)
         {
             auto xyz_sal_pnt_covar = GetDefaultXyzSalientPointCovar();
             estim_vars_covar_.block<kEucl3, kEucl3>(sal_pnt_offset, sal_pnt_offset) = xyz_sal_pnt_covar;
         }
-        else if (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+        else if (sal_pnt_repres == SalPntComps::kSphericalFirstCamInvDist)
         {
             auto sal_pnt_covar = estim_vars_covar_.block<kSphericalSalientPointComps, kSphericalSalientPointComps>(sal_pnt_offset, sal_pnt_offset);
             sal_pnt_covar(0, 0) = sal_pnt_first_cam_pos_variance;
@@ -2042,6 +3877,19 @@ void DavisonMonoSlam::SetEstimStateCovarInEstimSpace(size_t frame_ind)
             sal_pnt_covar(4, 4) = sal_pnt_elevation_variance;
             sal_pnt_covar(5, 5) = sal_pnt_inv_dist_variance;
         }
+        else if (sal_pnt_repres == SalPntComps::kSphericalAnchoredInvDist)
+        {
+            size_t anchor_offset = sal_pnts_[sal_pnt_ind]->anchor->estim_vars_ind;
+            auto anchor_covar = estim_vars_covar_.block<kEucl3, kEucl3>(anchor_offset, anchor_offset);
+            anchor_covar(0, 0) = sal_pnt_first_cam_pos_variance;
+            anchor_covar(1, 1) = sal_pnt_first_cam_pos_variance;
+            anchor_covar(2, 2) = sal_pnt_first_cam_pos_variance;
+
+            auto sal_pnt_covar = estim_vars_covar_.block<kAnchoredSalientPointComps, kAnchoredSalientPointComps>(sal_pnt_offset, sal_pnt_offset);
+            sal_pnt_covar(0, 0) = sal_pnt_azimuth_variance;
+            sal_pnt_covar(1, 1) = sal_pnt_elevation_variance;
+            sal_pnt_covar(2, 2) = sal_pnt_inv_dist_variance;
+        }
     }
 }
 
@@ -2089,7 +3937,7 @@ void DavisonMonoSlam::SetEstimStateCovarLikeInAddNewSalPnt(size_t frame_ind,
         Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic> spher_sal_pnt_to_other_covar;
         GetNewSphericalSalientPointCovar(first_cam_state, suriko::Point2f{ first_cam_corner_pix }, sal_pnt_build_info.proj_interm_vars, take_vars_count, &spher_sal_pnt_autocovar, &spher_sal_pnt_to_other_covar);
 
-        SalPntComps sal_pnt_repres = kSalPntRepres;
+        SalPntComps sal_pnt_repres = sal_pnts_[sal_pnt_ind]->repres;
         if (sal_pnt_repres == SalPntComps::kXyz)
         {
             Eigen::Matrix<Scalar, kXyzSalientPointComps, kXyzSalientPointComps> xyz_sal_pnt_autocovar;
@@ -2111,6 +3959,30 @@ void DavisonMonoSlam::SetEstimStateCovarLikeInAddNewSalPnt(size_t frame_ind,
 
             estim_vars_covar_.block(take_vars_count, take_vars_count, kSphericalSalientPointComps, kSphericalSalientPointComps) = spher_sal_pnt_autocovar;
         }
+        else if (sal_pnt_repres == SalPntComps::kSphericalAnchoredInvDist)
+        {
+            // the first salient point of the anchor, which immediately follows the anchor, sets the covariance of the anchor too
+            size_t anchor_offset = sal_pnts_[sal_pnt_ind]->anchor->estim_vars_ind;
+            if (anchor_offset + kEucl3 == sal_pnt_offset)
+            {
+                take_vars_count = anchor_offset;
+                GetNewSphericalSalientPointCovar(first_cam_state, suriko::Point2f{ first_cam_corner_pix }, sal_pnt_build_info.proj_interm_vars, take_vars_count, &spher_sal_pnt_autocovar, &spher_sal_pnt_to_other_covar);
+
+                estim_vars_covar_.block(take_vars_count, 0, kSphericalSalientPointComps, take_vars_count) = spher_sal_pnt_to_other_covar;
+                estim_vars_covar_.block(0, take_vars_count, take_vars_count, kSphericalSalientPointComps) = spher_sal_pnt_to_other_covar.transpose();
+
+                estim_vars_covar_.block(take_vars_count, take_vars_count, kSphericalSalientPointComps, kSphericalSalientPointComps) = spher_sal_pnt_autocovar;
+            }
+            else
+            {
+                const auto own_to_other_covar = spher_sal_pnt_to_other_covar.bottomRows<kAnchoredSalientPointComps>();
+                estim_vars_covar_.block(take_vars_count, 0, kAnchoredSalientPointComps, take_vars_count) = own_to_other_covar;
+                estim_vars_covar_.block(0, take_vars_count, take_vars_count, kAnchoredSalientPointComps) = own_to_other_covar.transpose();
+
+                estim_vars_covar_.block(take_vars_count, take_vars_count, kAnchoredSalientPointComps, kAnchoredSalientPointComps) =
+                    spher_sal_pnt_autocovar.bottomRightCorner<kAnchoredSalientPointComps, kAnchoredSalientPointComps>();
+            }
+        }
     }
 }
 
@@ -2121,7 +3993,7 @@ void DavisonMonoSlam::SetEstimStateAndCovarToGroundTruth(size_t frame_ind)
     GetGroundTruthEstimVars(frame_ind, &cam_state, &sal_pnt_build_infos);
 
     std::vector<MorphableSalientPoint> sal_pnts;
-    ConvertMorphableFromSphericalSalientPoints(sal_pnt_build_infos, kSalPntRepres, &sal_pnts);
+    ConvertMorphableFromSphericalSalientPoints(sal_pnt_build_infos, &sal_pnts);
 
     // estimated variables
     EigenDynVec gt_measured_estim_vars;
@@ -2129,6 +4001,8 @@ void DavisonMonoSlam::SetEstimStateAndCovarToGroundTruth(size_t frame_ind)
     SaveEstimVars(cam_state, sal_pnts, &gt_measured_estim_vars);
 
     estim_vars_ = gt_measured_estim_vars;
+    InjectCameraOrientationError();
+    InvalidateCovarSqrt();
 
     // covariance
     if (set_estim_state_covar_to_gt_impl_ == 1)
@@ -2192,20 +4066,23 @@ void DavisonMonoSlam::DumpTrackerState(std::ostringstream& os) const
     os << "cam.pos.covar.diag: ";
     FormatVec(os, cam_pos_covar_diag) << std::endl;
 
-    auto cam_orient_covar = p_src_estim_vars_covar->block<kQuat4, kQuat4>(kEucl3, kEucl3).eval();
-    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_covar_diag = cam_orient_covar.diagonal();
+    auto cam_orient_covar = p_src_estim_vars_covar->block<kOrientErrComps, kOrientErrComps>(kEucl3, kEucl3).eval();
+    Eigen::Matrix<Scalar, kOrientErrComps, 1> cam_orient_covar_diag = cam_orient_covar.diagonal();
     os << "cam.orient.covar.diag: ";
     FormatVec(os, cam_orient_covar_diag) << std::endl;
 
-    auto cam_vel_covar = p_src_estim_vars_covar->block<kEucl3, kEucl3>(kEucl3 + kQuat4, kEucl3 + kQuat4).eval();
-    Eigen::Matrix<Scalar, kEucl3, 1> cam_vel_covar_diag = cam_vel_covar.diagonal();
-    os << "cam.vel.covar.diag: ";
-    FormatVec(os, cam_vel_covar_diag) << std::endl;
-
-    auto cam_ang_vel_covar = p_src_estim_vars_covar->block<kEucl3, kEucl3>(kEucl3 + kQuat4 + kEucl3, kEucl3 + kQuat4 + kEucl3).eval();
-    Eigen::Matrix<Scalar, kEucl3, 1> cam_ang_vel_covar_diag = cam_ang_vel_covar.diagonal();
-    os << "cam.angvel.covar.diag: ";
-    FormatVec(os, cam_ang_vel_covar_diag) << std::endl;
+    if constexpr (kCamStateHasVelocity)
+    {
+        auto cam_vel_covar = p_src_estim_vars_covar->block<kEucl3, kEucl3>(kEucl3 + kOrientErrComps, kEucl3 + kOrientErrComps).eval();
+        Eigen::Matrix<Scalar, kEucl3, 1> cam_vel_covar_diag = cam_vel_covar.diagonal();
+        os << "cam.vel.covar.diag: ";
+        FormatVec(os, cam_vel_covar_diag) << std::endl;
+
+        auto cam_ang_vel_covar = p_src_estim_vars_covar->block<kEucl3, kEucl3>(kEucl3 + kOrientErrComps + kEucl3, kEucl3 + kOrientErrComps + kEucl3).eval();
+        Eigen::Matrix<Scalar, kEucl3, 1> cam_ang_vel_covar_diag = cam_ang_vel_covar.diagonal();
+        os << "cam.angvel.covar.diag: ";
+        FormatVec(os, cam_ang_vel_covar_diag) << std::endl;
+    }
 
     //
     for (auto& p_sal_pnt : sal_pnts_)
@@ -2229,18 +4106,16 @@ void DavisonMonoSlam::DumpTrackerState(std::ostringstream& os) const
             os << "NA";
         os << std::endl;
 
-        auto sal_pnt_vars_span = Span(*p_src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps);
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(sal_pnt_vars_span, &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(*p_src_estim_vars, sal_pnt);
 
-        if constexpr (kSalPntRepres == SalPntComps::kXyz)
+        if (sal_pnt_vars.repres == SalPntComps::kXyz)
         {
 #if defined(XYZ_SAL_PNT_REPRES)
             os << "SP.pos: ";
             FormatVec(os, Mat(sal_pnt_vars.pos_w)) << std::endl;
 #endif
         }
-        else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+        else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
         {
 #if defined(SPHER_SAL_PNT_REPRES)
             os << "SP.firstcam: ";
@@ -2259,8 +4134,8 @@ void DavisonMonoSlam::DumpTrackerState(std::ostringstream& os) const
         }
 
         // salient point covariance
-         auto sal_pnt_covar = p_src_estim_vars_covar->block<kSalientPointComps, kSalientPointComps>(sal_pnt.estim_vars_ind, sal_pnt.estim_vars_ind).eval();
-        Eigen::Matrix<Scalar, kSalientPointComps, 1> sal_pnt_covar_diag = sal_pnt_covar.diagonal();
+        SalPntMat sal_pnt_covar = GetSalientPointsCovar(*p_src_estim_vars_covar, sal_pnt, sal_pnt);
+        SalPntVec sal_pnt_covar_diag = sal_pnt_covar.diagonal();
         os << "SP.covar.diag: ";
         FormatVec(os, sal_pnt_covar_diag) << std::endl;
     }
@@ -2294,8 +4169,7 @@ void DavisonMonoSlam::SetNonObservedSalientPointCorner(const EigenDynVec& src_es
 
         // predict corner position of non-matched salient points by projecting predicted state
 
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> corner = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
 
@@ -2319,16 +4193,41 @@ Point3 DavisonMonoSlam::BackprojectPixelIntoCameraPlane(const Eigen::Matrix<Scal
     return Point3{ hcx, hcy, hcz };
 }
 
-void DavisonMonoSlam::AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_var_ind,
+suriko::Point2f DavisonMonoSlam::DistortPixel(const suriko::Point2f& hu) const
+{
+    return std::visit([this, &hu](const auto& cam_model) { return cam_model.DistortPixel(cam_intrinsics_, hu); }, cam_model_);
+}
+
+suriko::Point2f DavisonMonoSlam::UndistortPixel(const suriko::Point2f& hd) const
+{
+    return std::visit([this, &hd](const auto& cam_model) { return cam_model.UndistortPixel(cam_intrinsics_, hd); }, cam_model_);
+}
+
+void DavisonMonoSlam::AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_var_ind, SalPntComps sal_pnt_repres,
     const CameraStateVars& cam_state, suriko::Point2f corner_pix,
     std::optional<Scalar> pnt_inv_dist_gt)
+{
+    size_t vars_count_after = new_sal_pnt_var_ind + SalientPointVarsCount(sal_pnt_repres);
+
+    // Pold is augmented with 6 rows and columns corresponding to how a new salient point interact with all other
+    // variables and itself. So Pnew=Pold+6rowscols. The values of Pold itself are unchanged.
+    // the Eigen's conservative resize uses temporary to resize and copy matrix, slow
+    estim_vars_.conservativeResize(vars_count_after);
+    estim_vars_covar_.conservativeResize(vars_count_after, vars_count_after);
+
+    InitStateForNewSalientPoint(new_sal_pnt_var_ind, sal_pnt_repres, cam_state, corner_pix, pnt_inv_dist_gt);
+}
+
+void DavisonMonoSlam::InitStateForNewSalientPoint(size_t new_sal_pnt_var_ind, SalPntComps sal_pnt_repres,
+    const CameraStateVars& cam_state, suriko::Point2f corner_pix,
+    std::optional<Scalar> pnt_inv_dist_gt, std::optional<Scalar> init_inv_dist, std::optional<Scalar> init_inv_dist_std)
 {
     SphericalSalientPointIntermProjVars interm_proj_vars;
     SphericalSalientPoint spher_sal_pnt = GetNewSphericalSalientPointState(cam_state, corner_pix, pnt_inv_dist_gt, &interm_proj_vars);
+    if (init_inv_dist.has_value())
+        spher_sal_pnt.inverse_dist_rho = init_inv_dist.value();
 
-    size_t vars_count_before = EstimatedVarsCount();
-    size_t new_vars_count = kSalientPointComps;
-    size_t vars_count_after = vars_count_before + new_vars_count;
+    const size_t vars_count_before = new_sal_pnt_var_ind;
 
     // internal salient point state is either in XYZ or Spherical format
     // allocate both to switch between them at runtime
@@ -2336,13 +4235,14 @@ void DavisonMonoSlam::AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_
     Eigen::Matrix<Scalar, kSphericalSalientPointComps, 1> spher_sal_pnt_vars;
     Eigen::Matrix<Scalar, kSphericalSalientPointComps, kSphericalSalientPointComps> spher_sal_pnt_autocovar;
     Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic> spher_sal_pnt_to_other_covar;
-    GetNewSphericalSalientPointCovar(cam_state, corner_pix, interm_proj_vars, vars_count_before, &spher_sal_pnt_autocovar, &spher_sal_pnt_to_other_covar);
+    GetNewSphericalSalientPointCovar(cam_state, corner_pix, interm_proj_vars, vars_count_before, &spher_sal_pnt_autocovar, &spher_sal_pnt_to_other_covar,
+        init_inv_dist_std);
 
     Point3 xyz_sal_pnt_vars;
     Eigen::Matrix<Scalar, kXyzSalientPointComps, kXyzSalientPointComps> xyz_sal_pnt_autocovar;
     Eigen::Matrix<Scalar, kXyzSalientPointComps, Eigen::Dynamic> xyz_sal_pnt_to_other_covar;
 
-    if (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_repres == SalPntComps::kXyz)
     {
         // convert spherical [6x1] to Euclidean XYZ [3x1] format
         bool op = ConvertXyzFromSphericalSalientPoint(spher_sal_pnt, &xyz_sal_pnt_vars);
@@ -2353,45 +4253,55 @@ void DavisonMonoSlam::AllocateAndInitStateForNewSalientPoint(size_t new_sal_pnt_
             spher_sal_pnt_to_other_covar,
             &xyz_sal_pnt_autocovar, &xyz_sal_pnt_to_other_covar);
     }
-    else if (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else
     {
         SaveSalientPointDataToArray(spher_sal_pnt, Span(spher_sal_pnt_vars));
     }
 
-    // allocate space for estimated variables
-    estim_vars_.conservativeResize(vars_count_after);
-
-    if (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_repres == SalPntComps::kXyz)
     {
         Eigen::Map<Eigen::Matrix<Scalar, kXyzSalientPointComps, 1>> dst_sal_pnt_vars(&estim_vars_[new_sal_pnt_var_ind]);
         dst_sal_pnt_vars = Mat(xyz_sal_pnt_vars);
     }
-    else if (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_repres == SalPntComps::kSphericalFirstCamInvDist)
     {
         Eigen::Map<Eigen::Matrix<Scalar, kSphericalSalientPointComps, 1>> dst_sal_pnt_vars(&estim_vars_[new_sal_pnt_var_ind]);
         dst_sal_pnt_vars = spher_sal_pnt_vars;
     }
+    else if (sal_pnt_repres == SalPntComps::kSphericalAnchoredInvDist)
+    {
+        // the first camera position is already in the anchor
+        Eigen::Map<Eigen::Matrix<Scalar, kAnchoredSalientPointComps, 1>> dst_sal_pnt_vars(&estim_vars_[new_sal_pnt_var_ind]);
+        dst_sal_pnt_vars = spher_sal_pnt_vars.bottomRows<kAnchoredSalientPointComps>();
+    }
 
     // P
 
-    // Pold is augmented with 6 rows and columns corresponding to how a new salient point interact with all other
-    // variables and itself. So Pnew=Pold+6rowscols. The values of Pold itself are unchanged.
-    // the Eigen's conservative resize uses temporary to resize and copy matrix, slow
-    estim_vars_covar_.conservativeResize(vars_count_after, vars_count_after);
-
-    if (kSalPntRepres == SalPntComps::kXyz)
+    const size_t at = new_sal_pnt_var_ind;
+    if (sal_pnt_repres == SalPntComps::kXyz)
     {
-        estim_vars_covar_.bottomLeftCorner(kXyzSalientPointComps, vars_count_before) = xyz_sal_pnt_to_other_covar;
-        estim_vars_covar_.topRightCorner(vars_count_before, kXyzSalientPointComps) = xyz_sal_pnt_to_other_covar.transpose();
+        estim_vars_covar_.block(at, 0, kXyzSalientPointComps, vars_count_before) = xyz_sal_pnt_to_other_covar;
+        estim_vars_covar_.block(0, at, vars_count_before, kXyzSalientPointComps) = xyz_sal_pnt_to_other_covar.transpose();
 
-        estim_vars_covar_.bottomRightCorner(kXyzSalientPointComps, kXyzSalientPointComps) = xyz_sal_pnt_autocovar;
+        estim_vars_covar_.block<kXyzSalientPointComps, kXyzSalientPointComps>(at, at) = xyz_sal_pnt_autocovar;
     }
-    else if (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_repres == SalPntComps::kSphericalFirstCamInvDist)
     {
-        estim_vars_covar_.bottomLeftCorner(kSphericalSalientPointComps, vars_count_before) = spher_sal_pnt_to_other_covar;
-        estim_vars_covar_.topRightCorner(vars_count_before, kSphericalSalientPointComps) = spher_sal_pnt_to_other_covar.transpose();
+        estim_vars_covar_.block(at, 0, kSphericalSalientPointComps, vars_count_before) = spher_sal_pnt_to_other_covar;
+        estim_vars_covar_.block(0, at, vars_count_before, kSphericalSalientPointComps) = spher_sal_pnt_to_other_covar.transpose();
 
-        estim_vars_covar_.bottomRightCorner(kSphericalSalientPointComps, kSphericalSalientPointComps) = spher_sal_pnt_autocovar;
+        estim_vars_covar_.block<kSphericalSalientPointComps, kSphericalSalientPointComps>(at, at) = spher_sal_pnt_autocovar;
+    }
+    else if (sal_pnt_repres == SalPntComps::kSphericalAnchoredInvDist)
+    {
+        // the anchor is the copy of the current camera position, hence the covariance to the anchor is already
+        // in the stripe of the covariance to other variables
+        const auto own_to_other_covar = spher_sal_pnt_to_other_covar.bottomRows<kAnchoredSalientPointComps>();
+        estim_vars_covar_.block(at, 0, kAnchoredSalientPointComps, vars_count_before) = own_to_other_covar;
+        estim_vars_covar_.block(0, at, vars_count_before, kAnchoredSalientPointComps) = own_to_other_covar.transpose();
+
+        estim_vars_covar_.block<kAnchoredSalientPointComps, kAnchoredSalientPointComps>(at, at) =
+            spher_sal_pnt_autocovar.bottomRightCorner<kAnchoredSalientPointComps, kAnchoredSalientPointComps>();
     }
 }
 
@@ -2402,20 +4312,7 @@ DavisonMonoSlam::SphericalSalientPoint DavisonMonoSlam::GetNewSphericalSalientPo
     SphericalSalientPointIntermProjVars* interm_proj_vars) const
 {
     // undistort 2D image coordinate
-    const auto& h_distorted = first_cam_corner_pix; // distorted
-    Eigen::Matrix<Scalar, kPixPosComps, 1> hu = h_distorted.Mat(); // undistorted
-    if (cam_enable_distortion_)
-    {
-        auto [Cx, Cy] = cam_intrinsics_.principal_point_pix;
-        Scalar rd = Calc_rd(cam_intrinsics_, h_distorted);
-
-        const auto& k1 = cam_distort_params_.k1;
-        const auto& k2 = cam_distort_params_.k2;
-
-        Scalar stretch = 1 + k1 * Sqr(rd) + k2 * Pow4(rd);
-        hu[0] = Cx + (h_distorted.X() - Cx) * stretch;
-        hu[1] = Cy + (h_distorted.Y() - Cy) * stretch;
-    }
+    Eigen::Matrix<Scalar, kPixPosComps, 1> hu = UndistortPixel(first_cam_corner_pix).Mat();
 
     // A.58
     Point3 hc = BackprojectPixelIntoCameraPlane(hu);
@@ -2460,7 +4357,8 @@ void DavisonMonoSlam::GetNewSphericalSalientPointCovar(
     const SphericalSalientPointIntermProjVars& proj_side_effect_vars,
     size_t take_estim_vars_count,
     Eigen::Matrix<Scalar, kSphericalSalientPointComps, kSphericalSalientPointComps>* spher_sal_pnt_autocovar,
-    Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic>* spher_sal_pnt_to_other_covar) const
+    Eigen::Matrix<Scalar, kSphericalSalientPointComps, Eigen::Dynamic>* spher_sal_pnt_to_other_covar,
+    std::optional<Scalar> inv_dist_std) const
 {
     //Eigen::Matrix<Scalar, kPixPosComps, 1> hd = proj_side_effect_vars.corner_pix.Mat(); // distorted
     //Eigen::Matrix<Scalar, kPixPosComps, 1> hu = hd; // undistorted
@@ -2474,35 +4372,31 @@ void DavisonMonoSlam::GetNewSphericalSalientPointCovar(
     sal_pnt_by_cam_r.topRows<3>().setIdentity();
     sal_pnt_by_cam_r.bottomRows<3>().setZero();
 
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> dR_by_dq0;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> dR_by_dq1;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> dR_by_dq2;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> dR_by_dq3;
-    Deriv_R_by_q(first_cam_state.orientation_wfc, &dR_by_dq0, &dR_by_dq1, &dR_by_dq2, &dR_by_dq3);
-
-    // A.73
-    Eigen::Matrix<Scalar, kEucl3, kQuat4> hw_by_qwfc;
-    hw_by_qwfc.middleCols<1>(0) = Mat(dR_by_dq0 * hc);
-    hw_by_qwfc.middleCols<1>(1) = Mat(dR_by_dq1 * hc);
-    hw_by_qwfc.middleCols<1>(2) = Mat(dR_by_dq2 * hc);
-    hw_by_qwfc.middleCols<1>(3) = Mat(dR_by_dq3 * hc);
-
-    // salient point by camera quaternion
-    Eigen::Matrix<Scalar, kSphericalSalientPointComps, kQuat4> sal_pnt_by_cam_q;
+    // A.73, Rwfc=Rnominal*exp(dtheta) => hw(dtheta+d)=Rwfc*exp(Jr(dtheta)*d)*hc=hw-Rwfc*skew(hc)*Jr(dtheta)*d
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> hc_skew;
+    SkewSymmetricMat(hc, &hc_skew);
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> jr;
+    RightJacobianSO3(CameraOrientationError(first_cam_state.orientation_wfc), &jr);
+
+    Eigen::Matrix<Scalar, kEucl3, kOrientErrComps> hw_by_orient_err = -first_cam_Rwfc * hc_skew * jr;
+
+    // salient point by camera orientation error
+    Eigen::Matrix<Scalar, kSphericalSalientPointComps, kOrientErrComps> sal_pnt_by_cam_orient_err;
     Eigen::Matrix<Scalar, 1, kEucl3> azim_theta_by_hw;
     Eigen::Matrix<Scalar, 1, kEucl3> elev_phi_by_hw;
     Deriv_azim_theta_elev_phi_by_hw(hw, &azim_theta_by_hw, &elev_phi_by_hw);
 
     // A.68
-    sal_pnt_by_cam_q.topRows<kEucl3>().setZero();
-    sal_pnt_by_cam_q.bottomRows<kRho>().setZero();
-    sal_pnt_by_cam_q.middleRows<1>(kEucl3) = azim_theta_by_hw * hw_by_qwfc;
-    sal_pnt_by_cam_q.middleRows<1>(kEucl3 + 1) = elev_phi_by_hw * hw_by_qwfc; // +1 for azimuth component
+    sal_pnt_by_cam_orient_err.topRows<kEucl3>().setZero();
+    sal_pnt_by_cam_orient_err.bottomRows<kRho>().setZero();
+    sal_pnt_by_cam_orient_err.middleRows<1>(kEucl3) = azim_theta_by_hw * hw_by_orient_err;
+    sal_pnt_by_cam_orient_err.middleRows<1>(kEucl3 + 1) = elev_phi_by_hw * hw_by_orient_err; // +1 for azimuth component
 
-    constexpr size_t kCamPQ = kEucl3 + kQuat4;
+    constexpr size_t kCamPQ = kEucl3 + kOrientErrComps;
     Eigen::Matrix<Scalar, kSphericalSalientPointComps, kCamPQ> sal_pnt_by_cam;
     sal_pnt_by_cam.block<kSphericalSalientPointComps, kEucl3>(0, 0) = sal_pnt_by_cam_r;
-    sal_pnt_by_cam.block<kSphericalSalientPointComps, kQuat4>(0, kEucl3) = sal_pnt_by_cam_q;
+    sal_pnt_by_cam.block<kSphericalSalientPointComps, kOrientErrComps>(0, kEucl3) = sal_pnt_by_cam_orient_err;
 
     // A.78
     const Eigen::Matrix<Scalar, kEucl3, kEucl3>& hw_by_hc = first_cam_Rwfc;
@@ -2536,7 +4430,7 @@ void DavisonMonoSlam::GetNewSphericalSalientPointCovar(
     sal_pnt_by_h_rho.rightCols<kRho>().setZero();
     sal_pnt_by_h_rho.bottomRightCorner<kRho, kRho>().setOnes(); // single element
 
-    Scalar rho_init_var = suriko::Sqr(sal_pnt_init_inv_dist_std_);
+    Scalar rho_init_var = suriko::Sqr(inv_dist_std.value_or(sal_pnt_init_inv_dist_std_));
 
     // P bottom right corner
     spher_sal_pnt_autocovar->noalias() = spher_sal_pnt_to_other_covar->leftCols<kCamPQ>() * sal_pnt_by_cam.transpose();
@@ -2596,27 +4490,33 @@ void DavisonMonoSlam::GetDefaultXyzSalientPointCovarOrConvertFromSpherical(
 
 DavisonMonoSlam::SalPntId DavisonMonoSlam::AddSalientPoint(size_t frame_ind, const CameraStateVars& cam_state, suriko::Point2f corner_pix,
     Picture templ_img, TemplMatchStats templ_stats,
-    std::optional<Scalar> pnt_inv_dist_gt)
+    std::optional<Scalar> pnt_inv_dist_gt, SalPntAnchor* anchor)
 {
-    size_t old_sal_pnts_count = SalientPointsCount();
-    size_t sal_pnt_var_ind = SalientPointOffset(old_sal_pnts_count);
+    size_t sal_pnt_var_ind = SalientPointOffset(SalientPointsCount());
 
-    AllocateAndInitStateForNewSalientPoint(sal_pnt_var_ind, cam_state, corner_pix, pnt_inv_dist_gt);
+    SalPntComps sal_pnt_repres = anchor != nullptr ? SalPntComps::kSphericalAnchoredInvDist : kSalPntRepres;
+    AllocateAndInitStateForNewSalientPoint(sal_pnt_var_ind, sal_pnt_repres, cam_state, corner_pix, pnt_inv_dist_gt);
 
+    auto new_sal_pnt = NewSalientPointDescriptor(frame_ind, corner_pix, std::move(templ_img), templ_stats);
+    return InsertSalientPointDescriptor(std::move(new_sal_pnt), sal_pnt_var_ind, sal_pnt_repres, anchor);
+}
+
+std::unique_ptr<TrackedSalientPoint> DavisonMonoSlam::NewSalientPointDescriptor(size_t frame_ind, suriko::Point2f corner_pix,
+    Picture templ_img, TemplMatchStats templ_stats) const
+{
     auto new_sal_pnt = std::make_unique<TrackedSalientPoint>();
-    SalPntId sal_pnt_id = SalPntId(new_sal_pnt.get());  // get address of salient point before it is moved
 
     //
     suriko::Point2i top_left = TemplateTopLeftInt(corner_pix);
 
     TrackedSalientPoint& sal_pnt = *new_sal_pnt.get();
-    sal_pnt.estim_vars_ind = sal_pnt_var_ind;
-    sal_pnt.sal_pnt_ind = old_sal_pnts_count;
     sal_pnt.track_status = SalPntTrackStatus::New;
     sal_pnt.SetTemplCenterPix(corner_pix, sal_pnt_templ_size_);
     sal_pnt.offset_from_top_left_ = suriko::Point2f{ corner_pix.X() - top_left.x, corner_pix.Y() - top_left.y };
     sal_pnt.initial_templ_gray_ = std::move(templ_img.gray);
+    sal_pnt.initial_templ_top_left_pix_ = top_left;
     sal_pnt.initial_frame_ind_synthetic_only_ = frame_ind;
+    sal_pnt.last_seen_frame_ind = frame_ind;
 #if defined(SRK_DEBUG)
     sal_pnt.initial_templ_center_pix_debug_ = corner_pix;
     sal_pnt.initial_templ_top_left_pix_debug_ = top_left;
@@ -2624,6 +4524,27 @@ DavisonMonoSlam::SalPntId DavisonMonoSlam::AddSalientPoint(size_t frame_ind, con
 #endif
     sal_pnt.templ_stats = templ_stats;
 
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(estim_vars_, kCamStateComps), &cam_state);
+    sal_pnt.initial_cam_pos_w_ = cam_state.pos_w;
+    sal_pnt.initial_cam_orient_wfc_ = cam_state.orientation_wfc;
+    return new_sal_pnt;
+}
+
+DavisonMonoSlam::SalPntId DavisonMonoSlam::InsertSalientPointDescriptor(std::unique_ptr<TrackedSalientPoint> new_sal_pnt, size_t sal_pnt_var_ind,
+    SalPntComps sal_pnt_repres, SalPntAnchor* anchor)
+{
+    SalPntId sal_pnt_id = SalPntId(new_sal_pnt.get());  // get address of salient point before it is moved
+
+    TrackedSalientPoint& sal_pnt = *new_sal_pnt.get();
+    sal_pnt.estim_vars_ind = sal_pnt_var_ind;
+    sal_pnt.sal_pnt_ind = SalientPointsCount();
+    sal_pnt.repres = sal_pnt_repres;
+    sal_pnt.anchor = anchor;
+    if (anchor != nullptr)
+        ++anchor->sal_pnts_count;
+    sal_pnt.track_status = SalPntTrackStatus::New;
+
     // put salient point to the back of tracked points, but before the deleted points
     auto ins_pos_rit = sal_pnts_.rbegin();
     for (; ins_pos_rit != sal_pnts_.rend() && (*ins_pos_rit)->IsDeleted(); ++ins_pos_rit) {}
@@ -2636,6 +4557,27 @@ DavisonMonoSlam::SalPntId DavisonMonoSlam::AddSalientPoint(size_t frame_ind, con
     return sal_pnt_id;
 }
 
+SalPntAnchor* DavisonMonoSlam::AddSalientPointAnchor(size_t frame_ind)
+{
+    size_t vars_count_before = EstimatedVarsCount();
+    size_t vars_count_after = vars_count_before + kEucl3;
+
+    // the anchor is the copy of the camera position, fully correlated with it
+    estim_vars_.conservativeResize(vars_count_after);
+    estim_vars_.bottomRows<kEucl3>() = estim_vars_.topRows<kEucl3>();
+
+    estim_vars_covar_.conservativeResize(vars_count_after, vars_count_after);
+    estim_vars_covar_.bottomLeftCorner(kEucl3, vars_count_before) = estim_vars_covar_.topLeftCorner(kEucl3, vars_count_before);
+    estim_vars_covar_.topRightCorner(vars_count_before, kEucl3) = estim_vars_covar_.topLeftCorner(vars_count_before, kEucl3);
+    estim_vars_covar_.bottomRightCorner<kEucl3, kEucl3>() = estim_vars_covar_.topLeftCorner<kEucl3, kEucl3>();
+
+    auto anchor = std::make_unique<SalPntAnchor>();
+    anchor->estim_vars_ind = vars_count_before;
+    anchor->frame_ind = frame_ind;
+    sal_pnt_anchors_.push_back(std::move(anchor));
+    return sal_pnt_anchors_.back().get();
+}
+
 std::optional<suriko::Point2f> DavisonMonoSlam::GetDetectedSalientTemplCenter(SalPntId sal_pnt_id) const
 {
     const auto& sal_pnt = GetSalientPoint(sal_pnt_id);
@@ -2649,32 +4591,10 @@ std::optional<suriko::Point2f> DavisonMonoSlam::GetDetectedSalientTemplCenter(Sa
 
 void DavisonMonoSlam::Deriv_hu_by_hd(suriko::Point2f corner_pix, Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>* hu_by_hd) const
 {
-    if (!cam_enable_distortion_)
+    std::visit([this, &corner_pix, hu_by_hd](const auto& cam_model)
     {
-        hu_by_hd->setIdentity();
-        return;
-    }
-
-    const auto& hd = corner_pix;
-    auto [Cx,Cy] = cam_intrinsics_.principal_point_pix;
-    auto [dx,dy] = cam_intrinsics_.pixel_size_mm;
-    const auto& k1 = cam_distort_params_.k1;
-    const auto& k2 = cam_distort_params_.k2;
-
-    using suriko::Sqr, suriko::Pow4;
-    Scalar rd = Calc_rd(cam_intrinsics_, corner_pix);
-
-    Scalar stretch = 1 + k1 * Sqr(rd) + k2 * Pow4(rd);
-
-    Scalar kk = k1 + 2 * k2 * Sqr(rd);
-    Scalar side = 2 * kk * (hd.Y() - Cy) * (hd.X() - Cx);
-
-    // A.32
-    auto& r = *hu_by_hd;
-    r(0, 0) = stretch + 2 * kk * Sqr(dx * (hd.X() - Cx));
-    r(1, 1) = stretch + 2 * kk * Sqr(dy * (hd.Y() - Cy));
-    r(1, 0) = side * Sqr(dx);
-    r(0, 1) = side * Sqr(dy);
+        cam_model.Deriv_hu_by_hd(cam_intrinsics_, corner_pix, hu_by_hd);
+    }, cam_model_);
 }
 
 void DavisonMonoSlam::Deriv_hd_by_hu(suriko::Point2f corner_pix, Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>* hd_by_hu) const
@@ -2713,37 +4633,6 @@ void DavisonMonoSlam::Deriv_hc_by_hu(Eigen::Matrix<Scalar, kEucl3, kPixPosComps>
     m(1, 1) = -1 / f_pix[1];
 }
 
-void DavisonMonoSlam::Deriv_R_by_q(const Eigen::Matrix<Scalar, kQuat4, 1>& q,
-    Eigen::Matrix<Scalar, 3, 3>* dR_by_dq0,
-    Eigen::Matrix<Scalar, 3, 3>* dR_by_dq1,
-    Eigen::Matrix<Scalar, 3, 3>* dR_by_dq2,
-    Eigen::Matrix<Scalar, 3, 3>* dR_by_dq3) const
-{
-    Scalar q_len = q.norm();
-    SRK_ASSERT(IsCloseAbs(1, q_len, 1e-3));
-
-    // A.45: A.46-A.49
-    *dR_by_dq0 <<
-        2 * q[0], -2 * q[3], 2 * q[2],
-        2 * q[3], 2 * q[0], -2 * q[1],
-        -2 * q[2], 2 * q[1], 2 * q[0];
-
-    *dR_by_dq1 <<
-        2 * q[1], 2 * q[2], 2 * q[3],
-        2 * q[2], -2 * q[1], -2 * q[0],
-        2 * q[3], 2 * q[0], -2 * q[1];
-
-    *dR_by_dq2 <<
-        -2 * q[2], 2 * q[1], 2 * q[0],
-        2 * q[1], 2 * q[2], 2 * q[3],
-        -2 * q[0], 2 * q[3], -2 * q[2];
-
-    *dR_by_dq3 <<
-        -2 * q[3], -2 * q[0], 2 * q[1],
-        2 * q[0], -2 * q[3], 2 * q[2],
-        2 * q[1], 2 * q[2], 2 * q[3];
-}
-
 void DavisonMonoSlam::Deriv_hd_by_camera_state(const MorphableSalientPoint& sal_pnt,
     const CameraStateVars& cam_state,
     const Eigen::Matrix<Scalar, kEucl3, kEucl3>& cam_orient_wfc,
@@ -2758,11 +4647,11 @@ void DavisonMonoSlam::Deriv_hd_by_camera_state(const MorphableSalientPoint& sal_
     Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw = cam_orient_wfc.transpose();
 
     Eigen::Matrix<Scalar, kEucl3, kEucl3> hc_by_rwc;
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt.repres == SalPntComps::kXyz)
     {
         hc_by_rwc = -Rcw;  // A.36
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         hc_by_rwc = -sal_pnt.inverse_dist_rho * Rcw;  // A.35
@@ -2774,94 +4663,240 @@ void DavisonMonoSlam::Deriv_hd_by_camera_state(const MorphableSalientPoint& sal_
 
 
     //
-    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_cfw = QuatInverse(cam_state.orientation_wfc);
-    const auto& qcw = cam_orient_cfw;
-
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw_by_qcw0;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw_by_qcw1;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw_by_qcw2;
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw_by_qcw3;
-    Deriv_R_by_q(qcw, &Rcw_by_qcw0, &Rcw_by_qcw1, &Rcw_by_qcw2, &Rcw_by_qcw3);
-
     Point3 part2;
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt.repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         part2 = sal_pnt.pos_w - cam_state.pos_w;
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         part2 = sal_pnt.inverse_dist_rho * (sal_pnt.first_cam_pos_w - cam_state.pos_w) + proj_hist.first_cam_sal_pnt_unity_dir;
 #endif
     }
 
-    Eigen::Matrix<Scalar, kEucl3, kQuat4> hc_by_qcw; // A.40
-    hc_by_qcw.middleCols<1>(0) = Mat(Rcw_by_qcw0 * part2);
-    hc_by_qcw.middleCols<1>(1) = Mat(Rcw_by_qcw1 * part2);
-    hc_by_qcw.middleCols<1>(2) = Mat(Rcw_by_qcw2 * part2);
-    hc_by_qcw.middleCols<1>(3) = Mat(Rcw_by_qcw3 * part2);
+    // Rwc=Rnominal*exp(dtheta) => hc(dtheta+d)=exp(Jr(dtheta)*d)^T*Rcw*part2=hc+skew(hc)*Jr(dtheta)*d
+    Point3 hc = Rcw * part2;
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> hc_skew;
+    SkewSymmetricMat(hc, &hc_skew);
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> jr;
+    RightJacobianSO3(CameraOrientationError(cam_state.orientation_wfc), &jr);
+
+    Eigen::Matrix<Scalar, kEucl3, kOrientErrComps> hc_by_orient_err = hc_skew * jr;
+
+    //
+    Eigen::Matrix<Scalar, kPixPosComps, kOrientErrComps> hd_by_orient_err = hd_by_hu * hu_by_hc * hc_by_orient_err;
+    hd_by_cam->middleCols<kOrientErrComps>(kEucl3) = hd_by_orient_err;
+}
+
+void DavisonMonoSlam::Deriv_hd_by_sal_pnt(const MorphableSalientPoint& sal_pnt,
+    const CameraStateVars& cam_state,
+    const Eigen::Matrix<Scalar, kEucl3, kEucl3>& cam_orient_wfc,
+    const Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>& hd_by_hu,
+    const Eigen::Matrix<Scalar, kPixPosComps, kEucl3>& hu_by_hc,
+    HdBySalPntMat* hd_by_sal_pnt) const
+{
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw = cam_orient_wfc.transpose();
+
+    Eigen::Matrix<Scalar, kEucl3, Eigen::Dynamic, Eigen::ColMajor, kEucl3, kSalientPointComps> dhc_by_dy;
+    if (sal_pnt.repres == SalPntComps::kXyz)
+    {
+        // A.55
+        dhc_by_dy = Rcw;
+    }
+    else if (sal_pnt.repres == SalPntComps::kSphericalFirstCamInvDist)
+    {
+#if defined(SPHER_SAL_PNT_REPRES)
+        Scalar cos_phi = std::cos(sal_pnt.elevation_phi_w);
+        Scalar sin_phi = std::sin(sal_pnt.elevation_phi_w);
+        Scalar cos_theta = std::cos(sal_pnt.azimuth_theta_w);
+        Scalar sin_theta = std::sin(sal_pnt.azimuth_theta_w);
+
+        // A.53
+        Point3 dm_by_dtheta; // azimuth
+        dm_by_dtheta[0] = cos_phi * cos_theta;
+        dm_by_dtheta[1] = 0;
+        dm_by_dtheta[2] = -cos_phi * sin_theta;
+
+        // A.54
+        Point3 dm_by_dphi; // elevation
+        dm_by_dphi[0] = -sin_phi * sin_theta;
+        dm_by_dphi[1] = -cos_phi;
+        dm_by_dphi[2] = -sin_phi * cos_theta;
+
+        // A.52
+        DependsOnSalientPointPackOrder();
+        dhc_by_dy.resize(Eigen::NoChange, kSphericalSalientPointComps);
+        dhc_by_dy.middleCols<kEucl3>(0) = sal_pnt.inverse_dist_rho * Rcw;
+        dhc_by_dy.middleCols<1>(kEucl3+0) = Mat(Rcw * dm_by_dtheta);
+        dhc_by_dy.middleCols<1>(kEucl3+1) = Mat(Rcw * dm_by_dphi);
+        dhc_by_dy.middleCols<1>(kEucl3+2) = Mat(Rcw * (sal_pnt.first_cam_pos_w - cam_state.pos_w));
+#endif
+    }
+
+    // A.51
+    *hd_by_sal_pnt = hd_by_hu * hu_by_hc * dhc_by_dy;
+}
+
+template <typename T>
+Eigen::Matrix<T, kQuat4, 1> DavisonMonoSlam::QuatFromAxisAngleGeneric(const Eigen::Matrix<T, kEucl3, 1>& axis_ang)
+{
+    using std::sqrt, std::sin, std::cos;
+
+    // q=[cos(ang/2), sin(ang/2)/ang*axis_ang], ang=|axis_ang|
+    T ang_sqr = axis_ang.squaredNorm();
+    T q0;
+    T sin_div_ang;
+    if (JetValue(ang_sqr) > static_cast<Scalar>(1e-8))
+    {
+        T ang = sqrt(ang_sqr);
+        q0 = cos(ang / 2);
+        sin_div_ang = sin(ang / 2) / ang;
+    }
+    else
+    {
+        q0 = 1 - ang_sqr / 8;
+        sin_div_ang = static_cast<Scalar>(0.5) - ang_sqr / 48;
+    }
+
+    Eigen::Matrix<T, kQuat4, 1> q;
+    q[0] = q0;
+    q.template bottomRows<kEucl3>() = sin_div_ang * axis_ang;
+    return q;
+}
+
+template <typename T>
+Eigen::Matrix<T, kEucl3, 1> DavisonMonoSlam::AxisAngleFromQuatGeneric(const Eigen::Matrix<T, kQuat4, 1>& q)
+{
+    using std::sqrt, std::atan2;
+
+    // axis_ang=2*atan2(s,q0)/s*u, q=[q0,u], s=|u|; 2*atan(s/q0)/s=2/q0*(1-s^2/(3*q0^2)) for small s
+    Eigen::Matrix<T, kEucl3, 1> u = q.template bottomRows<kEucl3>();
+    T s_sqr = u.squaredNorm();
+    T scale;
+    if (JetValue(s_sqr) > static_cast<Scalar>(1e-8))
+    {
+        T s = sqrt(s_sqr);
+        scale = T(2) * atan2(s, q[0]) / s;
+    }
+    else
+    {
+        scale = T(2) / q[0] * (1 - s_sqr / (T(3) * q[0] * q[0]));
+    }
+    return scale * u;
+}
+
+template <typename T>
+Eigen::Matrix<T, kPixPosComps, 1> DavisonMonoSlam::ProjectSalientPointUndistorted(const Eigen::Matrix<T, kEucl3, 1>& cam_pos_w,
+    const Eigen::Matrix<T, kOrientErrComps, 1>& cam_orient_err,
+    SalPntComps sal_pnt_repres,
+    const Eigen::Matrix<T, kSalientPointComps, 1>& sal_pnt) const
+{
+    using std::sqrt, std::sin, std::cos;
+
+    Eigen::Matrix<T, kEucl3, 1> part2;
+    if (sal_pnt_repres == SalPntComps::kXyz)
+    {
+        part2 = sal_pnt.template topRows<kEucl3>() - cam_pos_w;
+    }
+    else if (sal_pnt_repres == SalPntComps::kSphericalFirstCamInvDist)
+    {
+#if defined(SPHER_SAL_PNT_REPRES)
+        DependsOnSalientPointPackOrder();
+        const T& azimuth_theta = sal_pnt[kEucl3 + 0];
+        const T& elevation_phi = sal_pnt[kEucl3 + 1];
+        const T& inverse_dist_rho = sal_pnt[kEucl3 + 2];
+
+        // see CameraCoordinatesEuclidUnityDirFromPolarAngles
+        Eigen::Matrix<T, kEucl3, 1> m;
+        m[0] = cos(elevation_phi) * sin(azimuth_theta);
+        m[1] = -sin(elevation_phi);
+        m[2] = cos(elevation_phi) * cos(azimuth_theta);
+
+        part2 = inverse_dist_rho * (sal_pnt.template topRows<kEucl3>() - cam_pos_w) + m;  // A.21
+#endif
+    }
+
+    // orientation_wfc=nominal*exp(dtheta)
+    Eigen::Matrix<T, kQuat4, 1> q = QuatFromAxisAngleGeneric(cam_orient_err);
 
-    Eigen::Matrix<Scalar, kQuat4, kQuat4> qcw_by_qwc; // A.39
-    qcw_by_qwc.setIdentity();
-    qcw_by_qwc(1, 1) = -1;
-    qcw_by_qwc(2, 2) = -1;
-    qcw_by_qwc(3, 3) = -1;
+    // hc=inv(exp(dtheta))*Rcw_nominal*part2, the inverse rotation by quaternion q=[q0,u] is v+2*u'x(u'xv+q0*v), u'=-u
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw_nominal = RotMat(cam_orient_wfc_nominal_).transpose();
+    Eigen::Matrix<T, kEucl3, 1> v = Rcw_nominal.template cast<T>() * part2;
+    Eigen::Matrix<T, kEucl3, 1> u = -q.template bottomRows<kEucl3>();
+    Eigen::Matrix<T, kEucl3, 1> w = u.cross(v) + q[0] * v;
+    Eigen::Matrix<T, kEucl3, 1> hc = v + T(2) * u.cross(w);
 
-    Eigen::Matrix<Scalar, kEucl3, kQuat4> hc_by_qwc = hc_by_qcw * qcw_by_qwc;  // A.38
+    Scalar Cx = cam_intrinsics_.principal_point_pix[0];
+    Scalar Cy = cam_intrinsics_.principal_point_pix[1];
+    std::array<Scalar, 2> f_pix = cam_intrinsics_.FocalLengthPix();
 
-    //
-    Eigen::Matrix<Scalar, kPixPosComps, kQuat4> hd_by_qwc = hd_by_hu * hu_by_hc * hc_by_qwc;  // A.37
-    hd_by_cam->middleCols<kQuat4>(kEucl3) = hd_by_qwc;
+    Eigen::Matrix<T, kPixPosComps, 1> h_undistorted;
+    h_undistorted[0] = Cx - f_pix[0] * hc[0] / hc[2];
+    h_undistorted[1] = Cy - f_pix[1] * hc[1] / hc[2];
+    return h_undistorted;
 }
 
-void DavisonMonoSlam::Deriv_hd_by_sal_pnt(const MorphableSalientPoint& sal_pnt,
-    const CameraStateVars& cam_state,
-    const Eigen::Matrix<Scalar, kEucl3, kEucl3>& cam_orient_wfc,
-    const Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps>& hd_by_hu,
-    const Eigen::Matrix<Scalar, kPixPosComps, kEucl3>& hu_by_hc,
-    Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_sal_pnt) const
+void DavisonMonoSlam::Deriv_hd_by_cam_state_and_sal_pnt_ByJets(const CameraStateVars& cam_state,
+    const MorphableSalientPoint& sal_pnt_vars,
+    Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
+    HdBySalPntMat* hd_by_sal_pnt,
+    Eigen::Matrix<Scalar, kPixPosComps, 1>* hd) const
 {
-    Eigen::Matrix<Scalar, kEucl3, kEucl3> Rcw = cam_orient_wfc.transpose();
+    // the projection doesn't depend on velocities, hence the independent variables are [x dtheta y]
+    constexpr int kJetVars = static_cast<int>(kEucl3 + kOrientErrComps + kSalientPointComps);
+    using J = Jet<Scalar, kJetVars>;
 
-    Eigen::Matrix<Scalar, kEucl3, kSalientPointComps> dhc_by_dy;
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    Eigen::Matrix<Scalar, kSalientPointComps, 1> sal_pnt = Eigen::Matrix<Scalar, kSalientPointComps, 1>::Zero();
+    if (sal_pnt_vars.repres == SalPntComps::kXyz)
     {
-        // A.55
-        dhc_by_dy = Rcw;
+#if defined(XYZ_SAL_PNT_REPRES)
+        sal_pnt.topRows<kEucl3>() = Mat(sal_pnt_vars.pos_w);
+#endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
-        Scalar cos_phi = std::cos(sal_pnt.elevation_phi_w);
-        Scalar sin_phi = std::sin(sal_pnt.elevation_phi_w);
-        Scalar cos_theta = std::cos(sal_pnt.azimuth_theta_w);
-        Scalar sin_theta = std::sin(sal_pnt.azimuth_theta_w);
-
-        // A.53
-        Point3 dm_by_dtheta; // azimuth
-        dm_by_dtheta[0] = cos_phi * cos_theta;
-        dm_by_dtheta[1] = 0;
-        dm_by_dtheta[2] = -cos_phi * sin_theta;
-
-        // A.54
-        Point3 dm_by_dphi; // elevation
-        dm_by_dphi[0] = -sin_phi * sin_theta;
-        dm_by_dphi[1] = -cos_phi;
-        dm_by_dphi[2] = -sin_phi * cos_theta;
-
-        // A.52
         DependsOnSalientPointPackOrder();
-        dhc_by_dy.middleCols<kEucl3>(0) = sal_pnt.inverse_dist_rho * Rcw;
-        dhc_by_dy.middleCols<1>(kEucl3+0) = Mat(Rcw * dm_by_dtheta);
-        dhc_by_dy.middleCols<1>(kEucl3+1) = Mat(Rcw * dm_by_dphi);
-        dhc_by_dy.middleCols<1>(kEucl3+2) = Mat(Rcw * (sal_pnt.first_cam_pos_w - cam_state.pos_w));
+        sal_pnt.topRows<kEucl3>() = Mat(sal_pnt_vars.first_cam_pos_w);
+        sal_pnt[kEucl3 + 0] = sal_pnt_vars.azimuth_theta_w;
+        sal_pnt[kEucl3 + 1] = sal_pnt_vars.elevation_phi_w;
+        sal_pnt[kEucl3 + 2] = sal_pnt_vars.inverse_dist_rho;
 #endif
     }
 
-    // A.51
-    *hd_by_sal_pnt = hd_by_hu * hu_by_hc * dhc_by_dy;
+    Eigen::Matrix<Scalar, kEucl3, 1> cam_pos_w = Mat(cam_state.pos_w);
+    Eigen::Matrix<Scalar, kOrientErrComps, 1> cam_orient_err = Mat(CameraOrientationError(cam_state.orientation_wfc));
+
+    Eigen::Matrix<J, kPixPosComps, 1> hu_jets = ProjectSalientPointUndistorted<J>(
+        JetVariables<kJetVars>(cam_pos_w, 0),
+        JetVariables<kJetVars>(cam_orient_err, kEucl3),
+        sal_pnt_vars.repres,
+        JetVariables<kJetVars>(sal_pnt, kEucl3 + kOrientErrComps));
+
+    Eigen::Matrix<Scalar, kPixPosComps, 1> hu;
+    Eigen::Matrix<Scalar, kPixPosComps, kJetVars> hu_by_vars;
+    JetToJacobian(hu_jets, &hu, &hu_by_vars);
+
+    // the distortion has no closed form, but its derivative is the inverse of the derivative of the undistortion (A.33)
+    suriko::Point2f h_distorted = DistortPixel(suriko::Point2f{ hu[0], hu[1] });
+    if (hd != nullptr)
+        *hd = h_distorted.Mat();
+
+    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> hd_by_hu;
+    Deriv_hd_by_hu(h_distorted, &hd_by_hu);
+
+    Eigen::Matrix<Scalar, kPixPosComps, kJetVars> hd_by_vars = hd_by_hu * hu_by_vars;
+
+    hd_by_cam_state->setZero();
+    hd_by_cam_state->leftCols<kEucl3 + kOrientErrComps>() = hd_by_vars.leftCols<kEucl3 + kOrientErrComps>();
+
+    Eigen::Index sal_pnt_comps = static_cast<Eigen::Index>(SalientPointVarsCount(sal_pnt_vars.repres));
+    *hd_by_sal_pnt = hd_by_vars.middleCols(kEucl3 + kOrientErrComps, sal_pnt_comps);
 }
 
 void DavisonMonoSlam::Deriv_azim_theta_elev_phi_by_hw(
@@ -2899,7 +4934,7 @@ std::optional<Point3> DavisonMonoSlam::InternalSalientPointToCamera(
     SE3Transform camk_orient_cfw = SE3Inv(camk_wfc);
 
     std::optional<Point3> sal_pnt_cam;
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_vars.repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         // A.22
@@ -2908,7 +4943,7 @@ std::optional<Point3> DavisonMonoSlam::InternalSalientPointToCamera(
         sal_pnt_cam = sal_pnt_camk_eucl;
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         if (IsClose(0, sal_pnt_vars.inverse_dist_rho) && !scaled_by_inv_dist)
@@ -2957,53 +4992,6 @@ Eigen::Matrix<Scalar, kPixPosComps,1> DavisonMonoSlam::ProjectInternalSalientPoi
     return h_distorted;
 }
 
-suriko::Point2f DistortPixel(const CameraIntrinsicParams& cam_intrinsics,
-    const MikhailRadialDistortionParams& cam_distort_params,
-    const suriko::Point2f& h_undistorted)
-{
-    // hu->hd: distort image coordinates
-    using suriko::Sqr, suriko::Pow4;
-    Scalar Cx = cam_intrinsics.principal_point_pix[0];
-    Scalar Cy = cam_intrinsics.principal_point_pix[1];
-    const auto& dx = cam_intrinsics.pixel_size_mm[0];
-    const auto& dy = cam_intrinsics.pixel_size_mm[1];
-    Scalar ru = std::sqrt(Sqr(dx * (h_undistorted[0] - Cx)) + Sqr(dy * (h_undistorted[1] - Cy)));
-
-    // solve polynomial fun(rd)=0=-ru+rd+k1*rd^3+k2*rd^5
-    Scalar rd = -1;
-    const auto& k1 = cam_distort_params.k1;
-    const auto& k2 = cam_distort_params.k2;
-    if (k2 != 0)  // Eigen impl requires nonzero highest degree coefficient
-    {
-        // https://eigen.tuxfamily.org/dox/unsupported/group__Polynomials__Module.html
-        constexpr auto PolyDeg = 5;
-        Eigen::Matrix<Scalar, PolyDeg+1, 1> distort_poly{};
-        distort_poly << -ru, 1, 0, k1, 0, k2;
-        Eigen::PolynomialSolver<Scalar, PolyDeg> poly_solver{ distort_poly };
-        std::vector<Scalar> rd_roots;
-        poly_solver.realRoots(rd_roots);
-        SRK_ASSERT(rd_roots.size() == 1);
-        rd = rd_roots[0];
-    }
-    else
-    {
-        if (k1 == 0) rd = ru;
-        else
-        {
-            // polynomial fun(rd)=0=-ru+rd+k1*rd^3
-            Scalar e = std::pow(9 * k1 * k1 * ru + std::sqrt(3 * k1 * k1 * k1 * (4 + 27 * k1 * ru * ru)), 1.0f / 3);
-            rd = (-2 * std::pow(3, 1.0f / 3) * k1 + std::pow(2, 1.0f / 3) * e * e) / (std::pow<Scalar>(6, 2.0 / 3) * k1 * e);
-        }
-    }
-    SRK_ASSERT(rd != -1);
-    Scalar stretch = 1 + k1 * Sqr(rd) + k2 * Pow4(rd);
-
-    suriko::Point2f h_distorted{};
-    h_distorted[0] = Cx + (h_undistorted[0] - Cx) / stretch;
-    h_distorted[1] = Cy + (h_undistorted[1] - Cy) / stretch;
-    return h_distorted;
-}
-
 Eigen::Matrix<Scalar, kPixPosComps,1> DavisonMonoSlam::ProjectCameraSalientPoint(
     const Point3& pnt_camera,
     SalPntProjectionIntermidVars *proj_hist) const
@@ -3020,9 +5008,7 @@ Eigen::Matrix<Scalar, kPixPosComps,1> DavisonMonoSlam::ProjectCameraSalientPoint
     h_undistorted[0] = Cx - f_pix[0] * sal_pnt_cam[0] / sal_pnt_cam[2];
     h_undistorted[1] = Cy - f_pix[1] * sal_pnt_cam[1] / sal_pnt_cam[2];
 
-    suriko::Point2f h_distorted = h_undistorted;
-    if (cam_enable_distortion_)
-        h_distorted = DistortPixel(cam_intrinsics_, cam_distort_params_, h_undistorted);
+    suriko::Point2f h_distorted = DistortPixel(h_undistorted);
 
     if (proj_hist != nullptr)
     {
@@ -3039,24 +5025,31 @@ suriko::Point2f DavisonMonoSlam::ProjectCameraPoint(const suriko::Point3& pnt_ca
     return result;
 }
 
-std::tuple<bool, RotatedEllipse2D> DavisonMonoSlam::GetSalientPointProjectedUncertEllipse(FilterStageType filter_stage, SalPntId sal_pnt_id) const
+auto DavisonMonoSlam::GetSalientPointProjectedUncertEllipseCovar(FilterStageType filter_stage, SalPntId sal_pnt_id) const
+    -> std::tuple<bool, MeanAndCov2D>
 {
     auto [op_cov, corner] = GetSalientPointProjected2DPosWithUncertainty(filter_stage, sal_pnt_id);
     static_assert(std::is_same_v<decltype(corner), MeanAndCov2D>);
     SRK_ASSERT(op_cov);
-    if (!op_cov) return std::make_tuple(false, RotatedEllipse2D{});
+    if (!op_cov) return std::make_tuple(false, MeanAndCov2D{});
 
-    Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> cov = corner.cov;
     if (filter_stage == FilterStageType::Predicted)
     {
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> Rk;
         FillRk2x2(&Rk);
-        cov += Rk;
+        corner.cov += Rk;
     }
+    return std::make_tuple(true, corner);
+}
+
+std::tuple<bool, RotatedEllipse2D> DavisonMonoSlam::GetSalientPointProjectedUncertEllipse(FilterStageType filter_stage, SalPntId sal_pnt_id) const
+{
+    auto [op_cov, corner] = GetSalientPointProjectedUncertEllipseCovar(filter_stage, sal_pnt_id);
+    if (!op_cov) return std::make_tuple(false, RotatedEllipse2D{});
 
     // an ellipse can always be extracted from 'good' covariance mat of error in position
     // but here we allow bad covariance matrix
-    return Get2DRotatedEllipseFromCovMat(cov, corner.mean, covar2D_to_ellipse_confidence_);
+    return Get2DRotatedEllipseFromCovMat(corner.cov, corner.mean, covar2D_to_ellipse_confidence_);
 }
 
 std::tuple<bool, RotatedEllipse2D> DavisonMonoSlam::GetPredictedSalientPointProjectedUncertEllipse(SalPntId sal_pnt_id) const
@@ -3071,9 +5064,15 @@ void DavisonMonoSlam::Deriv_hd_by_cam_state_and_sal_pnt(
     const TrackedSalientPoint& sal_pnt,
     const MorphableSalientPoint& sal_pnt_vars,
     Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps>* hd_by_cam_state,
-    Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_sal_pnt,
+    HdBySalPntMat* hd_by_sal_pnt,
     Eigen::Matrix<Scalar, kPixPosComps, 1>* hd) const
 {
+    if (jacobians_by_jets_)
+    {
+        Deriv_hd_by_cam_state_and_sal_pnt_ByJets(cam_state, sal_pnt_vars, hd_by_cam_state, hd_by_sal_pnt, hd);
+        return;
+    }
+
     // project salient point into current camera
     SalPntProjectionIntermidVars proj_hist{};
     Eigen::Matrix<Scalar, kPixPosComps, 1> h_distorted = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, &proj_hist);
@@ -3104,7 +5103,7 @@ void DavisonMonoSlam::Deriv_hd_by_cam_state_and_sal_pnt(
 
         Scalar diff1 = (finite_diff_hd_by_xc - *hd_by_cam_state).norm();
 
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> finite_diff_hd_by_y;
+        HdBySalPntMat finite_diff_hd_by_y;
         FiniteDiff_hd_by_sal_pnt_state(cam_state, sal_pnt, derive_at_pnt, kFiniteDiffEpsDebug, &finite_diff_hd_by_y);
 
         Scalar diff2 = (finite_diff_hd_by_y - *hd_by_sal_pnt).norm();
@@ -3134,12 +5133,10 @@ void DavisonMonoSlam::Deriv_H_by_estim_vars(const CameraStateVars& cam_state,
 
         const TrackedSalientPoint& sal_pnt = GetSalientPoint(obs_sal_pnt_id);
 
-        MorphableSalientPoint sal_pnt_vars;
-        size_t off = sal_pnt.estim_vars_ind;
-        LoadSalientPointDataFromArray(Span(derive_at_pnt).subspan(off, kSalientPointComps), &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(derive_at_pnt, sal_pnt);
 
         Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
-        Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> hd_by_sal_pnt;
+        HdBySalPntMat hd_by_sal_pnt;
         Deriv_hd_by_cam_state_and_sal_pnt(derive_at_pnt, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt);
 
         //
@@ -3151,8 +5148,12 @@ void DavisonMonoSlam::Deriv_H_by_estim_vars(const CameraStateVars& cam_state,
         Hrowblock.middleCols<kCamStateComps>(0) = hd_by_cam_state;
 
         // by salient point variables
-        // observed corner position (hd) depends only on the position of corresponding salient point (and not on any other salient point)
-        Hrowblock.middleCols<kSalientPointComps>(off) = hd_by_sal_pnt;
+        // observed corner position (hd) depends only on the position of corresponding salient point (and not on any other salient point),
+        // the anchored salient point depends also on its anchor
+        ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+        {
+            Hrowblock.middleCols(var_ind, vars_count) = hd_by_sal_pnt.middleCols(sal_pnt_var_ind, vars_count);
+        });
 
         H.middleRows<kPixPosComps>(obs_sal_pnt_ind*kPixPosComps) = Hrowblock;
     }
@@ -3189,17 +5190,18 @@ void DavisonMonoSlam::FiniteDiff_hd_by_sal_pnt_state(const CameraStateVars& cam_
     const TrackedSalientPoint& sal_pnt,
     const EigenDynVec& derive_at_pnt,
     Scalar finite_diff_eps,
-    Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps>* hd_by_y) const
+    HdBySalPntMat* hd_by_y) const
 {
-    size_t off = sal_pnt.estim_vars_ind;
-    for (size_t var_ind = 0; var_ind < kSalientPointComps; ++var_ind)
+    size_t sal_pnt_comps = sal_pnt.EstimVarsCountWithAnchor();
+    hd_by_y->resize(Eigen::NoChange, sal_pnt_comps);
+    for (size_t var_ind = 0; var_ind < sal_pnt_comps; ++var_ind)
     {
         // copy cam_state
-        Eigen::Matrix<Scalar, kSalientPointComps, 1> sal_pnt_state = derive_at_pnt.middleRows<kSalientPointComps>(off);
+        SalPntVec sal_pnt_state = GetSalientPointVars(derive_at_pnt, sal_pnt);
         sal_pnt_state[var_ind] += finite_diff_eps;
 
         MorphableSalientPoint sal_pnt_right;
-        LoadSalientPointDataFromArray(gsl::make_span<const Scalar>(sal_pnt_state.data(), kSalientPointComps), &sal_pnt_right);
+        LoadSalientPointDataFromArray(gsl::make_span<const Scalar>(sal_pnt_state.data(), sal_pnt_comps), &sal_pnt_right);
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> hd_right = ProjectInternalSalientPoint(cam_state, sal_pnt_right, nullptr);
         
@@ -3207,7 +5209,7 @@ void DavisonMonoSlam::FiniteDiff_hd_by_sal_pnt_state(const CameraStateVars& cam_
         sal_pnt_state[var_ind] -= 2 * finite_diff_eps;
 
         MorphableSalientPoint sal_pnt_left;
-        LoadSalientPointDataFromArray(gsl::make_span<const Scalar>(sal_pnt_state.data(), kSalientPointComps), &sal_pnt_left);
+        LoadSalientPointDataFromArray(gsl::make_span<const Scalar>(sal_pnt_state.data(), sal_pnt_comps), &sal_pnt_left);
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> hd_left = ProjectInternalSalientPoint(cam_state, sal_pnt_left, nullptr);
         hd_by_y->middleCols<1>(var_ind) = (hd_right - hd_left) / (2 * finite_diff_eps);
@@ -3233,6 +5235,100 @@ const std::set<SalPntId>& DavisonMonoSlam::GetSalientPoints() const
     return tracked_sal_pnt_ids;
 }
 
+void DavisonMonoSlam::FreezeMap()
+{
+    // deleted salient points are destroyed at the end of a frame
+    SRK_ASSERT(sal_pnts_.size() == estim_sal_pnts_count_);
+
+    for (auto& p_sal_pnt : sal_pnts_)
+    {
+        FrozenSalientPoint frozen_sal_pnt;
+        bool op = GetSalientPoint3DPosWithUncertainty(estim_vars_, estim_vars_covar_, *p_sal_pnt, false,
+            &frozen_sal_pnt.pos_w, &frozen_sal_pnt.pos_uncert);
+        if (!op)
+        {
+            // the salient point in infinity can't be frozen
+            if (corners_matcher_ != nullptr)
+                corners_matcher_->OnSalientPointIsRemoved(SalPntId(p_sal_pnt.get()));
+            continue;
+        }
+
+        p_sal_pnt->in_frozen_map = true;
+        p_sal_pnt->sal_pnt_ind = frozen_sal_pnts_.size();
+        p_sal_pnt->repres = SalPntComps::kXyz;
+        p_sal_pnt->anchor = nullptr;
+        frozen_sal_pnt.sal_pnt = std::move(p_sal_pnt);
+        frozen_sal_pnts_.push_back(std::move(frozen_sal_pnt));
+    }
+    sal_pnts_.clear();
+    estim_sal_pnts_count_ = 0;
+    sal_pnt_anchors_.clear();
+    if (corners_matcher_ != nullptr)
+        for (const auto& p_candidate : sal_pnt_candidates_)
+            corners_matcher_->OnSalientPointIsRemoved(SalPntId(p_candidate->sal_pnt.get()));
+    sal_pnt_candidates_.clear();
+
+    // the cross-covariances between the camera and salient points are dropped
+    auto shrink_to_camera = [](EigenDynVec* src_estim_vars, EigenDynMat* src_estim_vars_covar)
+    {
+        src_estim_vars->conservativeResize(kCamStateComps);
+        src_estim_vars_covar->conservativeResize(kCamStateComps, kCamStateComps);
+    };
+    shrink_to_camera(&estim_vars_, &estim_vars_covar_);
+    shrink_to_camera(&predicted_estim_vars_, &predicted_estim_vars_covar_);
+    InvalidateCovarSqrt();
+
+    localization_only_ = true;
+}
+
+DavisonMonoSlam::SalPntId DavisonMonoSlam::AddFrozenSalientPoint(const Point3& pos_w, const Eigen::Matrix<Scalar, kEucl3, kEucl3>& pos_uncert,
+    suriko::Point2f corner_pix, Picture templ_img)
+{
+    if (!localization_only_)
+        FreezeMap();
+
+    TemplMatchStats templ_stats{};
+    bool op = CalcTemplMatchStats(templ_img, &templ_stats);
+    SRK_ASSERT(op) << "The template of the salient point must have nonzero variance";
+
+    FrozenSalientPoint frozen_sal_pnt;
+    frozen_sal_pnt.sal_pnt = NewSalientPointDescriptor(0, corner_pix, std::move(templ_img), templ_stats);
+    frozen_sal_pnt.sal_pnt->in_frozen_map = true;
+    frozen_sal_pnt.sal_pnt->sal_pnt_ind = frozen_sal_pnts_.size();
+    frozen_sal_pnt.sal_pnt->repres = SalPntComps::kXyz;
+    frozen_sal_pnt.pos_w = pos_w;
+    frozen_sal_pnt.pos_uncert = pos_uncert;
+
+    SalPntId sal_pnt_id = SalPntId(frozen_sal_pnt.sal_pnt.get());
+    frozen_sal_pnts_.push_back(std::move(frozen_sal_pnt));
+    return sal_pnt_id;
+}
+
+bool DavisonMonoSlam::IsLocalizationOnly() const
+{
+    return localization_only_;
+}
+
+size_t DavisonMonoSlam::FrozenSalientPointsCount() const
+{
+    return frozen_sal_pnts_.size();
+}
+
+bool DavisonMonoSlam::GetFrozenSalientPoint3DPosWithUncertainty(SalPntId sal_pnt_id,
+    Point3* pos_mean,
+    Eigen::Matrix<Scalar, kEucl3, kEucl3>* pos_uncert) const
+{
+    const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+    if (!sal_pnt.in_frozen_map)
+        return false;
+
+    const FrozenSalientPoint& frozen_sal_pnt = frozen_sal_pnts_[sal_pnt.sal_pnt_ind];
+    *pos_mean = frozen_sal_pnt.pos_w;
+    if (pos_uncert != nullptr)
+        *pos_uncert = frozen_sal_pnt.pos_uncert;
+    return true;
+}
+
 size_t DavisonMonoSlam::EstimatedVarsCount() const
 {
     return estim_vars_.size();
@@ -3240,42 +5336,138 @@ size_t DavisonMonoSlam::EstimatedVarsCount() const
 
 void DavisonMonoSlam::Deriv_cam_state_by_cam_state(Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const
 {
-    Scalar dT = seconds_per_frame_;
+    if (jacobians_by_jets_)
+    {
+        Deriv_cam_state_by_cam_state_ByJets(result);
+        return;
+    }
+
+    Scalar dT = PredictionInterval();
 
     auto& m = *result;
     m.setIdentity();
 
     auto id33 = Eigen::Matrix<Scalar, kEucl3, kEucl3>::Identity();
 
+    // derivative of the orientation error dthetak+1 with respect to dthetak and wk
+    Eigen::Matrix<Scalar, kOrientErrComps, kOrientErrComps> err_by_err;
+    Eigen::Matrix<Scalar, kOrientErrComps, kAngVelocComps> err_by_w;
+    Deriv_orient_err_by_orient_err_and_w(dT, &err_by_err, &err_by_w);
+
+    m.block<kOrientErrComps, kOrientErrComps>(kEucl3, kEucl3) = err_by_err;
+
+    // the constant position model has no dependency on velocities
+    if constexpr (!kCamStateHasVelocity)
+    {
+        SRK_ASSERT(m.allFinite());
+        return;
+    }
+
     // derivative of speed v by speed v
     DependsOnCameraPosPackOrder();
-    m.block<kEucl3, kEucl3>(0, kEucl3 + kQuat4) = id33 * dT;
+    m.block<kEucl3, kEucl3>(0, kEucl3 + kOrientErrComps) = id33 * dT;
+
+    m.block<kOrientErrComps, kAngVelocComps>(kEucl3, kEucl3 + kOrientErrComps + kVelocComps) = err_by_w;
 
-    // derivative of qk+1 with respect to qk
+    // the angular velocity, measured by the gyroscope, doesn't depend on the state
+    if (ImuAngularVelocity().has_value())
+    {
+        m.block<kOrientErrComps, kAngVelocComps>(kEucl3, kEucl3 + kOrientErrComps + kVelocComps).setZero();
+        m.block<kAngVelocComps, kAngVelocComps>(kEucl3 + kOrientErrComps + kVelocComps, kEucl3 + kOrientErrComps + kVelocComps).setZero();
+    }
 
-    Eigen::Matrix<Scalar, kAngVelocComps, 1> w = EstimVarsCamAngularVelocity();
-    Eigen::Matrix<Scalar, kAngVelocComps, 1> delta_orient = w * dT;
+    // the specific force is rotated into the tracker's frame by the orientation of the camera
+    if (ImuAccelerationAvailable())
+    {
+        Point3 err = estim_vars_.middleRows<kOrientErrComps>(kEucl3);
 
-    Eigen::Matrix<Scalar, kQuat4, 1> q1;
-    QuatFromAxisAngle(delta_orient, &q1);
+        // d(Rnom*exp(err+d)*f)=-Rnom*exp(err)*skew(f)*Jr(err)*d
+        Eigen::Matrix<Scalar, kEucl3, kEucl3> skew_f;
+        SkewSymmetricMat(frame_timing_.imu.value().specific_force_c.value(), &skew_f);
 
-    // formula A.12
-    Eigen::Matrix<Scalar, kQuat4, kQuat4> q3_by_q2;
-    q3_by_q2 <<
-        q1[0], -q1[1], -q1[2], -q1[3],
-        q1[1],  q1[0],  q1[3], -q1[2],
-        q1[2], -q1[3],  q1[0],  q1[1],
-        q1[3],  q1[2], -q1[1],  q1[0];
-    m.block<kQuat4, kQuat4>(kEucl3, kEucl3) = q3_by_q2;
+        Eigen::Matrix<Scalar, kEucl3, kEucl3> jr_err;
+        RightJacobianSO3(err, &jr_err);
 
-    //
-    Eigen::Matrix<Scalar, kQuat4, kAngVelocComps> q3_by_w;
-    Deriv_q3_by_w(dT, &q3_by_w);
+        Eigen::Matrix<Scalar, kQuat4, 1> err_quat;
+        QuatFromAxisAngle(err, &err_quat);
 
-    m.block<kQuat4, kAngVelocComps>(kEucl3, kEucl3 + kQuat4 +  kVelocComps) = q3_by_w;
+        Eigen::Matrix<Scalar, kEucl3, kOrientErrComps> accel_by_err = -RotMat(cam_orient_wfc_nominal_) * RotMat(err_quat) * skew_f * jr_err;
+        m.block<kEucl3, kOrientErrComps>(0, kEucl3) = accel_by_err * (dT * dT / 2);
+        m.block<kVelocComps, kOrientErrComps>(kEucl3 + kOrientErrComps, kEucl3) = accel_by_err * dT;
+    }
     SRK_ASSERT(m.allFinite());
 }
 
+template <typename T>
+Eigen::Matrix<T, kCamStateComps, 1> DavisonMonoSlam::PredictCameraState(const Eigen::Matrix<T, kCamStateComps, 1>& cam_state) const
+{
+    Eigen::Matrix<T, kEucl3, 1> cam_pos = cam_state.template middleRows<kEucl3>(0);
+    Eigen::Matrix<T, kOrientErrComps, 1> cam_orient_err = cam_state.template middleRows<kOrientErrComps>(kEucl3);
+    Eigen::Matrix<T, kVelocComps, 1> cam_vel = Eigen::Matrix<T, kVelocComps, 1>::Zero();
+    Eigen::Matrix<T, kAngVelocComps, 1> cam_ang_vel = Eigen::Matrix<T, kAngVelocComps, 1>::Zero();
+    if constexpr (kCamStateHasVelocity)
+    {
+        cam_vel = cam_state.template middleRows<kVelocComps>(kEucl3 + kOrientErrComps);
+        cam_ang_vel = cam_state.template middleRows<kAngVelocComps>(kEucl3 + kOrientErrComps + kVelocComps);
+    }
+
+    // the gyroscope replaces the angular velocity of the motion model
+    std::optional<Point3> imu_ang_vel = ImuAngularVelocity();
+    if (imu_ang_vel.has_value())
+        cam_ang_vel = Mat(imu_ang_vel.value()).template cast<T>();
+
+    Eigen::Matrix<T, kQuat4, 1> cam_orient_err_quat = QuatFromAxisAngleGeneric(cam_orient_err);
+
+    // a=Rnom*exp(err)*f+g, the rotation by quaternion q=[q0,u] is v+2*ux(uxv+q0*v)
+    Eigen::Matrix<T, kEucl3, 1> cam_accel = Eigen::Matrix<T, kEucl3, 1>::Zero();
+    if (ImuAccelerationAvailable())
+    {
+        Eigen::Matrix<T, kEucl3, 1> f = Mat(frame_timing_.imu.value().specific_force_c.value()).template cast<T>();
+        const T& q0 = cam_orient_err_quat[0];
+        Eigen::Matrix<T, kEucl3, 1> u = cam_orient_err_quat.template bottomRows<kEucl3>();
+        Eigen::Matrix<T, kEucl3, 1> f_rot = f + T(2) * u.cross(u.cross(f) + q0 * f);
+        cam_accel = RotMat(cam_orient_wfc_nominal_).template cast<T>() * f_rot + Mat(imu_gravity_w_.value()).template cast<T>();
+    }
+
+    Eigen::Matrix<T, kCamStateComps, 1> new_cam_state;
+
+    // camera position
+    Scalar dT = PredictionInterval();
+    new_cam_state.template middleRows<kEucl3>(0) = cam_pos + cam_vel * dT + cam_accel * (dT * dT / 2);
+
+    // camera orientation, exp(new_err)=exp(err)*q(delta); the product of quaternions a*b=[a0*b0-au.bu, a0*bu+b0*au+auxbu]
+    Eigen::Matrix<T, kQuat4, 1> delta_quat = QuatFromAxisAngleGeneric<T>(cam_ang_vel * dT);
+    Eigen::Matrix<T, kEucl3, 1> err_u = cam_orient_err_quat.template bottomRows<kEucl3>();
+    Eigen::Matrix<T, kEucl3, 1> delta_u = delta_quat.template bottomRows<kEucl3>();
+
+    Eigen::Matrix<T, kQuat4, 1> new_err_quat;
+    new_err_quat[0] = cam_orient_err_quat[0] * delta_quat[0] - err_u.dot(delta_u);
+    new_err_quat.template bottomRows<kEucl3>() = cam_orient_err_quat[0] * delta_u + delta_quat[0] * err_u + err_u.cross(delta_u);
+    new_cam_state.template middleRows<kOrientErrComps>(kEucl3) = AxisAngleFromQuatGeneric(new_err_quat);
+
+    if constexpr (kCamStateHasVelocity)
+    {
+        // camera velocity is unchanged, unless the acceleration is measured; camera angular velocity is unchanged
+        new_cam_state.template middleRows<kVelocComps>(kEucl3 + kOrientErrComps) = cam_vel + cam_accel * dT;
+        new_cam_state.template middleRows<kAngVelocComps>(kEucl3 + kOrientErrComps + kVelocComps) = cam_ang_vel;
+    }
+    return new_cam_state;
+}
+
+void DavisonMonoSlam::Deriv_cam_state_by_cam_state_ByJets(Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const
+{
+    // the derivatives are taken at the current estimate, as in Deriv_cam_state_by_cam_state
+    constexpr int kJetVars = static_cast<int>(kCamStateComps);
+    using J = Jet<Scalar, kJetVars>;
+
+    Eigen::Matrix<Scalar, kCamStateComps, 1> cam_state = estim_vars_.topRows<kCamStateComps>();
+    Eigen::Matrix<J, kCamStateComps, 1> new_cam_state_jets = PredictCameraState<J>(JetVariables<kJetVars>(cam_state));
+
+    Eigen::Matrix<Scalar, kCamStateComps, 1> new_cam_state;
+    JetToJacobian(new_cam_state_jets, &new_cam_state, result);
+    SRK_ASSERT(result->allFinite());
+}
+
 void DavisonMonoSlam::FiniteDiff_cam_state_by_cam_state(gsl::span<const Scalar> cam_state, Scalar finite_diff_eps,
     Eigen::Matrix<Scalar, kCamStateComps, kCamStateComps>* result) const
 {
@@ -3312,21 +5504,25 @@ void DavisonMonoSlam::FiniteDiff_cam_state_by_cam_state(gsl::span<const Scalar>
 
 void DavisonMonoSlam::Deriv_cam_state_by_process_noise(Eigen::Matrix<Scalar, kCamStateComps, kProcessNoiseComps>* result) const
 {
-    Scalar dT = seconds_per_frame_;
+    Scalar dT = PredictionInterval();
 
     auto& m = *result;
     m.setZero();
     const auto id3x3 = Eigen::Matrix<Scalar, kEucl3, kEucl3>::Identity();
     m.block<kEucl3, kEucl3>(0, 0) = dT * id3x3;
-    m.block<kEucl3, kEucl3>(kEucl3 + kQuat4, 0) = id3x3;
-    m.block<kEucl3, kEucl3>(kEucl3 + kQuat4 + kVelocComps, kEucl3) = id3x3;
+    if constexpr (kCamStateHasVelocity)
+    {
+        m.block<kEucl3, kEucl3>(kEucl3 + kOrientErrComps, 0) = id3x3;
+        m.block<kEucl3, kEucl3>(kEucl3 + kOrientErrComps + kVelocComps, kEucl3) = id3x3;
+    }
 
-    // derivative of q3 with respect to capital omega is the same as the little omega
+    // derivative of the orientation error with respect to capital omega is the same as the little omega
     // because in A.9 small omega and capital omega are interchangable
-    Eigen::Matrix<Scalar, kQuat4, kAngVelocComps> q3_by_cap_omega;
-    Deriv_q3_by_w(dT, &q3_by_cap_omega);
+    Eigen::Matrix<Scalar, kOrientErrComps, kOrientErrComps> err_by_err;
+    Eigen::Matrix<Scalar, kOrientErrComps, kAngVelocComps> err_by_cap_omega;
+    Deriv_orient_err_by_orient_err_and_w(dT, &err_by_err, &err_by_cap_omega);
 
-    m.block<kQuat4, kAngVelocComps>(kEucl3, kEucl3) = q3_by_cap_omega;
+    m.block<kOrientErrComps, kAngVelocComps>(kEucl3, kEucl3) = err_by_cap_omega;
     SRK_ASSERT(m.allFinite());
 }
 
@@ -3359,71 +5555,49 @@ void DavisonMonoSlam::FiniteDiff_cam_state_by_process_noise(Scalar finite_diff_e
     }
 }
 
-void DavisonMonoSlam::Deriv_q3_by_w(Scalar deltaT, Eigen::Matrix<Scalar, kQuat4, kEucl3>* result) const
+void DavisonMonoSlam::Deriv_orient_err_by_orient_err_and_w(Scalar deltaT,
+    Eigen::Matrix<Scalar, kOrientErrComps, kOrientErrComps>* err_by_err,
+    Eigen::Matrix<Scalar, kOrientErrComps, kAngVelocComps>* err_by_w) const
 {
-    Eigen::Matrix<Scalar, kQuat4, 1> q2 = EstimVarsCamQuat();
+    Point3 err = estim_vars_.middleRows<kOrientErrComps>(kEucl3);
+    Point3 delta_orient = ImuAngularVelocity().value_or(EstimVarsCamAngularVelocity()) * deltaT;
 
-    // formula A.14
-    Eigen::Matrix<Scalar, kQuat4, kQuat4> q3_by_q1;
-    q3_by_q1 <<
-        q2[0], -q2[1], -q2[2], -q2[3],
-        q2[1], q2[0], -q2[3], q2[2],
-        q2[2], q2[3], q2[0], -q2[1],
-        q2[3], -q2[2], q2[1], q2[0];
+    // exp(err_new)=exp(err)*exp(w*dT)
+    Eigen::Matrix<Scalar, kQuat4, 1> err_quat;
+    QuatFromAxisAngle(err, &err_quat);
 
-    //
-    Eigen::Matrix<Scalar, kQuat4, kAngVelocComps> q1_by_wk;
-    Deriv_q1_by_w(deltaT, &q1_by_wk);
+    Eigen::Matrix<Scalar, kQuat4, 1> delta_quat;
+    QuatFromAxisAngle(delta_orient, &delta_quat);
 
-    // A.13
-    *result = q3_by_q1 * q1_by_wk;
-}
+    Eigen::Matrix<Scalar, kQuat4, 1> err_new_quat;
+    QuatMult(err_quat, delta_quat, &err_new_quat);
 
-void DavisonMonoSlam::Deriv_q1_by_w(Scalar deltaT, Eigen::Matrix<Scalar, kQuat4, kEucl3>* result) const
-{
-    auto& q1_by_wk = *result;
+    Point3 err_new;
+    AxisAngleFromQuat(err_new_quat, &err_new);
 
-    Eigen::Matrix<Scalar, kAngVelocComps, 1> w = EstimVarsCamAngularVelocity();
-    Scalar len_w = w.norm();
-    if (IsClose(0, len_w))
-    {
-        // when len(w)->0, the limit of formula A.19 gets deltaT/2 value; other values in the matrix are zero
-        q1_by_wk.setZero();
-        q1_by_wk(1, 0) = deltaT / 2;
-        q1_by_wk(2, 1) = deltaT / 2;
-        q1_by_wk(3, 2) = deltaT / 2;
-        return;
-    }
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> jr_err;
+    RightJacobianSO3(err, &jr_err);
 
-    Scalar c = std::cos(0.5f*len_w*deltaT);
-    Scalar s = std::sin(0.5f*len_w*deltaT);
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> jr_delta;
+    RightJacobianSO3(delta_orient, &jr_delta);
 
-    // top row
-    for (size_t i = 0; i < kAngVelocComps; ++i)
-    {
-        q1_by_wk(0, i) = -0.5f*deltaT*w[i] / len_w * s;
-    }
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> jr_inv_err_new;
+    RightJacobianInvSO3(err_new, &jr_inv_err_new);
 
-    // next 3 rows
-    for (size_t i = 0; i < kAngVelocComps; ++i)
-        for (size_t j = 0; j < kAngVelocComps; ++j)
-        {
-            if (i == j) // on 'diagonal'
-            {
-                Scalar rat = w[i] / len_w;
-                q1_by_wk(1 + i, i) = 0.5f*deltaT*rat*rat*c + (1 / len_w)*s*(1 - rat * rat);
-            }
-            else // off 'diagonal'
-            {
-                q1_by_wk(1 + i, j) = w[i] * w[j] / (len_w*len_w)*(0.5f*deltaT*c - (1 / len_w)*s);
-            }
-        }
+    // exp(err+d)*exp(w*dT)=exp(err_new)*exp(exp(w*dT)^T*Jr(err)*d)
+    *err_by_err = jr_inv_err_new * RotMat(delta_quat).transpose() * jr_err;
+
+    // exp(err)*exp((w+d)*dT)=exp(err_new)*exp(Jr(w*dT)*d*dT)
+    *err_by_w = jr_inv_err_new * jr_delta * deltaT;
 }
 
 void DavisonMonoSlam::LoadSalientPointDataFromArray(gsl::span<const Scalar> src, MorphableSalientPoint* result) const
 {
+    // the representation of a salient point is determined by the number of its variables
     DependsOnSalientPointPackOrder();
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    SRK_ASSERT(src.size() == kXyzSalientPointComps || src.size() == kSphericalSalientPointComps);
+    result->repres = src.size() == kXyzSalientPointComps ? SalPntComps::kXyz : SalPntComps::kSphericalFirstCamInvDist;
+    if (result->repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         result->pos_w[0] = src[0];
@@ -3431,7 +5605,7 @@ void DavisonMonoSlam::LoadSalientPointDataFromArray(gsl::span<const Scalar> src,
         result->pos_w[2] = src[2];
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (result->repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         result->first_cam_pos_w[0] = src[0];
@@ -3444,16 +5618,63 @@ void DavisonMonoSlam::LoadSalientPointDataFromArray(gsl::span<const Scalar> src,
     }
 }
 
-DavisonMonoSlam::MorphableSalientPoint DavisonMonoSlam::LoadSalientPointDataFromSrcEstimVars(const EigenDynVec& src_estim_vars, size_t estim_vars_ind) const
+DavisonMonoSlam::MorphableSalientPoint DavisonMonoSlam::LoadSalientPointDataFromSrcEstimVars(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const
 {
     DavisonMonoSlam::MorphableSalientPoint result;
-    LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(estim_vars_ind, kSalientPointComps), &result);
+    if (sal_pnt.anchor == nullptr)
+    {
+        LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, sal_pnt.EstimVarsCount()), &result);
+        return result;
+    }
+
+    // the anchored salient point is loaded as the inverse depth salient point
+    SalPntVec sal_pnt_vars = GetSalientPointVars(src_estim_vars, sal_pnt);
+    LoadSalientPointDataFromArray(Span(sal_pnt_vars), &result);
     return result;
 }
 
-DavisonMonoSlam::MorphableSalientPoint DavisonMonoSlam::LoadSalientPointDataFromSrcEstimVars(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const
+auto DavisonMonoSlam::GetSalientPointVars(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const -> SalPntVec
+{
+    SalPntVec result(sal_pnt.EstimVarsCountWithAnchor());
+    ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+    {
+        result.middleRows(sal_pnt_var_ind, vars_count) = src_estim_vars.middleRows(var_ind, vars_count);
+    });
+    return result;
+}
+
+void DavisonMonoSlam::SetSalientPointVars(gsl::span<const Scalar> sal_pnt_vars, const TrackedSalientPoint& sal_pnt, EigenDynVec* dst_estim_vars) const
+{
+    SRK_ASSERT(static_cast<size_t>(sal_pnt_vars.size()) == sal_pnt.EstimVarsCountWithAnchor());
+    ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t vars_count)
+    {
+        for (size_t i = 0; i < vars_count; ++i)
+            (*dst_estim_vars)[var_ind + i] = sal_pnt_vars[sal_pnt_var_ind + i];
+    });
+}
+
+void DavisonMonoSlam::GetSalientPointCovarCols(const EigenDynMat& src_estim_vars_covar, size_t first_var_ind, size_t vars_count,
+    const TrackedSalientPoint& sal_pnt, SalPntCovarCols* covar_cols) const
+{
+    covar_cols->resize(vars_count, sal_pnt.EstimVarsCountWithAnchor());
+    ForEachSalientPointVarsSegment(sal_pnt, [&](size_t var_ind, size_t sal_pnt_var_ind, size_t seg_vars_count)
+    {
+        covar_cols->middleCols(sal_pnt_var_ind, seg_vars_count) = src_estim_vars_covar.block(first_var_ind, var_ind, vars_count, seg_vars_count);
+    });
+}
+
+auto DavisonMonoSlam::GetSalientPointsCovar(const EigenDynMat& src_estim_vars_covar,
+    const TrackedSalientPoint& row_sal_pnt, const TrackedSalientPoint& col_sal_pnt) const -> SalPntMat
 {
-    return LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt.estim_vars_ind);
+    SalPntMat result(row_sal_pnt.EstimVarsCountWithAnchor(), col_sal_pnt.EstimVarsCountWithAnchor());
+    ForEachSalientPointVarsSegment(row_sal_pnt, [&](size_t row_var_ind, size_t row_sal_pnt_var_ind, size_t rows)
+    {
+        ForEachSalientPointVarsSegment(col_sal_pnt, [&](size_t col_var_ind, size_t col_sal_pnt_var_ind, size_t cols)
+        {
+            result.block(row_sal_pnt_var_ind, col_sal_pnt_var_ind, rows, cols) = src_estim_vars_covar.block(row_var_ind, col_var_ind, rows, cols);
+        });
+    });
+    return result;
 }
 
 void DavisonMonoSlam::SaveSalientPointDataToArray(const SphericalSalientPoint& sal_pnt_vars, gsl::span<Scalar> dst) const
@@ -3469,7 +5690,7 @@ void DavisonMonoSlam::SaveSalientPointDataToArray(const SphericalSalientPoint& s
 void DavisonMonoSlam::SaveSalientPointDataToArray(const MorphableSalientPoint& sal_pnt_vars, gsl::span<Scalar> dst) const
 {
     DependsOnSalientPointPackOrder();
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_vars.repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         dst[0] = sal_pnt_vars.pos_w[0];
@@ -3477,7 +5698,7 @@ void DavisonMonoSlam::SaveSalientPointDataToArray(const MorphableSalientPoint& s
         dst[2] = sal_pnt_vars.pos_w[2];
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         dst[0] = sal_pnt_vars.first_cam_pos_w[0];
@@ -3498,21 +5719,24 @@ void DavisonMonoSlam::SaveCameraStateToArray(const CameraStateVars& cam_state, g
     dst[1] = cam_state.pos_w[1];
     dst[2] = cam_state.pos_w[2];
 
-    // camera orientation
-    dst[3] = cam_state.orientation_wfc[0];
-    dst[4] = cam_state.orientation_wfc[1];
-    dst[5] = cam_state.orientation_wfc[2];
-    dst[6] = cam_state.orientation_wfc[3];
+    // camera orientation error, relative to the nominal orientation
+    Point3 cam_orient_err = CameraOrientationError(cam_state.orientation_wfc);
+    dst[3] = cam_orient_err[0];
+    dst[4] = cam_orient_err[1];
+    dst[5] = cam_orient_err[2];
 
-    // camera velocity
-    dst[7] = cam_state.velocity_w[0];
-    dst[8] = cam_state.velocity_w[1];
-    dst[9] = cam_state.velocity_w[2];
+    if constexpr (kCamStateHasVelocity)
+    {
+        // camera velocity
+        dst[6] = cam_state.velocity_w[0];
+        dst[7] = cam_state.velocity_w[1];
+        dst[8] = cam_state.velocity_w[2];
 
-    // camera angular velocity
-    dst[10] = cam_state.angular_velocity_c[0];
-    dst[11] = cam_state.angular_velocity_c[1];
-    dst[12] = cam_state.angular_velocity_c[2];
+        // camera angular velocity
+        dst[9] = cam_state.angular_velocity_c[0];
+        dst[10] = cam_state.angular_velocity_c[1];
+        dst[11] = cam_state.angular_velocity_c[2];
+    }
 }
 
 void DavisonMonoSlam::SaveEstimVars(const CameraStateVars& cam_state,
@@ -3529,18 +5753,24 @@ void DavisonMonoSlam::SaveEstimVars(const CameraStateVars& cam_state,
 
     for (size_t sal_pnt_ind = 0; sal_pnt_ind < sal_pnts.size(); ++sal_pnt_ind)
     {
-        size_t sal_pnt_offset = SalientPointOffset(sal_pnt_ind);
         const auto& sal_pnt_state = sal_pnts[sal_pnt_ind];
+        const TrackedSalientPoint& sal_pnt = *sal_pnts_[sal_pnt_ind];
 
-        gsl::span<Scalar> sal_pnt_dst = dst.subspan(sal_pnt_offset, kSalientPointComps);
-        SaveSalientPointDataToArray(sal_pnt_state, sal_pnt_dst);
+        // the anchor is saved for each of its salient points; all of them share the same first camera
+        SalPntVec sal_pnt_vars(sal_pnt.EstimVarsCountWithAnchor());
+        SaveSalientPointDataToArray(sal_pnt_state, Span(sal_pnt_vars));
+        SetSalientPointVars(Span(sal_pnt_vars), sal_pnt, &est);
     }
 }
 
 size_t DavisonMonoSlam::SalientPointOffset(size_t sal_pnt_ind) const
 {
     DependsOnOverallPackOrder();
-    return kCamStateComps + sal_pnt_ind * kSalientPointComps;
+    // salient points may have different number of variables, hence the offset is stored in each salient point;
+    // the offset past the last salient point is the place for a new salient point
+    if (sal_pnt_ind == SalientPointsCount())
+        return EstimatedVarsCount();
+    return sal_pnts_[sal_pnt_ind]->estim_vars_ind;
 }
 
 TrackedSalientPoint& DavisonMonoSlam::GetSalientPoint(SalPntId id)
@@ -3561,6 +5791,15 @@ SalPntId DavisonMonoSlam::GetSalientPointIdByOrderInEstimCovMat(size_t sal_pnt_i
 
 void DavisonMonoSlam::CheckSalientPointsConsistency() const
 {
+    // the variables of salient points and anchors tile the state after the camera
+    std::vector<std::pair<size_t, size_t>> var_blocks;  // (estim_vars_ind, vars_count)
+    std::map<const SalPntAnchor*, size_t> anchor_sal_pnts_count;
+    for (const auto& p_anchor : sal_pnt_anchors_)
+    {
+        var_blocks.push_back({ p_anchor->estim_vars_ind, kEucl3 });
+        anchor_sal_pnts_count[p_anchor.get()] = 0;
+    }
+
     for (size_t sal_pnt_ind = 0; sal_pnt_ind < estim_sal_pnts_count_; ++sal_pnt_ind)
     {
         const auto& p_sal_pnt = sal_pnts_[sal_pnt_ind];
@@ -3574,10 +5813,33 @@ void DavisonMonoSlam::CheckSalientPointsConsistency() const
         SalPntId sal_pnt_id_by_ind = GetSalientPointIdByOrderInEstimCovMat(sal_pnt_ind);
         SRK_ASSERT(sal_pnt_id == sal_pnt_id_by_ind);
 
-        // offset
-        size_t offset = SalientPointOffset(sal_pnt_ind);
-        SRK_ASSERT(offset == sal_pnt.estim_vars_ind);
+        var_blocks.push_back({ sal_pnt.estim_vars_ind, sal_pnt.EstimVarsCount() });
+
+        // anchor
+        SRK_ASSERT((sal_pnt.anchor != nullptr) == (sal_pnt.repres == SalPntComps::kSphericalAnchoredInvDist));
+        if (sal_pnt.anchor != nullptr)
+        {
+            auto anchor_it = anchor_sal_pnts_count.find(sal_pnt.anchor);
+            SRK_ASSERT(anchor_it != anchor_sal_pnts_count.end()) << "Salient point refers to unknown anchor";
+            anchor_it->second += 1;
+        }
+    }
+
+    for (const auto& p_anchor : sal_pnt_anchors_)
+    {
+        SRK_ASSERT(p_anchor->sal_pnts_count > 0) << "Anchor without salient points must be removed";
+        SRK_ASSERT(p_anchor->sal_pnts_count == anchor_sal_pnts_count[p_anchor.get()]);
+    }
+
+    // offset
+    std::sort(var_blocks.begin(), var_blocks.end());
+    size_t offset = kCamStateComps;
+    for (auto [estim_vars_ind, vars_count] : var_blocks)
+    {
+        SRK_ASSERT(offset == estim_vars_ind);
+        offset += vars_count;
     }
+    SRK_ASSERT(offset == EstimatedVarsCount());
 }
 
 std::optional<SalPntRectFacet> DavisonMonoSlam::ProtrudeSalientPointTemplIntoWorld(const EigenDynVec& src_estim_vars, const TrackedSalientPoint& sal_pnt) const
@@ -3684,6 +5946,65 @@ std::optional<SalPntRectFacet> DavisonMonoSlam::ProtrudeSalientTemplateIntoWorld
     return ProtrudeSalientPointTemplIntoWorld(src_estim_vars, sal_pnt);
 }
 
+std::optional<std::array<suriko::Point2f, 4>> DavisonMonoSlam::PredictSalientPointTemplCorners(SalPntId sal_pnt_id) const
+{
+    const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+    if (sal_pnt.in_candidate_pool || sal_pnt.in_frozen_map)
+        return std::nullopt;
+
+    Point3 sal_pnt_w;
+    if (!GetSalientPoint3DPosWithUncertainty(predicted_estim_vars_, predicted_estim_vars_covar_, sal_pnt, false, &sal_pnt_w, nullptr))
+        return std::nullopt;  // in the infinity
+
+    // the plane of the template is orthogonal to the ray from the first camera to the salient point
+    Point3 plane_normal = sal_pnt_w - sal_pnt.initial_cam_pos_w_;
+    const Scalar plane_dist = Norm(plane_normal);
+    if (IsClose(0, plane_dist))
+        return std::nullopt;
+    plane_normal = plane_normal / plane_dist;
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> first_cam_wfc;
+    RotMatFromQuat(Span(sal_pnt.initial_cam_orient_wfc_), &first_cam_wfc);
+
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(predicted_estim_vars_, kCamStateComps), &cam_state);
+
+    Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_wfc;
+    RotMatFromQuat(Span(cam_state.orientation_wfc), &cam_wfc);
+    const Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_cfw = cam_wfc.transpose();
+
+    using RealCorner = Eigen::Matrix<Scalar, 2, 1>;
+    auto top_left = RealCorner{ sal_pnt.initial_templ_top_left_pix_.x, sal_pnt.initial_templ_top_left_pix_.y };
+    auto bot_right = RealCorner{
+        top_left[0] + sal_pnt_templ_size_.width,
+        top_left[1] + sal_pnt_templ_size_.height
+    };
+
+    std::array<RealCorner, 4> corners;
+    corners[SalPntRectFacet::kTopLeftInd] = top_left;
+    corners[SalPntRectFacet::kTopRightInd] = RealCorner{ bot_right[0], top_left[1] };
+    corners[SalPntRectFacet::kBotLeftInd] = RealCorner{ top_left[0], bot_right[1] };
+    corners[SalPntRectFacet::kBotRightInd] = bot_right;
+
+    std::array<suriko::Point2f, 4> result;
+    for (size_t i = 0; i < corners.size(); ++i)
+    {
+        Point3 corner_dir_w = first_cam_wfc * BackprojectPixelIntoCameraPlane(UndistortPixel(suriko::Point2f{ corners[i] }).Mat());
+
+        // intersect the ray from the first camera with the plane of the template
+        Scalar cos_ang = Dot(plane_normal, corner_dir_w);
+        if (cos_ang <= 0)
+            return std::nullopt;
+        Point3 vertex_w = sal_pnt.initial_cam_pos_w_ + corner_dir_w * (plane_dist / cos_ang);
+
+        Point3 vertex_cam = cam_cfw * (vertex_w - cam_state.pos_w);
+        if (vertex_cam[2] <= 0)
+            return std::nullopt;  // behind the camera
+        result[i] = ProjectCameraPoint(vertex_cam);
+    }
+    return result;
+}
+
 void DavisonMonoSlam::LoadCameraStateVarsFromArray(gsl::span<const Scalar> src, CameraStateVars* result) const
 {
     DependsOnCameraPosPackOrder();
@@ -3691,16 +6012,37 @@ void DavisonMonoSlam::LoadCameraStateVarsFromArray(gsl::span<const Scalar> src,
     c.pos_w[0] = src[0];
     c.pos_w[1] = src[1];
     c.pos_w[2] = src[2];
-    c.orientation_wfc[0] = src[3];
-    c.orientation_wfc[1] = src[4];
-    c.orientation_wfc[2] = src[5];
-    c.orientation_wfc[3] = src[6];
-    c.velocity_w[0] = src[7];
-    c.velocity_w[1] = src[8];
-    c.velocity_w[2] = src[9];
-    c.angular_velocity_c[0] = src[10];
-    c.angular_velocity_c[1] = src[11];
-    c.angular_velocity_c[2] = src[12];
+
+    // orientation_wfc=nominal*exp(dtheta)
+    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_err_quat;
+    QuatFromAxisAngle(src.subspan(3, kOrientErrComps), Span(cam_orient_err_quat));
+    QuatMult(cam_orient_wfc_nominal_, cam_orient_err_quat, &c.orientation_wfc);
+
+    if constexpr (kCamStateHasVelocity)
+    {
+        c.velocity_w[0] = src[6];
+        c.velocity_w[1] = src[7];
+        c.velocity_w[2] = src[8];
+        c.angular_velocity_c[0] = src[9];
+        c.angular_velocity_c[1] = src[10];
+        c.angular_velocity_c[2] = src[11];
+    }
+    else
+    {
+        Fill(0, &c.velocity_w);
+        Fill(0, &c.angular_velocity_c);
+    }
+}
+
+Point3 DavisonMonoSlam::CameraOrientationError(const Eigen::Matrix<Scalar, kQuat4, 1>& cam_orient_wfc) const
+{
+    // exp(dtheta)=inv(nominal)*orientation_wfc
+    Eigen::Matrix<Scalar, kQuat4, 1> cam_orient_err_quat;
+    QuatMult(QuatInverse(cam_orient_wfc_nominal_), cam_orient_wfc, &cam_orient_err_quat);
+
+    Point3 cam_orient_err;
+    AxisAngleFromQuat(cam_orient_err_quat, &cam_orient_err);
+    return cam_orient_err;
 }
 
 CameraStateVars DavisonMonoSlam::GetCameraStateVars(FilterStageType filter_step)
@@ -3766,11 +6108,11 @@ void DavisonMonoSlam::GetCameraPosAndOrientationWithUncertainty(FilterStageType
     unc = orig_uncert;
     SRK_ASSERT(unc.allFinite());
 
+    CameraStateVars cam_state;
+    LoadCameraStateVarsFromArray(Span(src_estim_vars, kCamStateComps), &cam_state);
+
     auto& q = *cam_orient_quat;
-    q[0] = src_estim_vars[3];
-    q[1] = src_estim_vars[4];
-    q[2] = src_estim_vars[5];
-    q[3] = src_estim_vars[6];
+    q = cam_state.orientation_wfc;
     SRK_ASSERT(q.allFinite());
 }
 
@@ -3853,19 +6195,18 @@ bool DavisonMonoSlam::GetSalientPointPositionUncertainty(
     bool can_throw,
     Eigen::Matrix<Scalar, kEucl3, kEucl3>* sal_pnt_pos_covar) const
 {
-    Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps> sal_pnt_covar =
-        src_estim_vars_covar.block<kSalientPointComps, kSalientPointComps>(sal_pnt.estim_vars_ind, sal_pnt.estim_vars_ind);
+    SalPntMat sal_pnt_covar = GetSalientPointsCovar(src_estim_vars_covar, sal_pnt, sal_pnt);
 
     auto sal_pnt_covar_sym = (sal_pnt_covar + sal_pnt_covar.transpose()) / 2;
     auto sal_pnt_covar_diff = (sal_pnt_covar_sym - sal_pnt_covar).norm();
 
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_vars.repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         *sal_pnt_pos_covar = sal_pnt_covar;
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         SphericalSalientPoint spher_sal_pnt;
@@ -3894,6 +6235,10 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(FilterStageTy
     std::tie(src_estim_vars, src_estim_vars_covar) = GetFilterStage(filter_stage);
     
     const TrackedSalientPoint& sal_pnt = GetSalientPoint(sal_pnt_id);
+    if (sal_pnt.in_candidate_pool)
+        return GetSalientPointCandidateProjected2DPosWithUncertainty(*src_estim_vars, *src_estim_vars_covar, *FindSalientPointCandidate(sal_pnt));
+    if (sal_pnt.in_frozen_map)
+        return GetFrozenSalientPointProjected2DPosWithUncertainty(*src_estim_vars, *src_estim_vars_covar, frozen_sal_pnts_[sal_pnt.sal_pnt_ind]);
     
     return GetSalientPointProjected2DPosWithUncertainty(*src_estim_vars, *src_estim_vars_covar, sal_pnt);
 }
@@ -3906,32 +6251,28 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
     // propagate (using derivatives) 3D uncertainty of a ([3x1] or [6x1]) salient point into the [2x1] 2D pixels uncertainty.
     // [SfM_EKF_Civera formula 3.33]
 
-    // fun(camera frame, salient point) -> pixel_coord, 13->2
-    // collect 13x13 covariance matrix for
+    // fun(camera frame, salient point) -> pixel_coord, 12->2
+    // collect 12x12 covariance matrix for
     // 3x1 rwc = camera position
-    // 4x1 qwc = camera orientation
+    // 3x1 dtheta = camera orientation error
     // 6x1 yrho = salient point
-    constexpr size_t kInSigmaSize = kEucl3 + kQuat4 + kSalientPointComps;
-    Eigen::Matrix<Scalar, kInSigmaSize, kInSigmaSize> input_covar;
+    constexpr size_t kInSigmaMaxSize = kEucl3 + kOrientErrComps + kSalientPointComps;
+    const size_t sal_pnt_comps = sal_pnt.EstimVarsCountWithAnchor();
+    const size_t in_sigma_size = kEucl3 + kOrientErrComps + sal_pnt_comps;
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, kInSigmaMaxSize, kInSigmaMaxSize> input_covar(in_sigma_size, in_sigma_size);
 
-    // 1. Populate input covariance (of the camera frame (3+4) and the salient point (6))
+    // 1. Populate input covariance (of the camera frame (3+3) and the salient point (6))
 
-    constexpr static size_t kRQ = kEucl3 + kQuat4;
+    constexpr static size_t kRQ = kEucl3 + kOrientErrComps;
 
-    input_covar.topLeftCorner<kRQ, kRQ>() = src_estim_vars_covar.topLeftCorner<kRQ, kRQ>(); // cam pos and quaternion
-    auto sal_pnt_cov_debug = src_estim_vars_covar.block<kSalientPointComps, kSalientPointComps>(sal_pnt.estim_vars_ind, sal_pnt.estim_vars_ind).eval();
-    input_covar.bottomRightCorner<kSalientPointComps, kSalientPointComps>() =
-        src_estim_vars_covar.block<kSalientPointComps, kSalientPointComps>(sal_pnt.estim_vars_ind, sal_pnt.estim_vars_ind); // salient point
+    input_covar.topLeftCorner<kRQ, kRQ>() = src_estim_vars_covar.topLeftCorner<kRQ, kRQ>(); // cam pos and orientation error
+    input_covar.bottomRightCorner(sal_pnt_comps, sal_pnt_comps) = GetSalientPointsCovar(src_estim_vars_covar, sal_pnt, sal_pnt); // salient point
 
-    // 3x6 dr by dy
-    auto dr_by_dy = src_estim_vars_covar.block<kEucl3, kSalientPointComps>(0, sal_pnt.estim_vars_ind);
-    input_covar.block<kEucl3, kSalientPointComps>(0, kRQ) = dr_by_dy;
-    input_covar.block<kSalientPointComps, kEucl3>(kRQ, 0) = dr_by_dy.transpose();
-
-    // 4x6 dq by dy
-    auto dq_by_dy = src_estim_vars_covar.block< kQuat4, kSalientPointComps>(kEucl3, sal_pnt.estim_vars_ind);
-    input_covar.block<kQuat4, kSalientPointComps>(kEucl3, kRQ) = dq_by_dy;
-    input_covar.block<kSalientPointComps, kQuat4>(kRQ, kEucl3) = dq_by_dy.transpose();
+    // 6x6 d(r,q) by dy
+    SalPntCovarCols drq_by_dy;
+    GetSalientPointCovarCols(src_estim_vars_covar, 0, kRQ, sal_pnt, &drq_by_dy);
+    input_covar.topRightCorner(kRQ, sal_pnt_comps) = drq_by_dy;
+    input_covar.bottomLeftCorner(sal_pnt_comps, kRQ) = drq_by_dy.transpose();
 
     // 2. Populate Jacobian
 
@@ -3941,33 +6282,31 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
     Eigen::Matrix<Scalar, kEucl3, kEucl3> cam_orient_wfc;
     RotMatFromQuat(gsl::make_span<const Scalar>(cam_state.orientation_wfc.data(), kQuat4), &cam_orient_wfc);
 
-    MorphableSalientPoint sal_pnt_vars;
-    size_t off = sal_pnt.estim_vars_ind;
-    LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(off, kSalientPointComps), &sal_pnt_vars);
+    MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
     Eigen::Matrix<Scalar, kPixPosComps, kCamStateComps> hd_by_cam_state;
-    Eigen::Matrix<Scalar, kPixPosComps, kSalientPointComps> hd_by_sal_pnt;
+    HdBySalPntMat hd_by_sal_pnt;
     Eigen::Matrix<Scalar, kPixPosComps, 1> hd;
     Deriv_hd_by_cam_state_and_sal_pnt(src_estim_vars, cam_state, cam_orient_wfc, sal_pnt, sal_pnt_vars, &hd_by_cam_state, &hd_by_sal_pnt, &hd);
 
-    // Jacobian [2x13] of fun(camera frame, salient point) -> pixel_coord, 13->2
-    Eigen::Matrix <Scalar, kPixPosComps, kInSigmaSize> J;
+    // Jacobian [2x12] of fun(camera frame, salient point) -> pixel_coord, 12->2
+    Eigen::Matrix <Scalar, kPixPosComps, Eigen::Dynamic, Eigen::ColMajor, kPixPosComps, kInSigmaMaxSize> J(kPixPosComps, in_sigma_size);
     J.middleCols<kEucl3>(0) = hd_by_cam_state.middleCols<kEucl3>(0);
-    J.middleCols<kQuat4>(kEucl3) = hd_by_cam_state.middleCols<kQuat4>(kEucl3);
-    J.middleCols<kSalientPointComps>(kEucl3 + kQuat4) = hd_by_sal_pnt;
+    J.middleCols<kOrientErrComps>(kEucl3) = hd_by_cam_state.middleCols<kOrientErrComps>(kEucl3);
+    J.middleCols(kEucl3 + kOrientErrComps, sal_pnt_comps) = hd_by_sal_pnt;
 
     //
     static bool check_J = false;
     static bool use_finite_deriv_J = false;
     if (check_J)
     {
-        Eigen::Matrix<Scalar, kInSigmaSize, 1> y_mean;
+        Eigen::Matrix<Scalar, Eigen::Dynamic, 1, Eigen::ColMajor, kInSigmaMaxSize, 1> y_mean(in_sigma_size);
         y_mean.topRows<kRQ>() = src_estim_vars.topRows<kRQ>();
-        y_mean.bottomRows<kEucl3>() = src_estim_vars.middleRows<kEucl3>(sal_pnt.estim_vars_ind);
+        y_mean.bottomRows(sal_pnt_comps) = GetSalientPointVars(src_estim_vars, sal_pnt);
 
         static Scalar eps = kFiniteDiffEpsDebug;
-        Eigen::Matrix <Scalar, kPixPosComps, kInSigmaSize> finite_estim_J;
-        for (size_t i = 0; i < kInSigmaSize; ++i)
+        Eigen::Matrix <Scalar, kPixPosComps, Eigen::Dynamic, Eigen::ColMajor, kPixPosComps, kInSigmaMaxSize> finite_estim_J(kPixPosComps, in_sigma_size);
+        for (size_t i = 0; i < in_sigma_size; ++i)
         {
             auto y_mean1 = y_mean.eval();
             y_mean1[i] -= eps;
@@ -3975,7 +6314,7 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
             LoadCameraStateVarsFromArray(Span(y_mean1, kCamStateComps), &cam_state1);
 
             MorphableSalientPoint sal_pnt_vars1;
-            LoadSalientPointDataFromArray(Span(y_mean1).subspan(kRQ, kSalientPointComps), &sal_pnt_vars1);
+            LoadSalientPointDataFromArray(Span(y_mean1).subspan(kRQ, sal_pnt_comps), &sal_pnt_vars1);
 
             Eigen::Matrix<Scalar, kPixPosComps, 1> h1 = ProjectInternalSalientPoint(cam_state1, sal_pnt_vars1, nullptr);
 
@@ -3986,7 +6325,7 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
             LoadCameraStateVarsFromArray(Span(y_mean2, kCamStateComps), &cam_state2);
 
             MorphableSalientPoint sal_pnt_vars2;
-            LoadSalientPointDataFromArray(Span(y_mean2).subspan(kRQ, kSalientPointComps), &sal_pnt_vars2);
+            LoadSalientPointDataFromArray(Span(y_mean2).subspan(kRQ, sal_pnt_comps), &sal_pnt_vars2);
 
             Eigen::Matrix<Scalar, kPixPosComps, 1> h2 = ProjectInternalSalientPoint(cam_state2, sal_pnt_vars2, nullptr);
             finite_estim_J.middleCols<1>(i) = (h2 - h1) / (2 * eps);
@@ -4004,13 +6343,13 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
             hd_by_cam_state.middleCols<kEucl3>(0).transpose();
 
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> s2 =
-            hd_by_cam_state.middleCols<kQuat4>(kEucl3) *
-            src_estim_vars_covar.block< kQuat4, kQuat4>(kEucl3, kEucl3)*
-            hd_by_cam_state.middleCols<kQuat4>(kEucl3).transpose();
+            hd_by_cam_state.middleCols<kOrientErrComps>(kEucl3) *
+            src_estim_vars_covar.block< kOrientErrComps, kOrientErrComps>(kEucl3, kEucl3)*
+            hd_by_cam_state.middleCols<kOrientErrComps>(kEucl3).transpose();
 
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> s3 =
             hd_by_sal_pnt *
-            src_estim_vars_covar.block< kSalientPointComps, kSalientPointComps>(off, off)*
+            GetSalientPointsCovar(src_estim_vars_covar, sal_pnt, sal_pnt) *
             hd_by_sal_pnt.transpose();
 
         Eigen::Matrix<Scalar, kPixPosComps, kPixPosComps> s_sum = s1 + s2 + s3;
@@ -4034,16 +6373,16 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
     //
     static bool use_simul = false;
     static bool simulate_propagation = false;
-    if (simulate_propagation)
+    if (simulate_propagation && sal_pnt_comps == kSalientPointComps)
     {
-        auto propag_fun = [this](const auto& in_mat, auto* out_mat) -> bool
+        auto propag_fun = [this, sal_pnt_comps](const auto& in_mat, auto* out_mat) -> bool
         {
             CameraStateVars cam_state;
             gsl::span<const Scalar> cam_state_span = Span(in_mat, kCamStateComps);
             LoadCameraStateVarsFromArray(cam_state_span, &cam_state);
 
             MorphableSalientPoint sal_pnt_vars;
-            LoadSalientPointDataFromArray(Span(in_mat).subspan(kRQ, kSalientPointComps), &sal_pnt_vars);
+            LoadSalientPointDataFromArray(Span(in_mat).subspan(kRQ, sal_pnt_comps), &sal_pnt_vars);
 
             Eigen::Matrix<Scalar, kPixPosComps, 1> h_distorted = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
 
@@ -4052,11 +6391,11 @@ auto DavisonMonoSlam::GetSalientPointProjected2DPosWithUncertainty(
             return true;
         };
 
-        Eigen::Matrix<Scalar, kInSigmaSize, 1> input_mean;
+        Eigen::Matrix<Scalar, kInSigmaMaxSize, 1> input_mean;
         input_mean.topRows<kRQ>() = src_estim_vars.topRows<kRQ>();
-        input_mean.bottomRows<kEucl3>() = src_estim_vars.middleRows<kEucl3>(sal_pnt.estim_vars_ind);
+        input_mean.bottomRows<kSalientPointComps>() = GetSalientPointVars(src_estim_vars, sal_pnt);
 
-        Eigen::Matrix<Scalar, kInSigmaSize, kInSigmaSize> input_uncert = input_covar.eval();
+        Eigen::Matrix<Scalar, kInSigmaMaxSize, kInSigmaMaxSize> input_uncert = input_covar;
 
         static size_t gen_samples_count = 100;
         static std::mt19937 gen{ 811 };
@@ -4077,16 +6416,15 @@ bool DavisonMonoSlam::GetSalientPoint3DPosWithUncertainty(
     Point3* pos_mean,
     Eigen::Matrix<Scalar, kEucl3, kEucl3>* pos_uncert) const
 {
-    MorphableSalientPoint sal_pnt_vars;
-    LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+    MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
-    if constexpr (kSalPntRepres == SalPntComps::kXyz)
+    if (sal_pnt_vars.repres == SalPntComps::kXyz)
     {
 #if defined(XYZ_SAL_PNT_REPRES)
         *pos_mean = sal_pnt_vars.pos_w;
 #endif
     }
-    else if constexpr (kSalPntRepres == SalPntComps::kSphericalFirstCamInvDist)
+    else if (sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
 #if defined(SPHER_SAL_PNT_REPRES)
         Point3 m = CameraCoordinatesEuclidUnityDirFromPolarAngles(sal_pnt_vars.azimuth_theta_w, sal_pnt_vars.elevation_phi_w);
@@ -4112,7 +6450,7 @@ bool DavisonMonoSlam::GetSalientPoint3DPosWithUncertainty(
 
     static bool simulate_propagation = false;
     static bool use_simulated_results = true;
-    if (simulate_propagation)
+    if (simulate_propagation && sal_pnt_vars.repres == SalPntComps::kSphericalFirstCamInvDist)
     {
         auto propag_fun = [](const auto& in_mat, auto* out_mat) -> bool
         {
@@ -4131,12 +6469,9 @@ bool DavisonMonoSlam::GetSalientPoint3DPosWithUncertainty(
             return true;
         };
 
-        Eigen::Map<const Eigen::Matrix<Scalar, kSalientPointComps, 1>> y_mean_mat(&src_estim_vars[sal_pnt.estim_vars_ind]);
-        Eigen::Matrix<Scalar, kSalientPointComps, 1> y_mean = y_mean_mat;
+        Eigen::Matrix<Scalar, kSphericalSalientPointComps, 1> y_mean = GetSalientPointVars(src_estim_vars, sal_pnt);
 
-        Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps> orig_uncert =
-            src_estim_vars_covar.block<kSalientPointComps, kSalientPointComps>(sal_pnt.estim_vars_ind, sal_pnt.estim_vars_ind);
-        Eigen::Matrix<Scalar, kSalientPointComps, kSalientPointComps> y_uncert = orig_uncert.eval();
+        Eigen::Matrix<Scalar, kSphericalSalientPointComps, kSphericalSalientPointComps> y_uncert = GetSalientPointsCovar(src_estim_vars_covar, sal_pnt, sal_pnt);
 
         static size_t gen_samples_count = 100000;
         static std::mt19937 gen{ 811 };
@@ -4223,16 +6558,13 @@ gsl::span<Scalar> DavisonMonoSlam::EstimVarsCamPosW()
     return gsl::make_span<Scalar>(estim_vars_.data(), kEucl3);
 }
 
-Eigen::Matrix<Scalar, kQuat4, 1> DavisonMonoSlam::EstimVarsCamQuat() const
-{
-    DependsOnCameraPosPackOrder();
-    return estim_vars_.middleRows<kQuat4>(kEucl3);
-}
-
 Eigen::Matrix<Scalar, kAngVelocComps, 1> DavisonMonoSlam::EstimVarsCamAngularVelocity() const
 {
+    if constexpr (!kCamStateHasVelocity)
+        return Eigen::Matrix<Scalar, kAngVelocComps, 1>::Zero();
+
     DependsOnCameraPosPackOrder();
-    return estim_vars_.middleRows< kAngVelocComps>(kEucl3 + kQuat4 + kVelocComps);
+    return estim_vars_.middleRows< kAngVelocComps>(kEucl3 + kOrientErrComps + kVelocComps);
 }
 
 void DavisonMonoSlam::SetCornersMatcher(std::shared_ptr<CornersMatcherBase> corners_matcher)
@@ -4270,8 +6602,7 @@ std::optional<Scalar> DavisonMonoSlam::CurrentFrameReprojError(FilterStageType f
         TrackedSalientPoint& sal_pnt = *p_sal_pnt;
         if (!p_sal_pnt->IsDetected()) continue;  // reproject only observed salient points
 
-        MorphableSalientPoint sal_pnt_vars;
-        LoadSalientPointDataFromArray(Span(src_estim_vars).subspan(sal_pnt.estim_vars_ind, kSalientPointComps), &sal_pnt_vars);
+        MorphableSalientPoint sal_pnt_vars = LoadSalientPointDataFromSrcEstimVars(src_estim_vars, sal_pnt);
 
         Eigen::Matrix<Scalar, kPixPosComps, 1> pix = ProjectInternalSalientPoint(cam_state, sal_pnt_vars, nullptr);
 
@@ -1,7 +1,9 @@
 #include "suriko/image-proc.h"
+#include <algorithm>
+#include <cstdlib>
 
 #if defined(SRK_HAS_OPENCV)
-#include <opencv2/imgproc.hpp> // cv::cvtColor
+#include <opencv2/imgproc.hpp> // cv::cvtColor, cv::pyrDown
 #endif
 
 namespace suriko
@@ -14,4 +16,69 @@ void CopyBgr(const Picture& image, cv::Mat* out_image_bgr)
     cv::cvtColor(image.gray, *out_image_bgr, cv::COLOR_GRAY2BGR);
 #endif
 }
+
+void BuildGrayPyramid(int levels_count, Picture* image)
+{
+    image->gray_pyramid.resize(levels_count);
+    for (int level = 0; level < levels_count; ++level)
+    {
+        const cv::Mat& finer = level == 0 ? image->gray : image->gray_pyramid[level - 1];
+        cv::pyrDown(finer, image->gray_pyramid[level]);
+    }
+}
+
+const cv::Mat& GrayPyramidLevel(const Picture& image, int level)
+{
+    SRK_ASSERT(level >= 0 && level < GrayPyramidLevelsCount(image));
+    return level == 0 ? image.gray : image.gray_pyramid[level - 1];
+}
+
+bool BlockChangeMap::AnyChanged(const Recti& rect) const
+{
+    if (changed.empty())
+        return true;
+    if (rect.x < 0 || rect.y < 0 || rect.Right() > cols * block_size || rect.Bottom() > rows * block_size)
+        return true;
+
+    int col_max = (rect.Right() - 1) / block_size;
+    int row_max = (rect.Bottom() - 1) / block_size;
+    for (int row = rect.y / block_size; row <= row_max; ++row)
+        for (int col = rect.x / block_size; col <= col_max; ++col)
+            if (changed[row * cols + col])
+                return true;
+    return false;
+}
+
+void CalcBlockChangeMap(const cv::Mat& prev_gray, const cv::Mat& gray, int block_size, float max_mean_abs_diff, BlockChangeMap* change_map)
+{
+    SRK_ASSERT(prev_gray.rows == gray.rows && prev_gray.cols == gray.cols);
+
+    // the incomplete blocks at the right and bottom sides are ignored
+    change_map->block_size = block_size;
+    change_map->cols = gray.cols / block_size;
+    change_map->rows = gray.rows / block_size;
+    change_map->changed.resize(change_map->cols * change_map->rows);
+
+    std::vector<int> block_sad(change_map->cols);  // sum of absolute differences in the row of blocks
+    const int max_block_sad = static_cast<int>(max_mean_abs_diff * block_size * block_size);
+    for (int block_row = 0; block_row < change_map->rows; ++block_row)
+    {
+        std::fill(block_sad.begin(), block_sad.end(), 0);
+        for (int row = block_row * block_size; row < (block_row + 1) * block_size; ++row)
+        {
+            // NOTE: Mat.at(x,y) is a hot-spot (called multitude of times, bounds checking)
+            auto prev_row_ptr = prev_gray.ptr<unsigned char>(row);
+            auto row_ptr = gray.ptr<unsigned char>(row);
+            for (int block_col = 0; block_col < change_map->cols; ++block_col)
+            {
+                int sad = 0;
+                for (int col = block_col * block_size; col < (block_col + 1) * block_size; ++col)
+                    sad += std::abs(static_cast<int>(row_ptr[col]) - static_cast<int>(prev_row_ptr[col]));
+                block_sad[block_col] += sad;
+            }
+        }
+        for (int block_col = 0; block_col < change_map->cols; ++block_col)
+            change_map->changed[block_row * change_map->cols + block_col] = static_cast<char>(block_sad[block_col] > max_block_sad);
+    }
+}
 }
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include "suriko/lin-alg.h"
+#include "suriko/approx-alg.h"
 #include "suriko/obs-geom.h"
 
 namespace suriko
@@ -24,4 +28,191 @@ void OrthonormalizeGramSchmidtInplace(Eigen::Matrix<Scalar, 3, 3>* mat)
         SRK_ASSERT(op) << msg;
     }
 }
+
+void CholeskyFactorPsd(const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& mat,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor)
+{
+    auto& L = *lower_factor;
+    const Eigen::Index n = mat.rows();
+    L = mat.triangularView<Eigen::Lower>();
+
+    // pivots below the tolerance are the rounding errors of zero
+    const Scalar max_diag = n > 0 ? mat.diagonal().maxCoeff() : 0;
+    const Scalar pivot_tol = max_diag * n * std::numeric_limits<Scalar>::epsilon();
+
+    for (Eigen::Index k = 0; k < n; ++k)
+    {
+        const Eigen::Index tail_size = n - k - 1;
+        Scalar pivot = L(k, k);
+        if (!(pivot > pivot_tol))
+        {
+            L.col(k).tail(tail_size + 1).setZero();
+            continue;
+        }
+
+        Scalar diag = std::sqrt(pivot);
+        L(k, k) = diag;
+        L.col(k).tail(tail_size) /= diag;
+
+        // subtract the outer product of the column from the lower part of the trailing block
+        for (Eigen::Index j = k + 1; j < n; ++j)
+            L.col(j).tail(n - j) -= L(j, k) * L.col(k).tail(n - j);
+    }
+}
+
+void CholeskyFactorRankOneUpdate(Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> lower_factor,
+    Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> x)
+{
+    auto& L = lower_factor;
+    const Eigen::Index n = L.rows();
+    for (Eigen::Index k = 0; k < n; ++k)
+    {
+        Scalar xk = x[k];
+        if (xk == 0) continue;
+
+        // the Givens rotation of the k-th column of L and x, which zeroes x[k]
+        Scalar diag = std::hypot(L(k, k), xk);
+        Scalar c = L(k, k) / diag;
+        Scalar s = xk / diag;
+        L(k, k) = diag;
+        x[k] = 0;
+
+        for (Eigen::Index i = k + 1; i < n; ++i)
+        {
+            Scalar lik = L(i, k);
+            L(i, k) = c * lik + s * x[i];
+            x[i] = c * x[i] - s * lik;
+        }
+    }
+}
+
+Scalar CholeskyFactorScalarMeasurementUpdate(Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> lower_factor,
+    const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, 1>>& f, Scalar r,
+    Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> gain)
+{
+    // source: "Kalman Filtering: Theory and Practice Using MATLAB", Grewal, Andrews, 2008, Carlson's algorithm in paragraph 6.5.
+    // The algorithm is formulated for the upper-triangular factor, here it is applied to the lower-triangular factor
+    // in reversed order of variables.
+    auto& L = lower_factor;
+    const Eigen::Index n = L.rows();
+
+    // the columns after the last non-zero component of f are unchanged
+    Eigen::Index last_nonzero = n - 1;
+    while (last_nonzero >= 0 && f[last_nonzero] == 0)
+        --last_nonzero;
+
+    gain.setZero();
+    Scalar alpha = r;
+    for (Eigen::Index j = last_nonzero; j >= 0; --j)
+    {
+        Scalar beta = alpha;
+        alpha += suriko::Sqr(f[j]);
+        Scalar gamma = std::sqrt(alpha * beta);
+        Scalar eta = beta / gamma;
+        Scalar zeta = f[j] / gamma;
+        for (Eigen::Index i = j; i < n; ++i)
+        {
+            Scalar lij = L(i, j);
+            L(i, j) = eta * lij - zeta * gain[i];
+            gain[i] += lij * f[j];
+        }
+    }
+    gain /= alpha;
+    return alpha;
+}
+
+void CholeskyFactorExtend(const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& mat,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor)
+{
+    auto& L = *lower_factor;
+    const Eigen::Index n_old = L.rows();
+    const Eigen::Index n = mat.rows();
+    const Eigen::Index k = n - n_old;
+    SRK_ASSERT(k >= 0);
+    if (k == 0) return;
+
+    // the new rows C of the factor satisfy C*Lt=mat_new_old, found by forward substitution;
+    // the variable with zero pivot doesn't contribute
+    const Scalar pivot_tol = n_old > 0 ? L.diagonal().cwiseAbs().maxCoeff() * std::numeric_limits<Scalar>::epsilon() : 0;
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> C = mat.bottomLeftCorner(k, n_old);
+    for (Eigen::Index j = 0; j < n_old; ++j)
+    {
+        if (std::abs(L(j, j)) > pivot_tol)
+            C.col(j) /= L(j, j);
+        else
+            C.col(j).setZero();
+        const Eigen::Index tail_size = n_old - j - 1;
+        C.rightCols(tail_size).noalias() -= C.col(j) * L.col(j).tail(tail_size).transpose();
+    }
+
+    // the new diagonal block D satisfies D*Dt=mat_new_new-C*Ct
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> residual = mat.bottomRightCorner(k, k);
+    residual.noalias() -= C * C.transpose();
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> D;
+    CholeskyFactorPsd(residual, &D);
+
+    L.conservativeResize(n, n);
+    L.topRightCorner(n_old, k).setZero();
+    L.bottomLeftCorner(k, n_old) = C;
+    L.bottomRightCorner(k, k) = D;
+}
+
+void CholeskyFactorKeepVars(const std::vector<size_t>& keep_var_inds,
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>* lower_factor)
+{
+    auto& L = *lower_factor;
+    const Eigen::Index n = L.rows();
+    const Eigen::Index m = static_cast<Eigen::Index>(keep_var_inds.size());
+    if (m == n) return;
+
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> kept(m, m);
+    for (Eigen::Index j = 0; j < m; ++j)
+        for (Eigen::Index i = 0; i < m; ++i)
+            kept(i, j) = L(keep_var_inds[i], keep_var_inds[j]);
+
+    // the column of the removed variable contributes to the rows of the remaining variables, which follow it
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> x(m);
+    Eigen::Index kept_before = 0;  // the number of remaining variables before the current one
+    for (Eigen::Index var_ind = 0; var_ind < n; ++var_ind)
+    {
+        if (kept_before < m && static_cast<Eigen::Index>(keep_var_inds[kept_before]) == var_ind)
+        {
+            ++kept_before;
+            continue;
+        }
+        const Eigen::Index tail_size = m - kept_before;
+        for (Eigen::Index i = 0; i < tail_size; ++i)
+            x[i] = L(keep_var_inds[kept_before + i], var_ind);
+        CholeskyFactorRankOneUpdate(kept.bottomRightCorner(tail_size, tail_size), x.head(tail_size));
+    }
+    L = std::move(kept);
+}
+
+Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> CovarBlockFromCholeskyFactor(
+    const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>& lower_factor,
+    Eigen::Index first_row, Eigen::Index rows, Eigen::Index first_col, Eigen::Index cols)
+{
+    // the columns of L past the diagonal of the last row (column) are zero
+    const Eigen::Index k = std::min(first_row + rows, first_col + cols);
+    return lower_factor.block(first_row, 0, rows, k) * lower_factor.block(first_col, 0, cols, k).transpose();
+}
+
+void SymmetricEigenDecomp2x2Batch(const SymMat2x2Batch& mats, SymEigen2x2Batch* eigs)
+{
+    const size_t count = mats.Size();
+    eigs->eig_val_max.resize(count);
+    eigs->eig_val_min.resize(count);
+    eigs->cos_major.resize(count);
+    eigs->sin_major.resize(count);
+
+    const Scalar* xx = mats.xx.data();
+    const Scalar* xy = mats.xy.data();
+    const Scalar* yy = mats.yy.data();
+    Scalar* eig_val_max = eigs->eig_val_max.data();
+    Scalar* eig_val_min = eigs->eig_val_min.data();
+    Scalar* cos_major = eigs->cos_major.data();
+    Scalar* sin_major = eigs->sin_major.data();
+    for (size_t i = 0; i < count; ++i)
+        SymmetricEigenDecomp2x2(xx[i], xy[i], yy[i], &eig_val_max[i], &eig_val_min[i], &cos_major[i], &sin_major[i]);
+}
 }
@@ -5,6 +5,7 @@
 #include <Eigen/Cholesky>
 #include "suriko/approx-alg.h"
 #include "suriko/obs-geom.h"
+#include "suriko/lin-alg.h"
 
 namespace suriko
 {
@@ -114,6 +115,28 @@ Recti ClampRectWhenFixedCenter(const Recti& r, suriko::Sizei min_size)
     return result;
 }
 
+// Ensures the size of the rectangle is at most of a given value, keeping the center intact.
+Recti ShrinkRectWhenFixedCenter(const Recti& r, suriko::Sizei max_size)
+{
+    Recti result = r;
+    if (result.width > max_size.width)
+    {
+        int shrink_x = result.width - max_size.width;
+        int shrink_left_x = shrink_x / 2;
+        result.x += shrink_left_x;
+        result.width = max_size.width;
+    }
+
+    if (result.height > max_size.height)
+    {
+        int shrink_y = result.height - max_size.height;
+        int shrink_up_y = shrink_y / 2;
+        result.y += shrink_up_y;
+        result.height = max_size.height;
+    }
+    return result;
+}
+
 auto SE3Inv(const SE3Transform& rt) -> SE3Transform {
     SE3Transform result;
     result.R = rt.R.transpose();
@@ -560,6 +583,44 @@ auto RotMatFromAxisAngle(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<S
     return RotMatFromUnityDirAndAngle(unity_dir, ang, rot_mat, check_input);
 }
 
+void RightJacobianSO3(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<Scalar, 3, 3>*> jr)
+{
+    Eigen::Matrix<Scalar, 3, 3> skew;
+    SkewSymmetricMat(axis_angle, &skew);
+
+    // the coefficients are replaced by their Taylor series for small angles, where the closed form loses precision
+    Scalar ang = Norm(axis_angle);
+    Scalar c1;
+    Scalar c2;
+    if (ang < static_cast<Scalar>(1e-4))
+    {
+        c1 = 0.5f;
+        c2 = static_cast<Scalar>(1.0 / 6);
+    }
+    else
+    {
+        c1 = (1 - std::cos(ang)) / suriko::Sqr(ang);
+        c2 = (ang - std::sin(ang)) / (suriko::Sqr(ang) * ang);
+    }
+
+    *jr = Eigen::Matrix<Scalar, 3, 3>::Identity() - c1 * skew + c2 * skew * skew;
+}
+
+void RightJacobianInvSO3(const Point3& axis_angle, gsl::not_null<Eigen::Matrix<Scalar, 3, 3>*> jr_inv)
+{
+    Eigen::Matrix<Scalar, 3, 3> skew;
+    SkewSymmetricMat(axis_angle, &skew);
+
+    Scalar ang = Norm(axis_angle);
+    Scalar c2;
+    if (ang < static_cast<Scalar>(1e-4))
+        c2 = static_cast<Scalar>(1.0 / 12);
+    else
+        c2 = 1 / suriko::Sqr(ang) - (1 + std::cos(ang)) / (2 * ang * std::sin(ang));
+
+    *jr_inv = Eigen::Matrix<Scalar, 3, 3>::Identity() + 0.5f * skew + c2 * skew * skew;
+}
+
 auto LogSO3(const Eigen::Matrix<Scalar, 3, 3>& rot_mat, gsl::not_null<Point3*> unity_dir, gsl::not_null<Scalar*> ang, bool check_input) -> bool
 {
     // skip precondition checking in Release mode on user request (check_input=false)
@@ -780,6 +841,46 @@ Rect GetEllipseBounds2(const RotatedEllipse2D& rotated_ellipse)
     return result;
 }
 
+bool IsPointInsideEllipse(const RotatedEllipse2D& rotated_ellipse, const Eigen::Matrix<Scalar, 2, 1>& pnt)
+{
+    // x^2/a^2+y^2/b^2<=1 in the frame of the ellipse
+    Eigen::Matrix<Scalar, 2, 1> pnt_ellipse = rotated_ellipse.world_from_ellipse.R.transpose() * (pnt - rotated_ellipse.world_from_ellipse.T);
+    Scalar a = rotated_ellipse.semi_axes[0];
+    Scalar b = rotated_ellipse.semi_axes[1];
+    return Sqr(pnt_ellipse[0] / a) + Sqr(pnt_ellipse[1] / b) <= 1;
+}
+
+std::optional<Eigen::Matrix<Scalar, 3, 3>> HomographyFrom4Points(const std::array<suriko::Point2f, 4>& src, const std::array<suriko::Point2f, 4>& dst)
+{
+    // DLT with h33=1, each correspondence gives two equations
+    // u=(h11*x+h12*y+h13)/(h31*x+h32*y+1), v=(h21*x+h22*y+h23)/(h31*x+h32*y+1)
+    Eigen::Matrix<Scalar, 8, 8> A;
+    Eigen::Matrix<Scalar, 8, 1> b;
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        Scalar x = src[i][0];
+        Scalar y = src[i][1];
+        Scalar u = dst[i][0];
+        Scalar v = dst[i][1];
+        int r = static_cast<int>(i * 2);
+        A.row(r) << x, y, 1, 0, 0, 0, -u * x, -u * y;
+        A.row(r + 1) << 0, 0, 0, x, y, 1, -v * x, -v * y;
+        b[r] = u;
+        b[r + 1] = v;
+    }
+
+    Eigen::FullPivLU<Eigen::Matrix<Scalar, 8, 8>> lu(A);
+    if (!lu.isInvertible())
+        return std::nullopt;
+
+    Eigen::Matrix<Scalar, 8, 1> h = lu.solve(b);
+    Eigen::Matrix<Scalar, 3, 3> H;
+    H << h[0], h[1], h[2],
+        h[3], h[4], h[5],
+        h[6], h[7], 1;
+    return H;
+}
+
 std::tuple<bool, RotatedEllipsoid3D> GetRotatedUncertaintyEllipsoidFromCovMat(const Eigen::Matrix<Scalar, 3, 3>& cov, const Point3& mean,
     Scalar covar3D_to_ellipsoid_chi_square)
 {
@@ -789,7 +890,9 @@ std::tuple<bool, RotatedEllipsoid3D> GetRotatedUncertaintyEllipsoidFromCovMat(co
 
     //
     // A=V*D*inv(V)
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 3, 3>> eigen_solver(cov);
+    // the closed-form solver (roots of the characteristic polynomial) is cheaper than the iterative one for 3x3
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 3, 3>> eigen_solver;
+    eigen_solver.computeDirect(cov);
     bool op = eigen_solver.info() == Eigen::Success;
     SRK_ASSERT(op);
 
@@ -862,6 +965,41 @@ std::tuple<bool, RotatedEllipsoid3D> GetRotatedUncertaintyEllipsoidFromCovMat(co
     return std::make_tuple(true, result);
 }
 
+/// Constructs the ellipse from the eigen decomposition of its covariance matrix, see SymmetricEigenDecomp2x2.
+bool Get2DRotatedEllipseFromCovEigen(Scalar eig_val_max, Scalar eig_val_min, Scalar cos_major, Scalar sin_major,
+    Scalar right_side,
+    Eigen::Matrix<Scalar, 2, 1>* semi_axes,
+    Eigen::Matrix<Scalar, 2, 2>* world_from_ellipse)
+{
+    // each semi-axis of an ellipse must be positive
+    std::array<Scalar, 2> dd = { eig_val_max, eig_val_min };
+    for (Scalar& val : dd)
+    {
+        // Fix small errors when semi-axis is a small negative number,
+        // which may occur when dealing with zero-covariance variables.
+        if (val < 0)
+        {
+            if (!IsClose(0, val)) return false;
+            val = 0;
+        }
+    }
+
+    // the columns are the eigenvectors of the major and minor semi-axes, det=+1
+    auto& R = *world_from_ellipse;
+    R << cos_major, -sin_major,
+         sin_major, cos_major;
+
+    // note multiplication (not division) in a=sqrt(rs*lam) as we skip calculating inverse of covariance matrix
+    // and directly calculate inverse of diagonal D matrix in Sig=V*D*inv(V)
+    // order semi-axes from max to min
+    auto& semi = *semi_axes;
+    semi[0] = std::sqrt(right_side * dd[0]);
+    semi[1] = std::sqrt(right_side * dd[1]);
+    SRK_ASSERT(IsFinite(semi[0]));
+    SRK_ASSERT(IsFinite(semi[1]));
+    return true;
+}
+
 // Note, on why the direct conversion is used: covariance_matrix -> rotated_ellipse=(semi_axes,R).
 // We can calculate rotated ellipse from covariance matrix in multiple steps in such a sequence:
 // covariance_matrix -> ellipse -> rotated_ellipse
@@ -876,7 +1014,6 @@ bool Get2DRotatedEllipseFromCovMat(const Eigen::Matrix<Scalar, 2, 2>& cov,
     Eigen::Matrix<Scalar, 2, 2>* world_from_ellipse)
 {
     SRK_ASSERT(covar2D_to_ellipse_confidence >= 0 && covar2D_to_ellipse_confidence < 1);
-    static constexpr size_t kDim = 2;
 
     // check symmetry
     Scalar sym_diff = (cov - cov.transpose()).norm();
@@ -884,66 +1021,11 @@ bool Get2DRotatedEllipseFromCovMat(const Eigen::Matrix<Scalar, 2, 2>& cov,
 
     //
     // A=V*D*inv(V)
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, kDim, kDim>> eigen_solver(cov);
-    bool op = eigen_solver.info() == Eigen::Success;
-    SRK_ASSERT(op);
-
-    Eigen::Matrix<Scalar, kDim, kDim> eig_vecs = eigen_solver.eigenvectors(); // rot_mat_ellipse_from_world
-    Eigen::Matrix<Scalar, kDim, 1> dd = eigen_solver.eigenvalues();
-
-    // each semi-axis of an ellipse must be positive
-    for (int i = 0; i < dd.rows(); ++i)
-    {
-        Scalar val = dd[i];
-        // Fix small errors when semi-axis is a small negative number,
-        // which may occur when dealing with zero-covariance variables.
-        if (val < 0)
-        {
-            if (!IsClose(0, val)) return false;
-            dd[i] = 0;
-        }
-    }
-
-    // Eigen::SelfAdjointEigenSolver sorts eigenvalues in ascending order
-    int major_col_ind = kDim - 1;
-    int minor_col_ind = 0;
-
-    if (dd[minor_col_ind] == dd[major_col_ind])
-    {
-        // all eigenvalues are equal and may be treated as already sorted in decreasing order;
-        // no reordering is required
-        std::swap(major_col_ind, minor_col_ind);
-    }
-
-    // order semi-axes from max to min
-
-    auto& R = *world_from_ellipse;
-    R.middleCols<1>(0) = eig_vecs.middleCols<1>(major_col_ind);
-    R.middleCols<1>(1) = eig_vecs.middleCols<1>(minor_col_ind);
-
-    // eigenvectors is an orthogonal matrix (det=+1 or -1), but it may not be orthonormal (det=+1)
-    Scalar R_det = R.determinant();
-    if (R_det < 0)
-    {
-        // fix eigenvectors to have det=1
-        // changing the sign of the last column will flip the sign of determinant (to be positive)
-        R.rightCols<1>() = -R.rightCols<1>();
-    }
-
-    bool is_spec_ortho = IsSpecialOrthogonal(R);
-    SRK_ASSERT(is_spec_ortho); // further relying on inv(R)=Rt
+    Scalar eig_val_max, eig_val_min, cos_major, sin_major;
+    SymmetricEigenDecomp2x2(cov(0, 0), cov(0, 1), cov(1, 1), &eig_val_max, &eig_val_min, &cos_major, &sin_major);
 
     Scalar right_side = 2 * std::log(1 / (1 - covar2D_to_ellipse_confidence));
-
-    // note multiplication (not division) in a=sqrt(rs*lam) as we skip calculating inverse of covariance matrix
-    // and directly calculate inverse of diagonal D matrix in Sig=V*D*inv(V)
-    // order semi-axes from max to min
-    auto& semi = *semi_axes;
-    semi[0] = std::sqrt(right_side * dd[major_col_ind]);
-    semi[1] = std::sqrt(right_side * dd[minor_col_ind]);
-    SRK_ASSERT(IsFinite(semi[0]));
-    SRK_ASSERT(IsFinite(semi[1]));
-    return true;
+    return Get2DRotatedEllipseFromCovEigen(eig_val_max, eig_val_min, cos_major, sin_major, right_side, semi_axes, world_from_ellipse);
 }
 
 std::tuple<bool,RotatedEllipse2D> Get2DRotatedEllipseFromCovMat(
@@ -961,13 +1043,40 @@ std::tuple<bool,RotatedEllipse2D> Get2DRotatedEllipseFromCovMat(
     return std::make_tuple(true, result);
 }
 
+void Get2DRotatedEllipsesFromCovMats(const SymMat2x2Batch& covars,
+    const std::vector<Eigen::Matrix<Scalar, 2, 1>>& means,
+    Scalar covar2D_to_ellipse_confidence,
+    std::vector<std::optional<RotatedEllipse2D>>* ellipses)
+{
+    SRK_ASSERT(covar2D_to_ellipse_confidence >= 0 && covar2D_to_ellipse_confidence < 1);
+    SRK_ASSERT(covars.Size() == means.size());
+
+    SymEigen2x2Batch eigs;
+    SymmetricEigenDecomp2x2Batch(covars, &eigs);
+
+    Scalar right_side = 2 * std::log(1 / (1 - covar2D_to_ellipse_confidence));
+
+    ellipses->resize(covars.Size());
+    for (size_t i = 0; i < covars.Size(); ++i)
+    {
+        Eigen::Matrix<Scalar, 2, 1> semi_axes;
+        Eigen::Matrix<Scalar, 2, 2> world_from_ellipse;
+        if (Get2DRotatedEllipseFromCovEigen(eigs.eig_val_max[i], eigs.eig_val_min[i], eigs.cos_major[i], eigs.sin_major[i],
+            right_side, &semi_axes, &world_from_ellipse))
+            (*ellipses)[i] = RotatedEllipse2D{ semi_axes, SE2Transform{ world_from_ellipse, means[i] } };
+        else
+            (*ellipses)[i] = std::nullopt;
+    }
+}
+
 
 bool GetRotatedEllipsoid(const Ellipsoid3DWithCenter& ellipsoid, bool can_throw, RotatedEllipsoid3D* result)
 {
     // check symmetry
     // A=V*D*inv(V)
     // Eigen::SelfAdjointEigenSolver sorts eigenvalues in ascending order
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 3, 3>> eigen_solver(ellipsoid.A);
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 3, 3>> eigen_solver;
+    eigen_solver.computeDirect(ellipsoid.A);
     bool op = eigen_solver.info() == Eigen::Success;
     if (!op)
     {
@@ -1019,7 +1128,8 @@ RotatedEllipse2D GetRotatedEllipse2D(const Ellipse2DWithCenter& ellipse)
     // check symmetry
     // A=V*D*inv(V)
     // Eigen::SelfAdjointEigenSolver sorts eigenvalues in ascending order
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 2, 2>> eigen_solver(ellipse.A);
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 2, 2>> eigen_solver;
+    eigen_solver.computeDirect(ellipse.A);
     bool op = eigen_solver.info() == Eigen::Success;
     SRK_ASSERT(op);
 
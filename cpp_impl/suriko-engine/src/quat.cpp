@@ -148,11 +148,18 @@ auto AxisPlusAngleFromQuat(gsl::span<const Scalar> q, gsl::span<Scalar> dir, Sca
 
 auto AxisAngleFromQuat(gsl::span<const Scalar> q, gsl::span<Scalar> axis_angle) -> void
 {
-    Scalar ang;
-    AxisPlusAngleFromQuat(q, axis_angle, &ang);
-    axis_angle[0] *= ang;
-    axis_angle[1] *= ang;
-    axis_angle[2] *= ang;
+    // unlike acos(q0), atan2 keeps the precision of small angles
+    Scalar sin_ang2 = std::sqrt(Sqr(q[1]) + Sqr(q[2]) + Sqr(q[3]));
+
+    Scalar ang_by_sin_ang2;
+    if (IsClose(0, sin_ang2))
+        ang_by_sin_ang2 = 2 / q[0];  // the limit for ang->0
+    else
+        ang_by_sin_ang2 = 2 * std::atan2(sin_ang2, q[0]) / sin_ang2;
+
+    axis_angle[0] = q[1] * ang_by_sin_ang2;
+    axis_angle[1] = q[2] * ang_by_sin_ang2;
+    axis_angle[2] = q[3] * ang_by_sin_ang2;
 }
 
 auto AxisAngleFromQuat(const Eigen::Matrix<Scalar, 4, 1>& q, Eigen::Matrix<Scalar, 3, 1>* axis_angle) -> void
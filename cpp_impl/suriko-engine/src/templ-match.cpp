@@ -1,4 +1,9 @@
 #include "suriko/templ-match.h"
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 #include "suriko/approx-alg.h"
 #include <opencv2/imgproc.hpp>
 
@@ -109,4 +114,127 @@ std::optional<Scalar> CalcCorrCoeff(const Picture& pic,
     return corr_coeff;
 }
 
+/// Gets the intensity at fractional position by bilinear interpolation, replicating the border of the image.
+Scalar GetGrayImageBilinear(const cv::Mat& gray_image, Scalar x, Scalar y)
+{
+    x = std::clamp(x, Scalar{ 0 }, static_cast<Scalar>(gray_image.cols - 1));
+    y = std::clamp(y, Scalar{ 0 }, static_cast<Scalar>(gray_image.rows - 1));
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, gray_image.cols - 1);
+    int y1 = std::min(y0 + 1, gray_image.rows - 1);
+    Scalar ax = x - x0;
+    Scalar ay = y - y0;
+
+    auto row0_ptr = gray_image.ptr<unsigned char>(y0);
+    auto row1_ptr = gray_image.ptr<unsigned char>(y1);
+    Scalar v0 = (1 - ax) * row0_ptr[x0] + ax * row0_ptr[x1];
+    Scalar v1 = (1 - ax) * row1_ptr[x0] + ax * row1_ptr[x1];
+    return (1 - ay) * v0 + ay * v1;
+}
+
+std::optional<suriko::Point2f> TrackPointPyramidalLK(const Picture& ref_pic,
+    suriko::Point2f ref_center,
+    const Picture& pic,
+    suriko::Point2f guess_center,
+    const LucasKanadeParams& params)
+{
+    const int radx = params.window.width / 2;
+    const int rady = params.window.height / 2;
+    const int pixels_count = (2 * radx + 1) * (2 * rady + 1);
+
+    // patch of the reference image and its gradient, the same buffers are reused on each level
+    std::vector<Scalar> ref_values(pixels_count);
+    std::vector<Scalar> ref_grad_x(pixels_count);
+    std::vector<Scalar> ref_grad_y(pixels_count);
+
+    const int top_level = std::min(GrayPyramidLevelsCount(ref_pic), GrayPyramidLevelsCount(pic)) - 1;
+
+    // displacement of the point from the reference into the target image, in pixels of the current level
+    Eigen::Matrix<Scalar, 2, 1> guess = (guess_center.Mat() - ref_center.Mat()) / static_cast<Scalar>(1 << top_level);
+
+    for (int level = top_level; level >= 0; --level)
+    {
+        const cv::Mat& ref_gray = GrayPyramidLevel(ref_pic, level);
+        const cv::Mat& gray = GrayPyramidLevel(pic, level);
+        const Scalar level_scale = 1 / static_cast<Scalar>(1 << level);
+        const Scalar ref_x = ref_center.X() * level_scale;
+        const Scalar ref_y = ref_center.Y() * level_scale;
+
+        // the matrix of spatial gradients G=sum([Ix*Ix Ix*Iy; Ix*Iy Iy*Iy]) is constant during iterations
+        Scalar gxx = 0, gxy = 0, gyy = 0;
+        int pix_ind = 0;
+        for (int dy = -rady; dy <= rady; ++dy)
+            for (int dx = -radx; dx <= radx; ++dx, ++pix_ind)
+            {
+                Scalar x = ref_x + dx;
+                Scalar y = ref_y + dy;
+                Scalar ix = (GetGrayImageBilinear(ref_gray, x + 1, y) - GetGrayImageBilinear(ref_gray, x - 1, y)) / 2;
+                Scalar iy = (GetGrayImageBilinear(ref_gray, x, y + 1) - GetGrayImageBilinear(ref_gray, x, y - 1)) / 2;
+                ref_values[pix_ind] = GetGrayImageBilinear(ref_gray, x, y);
+                ref_grad_x[pix_ind] = ix;
+                ref_grad_y[pix_ind] = iy;
+                gxx += ix * ix;
+                gxy += ix * iy;
+                gyy += iy * iy;
+            }
+
+        Scalar det = gxx * gyy - gxy * gxy;
+        Scalar min_eigen_value = ((gxx + gyy) - std::sqrt(suriko::Sqr(gxx - gyy) + 4 * gxy * gxy)) / 2;
+        if (min_eigen_value / pixels_count < params.min_eigen_value || det == 0)
+            return std::nullopt;  // textureless patch, the shift can't be determined
+
+        Eigen::Matrix<Scalar, 2, 1> shift = Eigen::Matrix<Scalar, 2, 1>::Zero();
+        for (int iter = 0; iter < params.max_iters; ++iter)
+        {
+            // the mismatch image b=sum((I(x)-J(x+d))*[Ix Iy])
+            Scalar bx = 0, by = 0;
+            const Scalar x_off = ref_x + guess[0] + shift[0];
+            const Scalar y_off = ref_y + guess[1] + shift[1];
+            pix_ind = 0;
+            for (int dy = -rady; dy <= rady; ++dy)
+                for (int dx = -radx; dx <= radx; ++dx, ++pix_ind)
+                {
+                    Scalar diff = ref_values[pix_ind] - GetGrayImageBilinear(gray, x_off + dx, y_off + dy);
+                    bx += diff * ref_grad_x[pix_ind];
+                    by += diff * ref_grad_y[pix_ind];
+                }
+
+            // step=inv(G)*b
+            Eigen::Matrix<Scalar, 2, 1> step{ (gyy * bx - gxy * by) / det, (gxx * by - gxy * bx) / det };
+            shift += step;
+            if (step.norm() < params.min_step_pix)
+                break;
+        }
+
+        guess += shift;
+        if (level > 0)
+            guess *= 2;
+    }
+
+    suriko::Point2f result{ ref_center.Mat() + guess };
+
+    bool inside_image = result.X() >= 0 && result.X() <= pic.gray.cols - 1 && result.Y() >= 0 && result.Y() <= pic.gray.rows - 1;
+    if (!inside_image || !result.Mat().allFinite())
+        return std::nullopt;  // lost
+    return result;
+}
+
+int HammingDistance(const unsigned char* a, const unsigned char* b, int descr_bytes)
+{
+    // bits are counted in words of 64 bits, which compiles into popcount instruction, when it is available
+    int dist = 0;
+    int i = 0;
+    for (; i + 8 <= descr_bytes; i += 8)
+    {
+        std::uint64_t word_a;
+        std::uint64_t word_b;
+        std::memcpy(&word_a, a + i, 8);
+        std::memcpy(&word_b, b + i, 8);
+        dist += static_cast<int>(std::bitset<64>(word_a ^ word_b).count());
+    }
+    for (; i < descr_bytes; ++i)
+        dist += static_cast<int>(std::bitset<8>(a[i] ^ b[i]).count());
+    return dist;
+}
 }
@@ -1,5 +1,6 @@
 #include <glog/logging.h>
 #include "suriko/approx-alg.h"
+#include "suriko/quat.h"
 #include "suriko/virt-world/scene-generator.h"
 
 namespace suriko { namespace virt_world {
@@ -180,4 +181,56 @@ void GenerateCameraShots3DPath(const WorldBounds& wb,
     }
 }
 
+void GenerateImuSamples(const std::vector<SE3Transform>& inverse_orient_cams, Scalar seconds_per_frame,
+    const suriko::Point3& gravity_w,
+    Scalar gyro_noise_std, Scalar accel_noise_std, std::mt19937* gen,
+    std::vector<ImuSample>* imu_samples)
+{
+    CHECK(seconds_per_frame > 0);
+    CHECK(gen != nullptr || (gyro_noise_std == 0 && accel_noise_std == 0));
+    imu_samples->clear();
+
+    size_t frames_count = inverse_orient_cams.size();
+    if (frames_count < 2)
+        return;
+
+    auto cam_pos_w = [&inverse_orient_cams](size_t frame_ind) -> Point3
+    {
+        return SE3Inv(inverse_orient_cams[frame_ind]).T;
+    };
+
+    std::normal_distribution<Scalar> unit_noise{ 0, 1 };
+    auto noise_vec = [&unit_noise, gen](Scalar std) -> Point3
+    {
+        if (std == 0) return Point3{ 0, 0, 0 };
+        return Point3{ std * unit_noise(*gen), std * unit_noise(*gen), std * unit_noise(*gen) };
+    };
+
+    for (size_t i = 0; i + 1 < frames_count; ++i)
+    {
+        const SE3Transform& cfw = inverse_orient_cams[i];
+        const SE3Transform& next_cfw = inverse_orient_cams[i + 1];
+
+        // Rwc*exp(w*dT)=Rwc_next, the quaternion is used because the rotation between frames is small
+        Eigen::Matrix<Scalar, 3, 3> delta_rot = cfw.R * next_cfw.R.transpose();
+        Eigen::Matrix<Scalar, 4, 1> delta_quat;
+        QuatFromRotationMatNoRChecks(delta_rot, gsl::make_span(delta_quat.data(), 4));
+        Eigen::Matrix<Scalar, 3, 1> delta_axis_angle;
+        AxisAngleFromQuat(delta_quat, &delta_axis_angle);
+
+        // the acceleration is constant in the interval; the last interval repeats the previous one
+        Point3 accel_w{ 0, 0, 0 };
+        if (frames_count >= 3)
+        {
+            size_t j = std::min(i, frames_count - 3);
+            accel_w = (cam_pos_w(j + 2) - 2 * cam_pos_w(j + 1) + cam_pos_w(j)) / Sqr(seconds_per_frame);
+        }
+
+        ImuSample imu_sample;
+        imu_sample.angular_velocity_c = Point3{ delta_axis_angle / seconds_per_frame } + noise_vec(gyro_noise_std);
+        imu_sample.specific_force_c = Point3{ cfw.R * (accel_w - gravity_w) } + noise_vec(accel_noise_std);
+        imu_samples->push_back(imu_sample);
+    }
+}
+
 }}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <vector>
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include "suriko/camera-model.h"
+#include "suriko/rt-config.h"
+
+namespace suriko_test
+{
+using namespace suriko;
+
+class CameraModelTest : public testing::Test
+{
+public:
+    Scalar atol_pix = (Scalar)1e-4;
+    Scalar lut_atol_pix = (Scalar)1e-2;
+    CameraIntrinsicParams cam_intrinsics;
+
+    CameraModelTest()
+    {
+        cam_intrinsics.image_size = { 320, 240 };
+        cam_intrinsics.principal_point_pix = { 162, 125 };
+        cam_intrinsics.focal_length_mm = (Scalar)2.1735;
+        cam_intrinsics.pixel_size_mm = { (Scalar)0.0112, (Scalar)0.0112 };
+    }
+
+    static std::vector<Point2f> SamplePixels()
+    {
+        return { Point2f{162, 125}, Point2f{5, 7}, Point2f{310.5, 3.25}, Point2f{100.3, 200.7}, Point2f{318, 238} };
+    }
+
+    template <typename CameraModel>
+    void CheckUndistortDistortRoundtrip(const CameraModel& cam_model, Scalar tol)
+    {
+        for (const Point2f& hd : SamplePixels())
+        {
+            Point2f hu = cam_model.UndistortPixel(cam_intrinsics, hd);
+            Point2f hd_back = cam_model.DistortPixel(cam_intrinsics, hu);
+            EXPECT_TRUE(hd_back.Mat().isApprox(hd.Mat(), tol)) << "hd=" << hd.Mat().transpose() << " hd_back=" << hd_back.Mat().transpose();
+        }
+    }
+
+    template <typename CameraModel>
+    void CheckJacobianByFiniteDifferences(const CameraModel& cam_model)
+    {
+        const Scalar eps = (Scalar)1e-4;
+        for (const Point2f& hd : SamplePixels())
+        {
+            Eigen::Matrix<Scalar, 2, 2> hu_by_hd;
+            cam_model.Deriv_hu_by_hd(cam_intrinsics, hd, &hu_by_hd);
+
+            Eigen::Matrix<Scalar, 2, 2> hu_by_hd_num;
+            for (int j = 0; j < 2; ++j)
+            {
+                Point2f hd_plus = hd;
+                Point2f hd_minus = hd;
+                hd_plus[j] += eps;
+                hd_minus[j] -= eps;
+                hu_by_hd_num.col(j) = (cam_model.UndistortPixel(cam_intrinsics, hd_plus).Mat() -
+                    cam_model.UndistortPixel(cam_intrinsics, hd_minus).Mat()) / (2 * eps);
+            }
+            EXPECT_TRUE(hu_by_hd.isApprox(hu_by_hd_num, (Scalar)1e-4)) << "hd=" << hd.Mat().transpose();
+        }
+    }
+
+    template <typename CameraModel>
+    void CheckLutMatchesExact(CameraModel cam_model)
+    {
+        CameraModel cam_model_lut = cam_model;
+        cam_model_lut.BuildLut(cam_intrinsics);
+        EXPECT_TRUE(cam_model_lut.HasLut());
+
+        for (const Point2f& hd : SamplePixels())
+        {
+            Point2f hu = cam_model.UndistortPixel(cam_intrinsics, hd);
+            Point2f hu_lut = cam_model_lut.UndistortPixel(cam_intrinsics, hd);
+            EXPECT_NEAR(hu[0], hu_lut[0], lut_atol_pix);
+            EXPECT_NEAR(hu[1], hu_lut[1], lut_atol_pix);
+
+            Point2f hd_lut = cam_model_lut.DistortPixel(cam_intrinsics, hu);
+            EXPECT_NEAR(hd[0], hd_lut[0], lut_atol_pix);
+            EXPECT_NEAR(hd[1], hd_lut[1], lut_atol_pix);
+
+            Eigen::Matrix<Scalar, 2, 2> hu_by_hd;
+            Eigen::Matrix<Scalar, 2, 2> hu_by_hd_lut;
+            cam_model.Deriv_hu_by_hd(cam_intrinsics, hd, &hu_by_hd);
+            cam_model_lut.Deriv_hu_by_hd(cam_intrinsics, hd, &hu_by_hd_lut);
+            EXPECT_TRUE(hu_by_hd.isApprox(hu_by_hd_lut, (Scalar)1e-3));
+        }
+
+        // outside of the image the exact model is used
+        Point2f hu_far{ -150, 400 };
+        Point2f hd_far = cam_model.DistortPixel(cam_intrinsics, hu_far);
+        EXPECT_TRUE(cam_model_lut.DistortPixel(cam_intrinsics, hu_far).Mat().isApprox(hd_far.Mat(), atol_pix));
+    }
+};
+
+TEST_F(CameraModelTest, PinholeIsIdentity)
+{
+    PinholeCameraModel cam_model;
+    Point2f hd{ 10.5, 20.25 };
+    EXPECT_EQ(hd.Mat(), cam_model.UndistortPixel(cam_intrinsics, hd).Mat());
+    EXPECT_EQ(hd.Mat(), cam_model.DistortPixel(cam_intrinsics, hd).Mat());
+
+    Eigen::Matrix<Scalar, 2, 2> hu_by_hd;
+    cam_model.Deriv_hu_by_hd(cam_intrinsics, hd, &hu_by_hd);
+    EXPECT_TRUE(hu_by_hd.isIdentity());
+}
+
+TEST_F(CameraModelTest, MikhailRadialRoundtrip)
+{
+    MikhailRadialCameraModel cam_model{ MikhailRadialDistortionParams{ (Scalar)0.06333, (Scalar)0.0139 } };
+    CheckUndistortDistortRoundtrip(cam_model, atol_pix);
+}
+
+TEST_F(CameraModelTest, MikhailRadialWithoutDistortionIsIdentity)
+{
+    MikhailRadialCameraModel cam_model{};
+    Point2f hd{ 10.5, 20.25 };
+    EXPECT_TRUE(cam_model.UndistortPixel(cam_intrinsics, hd).Mat().isApprox(hd.Mat()));
+    EXPECT_TRUE(cam_model.DistortPixel(cam_intrinsics, hd).Mat().isApprox(hd.Mat()));
+}
+
+TEST_F(CameraModelTest, MikhailRadialJacobian)
+{
+    MikhailRadialCameraModel cam_model{ MikhailRadialDistortionParams{ (Scalar)0.06333, (Scalar)0.0139 } };
+    CheckJacobianByFiniteDifferences(cam_model);
+}
+
+TEST_F(CameraModelTest, MikhailRadialLut)
+{
+    MikhailRadialCameraModel cam_model{ MikhailRadialDistortionParams{ (Scalar)0.06333, (Scalar)0.0139 } };
+    CheckLutMatchesExact(cam_model);
+}
+
+TEST_F(CameraModelTest, EquidistantFisheyeRoundtrip)
+{
+    EquidistantFisheyeCameraModel cam_model;
+    CheckUndistortDistortRoundtrip(cam_model, atol_pix);
+}
+
+TEST_F(CameraModelTest, EquidistantFisheyeJacobian)
+{
+    EquidistantFisheyeCameraModel cam_model;
+    CheckJacobianByFiniteDifferences(cam_model);
+}
+
+TEST_F(CameraModelTest, EquidistantFisheyeLut)
+{
+    EquidistantFisheyeCameraModel cam_model;
+    CheckLutMatchesExact(cam_model);
+}
+}
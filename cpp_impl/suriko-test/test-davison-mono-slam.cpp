@@ -0,0 +1,295 @@
+#include <vector>
+#include <map>
+#include <set>
+#include <array>
+#include <random>
+#include <memory>
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include "suriko/rt-config.h"
+#include "suriko/obs-geom.h"
+#include "suriko/davison-mono-slam.h"
+
+namespace suriko_test
+{
+using namespace suriko;
+
+/// Matches the salient points to the projections of the points of the synthetic scene without errors.
+class PerfectCornersMatcher : public CornersMatcherBase
+{
+    struct Blob
+    {
+        suriko::Point2f coord;
+        size_t pnt_ind;
+    };
+
+    const DavisonMonoSlam* mono_slam_;
+    const std::vector<SE3Transform>& cams_from_tracker_;
+    const std::vector<Point3>& pnts_tracker_;
+    suriko::Sizei image_size_;
+    std::vector<Blob> blobs_;
+    std::map<size_t, SalPntId> pnt_ind_to_sal_pnt_;
+public:
+    size_t new_blobs_first_frame = 10;
+    size_t new_blobs_per_frame = 1;
+    size_t no_ellipse_count = 0;
+
+    PerfectCornersMatcher(const DavisonMonoSlam* mono_slam, const std::vector<SE3Transform>& cams_from_tracker,
+        const std::vector<Point3>& pnts_tracker, suriko::Sizei image_size)
+        : mono_slam_(mono_slam), cams_from_tracker_(cams_from_tracker), pnts_tracker_(pnts_tracker), image_size_(image_size)
+    {
+    }
+
+    void AnalyzeFrame(size_t frame_ind, const Picture& image) override
+    {
+        blobs_.clear();
+        for (size_t i = 0; i < pnts_tracker_.size(); ++i)
+        {
+            Point3 pnt_cam = SE3Apply(cams_from_tracker_[frame_ind], pnts_tracker_[i]);
+            if (pnt_cam[2] <= 0) continue;
+
+            suriko::Point2f pix = mono_slam_->ProjectCameraPoint(pnt_cam);
+            if (pix.X() < 0 || pix.X() >= image_size_.width || pix.Y() < 0 || pix.Y() >= image_size_.height) continue;
+            blobs_.push_back(Blob{ pix, i });
+        }
+    }
+
+    void MatchSalientPoints(const DavisonMonoSlam& mono_slam,
+        const std::set<SalPntId>& tracking_sal_pnts,
+        size_t frame_ind,
+        const Picture& image,
+        std::vector<std::pair<SalPntId, CornersMatcherBlobId>>* matched_sal_pnts) override
+    {
+        // the search ellipses are requested as a real matcher does, for salient points in the state and for candidates
+        for (SalPntId sal_pnt_id : tracking_sal_pnts)
+        {
+            auto [op, ellipse] = mono_slam.GetPredictedSalientPointProjectedUncertEllipse(sal_pnt_id);
+            if (!op) ++no_ellipse_count;
+        }
+
+        for (size_t blob_ind = 0; blob_ind < blobs_.size(); ++blob_ind)
+        {
+            auto it = pnt_ind_to_sal_pnt_.find(blobs_[blob_ind].pnt_ind);
+            if (it != pnt_ind_to_sal_pnt_.end() && tracking_sal_pnts.count(it->second) > 0)
+                matched_sal_pnts->push_back(std::make_pair(it->second, CornersMatcherBlobId{ blob_ind }));
+        }
+    }
+
+    void RecruitNewSalientPoints(const DavisonMonoSlam& mono_slam,
+        const std::set<SalPntId>& tracking_sal_pnts,
+        const std::vector<std::pair<SalPntId, CornersMatcherBlobId>>& matched_sal_pnts,
+        size_t frame_ind,
+        const Picture& image,
+        std::vector<CornersMatcherBlobId>* new_blob_ids) override
+    {
+        size_t new_blobs_count = frame_ind == 0 ? new_blobs_first_frame : new_blobs_per_frame;
+        for (size_t blob_ind = 0; blob_ind < blobs_.size() && new_blob_ids->size() < new_blobs_count; ++blob_ind)
+        {
+            if (pnt_ind_to_sal_pnt_.count(blobs_[blob_ind].pnt_ind) > 0) continue;
+            new_blob_ids->push_back(CornersMatcherBlobId{ blob_ind });
+        }
+    }
+
+    void OnSalientPointIsAssignedToBlobId(SalPntId sal_pnt_id, CornersMatcherBlobId blob_id, const Picture& image) override
+    {
+        pnt_ind_to_sal_pnt_[blobs_[blob_id.Ind].pnt_ind] = sal_pnt_id;
+    }
+
+    suriko::Point2f GetBlobCoord(CornersMatcherBlobId blob_id) override
+    {
+        return blobs_[blob_id.Ind].coord;
+    }
+};
+
+class DavisonMonoSlamTest : public testing::Test
+{
+public:
+    std::vector<Point3> pnts_tracker_;
+    std::vector<SE3Transform> cams_from_tracker_;
+    CameraIntrinsicParams cam_intrinsics_;
+
+    void SetUp() override
+    {
+        // a grid of points in the plane z=0, the camera looks at it from above while moving around the rectangle
+        Scalar x_min = -1.5, x_max = 1.5, y_min = -1.5, y_max = -0.4;
+        std::mt19937 gen{ 1234 };
+        std::normal_distribution<Scalar> jitter{ 0, 0.02 };
+        std::vector<Point3> pnts_world;
+        for (Scalar y = y_min; y < y_max + 1e-6; y += 0.25)
+            for (Scalar x = x_min; x < x_max + 1e-6; x += 0.25)
+                pnts_world.push_back(Point3{ x + jitter(gen), y + jitter(gen), jitter(gen) });
+
+        std::array<Point3, 5> corners = {
+            Point3{ x_min, y_min, 0 }, Point3{ x_max, y_min, 0 }, Point3{ x_max, y_max, 0 }, Point3{ x_min, y_max, 0 }, Point3{ x_min, y_min, 0 } };
+        const size_t steps_per_side = 10;
+        std::vector<SE3Transform> cams_from_world;
+        for (size_t side = 0; side + 1 < corners.size(); ++side)
+            for (size_t step = 0; step < steps_per_side; ++step)
+            {
+                Point3 look_at = corners[side] + (corners[side + 1] - corners[side]) * (static_cast<Scalar>(step) / steps_per_side);
+                cams_from_world.push_back(SE3Inv(LookAtLufWfc(look_at + Point3{ 3, -2, 7 }, look_at, Point3{ 0, 0, 1 })));
+            }
+
+        // the tracker's frame is the first camera
+        const SE3Transform tracker_from_world = cams_from_world[0];
+        for (const Point3& pnt_world : pnts_world)
+            pnts_tracker_.push_back(SE3Apply(tracker_from_world, pnt_world));
+        for (size_t lap = 0; lap < 2; ++lap)
+            for (const SE3Transform& cam_from_world : cams_from_world)
+                cams_from_tracker_.push_back(SE3AFromB(cam_from_world, tracker_from_world));
+
+        cam_intrinsics_.image_size = { 320, 240 };
+        cam_intrinsics_.principal_point_pix = { 160, 120 };
+        cam_intrinsics_.focal_length_mm = 1.95;
+        cam_intrinsics_.pixel_size_mm = { 0.01, 0.01 };
+    }
+
+    void InitTracker(DavisonMonoSlam* mono_slam) const
+    {
+        mono_slam->cam_intrinsics_ = cam_intrinsics_;
+        mono_slam->SetProcessNoiseStd(0.15, 0.01);
+        mono_slam->measurm_noise_std_pix_ = 1;
+        mono_slam->sal_pnt_init_inv_dist_ = 0.1;
+        mono_slam->sal_pnt_init_inv_dist_std_ = 1;
+        mono_slam->SetCameraStateCovarHelper();
+    }
+
+    /// Processes the frames and returns the RMS of the camera positions, after the estimated trajectory is scaled to the
+    /// ground truth (the scale of the monocular map is arbitrary).
+    Scalar TrackAndGetAlignedPositionRms(DavisonMonoSlam* mono_slam, PerfectCornersMatcher* matcher, size_t frames_count) const
+    {
+        std::vector<Point3> est_positions;
+        std::vector<Point3> gt_positions;
+        Picture image;
+        for (size_t frame_ind = 0; frame_ind < frames_count; ++frame_ind)
+        {
+            mono_slam->ProcessFrame(frame_ind, image);
+            est_positions.push_back(mono_slam->GetCameraEstimatedVars().pos_w);
+            gt_positions.push_back(SE3Inv(cams_from_tracker_[frame_ind]).T);
+        }
+
+        Scalar num = 0;
+        Scalar den = 0;
+        for (size_t i = 0; i < est_positions.size(); ++i)
+        {
+            num += est_positions[i].dot(gt_positions[i]);
+            den += est_positions[i].dot(est_positions[i]);
+        }
+        Scalar scale = den > 0 ? num / den : 0;
+
+        Scalar err_sqr_sum = 0;
+        for (size_t i = 0; i < est_positions.size(); ++i)
+            err_sqr_sum += (scale * est_positions[i] - gt_positions[i]).squaredNorm();
+        return std::sqrt(err_sqr_sum / est_positions.size());
+    }
+};
+
+TEST_F(DavisonMonoSlamTest, CandidatePoolWithOnePointRansac)
+{
+    for (size_t candidate_min_frames : { 2, 3, 5, 8 })
+    {
+        SCOPED_TRACE(testing::Message() << "candidate_min_frames=" << candidate_min_frames);
+
+        DavisonMonoSlam mono_slam;
+        InitTracker(&mono_slam);
+        mono_slam.mono_slam_update_impl_ = 4;
+        mono_slam.sal_pnt_candidate_min_frames_ = candidate_min_frames;
+
+        auto matcher = std::make_shared<PerfectCornersMatcher>(&mono_slam, cams_from_tracker_, pnts_tracker_, cam_intrinsics_.image_size);
+        mono_slam.SetCornersMatcher(matcher);
+
+        Scalar pos_rms = TrackAndGetAlignedPositionRms(&mono_slam, matcher.get(), cams_from_tracker_.size());
+
+        // the candidates are promoted into the state
+        EXPECT_GT(mono_slam.SalientPointsCount(), matcher->new_blobs_first_frame);
+        EXPECT_EQ(0, matcher->no_ellipse_count);
+
+        // the camera moves by 3 units around the rectangle; the stacked update without candidates yields 0.35
+        EXPECT_LT(pos_rms, 0.7);
+    }
+}
+
+TEST_F(DavisonMonoSlamTest, PublishedStateIsKeptByReader)
+{
+    DavisonMonoSlam mono_slam;
+    InitTracker(&mono_slam);
+    mono_slam.publish_state_ = true;
+
+    auto matcher = std::make_shared<PerfectCornersMatcher>(&mono_slam, cams_from_tracker_, pnts_tracker_, cam_intrinsics_.image_size);
+    mono_slam.SetCornersMatcher(matcher);
+    EXPECT_EQ(nullptr, mono_slam.GetPublishedState());
+
+    Picture image;
+    mono_slam.ProcessFrame(0, image);
+    std::shared_ptr<const DavisonMonoSlamPublishedState> held_state = mono_slam.GetPublishedState();
+    ASSERT_NE(nullptr, held_state);
+    EXPECT_EQ(0, held_state->frame_ind);
+    EXPECT_EQ(mono_slam.SalientPointsCount(), held_state->sal_pnts.size());
+    for (const PublishedSalientPoint& sal_pnt : held_state->sal_pnts)
+    {
+        EXPECT_TRUE(sal_pnt.estim_ellipse_pix.has_value());
+        EXPECT_TRUE(sal_pnt.predicted_ellipse_pix.has_value());
+    }
+    const size_t held_sal_pnts_count = held_state->sal_pnts.size();
+
+    // the snapshot, held by the reader, is not reused by the tracker
+    for (size_t frame_ind = 1; frame_ind < 4; ++frame_ind)
+        mono_slam.ProcessFrame(frame_ind, image);
+    EXPECT_EQ(0, held_state->frame_ind);
+    EXPECT_EQ(held_sal_pnts_count, held_state->sal_pnts.size());
+
+    std::shared_ptr<const DavisonMonoSlamPublishedState> last_state = mono_slam.GetPublishedState();
+    ASSERT_NE(nullptr, last_state);
+    EXPECT_EQ(3, last_state->frame_ind);
+    EXPECT_GT(last_state->version, held_state->version);
+}
+
+TEST_F(DavisonMonoSlamTest, BlockedUpdateEqualsStackedUpdate)
+{
+    std::array<DavisonMonoSlam, 2> mono_slams;
+    std::array<std::shared_ptr<PerfectCornersMatcher>, 2> matchers;
+    for (size_t i = 0; i < mono_slams.size(); ++i)
+    {
+        InitTracker(&mono_slams[i]);
+        matchers[i] = std::make_shared<PerfectCornersMatcher>(&mono_slams[i], cams_from_tracker_, pnts_tracker_, cam_intrinsics_.image_size);
+        mono_slams[i].SetCornersMatcher(matchers[i]);
+    }
+    mono_slams[0].mono_slam_update_impl_ = 1;
+    mono_slams[1].mono_slam_update_impl_ = 6;
+    mono_slams[1].update_block_sal_pnts_ = 3;  // many blocks of unequal size
+
+    // the results differ only by rounding errors
+    const Scalar tol = std::sqrt(std::numeric_limits<Scalar>::epsilon());
+    Picture image;
+    for (size_t frame_ind = 0; frame_ind < 20; ++frame_ind)
+    {
+        for (DavisonMonoSlam& mono_slam : mono_slams)
+            mono_slam.ProcessFrame(frame_ind, image);
+
+        ASSERT_EQ(mono_slams[0].SalientPointsCount(), mono_slams[1].SalientPointsCount());
+        Point3 pos0 = mono_slams[0].GetCameraEstimatedVars().pos_w;
+        Point3 pos1 = mono_slams[1].GetCameraEstimatedVars().pos_w;
+        EXPECT_LT((pos0 - pos1).norm(), tol * (1 + pos0.norm())) << "frame_ind=" << frame_ind;
+    }
+}
+
+TEST_F(DavisonMonoSlamTest, UpdateImplAutoChoiceDependsOnObservationsAndVariables)
+{
+    const size_t block_sal_pnts = 8;
+
+    // the observations fit in one block
+    EXPECT_EQ(1, DavisonMonoSlam::ChooseUpdateImpl(8, 120, block_sal_pnts));
+
+    // the inversion of the stacked innovation matrix [2m,2m] dominates for many observations
+    EXPECT_EQ(6, DavisonMonoSlam::ChooseUpdateImpl(40, 120, block_sal_pnts));
+    EXPECT_EQ(6, DavisonMonoSlam::ChooseUpdateImpl(100, 1200, block_sal_pnts));
+
+    // the passes over the covariance matrix [n,n] in each block dominate for many estimated variables
+    EXPECT_EQ(1, DavisonMonoSlam::ChooseUpdateImpl(40, 1200, block_sal_pnts));
+
+    // all observations in one block
+    EXPECT_EQ(1, DavisonMonoSlam::ChooseUpdateImpl(40, 120, 40));
+}
+}
@@ -69,4 +69,15 @@ TEST_P(GeomTest, RectIntersect)
     EXPECT_EQ(data.result.value_or(NullRect), c2.value_or(NullRect));
 }
 
+TEST(GeomRectTest, ShrinkRectWhenFixedCenter)
+{
+    EXPECT_EQ((R{ 12, 6, 10, 8 }), ShrinkRectWhenFixedCenter(R{ 12, 6, 10, 8 }, suriko::Sizei{ 10, 8 }));
+    EXPECT_EQ((R{ 14, 7, 6, 6 }), ShrinkRectWhenFixedCenter(R{ 12, 6, 10, 8 }, suriko::Sizei{ 6, 6 }));
+    EXPECT_EQ((R{ 12, 8, 10, 3 }), ShrinkRectWhenFixedCenter(R{ 12, 6, 10, 8 }, suriko::Sizei{ 20, 3 }));
+
+    // shrinking is inverse to clamping
+    R r{ 3, 4, 5, 7 };
+    EXPECT_EQ(r, ShrinkRectWhenFixedCenter(ClampRectWhenFixedCenter(r, suriko::Sizei{ 11, 13 }), suriko::Sizei{ 5, 7 }));
+}
+
 }
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include "suriko/jet.h"
+#include "suriko/rt-config.h"
+
+namespace suriko_test
+{
+using namespace suriko;
+
+class JetTest : public testing::Test
+{
+public:
+    Scalar atol = (Scalar)1e-5;
+
+    /// The function, generic on the scalar type, to compare its derivatives by jets with finite differences.
+    template <typename T>
+    static Eigen::Matrix<T, 2, 1> Fun(const Eigen::Matrix<T, 3, 1>& x)
+    {
+        using std::sin, std::cos, std::sqrt, std::atan2, std::exp, std::log;
+        Eigen::Matrix<T, 2, 1> y;
+        y[0] = sin(x[0]) * cos(x[1]) + sqrt(x[2] * x[2] + 1) / (x[0] + 3);
+        y[1] = atan2(x[1], x[0]) - 2 * exp(x[2]) + log(x[0] * x[0] + 1) * x[1];
+        return y;
+    }
+};
+
+TEST_F(JetTest, Arithmetic)
+{
+    using J = Jet<Scalar, 2>;
+    J x((Scalar)3, 0);
+    J y((Scalar)2, 1);
+
+    J f = x * y - x / y + 1 - 2 * x + y / 4;
+    EXPECT_NEAR(6 - 1.5 + 1 - 6 + 0.5, f.a, atol);
+    // df/dx=y-1/y-2, df/dy=x+x/y^2+1/4
+    EXPECT_NEAR(2 - 0.5 - 2, f.v[0], atol);
+    EXPECT_NEAR(3 + 0.75 + 0.25, f.v[1], atol);
+
+    J g = 1 / x;
+    EXPECT_NEAR(-1 / 9.0, g.v[0], atol);
+    EXPECT_NEAR(0, g.v[1], atol);
+}
+
+TEST_F(JetTest, JacobianMatchesFiniteDifferences)
+{
+    Eigen::Matrix<Scalar, 3, 1> x{ (Scalar)0.3, (Scalar)-0.7, (Scalar)0.5 };
+
+    Eigen::Matrix<Scalar, 2, 1> y;
+    Eigen::Matrix<Scalar, 2, 3> y_by_x;
+    JetJacobian<2>([](const auto& xj) { return Fun(xj); }, x, &y, &y_by_x);
+    EXPECT_TRUE(y.isApprox(Fun(x)));
+
+    const Scalar eps = (Scalar)1e-5;
+    Eigen::Matrix<Scalar, 2, 3> y_by_x_num;
+    for (int j = 0; j < 3; ++j)
+    {
+        Eigen::Matrix<Scalar, 3, 1> x_plus = x;
+        Eigen::Matrix<Scalar, 3, 1> x_minus = x;
+        x_plus[j] += eps;
+        x_minus[j] -= eps;
+        y_by_x_num.col(j) = (Fun(x_plus) - Fun(x_minus)) / (2 * eps);
+    }
+    EXPECT_TRUE(y_by_x.isApprox(y_by_x_num, (Scalar)1e-4)) << y_by_x << std::endl << y_by_x_num;
+}
+
+TEST_F(JetTest, EigenMatrixOfJets)
+{
+    using J = Jet<Scalar, 3>;
+    Eigen::Matrix<Scalar, 3, 3> R = Eigen::AngleAxis<Scalar>((Scalar)0.4, Eigen::Matrix<Scalar, 3, 1>::UnitZ()).toRotationMatrix();
+    Eigen::Matrix<Scalar, 3, 1> x{ 1, 2, 3 };
+
+    // d(R*x)/dx=R, d(x.x)/dx=2x
+    Eigen::Matrix<J, 3, 1> xj = JetVariables<3>(x);
+    Eigen::Matrix<J, 3, 1> rx = R.cast<J>() * xj;
+    J xx = xj.dot(xj);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR((R * x)[i], rx[i].a, atol);
+        EXPECT_TRUE(rx[i].v.isApprox(R.row(i).transpose()));
+    }
+    EXPECT_TRUE(xx.v.isApprox(2 * x));
+}
+}
@@ -0,0 +1,249 @@
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <Eigen/Dense>
+#include "suriko/lin-alg.h"
+#include "suriko/rt-config.h"
+
+namespace suriko_test
+{
+using namespace suriko;
+
+class LinAlgTest : public testing::Test
+{
+public:
+    using EigenDynMat = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+    using EigenDynVec = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+    Scalar atol = (Scalar)1e-4;
+
+    static EigenDynMat RandomCovar(Eigen::Index n)
+    {
+        EigenDynMat a = EigenDynMat::Random(n, n);
+        return a * a.transpose() + EigenDynMat::Identity(n, n);
+    }
+
+    static bool IsLowerTriangular(const EigenDynMat& m)
+    {
+        return m.triangularView<Eigen::StrictlyUpper>().toDenseMatrix().isZero();
+    }
+};
+
+TEST_F(LinAlgTest, CholeskyFactorPsdOfSingularMatrix)
+{
+    // the last variable is the copy of the first one
+    EigenDynMat a = EigenDynMat::Random(4, 3);
+    a.row(3) = a.row(0);
+    EigenDynMat P = a * a.transpose();
+
+    EigenDynMat L;
+    CholeskyFactorPsd(P, &L);
+    EXPECT_TRUE(IsLowerTriangular(L));
+    EXPECT_TRUE((L * L.transpose()).isApprox(P, atol));
+    EXPECT_NEAR(0, L(3, 3), atol);
+}
+
+TEST_F(LinAlgTest, CholeskyFactorRankOneUpdate)
+{
+    EigenDynMat P = RandomCovar(7);
+    EigenDynVec x = EigenDynVec::Random(7);
+    x.head(2).setZero();
+    EigenDynMat P_new = P + x * x.transpose();
+
+    EigenDynMat L = P.llt().matrixL();
+    CholeskyFactorRankOneUpdate(L, x);
+    EXPECT_TRUE(IsLowerTriangular(L));
+    EXPECT_TRUE((L * L.transpose()).isApprox(P_new, atol));
+}
+
+TEST_F(LinAlgTest, CholeskyFactorScalarMeasurementUpdateEqualsKalmanUpdate)
+{
+    EigenDynMat P = RandomCovar(9);
+    EigenDynVec h = EigenDynVec::Zero(9);
+    h[2] = (Scalar)0.7;
+    h[5] = (Scalar)-1.3;
+    Scalar r = (Scalar)0.4;
+
+    // conventional form
+    Scalar s_expect = h.dot(P * h) + r;
+    EigenDynVec K_expect = P * h / s_expect;
+    EigenDynMat P_expect = P - s_expect * K_expect * K_expect.transpose();
+
+    EigenDynMat L = P.llt().matrixL();
+    EigenDynVec f = L.transpose() * h;
+    EigenDynVec K(9);
+    Scalar s = CholeskyFactorScalarMeasurementUpdate(L, f, r, K);
+
+    EXPECT_NEAR(s_expect, s, atol);
+    EXPECT_TRUE(K.isApprox(K_expect, atol));
+    EXPECT_TRUE(IsLowerTriangular(L));
+    EXPECT_TRUE((L * L.transpose()).isApprox(P_expect, atol));
+}
+
+TEST_F(LinAlgTest, CholeskyFactorExtend)
+{
+    EigenDynMat P = RandomCovar(8);
+
+    EigenDynMat L = P.topLeftCorner(5, 5).llt().matrixL();
+    CholeskyFactorExtend(P, &L);
+    EXPECT_EQ(8, L.rows());
+    EXPECT_TRUE(IsLowerTriangular(L));
+    EXPECT_TRUE((L * L.transpose()).isApprox(P, atol));
+}
+
+TEST_F(LinAlgTest, CholeskyFactorKeepVars)
+{
+    EigenDynMat P = RandomCovar(8);
+    std::vector<size_t> keep_var_inds = { 0, 1, 4, 5, 7 };
+
+    EigenDynMat P_kept(5, 5);
+    for (size_t i = 0; i < keep_var_inds.size(); ++i)
+        for (size_t j = 0; j < keep_var_inds.size(); ++j)
+            P_kept(i, j) = P(keep_var_inds[i], keep_var_inds[j]);
+
+    EigenDynMat L = P.llt().matrixL();
+    CholeskyFactorKeepVars(keep_var_inds, &L);
+    EXPECT_EQ(5, L.rows());
+    EXPECT_TRUE(IsLowerTriangular(L));
+    EXPECT_TRUE((L * L.transpose()).isApprox(P_kept, atol));
+}
+
+TEST_F(LinAlgTest, CovarBlockFromCholeskyFactor)
+{
+    EigenDynMat P = RandomCovar(9);
+    EigenDynMat L = P.llt().matrixL();
+
+    EXPECT_TRUE(CovarBlockFromCholeskyFactor(L, 0, 3, 0, 9).isApprox(P.topRows(3), atol));
+    EXPECT_TRUE(CovarBlockFromCholeskyFactor(L, 6, 3, 2, 2).isApprox(P.block(6, 2, 3, 2), atol));
+    EXPECT_TRUE(CovarBlockFromCholeskyFactor(L, 4, 2, 4, 2).isApprox(P.block(4, 4, 2, 2), atol));
+}
+
+TEST_F(LinAlgTest, CholeskyFactorMeasurementUpdatesKeepMarginalsInScalarPrecision)
+{
+    // the sequence of scalar measurements of the camera (the first 3 variables) and of one of salient points (3 variables each)
+    // is incorporated into the factor in the precision of Scalar (float or double) and into the covariance in double;
+    // the marginals, derived from the factor, must be as accurate as the precision of Scalar allows
+    using DoubleMat = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>;
+    constexpr Eigen::Index kCam = 3;
+    constexpr Eigen::Index kSalPnt = 3;
+    constexpr Eigen::Index kSalPnts = 5;
+    constexpr Eigen::Index n = kCam + kSalPnts * kSalPnt;
+    const Scalar rtol = 10 * std::sqrt(std::numeric_limits<Scalar>::epsilon());
+
+    EigenDynMat P = RandomCovar(n);
+    DoubleMat P_expect = P.cast<double>();
+    EigenDynMat L = P.llt().matrixL();
+
+    EigenDynVec f(n);
+    EigenDynVec K(n);
+    for (int obs_ind = 0; obs_ind < 40; ++obs_ind)
+    {
+        const Eigen::Index sal_pnt_var_ind = kCam + (obs_ind % kSalPnts) * kSalPnt;
+        EigenDynVec h = EigenDynVec::Zero(n);
+        h.head(kCam) = EigenDynVec::Random(kCam);
+        h.segment(sal_pnt_var_ind, kSalPnt) = EigenDynVec::Random(kSalPnt);
+        Scalar r = (Scalar)0.01;
+
+        Eigen::VectorXd h_d = h.cast<double>();
+        double s_expect = h_d.dot(P_expect * h_d) + r;
+        Eigen::VectorXd K_expect = P_expect * h_d / s_expect;
+        P_expect -= s_expect * K_expect * K_expect.transpose();
+
+        f.noalias() = L.transpose() * h;
+        CholeskyFactorScalarMeasurementUpdate(L, f, r, K);
+    }
+    EXPECT_TRUE(IsLowerTriangular(L));
+
+    // the rows of the camera
+    EigenDynMat P_cam = CovarBlockFromCholeskyFactor(L, 0, kCam, 0, n);
+    EXPECT_TRUE(P_cam.cast<double>().isApprox(P_expect.topRows(kCam), rtol)) << P_cam;
+
+    // the marginals of salient points
+    for (Eigen::Index sal_pnt_ind = 0; sal_pnt_ind < kSalPnts; ++sal_pnt_ind)
+    {
+        const Eigen::Index var_ind = kCam + sal_pnt_ind * kSalPnt;
+        EigenDynMat P_sal_pnt = CovarBlockFromCholeskyFactor(L, var_ind, kSalPnt, var_ind, kSalPnt);
+        EXPECT_TRUE(P_sal_pnt.cast<double>().isApprox(P_expect.block(var_ind, var_ind, kSalPnt, kSalPnt), rtol)) << P_sal_pnt;
+        EXPECT_GT(P_sal_pnt.determinant(), 0);
+    }
+}
+
+TEST_F(LinAlgTest, SymmetricEigenDecomp2x2EqualsIterativeSolver)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        Eigen::Matrix<Scalar, 2, 2> a = Eigen::Matrix<Scalar, 2, 2>::Random();
+        Eigen::Matrix<Scalar, 2, 2> P = a * a.transpose();
+
+        Scalar eig_val_max, eig_val_min, cos_major, sin_major;
+        SymmetricEigenDecomp2x2(P(0, 0), P(0, 1), P(1, 1), &eig_val_max, &eig_val_min, &cos_major, &sin_major);
+
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 2, 2>> eigen_solver(P);
+        EXPECT_NEAR(eigen_solver.eigenvalues()[1], eig_val_max, atol);
+        EXPECT_NEAR(eigen_solver.eigenvalues()[0], eig_val_min, atol);
+
+        Eigen::Matrix<Scalar, 2, 1> major{ cos_major, sin_major };
+        EXPECT_NEAR(1, major.norm(), atol);
+        EXPECT_TRUE((P * major).isApprox(eig_val_max * major, atol));
+    }
+}
+
+TEST_F(LinAlgTest, SymmetricEigenDecomp2x2OfScaledIdentity)
+{
+    Scalar eig_val_max, eig_val_min, cos_major, sin_major;
+    SymmetricEigenDecomp2x2(3, 0, 3, &eig_val_max, &eig_val_min, &cos_major, &sin_major);
+    EXPECT_NEAR(3, eig_val_max, atol);
+    EXPECT_NEAR(3, eig_val_min, atol);
+    EXPECT_NEAR(1, cos_major, atol);
+    EXPECT_NEAR(0, sin_major, atol);
+}
+
+TEST_F(LinAlgTest, SymmetricEigenDecomp2x2BatchEqualsOneByOne)
+{
+    SymMat2x2Batch mats;
+    for (int i = 0; i < 9; ++i)
+    {
+        Eigen::Matrix<Scalar, 2, 2> a = Eigen::Matrix<Scalar, 2, 2>::Random();
+        mats.PushBack(a * a.transpose());
+    }
+
+    SymEigen2x2Batch eigs;
+    SymmetricEigenDecomp2x2Batch(mats, &eigs);
+    ASSERT_EQ(mats.Size(), eigs.eig_val_max.size());
+    for (size_t i = 0; i < mats.Size(); ++i)
+    {
+        Scalar eig_val_max, eig_val_min, cos_major, sin_major;
+        SymmetricEigenDecomp2x2(mats.xx[i], mats.xy[i], mats.yy[i], &eig_val_max, &eig_val_min, &cos_major, &sin_major);
+        EXPECT_EQ(eig_val_max, eigs.eig_val_max[i]);
+        EXPECT_EQ(eig_val_min, eigs.eig_val_min[i]);
+        EXPECT_EQ(cos_major, eigs.cos_major[i]);
+        EXPECT_EQ(sin_major, eigs.sin_major[i]);
+    }
+}
+
+TEST_F(LinAlgTest, IsPositiveSemidefinite)
+{
+    Eigen::Matrix<Scalar, 3, 3> a = Eigen::Matrix<Scalar, 3, 3>::Random();
+    Eigen::Matrix<Scalar, 3, 3> P = a * a.transpose();
+    EXPECT_TRUE(IsPositiveSemidefinite(P));
+
+    // singular, the last variable is the copy of the first one
+    Eigen::Matrix<Scalar, 3, 3> P_singular = P;
+    P_singular.row(2) = P_singular.row(0);
+    P_singular.col(2) = P_singular.col(0);
+    EXPECT_TRUE(IsPositiveSemidefinite(P_singular));
+
+    Eigen::Matrix<Scalar, 3, 3> P_neg = P - 2 * P.trace() * Eigen::Matrix<Scalar, 3, 3>::Identity();
+    EXPECT_FALSE(IsPositiveSemidefinite(P_neg));
+
+    // zero variance, correlated with other variable
+    Eigen::Matrix<Scalar, 2, 2> indefinite;
+    indefinite << 0, 1, 1, 1;
+    EXPECT_FALSE(IsPositiveSemidefinite(indefinite));
+
+    Eigen::Matrix<Scalar, 2, 2> nan_mat;
+    nan_mat << std::numeric_limits<Scalar>::quiet_NaN(), 0, 0, 1;
+    EXPECT_FALSE(IsPositiveSemidefinite(nan_mat));
+}
+}
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <limits>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <Eigen/Dense>
@@ -81,5 +82,86 @@ TEST_F(ObsGeomTest, UnityDirAndAngleCornerCases)
 	EXPECT_FALSE(op) << "ang != 0 is unchecked";
 }
 
+TEST_F(ObsGeomTest, RightJacobianSO3)
+{
+	Point3 v{ 0.3, -0.2, 0.5 };
+	Point3 dv{ 1e-6, 2e-6, -1e-6 };
+	// both the error O(|dv|^2) of the first order approximation and the rounding error are well below this
+	const Scalar rot_tol = std::sqrt(std::numeric_limits<Scalar>::epsilon());
+
+	Eigen::Matrix<Scalar, 3, 3> jr;
+	RightJacobianSO3(v, &jr);
+
+	// Exp(v+dv)=Exp(v)*Exp(Jr(v)*dv)
+	Eigen::Matrix<Scalar, 3, 3> R1;
+	Eigen::Matrix<Scalar, 3, 3> R2;
+	Eigen::Matrix<Scalar, 3, 3> R_delta;
+	ASSERT_TRUE(RotMatFromAxisAngle(v + dv, &R1));
+	ASSERT_TRUE(RotMatFromAxisAngle(v, &R2));
+	ASSERT_TRUE(RotMatFromAxisAngle(jr * dv, &R_delta));
+	EXPECT_NEAR(0, (R1 - R2 * R_delta).norm(), rot_tol);
+
+	Eigen::Matrix<Scalar, 3, 3> jr_inv;
+	RightJacobianInvSO3(v, &jr_inv);
+	EXPECT_NEAR(0, (jr * jr_inv - Eigen::Matrix<Scalar, 3, 3>::Identity()).norm(), atol);
+
+	// small angles
+	RightJacobianSO3(dv, &jr);
+	RightJacobianInvSO3(dv, &jr_inv);
+	EXPECT_NEAR(0, (jr * jr_inv - Eigen::Matrix<Scalar, 3, 3>::Identity()).norm(), atol);
+}
 
+TEST_F(ObsGeomTest, PointInsideRotatedEllipse)
+{
+    Eigen::Matrix<Scalar, 2, 2> cov;
+    cov << 9, 3,
+           3, 4;
+    Eigen::Matrix<Scalar, 2, 1> mean{ 100, 50 };
+    auto [op, ellipse] = Get2DRotatedEllipseFromCovMat(cov, mean, (Scalar)0.95);
+    ASSERT_TRUE(op);
+
+    EXPECT_TRUE(IsPointInsideEllipse(ellipse, mean));
+
+    // the ends of the major axis are on the border
+    Eigen::Matrix<Scalar, 2, 1> major_dir = ellipse.world_from_ellipse.R.col(0);
+    Scalar a = ellipse.semi_axes[0];
+    EXPECT_TRUE(IsPointInsideEllipse(ellipse, mean + major_dir * (a * (Scalar)0.99)));
+    EXPECT_FALSE(IsPointInsideEllipse(ellipse, mean + major_dir * (a * (Scalar)1.01)));
+
+    // the ellipse is bounded by its rectangle
+    Rect bounds = GetEllipseBounds2(ellipse);
+    EXPECT_FALSE(IsPointInsideEllipse(ellipse, Eigen::Matrix<Scalar, 2, 1>{ bounds.x - 1, mean[1] }));
+    EXPECT_FALSE(IsPointInsideEllipse(ellipse, Eigen::Matrix<Scalar, 2, 1>{ bounds.x + bounds.width + 1, bounds.y + bounds.height + 1 }));
+}
+
+TEST_F(ObsGeomTest, HomographyFrom4Points)
+{
+    Eigen::Matrix<Scalar, 3, 3> H_gt;
+    H_gt << (Scalar)1.1, (Scalar)0.2, 5,
+            (Scalar)-0.1, (Scalar)0.9, 7,
+            (Scalar)0.001, (Scalar)0.002, 1;
+
+    auto apply = [](const Eigen::Matrix<Scalar, 3, 3>& H, const suriko::Point2f& p)
+    {
+        Eigen::Matrix<Scalar, 3, 1> q = H * Eigen::Matrix<Scalar, 3, 1>{ p[0], p[1], 1 };
+        return suriko::Point2f{ q[0] / q[2], q[1] / q[2] };
+    };
+
+    std::array<suriko::Point2f, 4> src = { suriko::Point2f{0, 0}, suriko::Point2f{15, 0}, suriko::Point2f{0, 15}, suriko::Point2f{15, 15} };
+    std::array<suriko::Point2f, 4> dst;
+    for (size_t i = 0; i < src.size(); ++i)
+        dst[i] = apply(H_gt, src[i]);
+
+    std::optional<Eigen::Matrix<Scalar, 3, 3>> H = HomographyFrom4Points(src, dst);
+    ASSERT_TRUE(H.has_value());
+    EXPECT_TRUE(H.value().isApprox(H_gt, (Scalar)1e-4)) << H.value();
+
+    // the point, which is not used to find the homography
+    suriko::Point2f p{ 4, 11 };
+    EXPECT_TRUE(apply(H.value(), p).Mat().isApprox(apply(H_gt, p).Mat(), (Scalar)1e-4));
+
+    // collinear points
+    std::array<suriko::Point2f, 4> degenerate = { suriko::Point2f{0, 0}, suriko::Point2f{1, 1}, suriko::Point2f{2, 2}, suriko::Point2f{3, 3} };
+    EXPECT_FALSE(HomographyFrom4Points(degenerate, dst).has_value());
+}
 }
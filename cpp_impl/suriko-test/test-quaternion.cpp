@@ -102,6 +102,20 @@ TEST_F(QuaternionTest, ZeroAxisAngleToQuat)
     EXPECT_NEAR(0, diff_value, atol);
 }
 
+TEST_F(QuaternionTest, SmallAxisAngleToQuatAndBack)
+{
+    Eigen::Matrix<Scalar, 3, 1> v(1e-4, -2e-4, 3e-4);
+
+    Eigen::Matrix<Scalar, 4, 1> q{};
+    QuatFromAxisAngle(v, &q);
+
+    Eigen::Matrix<Scalar, 3, 1> v_back;
+    AxisAngleFromQuat(q, &v_back);
+
+    Scalar diff_value = (v_back - v).norm();
+    EXPECT_NEAR(0, diff_value, 1e-6 * v.norm());
+}
+
 TEST_F(QuaternionTest, RotMatToQuat)
 {
     Point3 v(1,2,3);
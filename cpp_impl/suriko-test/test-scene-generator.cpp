@@ -0,0 +1,51 @@
+#include <vector>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <Eigen/Dense>
+#include "suriko/obs-geom.h"
+#include "suriko/rt-config.h"
+#include "suriko/virt-world/scene-generator.h"
+
+namespace suriko_test
+{
+using namespace suriko;
+using namespace suriko::virt_world;
+
+class SceneGeneratorTest : public testing::Test
+{
+public:
+    Scalar atol = (Scalar)1e-3;
+};
+
+TEST_F(SceneGeneratorTest, ImuSamplesOfAcceleratingRotatingCamera)
+{
+    Scalar dT = (Scalar)0.05;
+    Scalar ang_vel = (Scalar)0.4;  // around the camera's Z axis
+    Point3 accel_w{ 0.3, -0.1, 0.2 };
+    Point3 gravity_w{ 0, 0, -9.8 };
+
+    std::vector<SE3Transform> cfw;
+    for (int i = 0; i < 10; ++i)
+    {
+        Scalar t = i * dT;
+        SE3Transform wfc{ internals::RotMat(0, 0, 1, ang_vel * t), Point3{ accel_w * (t * t / 2) } };
+        cfw.push_back(SE3Inv(wfc));
+    }
+
+    std::vector<ImuSample> imu_samples;
+    GenerateImuSamples(cfw, dT, gravity_w, 0, 0, nullptr, &imu_samples);
+    ASSERT_EQ(cfw.size() - 1, imu_samples.size());
+
+    for (size_t i = 0; i < imu_samples.size(); ++i)
+    {
+        const ImuSample& imu = imu_samples[i];
+        ASSERT_TRUE(imu.angular_velocity_c.has_value());
+        ASSERT_TRUE(imu.specific_force_c.has_value());
+        EXPECT_NEAR(0, (imu.angular_velocity_c.value() - Point3{ 0, 0, ang_vel }).norm(), atol);
+
+        Point3 expect_force_c{ cfw[i].R * (accel_w - gravity_w) };
+        EXPECT_NEAR(0, (imu.specific_force_c.value() - expect_force_c).norm(), atol);
+    }
+}
+}